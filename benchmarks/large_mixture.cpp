@@ -0,0 +1,74 @@
+/*
+Scaling benchmark for mixtures with many pseudo-components, such as
+characterized crude oils and condensates.
+
+The fugacity coefficients and the compressibility factor are timed for
+synthetic mixtures with n = 10, 50, 100 and 200 components at a liquid-like
+density. It is built with the library by CMake (the target large_mixture).
+*/
+#include <cstdio>
+#include <chrono>
+#include <vector>
+
+#include "pcsaft_internal.h"
+
+using namespace std;
+
+static double time_per_call(int ncall, vector<double> &x, vector<double> &m, vector<double> &s,
+    vector<double> &e, double t, double rho, add_args &cppargs, bool fugcoef) {
+    /**Return the average time per call in microseconds.*/
+    double sink = 0.;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int k = 0; k < ncall; k++) {
+        if (fugcoef) {
+            sink += pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs)[0];
+        }
+        else {
+            sink += pcsaft_Z_cpp(x, m, s, e, t, rho, cppargs);
+        }
+    }
+    chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+    if (sink == 0.12345) {
+        printf(" ");
+    }
+    return elapsed.count()/ncall;
+}
+
+int main() {
+    int sizes[4] = {10, 50, 100, 200};
+    double t = 350.;
+    printf("%6s %14s %14s\n", "ncomp", "fugcoef (us)", "Z (us)");
+    for (int k = 0; k < 4; k++) {
+        int ncomp = sizes[k];
+        vector<double> x(ncomp), m(ncomp), s(ncomp), e(ncomp);
+        double xsum = 0.;
+        for (int i = 0; i < ncomp; i++) {
+            double f = (double) i/ncomp;
+            m[i] = 1. + 9.*f; // from methane-like to heavy pseudo-components
+            s[i] = 3.7 + 0.3*f;
+            e[i] = 150. + 120.*f;
+            x[i] = 1. + 0.5*(i % 3);
+            xsum += x[i];
+        }
+        for (int i = 0; i < ncomp; i++) {
+            x[i] = x[i]/xsum;
+        }
+
+        add_args cppargs;
+        cppargs.k_ij.assign(ncomp*ncomp, 0.);
+        for (int i = 0; i < ncomp; i++) {
+            for (int j = 0; j < ncomp; j++) {
+                if (i != j) {
+                    cppargs.k_ij[i*ncomp+j] = 0.001*abs(i-j)/ncomp;
+                }
+            }
+        }
+
+        double rho = pcsaft_den_cpp(x, m, s, e, t, 1.0e6, 0, cppargs);
+        int ncall = 200000/(ncomp*ncomp) + 10;
+        double t_fug = time_per_call(ncall, x, m, s, e, t, rho, cppargs, true);
+        double t_Z = time_per_call(ncall, x, m, s, e, t, rho, cppargs, false);
+        printf("%6d %14.2f %14.2f\n", ncomp, t_fug, t_Z);
+    }
+    return 0;
+}
@@ -0,0 +1,531 @@
+/*
+Microbenchmarks of the kernels and solvers of the C++ core.
+
+pcsaft_Z_cpp, pcsaft_fugcoef_cpp, pcsaft_dadt_cpp, pcsaft_den_cpp (liquid and
+vapor), XA_find, dXA_find, bubblePfit_cpp and PTzfit_cpp are timed with the
+fluids of the Python tests: toluene (non-associating), water and acetic acid
+(associating), butyl acetate (polar), methanol-cyclohexane (binary) and
+aqueous NaCl (electrolyte). For every benchmark the time per call, the number
+of evaluations of the equation of state per call (i.e. per solve for the
+solvers) and the number of heap allocations per call are written as JSON.
+For the fluids that the batch kernels support, the liquid density of 256
+states is solved once with pcsaft_den_batch_cpp (den_batch) and once with a
+loop over pcsaft_den_cpp (den_loop); the speedup of the batch, which should be
+at least 4 on one core, is printed to stderr.
+The evaluations are the calls of pcsaft_Z_cpp, pcsaft_fugcoef_cpp,
+pcsaft_ares_cpp and pcsaft_dadt_cpp, including the calls they make of each
+other (pcsaft_fugcoef_cpp evaluates Z as well). They are taken from the
+counters of PCSAFT_INSTRUMENT, and written as null if the library was built
+without it.
+
+The benchmark is built with the library by CMake (the target pcsaft_bench),
+and is also the training workload of the profile-guided build (see README).
+
+Usage:
+
+    pcsaft_bench [--out FILE] [--filter TEXT] [--min-time SECONDS]
+                 [--baseline FILE] [--threshold FRACTION]
+
+With --baseline the results are compared with a file written earlier by
+pcsaft_bench: the ratio of the times is added to each benchmark, and the exit
+status is 1 if any benchmark is slower than the baseline by more than the
+threshold (default 0.1).
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <limits>
+
+#include "pcsaft_internal.h"
+
+using namespace std;
+
+// Heap allocations are counted by replacing the global operator new. The
+// benchmarks run on a single thread, so the counter does not need a lock.
+static long alloc_count = 0;
+
+void *operator new(size_t size) {
+    alloc_count++;
+    void *ptr = malloc(size > 0 ? size : 1);
+    if (ptr == NULL) {
+        throw bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+    free(ptr);
+}
+
+
+static double eval_count() {
+    /**Evaluations of the equation of state so far, or NaN without PCSAFT_INSTRUMENT.*/
+    if (!instrument_enabled_cpp()) {
+        return numeric_limits<double>::quiet_NaN();
+    }
+    vector<instrument_counters> counters = instrument_snapshot_cpp();
+    double evals = 0.;
+    for (size_t k = 0; k < counters.size(); k++) {
+        evals += counters[k].evals;
+    }
+    return evals;
+}
+
+
+struct fluid {
+    string name;
+    vector<double> x, m, s, e;
+    add_args cppargs;
+    double t; // temperature of the states (K)
+    double p_liq; // pressure of the liquid state (Pa)
+    vector<double> xv; // composition of the vapor state
+    double p_vap; // pressure of the vapor state (Pa)
+};
+
+struct benchmark {
+    string name;
+    function<double()> fn;
+};
+
+struct bench_result {
+    string name;
+    double ns_per_call;
+    double ns_min;
+    double evals_per_call;
+    double allocs_per_call;
+    double baseline_ns_per_call; // NaN without a baseline
+};
+
+
+static double water_sigma(double t) {
+    /**Temperature dependent segment diameter of water (Angstrom).*/
+    return 2.7927 + 10.11*exp(-0.01775*t) - 1.417*exp(-0.01146*t);
+}
+
+
+static vector<fluid> test_fluids() {
+    /**The fluids and states of "pc-saft tests cython.py".*/
+    vector<fluid> fluids;
+    fluid f;
+
+    f = fluid();
+    f.name = "toluene";
+    f.x = {1.};
+    f.m = {2.8149};
+    f.s = {3.7169};
+    f.e = {285.69};
+    f.t = 320.;
+    f.p_liq = 101325.;
+    f.xv = f.x;
+    f.p_vap = 5000.;
+    fluids.push_back(f);
+
+    f = fluid();
+    f.name = "water";
+    f.t = 298.15;
+    f.x = {1.};
+    f.m = {1.2047};
+    f.s = {water_sigma(f.t)};
+    f.e = {353.95};
+    f.cppargs.e_assoc = {2425.67};
+    f.cppargs.vol_a = {0.0451};
+    f.p_liq = 101325.;
+    f.xv = f.x;
+    f.p_vap = 1000.;
+    fluids.push_back(f);
+
+    f = fluid();
+    f.name = "acetic_acid";
+    f.x = {1.};
+    f.m = {1.3403};
+    f.s = {3.8582};
+    f.e = {211.59};
+    f.cppargs.e_assoc = {3044.4};
+    f.cppargs.vol_a = {0.075550};
+    f.t = 305.;
+    f.p_liq = 101325.;
+    f.xv = f.x;
+    f.p_vap = 1000.;
+    fluids.push_back(f);
+
+    f = fluid();
+    f.name = "butyl_acetate";
+    f.x = {1.};
+    f.m = {3.9706};
+    f.s = {3.5440};
+    f.e = {241.93};
+    f.cppargs.dipm = {1.86};
+    f.cppargs.dip_num = {1.0};
+    f.t = 300.;
+    f.p_liq = 101325.;
+    f.xv = f.x;
+    f.p_vap = 500.;
+    fluids.push_back(f);
+
+    f = fluid();
+    f.name = "methanol_cyclohexane";
+    f.x = {0.3, 0.7};
+    f.m = {1.5255, 2.5303};
+    f.s = {3.2300, 3.8499};
+    f.e = {188.90, 278.11};
+    f.cppargs.e_assoc = {2899.5, 0.};
+    f.cppargs.vol_a = {0.035176, 0.};
+    f.cppargs.k_ij = {0, 0.051, 0.051, 0};
+    f.t = 327.48;
+    f.p_liq = 101330.;
+    f.xv = {0.594, 0.406};
+    f.p_vap = 101330.;
+    fluids.push_back(f);
+
+    f = fluid();
+    f.name = "aqueous_nacl";
+    f.t = 298.15;
+    f.x = {0.0907304774758426, 0.0907304774758426, 0.818539045048315};
+    f.m = {1, 1, 1.2047};
+    f.s = {2.8232, 2.7599589, water_sigma(f.t)};
+    f.e = {230.00, 170.00, 353.9449};
+    f.cppargs.e_assoc = {0, 0, 2425.67};
+    f.cppargs.vol_a = {0, 0, 0.0451};
+    double k_w = -0.007981*f.t + 2.37999;
+    f.cppargs.k_ij = {0, 0.317, k_w,
+                      0.317, 0, -0.25,
+                      k_w, -0.25, 0};
+    f.cppargs.z = {1., -1., 0.};
+    double ddielc_dt;
+    f.cppargs.dielc = dielc_water_cpp(f.t, ddielc_dt);
+    f.p_liq = 2393.8;
+    f.xv = {0., 0., 1.};
+    f.p_vap = 1000.;
+    fluids.push_back(f);
+
+    return fluids;
+}
+
+
+static bool associating(const fluid &f) {
+    for (size_t i = 0; i < f.cppargs.vol_a.size(); i++) {
+        if (f.cppargs.vol_a[i] != 0.) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static void add_assoc_benchmarks(vector<benchmark> &benchmarks, const fluid &f, double rho) {
+    /**
+    Add XA_find and dXA_find for the liquid state of an associating fluid.
+
+    The association strengths are chosen so that the converged XA of the full
+    equation of state solves the XA equations, i.e. the kernels see the same
+    numbers as inside pcsaft_Z_cpp.
+    */
+    fluid g = f;
+    vector<double> XA;
+    pcsaft_p_cpp(g.x, g.m, g.s, g.e, g.t, rho, g.cppargs, &XA);
+
+    int ncomp = f.x.size();
+    int n_sites = 2;
+    vector<int> iA;
+    vector<double> x_assoc;
+    for (int i = 0; i < ncomp; i++) {
+        if (f.cppargs.vol_a[i] != 0.) {
+            iA.push_back(i);
+            x_assoc.push_back(f.x[i]);
+        }
+    }
+    int ncA = iA.size();
+    double den = rho*N_AV/1.0e30;
+    vector<double> delta_ij(ncA*ncA), ddelta_dd(ncA*ncA*ncomp);
+    for (int i = 0; i < ncA; i++) {
+        // with two sites per molecule 1/XA_i - 1 = den*sum_j(x_j*XA_j*delta_ij)
+        double summ = 0.;
+        for (int j = 0; j < ncA; j++) {
+            summ += x_assoc[j]*XA[j*n_sites];
+        }
+        for (int j = 0; j < ncA; j++) {
+            delta_ij[i*ncA+j] = (1./XA[i*n_sites] - 1.)/(den*summ);
+            for (int k = 0; k < ncomp; k++) {
+                ddelta_dd[(i*ncA+j)*ncomp+k] = 0.5*delta_ij[i*ncA+j]; // same order of magnitude as the real derivative
+            }
+        }
+    }
+    vector<double> XA_guess(XA.size(), 0.5);
+
+    benchmarks.push_back(benchmark{"XA_find/" + f.name, [=]() {
+        return XA_find(XA_guess, ncA, delta_ij, den, x_assoc)[0];
+    }});
+    benchmarks.push_back(benchmark{"dXA_find/" + f.name, [=]() {
+        return dXA_find(ncA, ncomp, iA, delta_ij, den, XA, ddelta_dd, x_assoc, n_sites)[0];
+    }});
+}
+
+
+static vector<benchmark> make_benchmarks(vector<fluid> &fluids) {
+    vector<benchmark> benchmarks;
+    for (size_t k = 0; k < fluids.size(); k++) {
+        fluid &f = fluids[k];
+        double rho_l = pcsaft_den_cpp(f.x, f.m, f.s, f.e, f.t, f.p_liq, 0, f.cppargs);
+        double rho_v = pcsaft_den_cpp(f.xv, f.m, f.s, f.e, f.t, f.p_vap, 1, f.cppargs);
+
+        benchmarks.push_back(benchmark{"Z/" + f.name, [&f, rho_l]() {
+            return pcsaft_Z_cpp(f.x, f.m, f.s, f.e, f.t, rho_l, f.cppargs);
+        }});
+        benchmarks.push_back(benchmark{"fugcoef/" + f.name, [&f, rho_l]() {
+            return pcsaft_fugcoef_cpp(f.x, f.m, f.s, f.e, f.t, rho_l, f.cppargs)[0];
+        }});
+        benchmarks.push_back(benchmark{"dadt/" + f.name, [&f, rho_l]() {
+            return pcsaft_dadt_cpp(f.x, f.m, f.s, f.e, f.t, rho_l, f.cppargs);
+        }});
+        benchmarks.push_back(benchmark{"den_liq/" + f.name, [&f]() {
+            return pcsaft_den_cpp(f.x, f.m, f.s, f.e, f.t, f.p_liq, 0, f.cppargs);
+        }});
+        benchmarks.push_back(benchmark{"den_vap/" + f.name, [&f]() {
+            return pcsaft_den_cpp(f.xv, f.m, f.s, f.e, f.t, f.p_vap, 1, f.cppargs);
+        }});
+        if (associating(f)) {
+            add_assoc_benchmarks(benchmarks, f, rho_l);
+        }
+        if (f.cppargs.dipm.empty() && f.cppargs.e_assoc.empty()) {
+            // liquid states within 20 K of the test temperature, all solved on one thread
+            vector<double> t_batch(256), p_batch(256, f.p_liq);
+            for (size_t k = 0; k < t_batch.size(); k++) {
+                t_batch[k] = f.t - 20. + 40.*k/(t_batch.size() - 1);
+            }
+            benchmarks.push_back(benchmark{"den_batch/" + f.name, [&f, t_batch, p_batch]() {
+                return pcsaft_den_batch_cpp(f.x, f.m, f.s, f.e, t_batch, p_batch, 0, f.cppargs)[0];
+            }});
+            benchmarks.push_back(benchmark{"den_loop/" + f.name, [&f, t_batch, p_batch]() {
+                double rho = 0.;
+                for (size_t k = 0; k < t_batch.size(); k++) {
+                    rho += pcsaft_den_cpp(f.x, f.m, f.s, f.e, t_batch[k], p_batch[k], 0, f.cppargs);
+                }
+                return rho;
+            }});
+        }
+
+        if (f.x.size() > 1) {
+            // phase equilibrium objective functions, as called by the minimizer
+            benchmarks.push_back(benchmark{"bubblePfit/" + f.name, [&f]() {
+                return bubblePfit_cpp(f.p_liq, f.xv, f.x, f.m, f.s, f.e, f.t, f.cppargs);
+            }});
+
+            // a state with 60 % vapor (0.1 % for the electrolyte) as in the PTz test
+            double beta = f.cppargs.z.empty() ? 0.6 : 0.001;
+            double mol = 1.;
+            double vol = beta*mol/rho_v + (1-beta)*mol/rho_l;
+            vector<double> x_total(f.x.size());
+            for (size_t i = 0; i < f.x.size(); i++) {
+                x_total[i] = beta*f.xv[i] + (1-beta)*f.x[i];
+            }
+            benchmarks.push_back(benchmark{"PTzfit/" + f.name, [&f, beta, mol, vol, x_total]() {
+                return PTzfit_cpp(f.p_liq, f.x, beta, mol, vol, x_total, f.m, f.s, f.e, f.t, f.cppargs);
+            }});
+        }
+    }
+    return benchmarks;
+}
+
+
+static bench_result run_benchmark(const benchmark &b, double min_time) {
+    /**
+    Time a benchmark. The number of calls per repetition is increased until a
+    repetition takes at least min_time/5, and the median of five repetitions
+    is reported.
+    */
+    bench_result r;
+    r.name = b.name;
+    r.baseline_ns_per_call = numeric_limits<double>::quiet_NaN();
+    double sink = 0.;
+
+    // a first call outside of the counts, e.g. for static initialization
+    sink += b.fn();
+    double evals0 = eval_count();
+    long allocs0 = alloc_count;
+    sink += b.fn();
+    r.evals_per_call = eval_count() - evals0;
+    r.allocs_per_call = alloc_count - allocs0;
+
+    long ncall = 1;
+    double elapsed;
+    for (;;) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (long k = 0; k < ncall; k++) {
+            sink += b.fn();
+        }
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (elapsed >= min_time/5. || ncall > (1L << 40)) {
+            break;
+        }
+        ncall = (elapsed > 0) ? max(2*ncall, (long)(ncall*1.2*min_time/5./elapsed)) : 2*ncall;
+    }
+
+    vector<double> ns(5);
+    ns[0] = elapsed*1e9/ncall;
+    for (int rep = 1; rep < 5; rep++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (long k = 0; k < ncall; k++) {
+            sink += b.fn();
+        }
+        ns[rep] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count()/ncall;
+    }
+    sort(ns.begin(), ns.end());
+    r.ns_per_call = ns[2];
+    r.ns_min = ns[0];
+
+    if (sink == 0.12345) {
+        printf(" ");
+    }
+    return r;
+}
+
+
+static map<string, double> read_baseline(const char *path) {
+    /**
+    Read the times of a JSON file written by this program. Only the format
+    written by write_json is understood (one benchmark per line).
+    */
+    map<string, double> times;
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return times;
+    }
+    char line[1024];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        const char *name = strstr(line, "\"name\": \"");
+        const char *ns = strstr(line, "\"ns_per_call\": ");
+        if (name == NULL || ns == NULL) {
+            continue;
+        }
+        name += strlen("\"name\": \"");
+        const char *end = strchr(name, '"');
+        if (end == NULL) {
+            continue;
+        }
+        times[string(name, end - name)] = atof(ns + strlen("\"ns_per_call\": "));
+    }
+    fclose(fp);
+    return times;
+}
+
+
+static void write_json(FILE *fp, const vector<bench_result> &results) {
+    fprintf(fp, "{\n  \"benchmarks\": [\n");
+    for (size_t k = 0; k < results.size(); k++) {
+        const bench_result &r = results[k];
+        fprintf(fp, "    {\"name\": \"%s\", \"ns_per_call\": %.1f, \"ns_min\": %.1f, ",
+            r.name.c_str(), r.ns_per_call, r.ns_min);
+        if (isfinite(r.evals_per_call)) {
+            fprintf(fp, "\"evals_per_call\": %.0f, ", r.evals_per_call);
+        }
+        else {
+            fprintf(fp, "\"evals_per_call\": null, ");
+        }
+        fprintf(fp, "\"allocs_per_call\": %.0f", r.allocs_per_call);
+        if (isfinite(r.baseline_ns_per_call)) {
+            fprintf(fp, ", \"baseline_ns_per_call\": %.1f, \"ratio\": %.4f",
+                r.baseline_ns_per_call, r.ns_per_call/r.baseline_ns_per_call);
+        }
+        fprintf(fp, "}%s\n", (k + 1 < results.size()) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+
+int main(int argc, char **argv) {
+    const char *out_path = NULL;
+    const char *baseline_path = NULL;
+    string filter;
+    double min_time = 0.2;
+    double threshold = 0.1;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 < argc && arg == "--out") {
+            out_path = argv[++i];
+        }
+        else if (i + 1 < argc && arg == "--baseline") {
+            baseline_path = argv[++i];
+        }
+        else if (i + 1 < argc && arg == "--filter") {
+            filter = argv[++i];
+        }
+        else if (i + 1 < argc && arg == "--min-time") {
+            min_time = atof(argv[++i]);
+        }
+        else if (i + 1 < argc && arg == "--threshold") {
+            threshold = atof(argv[++i]);
+        }
+        else {
+            fprintf(stderr, "usage: %s [--out FILE] [--filter TEXT] [--min-time SECONDS] "
+                "[--baseline FILE] [--threshold FRACTION]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    map<string, double> baseline;
+    if (baseline_path != NULL) {
+        baseline = read_baseline(baseline_path);
+        if (baseline.empty()) {
+            fprintf(stderr, "no benchmarks found in the baseline %s\n", baseline_path);
+            return 2;
+        }
+    }
+
+    vector<fluid> fluids = test_fluids();
+    vector<benchmark> benchmarks = make_benchmarks(fluids);
+    vector<bench_result> results;
+    int n_slower = 0;
+    for (size_t k = 0; k < benchmarks.size(); k++) {
+        if (!filter.empty() && benchmarks[k].name.find(filter) == string::npos) {
+            continue;
+        }
+        bench_result r = run_benchmark(benchmarks[k], min_time);
+        map<string, double>::const_iterator it = baseline.find(r.name);
+        if (it != baseline.end()) {
+            r.baseline_ns_per_call = it->second;
+            if (r.ns_per_call > (1. + threshold)*it->second) {
+                n_slower++;
+                fprintf(stderr, "slower: %s %.1f ns -> %.1f ns\n", r.name.c_str(), it->second, r.ns_per_call);
+            }
+        }
+        results.push_back(r);
+    }
+    for (size_t k = 0; k < results.size(); k++) {
+        if (results[k].name.compare(0, 10, "den_batch/") != 0) {
+            continue;
+        }
+        string fluid_name = results[k].name.substr(10);
+        for (size_t j = 0; j < results.size(); j++) {
+            if (results[j].name == "den_loop/" + fluid_name) {
+                fprintf(stderr, "den_batch/%s: %.1fx faster than den_loop (target 4x)\n", fluid_name.c_str(),
+                    results[j].ns_per_call/results[k].ns_per_call);
+            }
+        }
+    }
+
+    FILE *fp = stdout;
+    if (out_path != NULL) {
+        fp = fopen(out_path, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "cannot write %s\n", out_path);
+            return 2;
+        }
+    }
+    write_json(fp, results);
+    if (fp != stdout) {
+        fclose(fp);
+    }
+    return (n_slower > 0) ? 1 : 0;
+}
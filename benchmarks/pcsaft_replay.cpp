@@ -0,0 +1,167 @@
+/*
+Replay of a trace of calls recorded with trace_start_cpp (or trace_start in
+Python) by a build with PCSAFT_TRACE.
+
+Every call of the trace is evaluated again, on one or more threads. The
+throughput, the percentiles of the latency of the calls and the deviation of
+the results from the recorded results are reported for each function, so the
+same production workload can be used to find bottlenecks and to validate
+changes of the solvers. It is built with the library by CMake (the target
+pcsaft_replay); the trace is recorded by a build with -DPCSAFT_TRACE=ON.
+
+Usage:
+
+    pcsaft_replay TRACE [--threads N] [--repeat N] [--rtol TOLERANCE]
+
+The exit status is 1 if any result deviates from the recorded result by more
+than rtol (relative, default 1e-6), and 2 if the trace cannot be read.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <limits>
+#include <cmath>
+#include <omp.h>
+
+#include "pcsaft_internal.h"
+
+using namespace std;
+
+static const char *function_name(int fn) {
+    switch (fn) {
+        case TRACE_Z: return "Z";
+        case TRACE_P: return "p";
+        case TRACE_FUGCOEF: return "fugcoef";
+        case TRACE_DEN: return "den";
+        case TRACE_ARES: return "ares";
+        case TRACE_DADT: return "dadt";
+        case TRACE_HRES: return "hres";
+        case TRACE_SRES: return "sres";
+        case TRACE_GRES: return "gres";
+    }
+    return "unknown";
+}
+
+
+static double rel_deviation(const vector<double> &a, const vector<double> &b) {
+    /**Largest relative deviation between two results. NaN in both counts as equal.*/
+    if (a.size() != b.size()) {
+        return numeric_limits<double>::infinity();
+    }
+    double dev = 0.;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (isnan(a[i]) && isnan(b[i])) {
+            continue;
+        }
+        double d = fabs(a[i] - b[i])/max(fabs(b[i]), 1e-300);
+        dev = (d == d) ? max(dev, d) : numeric_limits<double>::infinity();
+    }
+    return dev;
+}
+
+
+static double percentile(vector<double> &v, double q) {
+    /**Return the q quantile of v, which is sorted in place.*/
+    if (v.empty()) {
+        return numeric_limits<double>::quiet_NaN();
+    }
+    sort(v.begin(), v.end());
+    size_t k = min(v.size() - 1, (size_t)(q*(v.size() - 1) + 0.5));
+    return v[k];
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s TRACE [--threads N] [--repeat N] [--rtol TOLERANCE]\n", argv[0]);
+        return 2;
+    }
+    string path = argv[1];
+    int nthreads = 1;
+    int repeat = 1;
+    double rtol = 1e-6;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        string arg = argv[i];
+        if (arg == "--threads") {
+            nthreads = atoi(argv[i+1]);
+        }
+        else if (arg == "--repeat") {
+            repeat = atoi(argv[i+1]);
+        }
+        else if (arg == "--rtol") {
+            rtol = atof(argv[i+1]);
+        }
+        else {
+            fprintf(stderr, "unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    vector<trace_mixture> mixtures;
+    vector<trace_call> calls;
+    if (!trace_read_cpp(path, mixtures, calls)) {
+        fprintf(stderr, "cannot read the trace %s\n", path.c_str());
+        return 2;
+    }
+    int ncall = calls.size();
+    printf("trace %s: %d calls, %d mixtures\n", path.c_str(), ncall, (int)mixtures.size());
+    if (ncall == 0) {
+        return 0;
+    }
+
+    vector<double> latency(ncall); // microseconds, of the last repetition
+    vector<double> deviation(ncall);
+    omp_set_num_threads(max(nthreads, 1));
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int rep = 0; rep < repeat; rep++) {
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (int k = 0; k < ncall; k++) {
+            chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+            vector<double> result = trace_eval_cpp(calls[k], mixtures[calls[k].mixture]);
+            chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+            latency[k] = chrono::duration<double, micro>(t1 - t0).count();
+            deviation[k] = rel_deviation(result, calls[k].result);
+        }
+    }
+    double wall = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("threads %d, repetitions %d: %.3f s, %.1f calls/s\n\n", nthreads, repeat, wall,
+        (double)ncall*repeat/wall);
+
+    printf("%-9s %9s %10s %10s %10s %10s %12s %8s\n", "function", "calls", "p50 (us)", "p90 (us)",
+        "p99 (us)", "max (us)", "max rel dev", "> rtol");
+    int n_bad = 0;
+    for (int fn = TRACE_Z; fn <= TRACE_GRES; fn++) {
+        vector<double> lat;
+        double dev_max = 0.;
+        int bad = 0;
+        for (int k = 0; k < ncall; k++) {
+            if (calls[k].fn != fn) {
+                continue;
+            }
+            lat.push_back(latency[k]);
+            dev_max = max(dev_max, deviation[k]);
+            if (!(deviation[k] <= rtol)) {
+                bad += 1;
+            }
+        }
+        if (lat.empty()) {
+            continue;
+        }
+        int n = lat.size();
+        double p50 = percentile(lat, 0.5);
+        double p90 = percentile(lat, 0.9);
+        double p99 = percentile(lat, 0.99);
+        printf("%-9s %9d %10.2f %10.2f %10.2f %10.2f %12.3e %8d\n", function_name(fn), n, p50, p90, p99,
+            lat.back(), dev_max, bad);
+        n_bad += bad;
+    }
+    vector<double> lat = latency;
+    double p50 = percentile(lat, 0.5);
+    double p90 = percentile(lat, 0.9);
+    double p99 = percentile(lat, 0.99);
+    printf("%-9s %9d %10.2f %10.2f %10.2f %10.2f\n", "all", ncall, p50, p90, p99, lat.back());
+    return (n_bad > 0) ? 1 : 0;
+}
@@ -7,7 +7,10 @@ Tests for checking that the PC-SAFT functions are working correctly.
 import numpy as np
 from pcsaft_electrolyte import pcsaft_den, pcsaft_hres, pcsaft_gres, pcsaft_sres, pcsaft_Hvap
 from pcsaft_electrolyte import pcsaft_vaporP, pcsaft_bubbleP, dielc_water, pcsaft_PTz, pcsaft_osmoticC
-from pcsaft_electrolyte import pcsaft_cp, pcsaft_ares, pcsaft_dadt
+from pcsaft_electrolyte import pcsaft_cp, pcsaft_ares, pcsaft_dadt, pcsaft_fugcoef, PyMixture, pcsaft_fit_pure
+from pcsaft_electrolyte import pcsaft_fit_binary, pcsaft_ensemble, chem_equil, pcsaft_activity
+from pcsaft_electrolyte import pcsaft_sweep, vaporPfit
+from scipy.optimize import minimize
 
 def test_hres():
     """Test the residual enthalpy function to see if it is working correctly."""
@@ -384,6 +387,15 @@ def test_bubbleP():
     print('    Relative deviation:', (calc-ref)/ref*100, '%')
     print('    Vapor composition (reference):', xv_ref)
     print('    Vapor composition (PC-SAFT):', xv)     
+
+    # the bubble point solver of pcsaft_fit_binary loosens its inner tolerances while it converges, and
+    # the residual of its initial guess gives its bubble point pressure. Its stopping criterion differs
+    # from that of the minimizer, so the pressures agree to about 1e-6.
+    fit = pcsaft_fit_binary(np.asarray([0.051]), ['k_ij'], m, s, e, np.asarray([327.48]), np.asarray([ref]),
+                            x.reshape(1, 2), pyargs, maxiter=0)
+    calc_budget = ref*(1 + fit['residuals'][0]/100)
+    print('    PC-SAFT (tolerance budget):', calc_budget, 'Pa')
+    assert abs(calc_budget - calc[0]) < 1e-5*calc[0]
     
     # NaCl in water
     print('\n##########  Test with aqueous NaCl  ##########')
@@ -415,6 +427,9 @@ def test_bubbleP():
     print('    Reference:', ref, 'Pa')
     print('    PC-SAFT:', calc, 'Pa')
     print('    Relative deviation:', (calc-ref)/ref*100, '%')    
+    calc_guess = pcsaft_bubbleP(2400., xv_guess, x, m, s, e, t, pyargs)[0]
+    print('    PC-SAFT (other initial guess):', calc_guess, 'Pa')
+    assert abs(calc_guess - calc) < 1e-6*calc
     
     return None
     
@@ -520,6 +535,70 @@ def test_PTz():
     return None
     
 
+def test_chem_equil():
+    """Test the speciation solver with ion pairing in aqueous NaCl."""
+    print('\n##########  Test speciation with ion pairing in aqueous NaCl  ##########')
+    # 0 = Na+, 1 = Cl-, 2 = H2O, 3 = NaCl ion pair (illustrative parameters)
+    t = 298.15
+    p = 101325.
+    m = np.asarray([1, 1, 1.2047, 2.])
+    s = np.asarray([2.8232, 2.7599589, 2.7927 + 10.11*np.exp(-0.01775*t) - 1.417*np.exp(-0.01146*t), 3.5])
+    e = np.asarray([230.00, 170.00, 353.9449, 200.])
+    volAB = np.asarray([0, 0, 0.0451, 0])
+    eAB = np.asarray([0, 0, 2425.67, 0])
+    k_ij = np.zeros((4, 4))
+    k_ij[0,1] = k_ij[1,0] = 0.317
+    k_ij[1,2] = k_ij[2,1] = -0.25
+    k_ij[0,2] = k_ij[2,0] = -0.007981*t + 2.37999
+    z = np.asarray([1., -1., 0., 0.])
+    rxn_nu = np.asarray([[-1., -1., 0., 1.]]) # Na+ + Cl- = NaCl
+    rxn_lnk = np.asarray([[2., 0., 0., 0.]])
+    pyargs = {'e_assoc':eAB, 'vol_a':volAB, 'k_ij':k_ij, 'z':z, 'dielc':dielc_water(t), 'rxn_nu':rxn_nu, 'rxn_lnk':rxn_lnk}
+
+    x = chem_equil(np.asarray([0.05, 0.05, 0.9, 0.]), m, s, e, t, p, pyargs)
+    rho = pcsaft_den(x, m, s, e, t, p, pyargs, phase='liq')
+    fugcoef = pcsaft_fugcoef(x, m, s, e, t, rho, pyargs)
+    print('----- Speciation at 298.15 K -----')
+    print('    Mole fractions:', x)
+    print('    Residual of the equilibrium condition:', np.sum(rxn_nu[0]*np.log(x*fugcoef)) - rxn_lnk[0,0])
+    print('    Charge balance:', np.sum(z*x))
+
+    return None
+
+
+def test_chem_equil_inert():
+    """Test the speciation solver with a species that is absent and takes part in no reaction."""
+    print('\n##########  Test speciation with an absent inert species  ##########')
+    # 0 = Na+, 1 = Cl-, 2 = H2O, 3 = NaCl ion pair, 4 = methane (illustrative parameters)
+    t = 298.15
+    p = 101325.
+    m = np.asarray([1, 1, 1.2047, 2., 1.])
+    s = np.asarray([2.8232, 2.7599589, 2.7927 + 10.11*np.exp(-0.01775*t) - 1.417*np.exp(-0.01146*t), 3.5, 3.7039])
+    e = np.asarray([230.00, 170.00, 353.9449, 200., 150.03])
+    volAB = np.asarray([0, 0, 0.0451, 0, 0])
+    eAB = np.asarray([0, 0, 2425.67, 0, 0])
+    k_ij = np.zeros((5, 5))
+    k_ij[0,1] = k_ij[1,0] = 0.317
+    k_ij[1,2] = k_ij[2,1] = -0.25
+    k_ij[0,2] = k_ij[2,0] = -0.007981*t + 2.37999
+    z = np.asarray([1., -1., 0., 0., 0.])
+    rxn_nu = np.asarray([[-1., -1., 0., 1., 0.]]) # Na+ + Cl- = NaCl
+    rxn_lnk = np.asarray([[2., 0., 0., 0.]])
+    pyargs = {'e_assoc':eAB, 'vol_a':volAB, 'k_ij':k_ij, 'z':z, 'dielc':dielc_water(t), 'rxn_nu':rxn_nu, 'rxn_lnk':rxn_lnk}
+
+    x = chem_equil(np.asarray([0.05, 0.05, 0.9, 0., 0.]), m, s, e, t, p, pyargs)
+    x_ref = chem_equil(np.asarray([0.05, 0.05, 0.9, 0.]), m[:4], s[:4], e[:4], t, p,
+        {'e_assoc':eAB[:4], 'vol_a':volAB[:4], 'k_ij':k_ij[:4,:4], 'z':z[:4], 'dielc':dielc_water(t),
+         'rxn_nu':rxn_nu[:,:4], 'rxn_lnk':rxn_lnk})
+    print('----- Speciation at 298.15 K -----')
+    print('    Mole fractions:', x)
+    print('    Without the inert species:', x_ref)
+    assert np.all(np.isfinite(x)) and x[4] == 0.
+    assert np.allclose(x[:4], x_ref, rtol=1e-6)
+
+    return None
+
+
 def test_osmoticC():
     """Test the function for calculating osmotic coefficients to see if it is working correctly."""
     # NaCl in water
@@ -546,8 +625,7 @@ def test_osmoticC():
     pyargs = {'e_assoc':eAB, 'vol_a':volAB, 'k_ij':k_ij, 'z':z, 'dielc':dielc}
  
     rho = pcsaft_den(x, m, s, e, t, 2339.3, pyargs, phase='liq')      
-    result = pcsaft_osmoticC(x, m, s, e, t, rho, pyargs)
-    calc = result[0]
+    calc = pcsaft_osmoticC(x, m, s, e, t, rho, pyargs)
     print('----- Osmotic coefficient at 293.15 K -----')
     print('    Reference:', ref)
     print('    PC-SAFT:', calc)
@@ -556,6 +634,65 @@ def test_osmoticC():
     return None
 
 
+def test_activity():
+    """Test the activity coefficients of aqueous NaCl over a range of molalities."""
+    print('\n##########  Test activity coefficients of aqueous NaCl  ##########')
+    # 0 = Na+, 1 = Cl-, 2 = H2O
+    t = 298.15 # K
+    m = np.asarray([1, 1, 1.2047])
+    s = np.asarray([2.8232, 2.7599589, 2.7927 + 10.11*np.exp(-0.01775*t) - 1.417*np.exp(-0.01146*t)])
+    e = np.asarray([230.00, 170.00, 353.9449])
+    volAB = np.asarray([0, 0, 0.0451])
+    eAB = np.asarray([0, 0, 2425.67])
+    k_ij = np.asarray([[0, 0.317, -0.007981*t + 2.37999],
+                       [0.317, 0, -0.25],
+                       [-0.007981*t + 2.37999, -0.25, 0]])
+    z = np.asarray([1., -1., 0.])
+    pyargs = {'e_assoc':eAB, 'vol_a':volAB, 'k_ij':k_ij, 'z':z, 'dielc':dielc_water(t)}
+
+    molality = np.asarray([1., 2., 4.])
+    ref = np.asarray([0.657, 0.668, 0.783]) # source: R. A. Robinson and R. H. Stokes, Electrolyte Solutions: Second Revised Edition. Dover Publications, 1959.
+    x = np.column_stack((molality, molality, np.full(3, 1000/18.0153)))
+    x = x/np.sum(x, axis=1)[:,None]
+    result = pcsaft_activity(x, m, s, e, t, 101325., 2, pyargs)
+    print('----- Mean ionic activity coefficient at 298.15 K -----')
+    print('    Molality:', molality, 'mol kg^-1 (calculated:', result['molality'][:,0], ')')
+    print('    Reference:', ref)
+    print('    PC-SAFT:', result['gamma_pm'])
+    print('    Relative deviation:', (result['gamma_pm']-ref)/ref*100, '%')
+    print('    Osmotic coefficient:', result['osmotic'])
+
+    return None
+
+
+def test_dielc_model():
+    """Test the temperature dependent dielectric constant of water in the ion term."""
+    print('\n##########  Test dielectric model for aqueous NaCl  ##########')
+    # 0 = Na+, 1 = Cl-, 2 = H2O
+    t = 298.15 # K
+    x = np.asarray([0.0629838206, 0.0629838206, 0.8740323588])
+    m = np.asarray([1, 1, 1.2047])
+    s = np.asarray([2.8232, 2.7599589, 2.7927 + 10.11*np.exp(-0.01775*t) - 1.417*np.exp(-0.01146*t)])
+    e = np.asarray([230.00, 170.00, 353.9449])
+    k_ij = np.asarray([[0, 0.317, -0.007981*t + 2.37999],
+                       [0.317, 0, -0.25],
+                       [-0.007981*t + 2.37999, -0.25, 0]])
+    pyargs = {'e_assoc':np.asarray([0, 0, 2425.67]), 'vol_a':np.asarray([0, 0, 0.0451]), 'k_ij':k_ij,
+              'z':np.asarray([1., -1., 0.]), 'dielc':dielc_water(t)}
+    pyargs_model = dict(pyargs, dielc_model=np.asarray([0, 0, 1]))
+
+    rho = pcsaft_den(x, m, s, e, t, 101325., pyargs, phase='liq')
+    rho_model = pcsaft_den(x, m, s, e, t, 101325., pyargs_model, phase='liq')
+    print('----- Density at 298.15 K -----')
+    print('    Constant dielectric constant:', rho, 'mol m^-3')
+    print('    Dielectric model:', rho_model, 'mol m^-3')
+    print('----- Residual enthalpy at 298.15 K (includes d(dielc)/dT with the model) -----')
+    print('    Constant dielectric constant:', pcsaft_hres(x, m, s, e, t, rho, pyargs), 'J mol^-1')
+    print('    Dielectric model:', pcsaft_hres(x, m, s, e, t, rho_model, pyargs_model), 'J mol^-1')
+
+    return None
+
+
 def test_Hvap():
     """Test the enthalpy of vaporization function to see if it is working correctly."""
     # Toluene
@@ -831,3 +968,229 @@ def test_cp():
     print('    Relative deviation:', (calc-ref)/ref*100, '%')     
     
     return None
+
+def test_mixture():
+    """Test that a PyMixture gives the same results as the standalone functions."""
+    # Binary mixture: methanol-cyclohexane
+    print('\n##########  Test with methanol-cyclohexane mixture  ##########')
+    #0 = methanol, 1 = cyclohexane
+    x = np.asarray([0.3,0.7])
+    m = np.asarray([1.5255, 2.5303])
+    s = np.asarray([3.2300, 3.8499])
+    e = np.asarray([188.90, 278.11])
+    volAB = np.asarray([0.035176, 0.])
+    eAB = np.asarray([2899.5, 0.])
+    k_ij = np.asarray([[0, 0.051],
+                       [0.051, 0]])
+    pyargs = {'e_assoc':eAB, 'vol_a':volAB, 'k_ij':k_ij}
+    t = 327.48
+    p = 101330
+
+    mix = PyMixture(m, s, e, pyargs)
+    ref = pcsaft_den(x, m, s, e, t, p, pyargs, phase='liq')
+    calc = mix.den(x, t, p, 'liq')
+    print('----- Liquid density at 327.48 K -----')
+    print('    Function:', ref, 'mol m^-3')
+    print('    PyMixture:', calc, 'mol m^-3')
+    print('    Relative deviation:', (calc-ref)/ref*100, '%')
+
+    ref = pcsaft_fugcoef(x, m, s, e, t, calc, pyargs)
+    calc = mix.fugcoef(x, t, calc)
+    print('----- Liquid fugacity coefficients at 327.48 K -----')
+    print('    Function:', ref)
+    print('    PyMixture:', calc)
+    print('    Relative deviation:', (calc-ref)/ref*100, '%')
+
+    return None
+
+
+def test_batch():
+    """Test that the batch functions of PyMixture agree with the single state functions."""
+    # Binary mixture: methane-cyclohexane
+    print('\n##########  Test batch evaluation with methane-cyclohexane mixture  ##########')
+    #0 = methane, 1 = cyclohexane
+    x = np.asarray([0.3,0.7])
+    m = np.asarray([1.0000, 2.5303])
+    s = np.asarray([3.7039, 3.8499])
+    e = np.asarray([150.03, 278.11])
+    k_ij = np.asarray([[0, 0.02],
+                       [0.02, 0]])
+    pyargs = {'k_ij':k_ij}
+    t = np.linspace(300., 400., 11)
+    p = np.full(11, 2e6)
+
+    mix = PyMixture(m, s, e, pyargs)
+    ref = np.asarray([mix.den(x, t[i], p[i], 'liq') for i in range(t.shape[0])])
+    calc = mix.den_batch(x, t, p, 'liq')
+    print('----- Liquid density from 300 to 400 K -----')
+    print('    Maximum relative deviation:', np.max(np.abs((calc-ref)/ref))*100, '%')
+
+    ref = np.asarray([mix.Z(x, t[i], calc[i]) for i in range(t.shape[0])])
+    calc_Z = mix.Z_batch(x, t, calc)
+    print('----- Compressibility factor from 300 to 400 K -----')
+    print('    Maximum relative deviation:', np.max(np.abs((calc_Z-ref)/ref))*100, '%')
+
+    ref = np.asarray([mix.fugcoef(x, t[i], calc[i]) for i in range(t.shape[0])])
+    calc_phi = mix.fugcoef_batch(x, t, calc)
+    print('----- Fugacity coefficients from 300 to 400 K -----')
+    print('    Maximum relative deviation:', np.max(np.abs((calc_phi-ref)/ref))*100, '%')
+
+    return None
+
+
+def test_packed_kij():
+    """Test that dense, packed and sparse interaction parameters give the same results."""
+    # Ternary mixture: methane-ethane-cyclohexane
+    print('\n##########  Test interaction parameter formats with methane-ethane-cyclohexane mixture  ##########')
+    #0 = methane, 1 = ethane, 2 = cyclohexane
+    x = np.asarray([0.2,0.3,0.5])
+    m = np.asarray([1.0000, 1.6069, 2.5303])
+    s = np.asarray([3.7039, 3.5206, 3.8499])
+    e = np.asarray([150.03, 191.42, 278.11])
+    k_ij = np.asarray([[0, 0, 0.02],
+                       [0, 0, 0.01],
+                       [0.02, 0.01, 0]])
+    t = 350.
+    p = 2e6
+
+    dense = PyMixture(m, s, e, {'k_ij':k_ij})
+    packed = PyMixture(m, s, e, {'k_ij':np.asarray([0, 0, 0.02, 0, 0.01, 0])})
+    sparse = PyMixture(m, s, e, {'k_ij':{(0, 2):0.02, (2, 1):0.01}})
+    ref = dense.den(x, t, p, 'liq')
+    print('----- Liquid density at 350 K -----')
+    print('    Dense:', ref, 'mol m^-3')
+    print('    Packed:', packed.den(x, t, p, 'liq'), 'mol m^-3')
+    print('    Sparse:', sparse.den(x, t, p, 'liq'), 'mol m^-3')
+
+    ref = dense.fugcoef(x, t, ref)
+    calc = sparse.fugcoef(x, t, dense.den(x, t, p, 'liq'))
+    print('----- Liquid fugacity coefficients at 350 K -----')
+    print('    Dense:', ref)
+    print('    Sparse:', calc)
+    print('    Relative deviation:', (calc-ref)/ref*100, '%')
+
+    return None
+
+
+def test_fit_pure():
+    """Test that the parameter regression recovers the parameters used to generate the data."""
+    # Toluene
+    print('\n##########  Test parameter regression with toluene  ##########')
+    x = np.asarray([1.])
+    m = np.asarray([2.8149])
+    s = np.asarray([3.7169])
+    e = np.asarray([285.69])
+    pyargs = {}
+
+    T = np.linspace(320., 500., 10)
+    Pvap = np.asarray([pcsaft_vaporP(1e5, x, m, s, e, t, pyargs)[0] for t in T])
+    rho = np.asarray([pcsaft_den(x, m, s, e, t, max(p, 101325.), pyargs, phase='liq') for t, p in zip(T, Pvap)])
+    prop = np.concatenate([np.zeros(T.shape[0]), np.ones(T.shape[0])])
+    T_data = np.concatenate([T, T])
+    P_data = np.concatenate([np.maximum(Pvap, 101325.), Pvap])
+    value = np.concatenate([rho, Pvap])
+
+    result = pcsaft_fit_pure(np.asarray([2.6, 3.8, 275.]), prop, T_data, P_data, value, pyargs)
+    print('----- Fitted parameters -----')
+    print('    Reference:', m[0], s[0], e[0])
+    print('    Fitted:', result['params'])
+    print('    Converged:', result['converged'], 'after', result['iterations'], 'iterations')
+    print('    Maximum absolute deviation of the data:', np.max(np.abs(result['residuals'])), '%')
+
+    return None
+
+
+def test_fit_binary():
+    """Test that the regression of k_ij recovers the value used to generate bubble point data."""
+    # Propane and toluene
+    print('\n##########  Test k_ij regression with propane and toluene  ##########')
+    m = np.asarray([2.0020, 2.8149])
+    s = np.asarray([3.6184, 3.7169])
+    e = np.asarray([208.11, 285.69])
+    k_ij = 0.03
+    pyargs = {'k_ij': np.asarray([[0, k_ij], [k_ij, 0]])}
+
+    T = np.asarray([280., 300., 320., 340., 300., 320.])
+    x = np.asarray([[0.1, 0.9], [0.2, 0.8], [0.3, 0.7], [0.4, 0.6], [0.5, 0.5], [0.6, 0.4]])
+    P = np.asarray([pcsaft_bubbleP(5e5, np.asarray([0.9, 0.1]), x[i], m, s, e, T[i], pyargs)[0][0]
+                    for i in range(T.shape[0])])
+
+    result = pcsaft_fit_binary(np.asarray([0.]), ['k_ij'], m, s, e, T, P, x)
+    print('----- Fitted k_ij -----')
+    print('    Reference:', k_ij)
+    print('    Fitted:', result['params'][0])
+    print('    Converged:', result['converged'], 'after', result['iterations'], 'iterations')
+    print('    Maximum absolute deviation of the data:', np.max(np.abs(result['residuals'])), '%')
+
+    return None
+
+
+def test_ensemble():
+    """Test the statistics of an ensemble of parameter sets against evaluating each set separately."""
+    # Methane and cyclohexane
+    print('\n##########  Test parameter ensemble for methane and cyclohexane  ##########')
+    x = np.asarray([0.3, 0.7])
+    T = np.asarray([250., 300., 350.])
+    P = np.asarray([5e5, 5e5, 5e5])
+    rng = np.random.default_rng(1)
+    nsets = 500
+    params = np.asarray([1.5255, 2.5303, 3.23, 3.8499, 188.9, 278.11, 0.051])
+    params = params*(1 + 0.01*rng.standard_normal((nsets, params.shape[0])))
+
+    result = pcsaft_ensemble(params, x, T, P, quantiles=[0.05, 0.5, 0.95])
+    rho = np.asarray([[pcsaft_den(x, p[:2], p[2:4], p[4:6], t, pr, {'k_ij': np.asarray([[0, p[6]], [p[6], 0]])})
+                       for t, pr in zip(T, P)] for p in params])
+    print('----- Density at 300 K -----')
+    print('    Mean:', result['mean'][1,0], 'mol m^-3 (reference:', np.mean(rho[:,1]), ')')
+    print('    Standard deviation:', np.sqrt(result['var'][1,0]), '(reference:', np.std(rho[:,1], ddof=1), ')')
+    print('    5%, 50% and 95% quantiles:', result['quantiles'][1,0], '(reference:', np.percentile(rho[:,1], [5, 50, 95]), ')')
+
+    return None
+
+
+def test_sweep():
+    """Test a sweep along an isobar against solving each state separately."""
+    # Water
+    print('\n##########  Test isobar sweep for water  ##########')
+    x = np.asarray([1.])
+    m = np.asarray([1.2047])
+    s = np.asarray([2.7927 + 10.11*np.exp(-0.01775*300) - 1.417*np.exp(-0.01146*300)])
+    e = np.asarray([353.9449])
+    pyargs = {'e_assoc':np.asarray([2425.67]), 'vol_a':np.asarray([0.0451])}
+    T = np.linspace(280., 430., 101)
+
+    result = pcsaft_sweep(x, m, s, e, T, 101325., pyargs, phase='stable', props=['hres'])
+    rho = np.asarray([pcsaft_den(x, m, s, e, t, 101325., pyargs, phase=('liq' if ph == 0 else 'vap'))
+                      for t, ph in zip(T, result['phase'])])
+    print('----- Density along the 101325 Pa isobar -----')
+    print('    Maximum relative deviation from pcsaft_den:', np.max(np.abs(result['rho']/rho - 1)))
+    print('    States solved without a warm start:', result['n_cold'], 'of', T.shape[0])
+    print('    Phase change between', T[result['phase'] == 0][-1], 'and', T[result['phase'] == 1][0], 'K')
+
+    return None
+
+
+def test_cache():
+    """Test that repeated evaluations of the same state are taken from the cache."""
+    # Water
+    print('\n##########  Test cache of a vapor pressure calculation for water  ##########')
+    t = 362
+    x = np.asarray([1.])
+    m = np.asarray([1.2047])
+    s = np.asarray([2.7927 + 10.11*np.exp(-0.01775*t) - 1.417*np.exp(-0.01146*t)])
+    e = np.asarray([353.9449])
+    pyargs = {'e_assoc':np.asarray([2425.67]), 'vol_a':np.asarray([0.0451])}
+
+    pvap = []
+    for cache_size in [1024, 0]:
+        mix = PyMixture(m, s, e, pyargs, cache_size=cache_size)
+        result = minimize(vaporPfit, 67000., args=(x, t, mix), tol=1e-10, method='Nelder-Mead', options={'maxiter': 100})
+        pvap.append(result.x[0])
+        if cache_size > 0:
+            stats = mix.cache_stats()
+    print('----- Cache statistics -----')
+    print('    Evaluations of the objective function:', result.nfev)
+    print('    Hits:', stats['hits'], 'Misses:', stats['misses'], 'Hit rate:', stats['hit_rate'])
+    print('    Vapor pressure with and without the cache:', pvap[0], pvap[1], 'Pa')
+
+    return None
@@ -4,7 +4,8 @@
 #include "math.h"
 #include <Eigen/Dense>
 
-#include "pcsaft.h"
+#include "pcsaft_internal.h"
+#include "pcsaft_poly.h"
 
 using namespace std;
 using namespace Eigen;
@@ -77,6 +78,7 @@ vector<double> dXA_find(int ncA, int ncomp, vector<int> iA, vector<double> delta
         }
     }
 
+    PCSAFT_COUNT_LU(A.rows());
     MatrixXd solution = A.lu().solve(B); //Solves linear system of equations
     vector<double> dXA_dd(n_sites*ncA*ncomp);
     for (int i = 0; i < n_sites*ncA*ncomp; i++) {
@@ -111,6 +113,7 @@ vector<double> dXAdt_find(int ncA, vector<double> delta_ij, double den,
         }
     }
 
+    PCSAFT_COUNT_LU(A.rows());
     MatrixXd solution = A.lu().solve(B); //Solves linear system of equations
     vector<double> dXA_dt(n_sites*ncA);
     for (int i = 0; i < n_sites*ncA; i++) {
@@ -120,8 +123,250 @@ vector<double> dXAdt_find(int ncA, vector<double> delta_ij, double den,
 }
 
 
-double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs) {
+void mixing_tables(const vector<double> &s, const vector<double> &e, add_args &cppargs,
+    vector<double> &e_ij, vector<double> &s_ij) {
+    /**
+    Calculate the dispersion energy and segment diameter of each pair of components.
+
+    Both tables are symmetric, so they are stored as their packed upper
+    triangle (see sym_idx), which halves the memory that the property
+    functions write and read. k_ij and l_ij may be dense, packed or empty
+    (see pair_param); for a dense matrix only the upper triangle is used.
+    */
+    int ncomp = s.size();
+    bool ions = !cppargs.z.empty();
+    e_ij.assign(ncomp*(ncomp+1)/2, 0);
+    s_ij.assign(ncomp*(ncomp+1)/2, 0);
+    int idx = -1;
+    for (int i = 0; i < ncomp; i++) {
+        for (int j = i; j < ncomp; j++) {
+            idx += 1;
+            if (cppargs.l_ij.empty()) {
+                s_ij[idx] = (s[i] + s[j])/2.;
+            }
+            else {
+                s_ij[idx] = (s[i] + s[j])/2.*(1-pair_param(cppargs.l_ij, i, j, ncomp));
+            }
+            if (!ions || cppargs.z[i]*cppargs.z[j] <= 0) { // for two cations or two anions e_ij is kept at zero to avoid dispersion between like ions (see Held et al. 2014)
+                if (cppargs.k_ij.empty()) {
+                    e_ij[idx] = sqrt(e[i]*e[j]);
+                }
+                else {
+                    e_ij[idx] = sqrt(e[i]*e[j])*(1-pair_param(cppargs.k_ij, i, j, ncomp));
+                }
+            }
+        }
+    }
+}
+
+
+polar_subset polar_subset_setup(const vector<double> &m, const vector<double> &s, const vector<double> &e,
+    const vector<double> &e_ij, const vector<double> &s_ij, add_args &cppargs) {
+    /**
+    Prepare the dipole term for the components that have a dipole moment.
+
+    Components without a dipole moment do not contribute to A2 or A3, so only
+    the compacted subset of polar components is used. The weights and the m
+    dependent coefficients are symmetric in their indices, so they are stored
+    for the unique pairs (i <= j) and triples (i <= j <= k) of the subset,
+    along with the number of orderings that each represents.
+    */
+    const static double conv = 7242.702976750923; // conversion factor, see the note below Table 2 in Gross and Vrabec 2006
+
+    int ncomp = m.size();
+    polar_subset ps;
+    vector<double> dipmSQ (ncomp, 0);
+    vector<double> s3 (ncomp, 0); // s_ii^3
+    for (int i = 0; i < ncomp; i++) {
+        if (cppargs.dipm[i] != 0) {
+            ps.ip.push_back(i);
+            dipmSQ[i] = pow(cppargs.dipm[i], 2.)/(m[i]*e[i]*pow(s[i],3.))*conv;
+            s3[i] = pow(s_ij[sym_idx(i, i, ncomp)],3);
+        }
+    }
+
+    int np = ps.ip.size();
+    int i, j, k;
+    double m_ij, m_ijk;
+    for (int a = 0; a < np; a++) {
+        i = ps.ip[a];
+        for (int b = a; b < np; b++) {
+            j = ps.ip[b];
+            polar_pair pp;
+            pp.i = i;
+            pp.j = j;
+            pp.w = e_ij[sym_idx(i, i, ncomp)]*e_ij[sym_idx(j, j, ncomp)]*s3[i]*s3[j]/pow(s_ij[sym_idx(i, j, ncomp)],3)
+                *cppargs.dip_num[i]*cppargs.dip_num[j]*dipmSQ[i]*dipmSQ[j];
+            if (i == j) {
+                pp.mult = 1;
+                pp.e_b = e_ij[sym_idx(j, j, ncomp)];
+            }
+            else {
+                pp.mult = 2;
+                pp.e_b = e_ij[sym_idx(i, i, ncomp)] + e_ij[sym_idx(j, j, ncomp)]; // J2 for (i, j) uses e_jj and J2 for (j, i) uses e_ii
+            }
+            m_ij = sqrt(m[i]*m[j]);
+            if (m_ij > 2) {
+                m_ij = 2;
+            }
+            mix_coef(a0dip, a1dip, a2dip, m_ij, pp.adip);
+            mix_coef(b0dip, b1dip, b2dip, m_ij, pp.bdip);
+            ps.pairs.push_back(pp);
+
+            for (int c = b; c < np; c++) {
+                k = ps.ip[c];
+                polar_triple pt;
+                pt.i = i;
+                pt.j = j;
+                pt.k = k;
+                pt.w = e_ij[sym_idx(i, i, ncomp)]*e_ij[sym_idx(j, j, ncomp)]*e_ij[sym_idx(k, k, ncomp)]*s3[i]*s3[j]*s3[k]
+                    /s_ij[sym_idx(i, j, ncomp)]/s_ij[sym_idx(i, k, ncomp)]/s_ij[sym_idx(j, k, ncomp)]*cppargs.dip_num[i]*cppargs.dip_num[j]
+                    *cppargs.dip_num[k]*dipmSQ[i]*dipmSQ[j]*dipmSQ[k];
+                if ((i == j) && (j == k)) {
+                    pt.mult = 1;
+                }
+                else if ((i == j) || (j == k)) {
+                    pt.mult = 3;
+                }
+                else {
+                    pt.mult = 6;
+                }
+                m_ijk = pow((m[i]*m[j]*m[k]),1/3.);
+                if (m_ijk > 2) {
+                    m_ijk = 2;
+                }
+                mix_coef(c0dip, c1dip, c2dip, m_ijk, pt.cdip);
+                ps.triples.push_back(pt);
+            }
+        }
+    }
+
+    return ps;
+}
+
+
+const mixing_cache &mixing_cache_get(const vector<double> &m, const vector<double> &s, const vector<double> &e,
+    add_args &cppargs, mixing_cache &local) {
+    /**
+    Return the tables of the mixture (see mixing_cache).
+
+    The tables attached to cppargs are only used if they were calculated for
+    these parameters, i.e. for the same vectors m, s, e and cppargs. A copy of
+    cppargs (e.g. with other k_ij in a fit) or other parameter vectors get
+    their tables calculated in local.
+    */
+    const mixing_cache *cache = cppargs.mixing;
+    if (cache != NULL && cache->m == &m && cache->s == &s && cache->e == &e && cache->cppargs == &cppargs) {
+        return *cache;
+    }
+    mixing_tables(s, e, cppargs, local.e_ij, local.s_ij);
+    if (!cppargs.dipm.empty()) {
+        local.polar = polar_subset_setup(m, s, e, local.e_ij, local.s_ij, cppargs);
+    }
+    return local;
+}
+
+
+void mixing_cache_setup_cpp(const vector<double> &m, const vector<double> &s, const vector<double> &e,
+    add_args &cppargs, mixing_cache &cache) {
+    /**
+    Calculate the tables of a mixture once and attach them to cppargs.
+
+    The owner of m, s, e and cppargs (PyMixture, the C interface) calls this
+    again after it changed any of the parameters. cache must stay at the same
+    address while cppargs refers to it.
+    */
+    cppargs.mixing = NULL;
+    cache = mixing_cache();
+    mixing_cache_get(m, s, e, cppargs, cache);
+    cache.m = &m;
+    cache.s = &s;
+    cache.e = &e;
+    cache.cppargs = &cppargs;
+    cppargs.mixing = &cache;
+}
+
+
+double dielc_water_cpp(double t, double &ddielc_dt) {
+    /**
+    Return the dielectric constant of water at the given temperature and its
+    temperature derivative (K^-1).
+
+    This equation was fit to values given in the reference. For temperatures
+    from 263.15 to 368.15 K values at 1 bar were used. For temperatures from
+    368.15 to 443.15 K values at 10 bar were used.
+
+    Reference:
+    D. G. Archer and P. Wang, “The Dielectric Constant of Water and Debye‐Hückel
+    Limiting Law Slopes,” J. Phys. Chem. Ref. Data, vol. 19, no. 2, pp. 371–411,
+    Mar. 1990.
+    */
+    if (t <= 368.15) {
+        ddielc_dt = 2*7.6555618295E-04*t - 8.1783881423E-01;
+        return 7.6555618295E-04*t*t - 8.1783881423E-01*t + 2.5419616803E+02;
+    }
+    ddielc_dt = 2*0.0005003272124*t - 0.6285556029;
+    return 0.0005003272124*t*t - 0.6285556029*t + 220.4467027;
+}
+
+
+double dielc_cpp(const vector<double> &x, double t, add_args &cppargs, double &ddielc_dt,
+    vector<double> &ddielc_dx) {
+    /**
+    Return the dielectric constant of the solvent mixture, along with its
+    derivatives with respect to temperature and mole fractions.
+
+    If cppargs.dielc_model is empty the constant cppargs.dielc is returned.
+    Otherwise the dielectric constant is the mole fraction average of the
+    dielectric constants of the solvents on a salt free basis, where the
+    solvents are the components whose model is not 0. The dielectric constant
+    of each solvent is given either by the correlation for water (model 1) or
+    by a + b*T + c*T^2 with the coefficients from cppargs.dielc_coef (model
+    2). If none of the solvents is present cppargs.dielc is returned.
+    */
+    int ncomp = x.size();
+    ddielc_dt = 0.;
+    ddielc_dx.assign(ncomp, 0.);
+    if (cppargs.dielc_model.empty()) {
+        return cppargs.dielc;
+    }
+
+    vector<double> dielc_i(ncomp, 0.);
+    double deps_dt, x_solv = 0., summ = 0., summ_dt = 0.;
+    for (int i = 0; i < ncomp; i++) {
+        if (cppargs.dielc_model[i] == 0) {
+            continue;
+        }
+        else if (cppargs.dielc_model[i] == 1) {
+            dielc_i[i] = dielc_water_cpp(t, deps_dt);
+        }
+        else {
+            const double *c = &cppargs.dielc_coef[3*i];
+            dielc_i[i] = c[0] + c[1]*t + c[2]*t*t;
+            deps_dt = c[1] + 2*c[2]*t;
+        }
+        x_solv += x[i];
+        summ += x[i]*dielc_i[i];
+        summ_dt += x[i]*deps_dt;
+    }
+    if (x_solv == 0) {
+        return cppargs.dielc;
+    }
+
+    double dielc = summ/x_solv;
+    ddielc_dt = summ_dt/x_solv;
+    for (int i = 0; i < ncomp; i++) {
+        if (cppargs.dielc_model[i] != 0) {
+            ddielc_dx[i] = (dielc_i[i] - dielc)/x_solv;
+        }
+    }
+    return dielc;
+}
+
+
+double pcsaft_Z_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double rho, add_args &cppargs, vector<double> *XA_io,
+    const solver_tol *tol) {
     /**
     Calculate the compressibility factor.
 
@@ -146,9 +391,9 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
         A struct containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : vector<double>, shape (n*n,)
+        k_ij : vector<double>, shape (n*n,) or (n*(n+1)/2,)
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, or the packed upper triangle)
         e_assoc : vector<double>, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -167,12 +412,31 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
         dielc : double
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+        dielc_model : vector<int>, shape (n,)
+            Model for the dielectric constant of each component (0 = not a 
+            solvent, 1 = water, 2 = dielc_coef). If given, the dielectric 
+            constant is calculated from the solvents instead of using dielc.
+        dielc_coef : vector<double>, shape (n*3,)
+            Coefficients a, b, c of the dielectric constant a + b*T + c*T^2 
+            of the components that use model 2.
+    XA_io : vector<double>*
+        If not NULL and it has two values per associating component, it is
+        used as the starting point for the fraction of unbonded association
+        sites (e.g. the solution at a nearby density), and it receives the
+        converged fractions. Optional.
+    tol : solver_tol*
+        Tolerances of the iterative solvers. If NULL the default tolerances
+        are used. Only the tolerance of the association term (assoc) is used
+        here. Optional.
 
     Returns
     -------
     Z : double
         Compressibility factor
     */
+    PCSAFT_COUNT(evals, 1);
+    PCSAFT_TIMER_START();
+    PCSAFT_TRACE_SCOPE();
     int ncomp = x.size(); // number of components
     vector<double> d (ncomp);
     for (int i = 0; i < ncomp; i++) {
@@ -206,39 +470,21 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
 
     vector<double> ghs (ncomp, 0);
     vector<double> denghs (ncomp, 0);
-    vector<double> e_ij (ncomp*ncomp, 0);
-    vector<double> s_ij (ncomp*ncomp, 0);
+    mixing_cache local;
+    const mixing_cache &mixing = mixing_cache_get(m, s, e, cppargs, local);
+    const vector<double> &e_ij = mixing.e_ij;
+    const vector<double> &s_ij = mixing.s_ij;
     double m2es3 = 0.;
     double m2e2s3 = 0.;
+    double s3, w;
     int idx = -1;
     for (int i = 0; i < ncomp; i++) {
-        for (int j = 0; j < ncomp; j++) {
+        for (int j = i; j < ncomp; j++) {
             idx += 1;
-            if (cppargs.l_ij.empty()) {
-                s_ij[idx] = (s[i] + s[j])/2.;
-            }
-            else {
-                s_ij[idx] = (s[i] + s[j])/2.*(1-cppargs.l_ij[idx]);
-            }
-            if (!cppargs.z.empty()) {
-                if (cppargs.z[i]*cppargs.z[j] <= 0) { // for two cations or two anions e_ij is kept at zero to avoid dispersion between like ions (see Held et al. 2014)
-                    if (cppargs.k_ij.empty()) {
-                        e_ij[idx] = sqrt(e[i]*e[j]);
-                    }                    
-                    else {
-                        e_ij[idx] = sqrt(e[i]*e[j])*(1-cppargs.k_ij[idx]);
-                    }
-                }
-            } else {
-                if (cppargs.k_ij.empty()) {
-                    e_ij[idx] = sqrt(e[i]*e[j]);
-                }                    
-                else {
-                    e_ij[idx] = sqrt(e[i]*e[j])*(1-cppargs.k_ij[idx]);
-                }
-            }
-            m2es3 = m2es3 + x[i]*x[j]*m[i]*m[j]*e_ij[idx]/t*pow(s_ij[idx], 3);
-            m2e2s3 = m2e2s3 + x[i]*x[j]*m[i]*m[j]*pow(e_ij[idx]/t,2)*pow(s_ij[idx], 3);
+            w = (i == j) ? 1. : 2.; // the tables hold each unordered pair once
+            s3 = s_ij[idx]*s_ij[idx]*s_ij[idx];
+            m2es3 = m2es3 + w*x[i]*x[j]*m[i]*m[j]*e_ij[idx]/t*s3;
+            m2e2s3 = m2e2s3 + w*x[i]*x[j]*m[i]*m[j]*e_ij[idx]/t*e_ij[idx]/t*s3;
         }
         ghs[i] = 1/(1-zeta[3]) + (d[i]*d[i]/(d[i]+d[i]))*3*zeta[2]/(1-zeta[3])/(1-zeta[3]) + 
             pow(d[i]*d[i]/(d[i]+d[i]), 2)*2*zeta[2]*zeta[2]/pow(1-zeta[3], 3);
@@ -252,28 +498,16 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
     double Zhs = zeta[3]/(1-zeta[3]) + 3.*zeta[1]*zeta[2]/zeta[0]/(1.-zeta[3])/(1.-zeta[3]) + 
         (3.*pow(zeta[2], 3.) - zeta[3]*pow(zeta[2], 3.))/zeta[0]/pow(1.-zeta[3], 3.);
 
-    static double a0[7] = { 0.910563145, 0.636128145, 2.686134789, -26.54736249, 97.75920878, -159.5915409, 91.29777408 };
-    static double a1[7] = { -0.308401692, 0.186053116, -2.503004726, 21.41979363, -65.25588533, 83.31868048, -33.74692293 };
-    static double a2[7] = { -0.090614835, 0.452784281, 0.596270073, -1.724182913, -4.130211253, 13.77663187, -8.672847037 };
-    static double b0[7] = { 0.724094694, 2.238279186, -4.002584949, -21.00357682, 26.85564136, 206.5513384, -355.6023561 };
-    static double b1[7] = { -0.575549808, 0.699509552, 3.892567339, -17.21547165, 192.6722645, -161.8264617, -165.2076935 };
-    static double b2[7] = { 0.097688312, -0.255757498, -9.155856153, 20.64207597, -38.80443005, 93.62677408, -29.66690559 };
-
-    vector<double> a (7, 0);
-    vector<double> b (7, 0);
-    for (int i = 0; i < 7; i++) {
-        a[i] = a0[i] + (m_avg-1.)/m_avg*a1[i] + (m_avg-1.)/m_avg*(m_avg-2.)/m_avg*a2[i];
-        b[i] = b0[i] + (m_avg-1.)/m_avg*b1[i] + (m_avg-1.)/m_avg*(m_avg-2.)/m_avg*b2[i];
-    }
+    double a[7], b[7];
+    mix_coef(a0, a1, a2, m_avg, a);
+    mix_coef(b0, b1, b2, m_avg, b);
 
-    double detI1_det = 0.0;
-    double detI2_det = 0.0;
-    double I2 = 0.0;
-    for (int i = 0; i < 7; i++) {
-        detI1_det += a[i]*(i+1)*pow(eta, i);
-        detI2_det += b[i]*(i+1)*pow(eta, i);
-        I2 += b[i]*pow(eta, i);
-    }
+    double I1_p[2], I2_p[2]; // I1 and I2 and their first derivatives with respect to eta
+    horner<1>(a, eta, I1_p);
+    horner<1>(b, eta, I2_p);
+    double detI1_det = I1_p[0] + eta*I1_p[1];
+    double detI2_det = I2_p[0] + eta*I2_p[1];
+    double I2 = I2_p[0];
     double C1 = 1./(1. + m_avg*(8*eta-2*eta*eta)/pow(1-eta, 4) + (1-m_avg)*(20*eta-27*eta*eta+12*pow(eta, 3)-2*pow(eta, 4))/pow((1-eta)*(2-eta), 2.0));
     double C2 = -1.*C1*C1*(m_avg*(-4*eta*eta+20*eta+8)/pow(1-eta, 5) + (1-m_avg)*(2*pow(eta, 3)+12*eta*eta-48*eta+40)/pow((1-eta)*(2-eta), 3.0));
 
@@ -286,92 +520,48 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
     double Zhc = m_avg*Zhs - summ;
     double Zdisp = -2*PI*den*detI1_det*m2es3 - PI*den*m_avg*(C1*detI2_det + C2*eta*I2)*m2e2s3;
 
+    PCSAFT_TIMER_LAP(t_hc_disp);
+
     // Dipole term (Gross and Vrabec term) --------------------------------------
     double Zpolar = 0;
     if (!cppargs.dipm.empty()) {
+        const polar_subset &ps = mixing.polar;
+        int npairs = ps.pairs.size();
+        int ntriples = ps.triples.size();
         double A2 = 0.;
         double A3 = 0.;
         double dA2_det = 0.;
         double dA3_det = 0.;
-        vector<double> adip (5, 0);
-        vector<double> bdip (5, 0);
-        vector<double> cdip (5, 0);
-        vector<double> dipmSQ (ncomp, 0);
-        double J2, dJ2_det, J3, dJ3_det;
-
-        static double a0dip[5] = { 0.3043504, -0.1358588, 1.4493329, 0.3556977, -2.0653308 };
-        static double a1dip[5] = { 0.9534641, -1.8396383, 2.0131180, -7.3724958, 8.2374135 };
-        static double a2dip[5] = { -1.1610080, 4.5258607, 0.9751222, -12.281038, 5.9397575 };
-        static double b0dip[5] = { 0.2187939, -1.1896431, 1.1626889, 0, 0 };
-        static double b1dip[5] = { -0.5873164, 1.2489132, -0.5085280, 0, 0 };
-        static double b2dip[5] = { 3.4869576, -14.915974, 15.372022, 0, 0 };
-        static double c0dip[5] = { -0.0646774, 0.1975882, -0.8087562, 0.6902849, 0 };
-        static double c1dip[5] = { -0.9520876, 2.9924258, -2.3802636, -0.2701261, 0 };
-        static double c2dip[5] = { -0.6260979, 1.2924686, 1.6542783, -3.4396744, 0 };
-
-        const static double conv = 7242.702976750923; // conversion factor, see the note below Table 2 in Gross and Vrabec 2006
-
-        for (int i = 0; i < ncomp; i++) {     
-            dipmSQ[i] = pow(cppargs.dipm[i], 2.)/(m[i]*e[i]*pow(s[i],3.))*conv;
-        }
-
-        double m_ij;
-        for (int i = 0; i < ncomp; i++) {
-            for (int j = 0; j < ncomp; j++) {
-                m_ij = sqrt(m[i]*m[j]);
-                if (m_ij > 2) {
-                    m_ij = 2;
-                }
-                J2 = 0.;
-                dJ2_det = 0.;
-                for (int l = 0; l < 5; l++) {
-                    adip[l] = a0dip[l] + (m_ij-1)/m_ij*a1dip[l] + (m_ij-1)/m_ij*(m_ij-2)/m_ij*a2dip[l];
-                    bdip[l] = b0dip[l] + (m_ij-1)/m_ij*b1dip[l] + (m_ij-1)/m_ij*(m_ij-2)/m_ij*b2dip[l];
-                    J2 += (adip[l] + bdip[l]*e_ij[j*ncomp+j]/t)*pow(eta, l); // j*ncomp+j needs to be used for e_ij because it is formatted as a 1D vector                   
-                    dJ2_det += (adip[l] + bdip[l]*e_ij[j*ncomp+j]/t)*l*pow(eta, l-1);
-                }
-                A2 += x[i]*x[j]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)/
-                    pow(s_ij[i*ncomp+j],3)*cppargs.dip_num[i]*cppargs.dip_num[j]*dipmSQ[i]*dipmSQ[j]*J2;
-                dA2_det += x[i]*x[j]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*pow(s_ij[i*ncomp+i],3)*
-                    pow(s_ij[j*ncomp+j],3)/pow(s_ij[i*ncomp+j],3)*cppargs.dip_num[i]*cppargs.dip_num[j]*dipmSQ[i]*dipmSQ[j]*dJ2_det;
-            }
+        double J2a_p[2], J2b_p[2], J3_p[2];
+        double xw;
+        for (int n = 0; n < npairs; n++) {
+            const polar_pair &pp = ps.pairs[n];
+            horner<1>(pp.adip, eta, J2a_p);
+            horner<1>(pp.bdip, eta, J2b_p);
+            xw = x[pp.i]*x[pp.j]*pp.w/t/t;
+            A2 += xw*(pp.mult*J2a_p[0] + pp.e_b/t*J2b_p[0]);
+            dA2_det += xw*(pp.mult*J2a_p[1] + pp.e_b/t*J2b_p[1]);
         }
-
-        double m_ijk;
-        for (int i = 0; i < ncomp; i++) {
-            for (int j = 0; j < ncomp; j++) {
-                for (int k = 0; k < ncomp; k++) {
-                    m_ijk = pow((m[i]*m[j]*m[k]),1/3.);
-                    if (m_ijk > 2) {
-                        m_ijk = 2;
-                    }
-                    J3 = 0.;
-                    dJ3_det = 0.;
-                    for (int l = 0; l < 5; l++) {
-                        cdip[l] = c0dip[l] + (m_ijk-1)/m_ijk*c1dip[l] + (m_ijk-1)/m_ijk*(m_ijk-2)/m_ijk*c2dip[l];
-                        J3 += cdip[l]*pow(eta, l);
-                        dJ3_det += cdip[l]*l*pow(eta, (l-1));
-                    }
-                    A3 += x[i]*x[j]*x[k]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*e_ij[k*ncomp+k]/t*
-                        pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)*pow(s_ij[k*ncomp+k],3)/s_ij[i*ncomp+j]/s_ij[i*ncomp+k]/
-                        s_ij[j*ncomp+k]*cppargs.dip_num[i]*cppargs.dip_num[j]*cppargs.dip_num[k]*dipmSQ[i]*
-                        dipmSQ[j]*dipmSQ[k]*J3;
-                    dA3_det += x[i]*x[j]*x[k]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*e_ij[k*ncomp+k]/t*
-                        pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)*pow(s_ij[k*ncomp+k],3)/s_ij[i*ncomp+j]/s_ij[i*ncomp+k]/
-                        s_ij[j*ncomp+k]*cppargs.dip_num[i]*cppargs.dip_num[j]*cppargs.dip_num[k]*dipmSQ[i]*
-                        dipmSQ[j]*dipmSQ[k]*dJ3_det;
-                }
-            }
+        for (int n = 0; n < ntriples; n++) {
+            const polar_triple &pt = ps.triples[n];
+            horner<1>(pt.cdip, eta, J3_p);
+            xw = pt.mult*x[pt.i]*x[pt.j]*x[pt.k]*pt.w/t/t/t;
+            A3 += xw*J3_p[0];
+            dA3_det += xw*J3_p[1];
         }
 
-        A2 = -PI*den*A2;
-        A3 = -4/3.*PI*PI*den*den*A3;
-        dA2_det = -PI*den*dA2_det;
-        dA3_det = -4/3.*PI*PI*den*den*dA3_det;
+        if (npairs > 0) {
+            A2 = -PI*den*A2;
+            A3 = -4/3.*PI*PI*den*den*A3;
+            dA2_det = -PI*den*dA2_det;
+            dA3_det = -4/3.*PI*PI*den*den*dA3_det;
 
-        Zpolar = eta*((dA2_det*(1-A3/A2)+(dA3_det*A2-A3*dA2_det)/A2)/(1-A3/A2)/(1-A3/A2));
+            Zpolar = eta*((dA2_det*(1-A3/A2)+(dA3_det*A2-A3*dA2_det)/A2)/(1-A3/A2)/(1-A3/A2));
+        }
     }
 
+    PCSAFT_TIMER_LAP(t_polar);
+
     // Association term -------------------------------------------------------
     // only the 2B association type is currently implemented
     double Zassoc = 0;
@@ -401,10 +591,10 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
         int idx_ddelta = -1; // index for ddelta_dd vector
         double dghsd_dd;
         for (int i = 0; i < ncA; i++) {
-            idxi = iA[i]*ncomp+iA[i];
+            idxi = sym_idx(iA[i], iA[i], ncomp);
             for (int j = 0; j < ncA; j++) {
                 idxa += 1;
-                idxj = iA[j]*ncomp+iA[j];
+                idxj = sym_idx(iA[j], iA[j], ncomp);
                 eABij[idxa] = (cppargs.e_assoc[iA[i]]+cppargs.e_assoc[iA[j]])/2.;
                 if (cppargs.k_hb.empty()) {
                     volABij[idxa] = sqrt(cppargs.vol_a[iA[i]]*cppargs.vol_a[iA[j]])*pow(sqrt(s_ij[idxi]*
@@ -412,9 +602,9 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
                 }
                 else {
                     volABij[idxa] = sqrt(cppargs.vol_a[iA[i]]*cppargs.vol_a[iA[j]])*pow(sqrt(s_ij[idxi]*
-                        s_ij[idxj])/(0.5*(s_ij[idxi]+s_ij[idxj])), 3)*(1-cppargs.k_hb[iA[i]*ncomp+iA[j]]);
+                        s_ij[idxj])/(0.5*(s_ij[idxi]+s_ij[idxj])), 3)*(1-pair_param(cppargs.k_hb, iA[i], iA[j], ncomp));
                 }
-                delta_ij[idxa] = ghs[iA[j]]*(exp(eABij[idxa]/t)-1)*pow(s_ij[iA[i]*ncomp+iA[j]], 3)*volABij[idxa];
+                delta_ij[idxa] = ghs[iA[j]]*(exp(eABij[idxa]/t)-1)*pow(s_ij[sym_idx(iA[i], iA[j], ncomp)], 3)*volABij[idxa];
                 for (int k = 0; k < ncomp; k++) {
                     idx_ddelta += 1;
                     dghsd_dd = PI/6.*m[k]*(pow(d[k], 3)/(1-zeta[3])/(1-zeta[3]) + 3*d[iA[i]]*d[iA[j]]/
@@ -422,7 +612,7 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
                         zeta[2]/pow(1-zeta[3], 3)) + 2*pow((d[iA[i]]*d[iA[j]]/(d[iA[i]]+d[iA[j]])), 2)*
                         (2*d[k]*d[k]*zeta[2]/pow(1-zeta[3], 3)+3*(pow(d[k], 3)*zeta[2]*zeta[2]
                         /pow(1-zeta[3], 4))));
-                    ddelta_dd[idx_ddelta] = dghsd_dd*(exp(eABij[idxa]/t)-1)*pow(s_ij[iA[i]*ncomp+iA[j]], 3)*volABij[idxa];
+                    ddelta_dd[idx_ddelta] = dghsd_dd*(exp(eABij[idxa]/t)-1)*pow(s_ij[sym_idx(iA[i], iA[j], ncomp)], 3)*volABij[idxa];
                 }
             }           
             XA[i*2] = (-1 + sqrt(1+8*den*delta_ij[i*ncA+i]))/(4*den*delta_ij[i*ncA+i]);
@@ -431,6 +621,9 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
             }
             XA[i*2+1] = XA[i*2];
         }
+        if (XA_io != NULL && (int)XA_io->size() == ncA*a_sites) {
+            XA = *XA_io;
+        }
 
         vector<double> x_assoc(ncA); // mole fractions of only the associating compounds
         for (int i = 0; i < ncA; i++) {
@@ -440,7 +633,8 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
         ctr = 0;
         double dif = 1000.;
         vector<double> XA_old = XA;
-        while ((ctr < 500) && (dif > 1e-9)) {
+        double dif_tol = (tol != NULL) ? tol->assoc : 1e-9;
+        while ((ctr < 500) && (dif > dif_tol)) {
             ctr += 1;
             XA = XA_find(XA, ncA, delta_ij, den, x_assoc);
             dif = 0.;
@@ -449,6 +643,10 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
             }
             XA_old = XA;
         }
+        PCSAFT_COUNT_XA(ctr, dif > dif_tol);
+        if (XA_io != NULL) {
+            *XA_io = XA;
+        }
 
         vector<double> dXA_dd(ncA*a_sites*ncomp, 0);
         dXA_dd = dXA_find(ncA, ncomp, iA, delta_ij, den, XA, ddelta_dd, x_assoc, a_sites);
@@ -465,6 +663,8 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
         Zassoc = summ;
     }
 
+    PCSAFT_TIMER_LAP(t_assoc);
+
     // Ion term ---------------------------------------------------------------
     double Zion = 0;
     if (!cppargs.z.empty()) {
@@ -473,12 +673,16 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
             q[i] = q[i]*E_CHRG;
         }
 
+        double ddielc_dt;
+        vector<double> ddielc_dx;
+        double dielc = dielc_cpp(x, t, cppargs, ddielc_dt, ddielc_dx);
+
         summ = 0.;
         for (int i = 0; i < ncomp; i++) {
             summ += cppargs.z[i]*cppargs.z[i]*x[i];
         }
         
-        double kappa = sqrt(den*E_CHRG*E_CHRG/kb/t/(cppargs.dielc*perm_vac)*summ); // the inverse Debye screening length. Equation 4 in Held et al. 2008.
+        double kappa = sqrt(den*E_CHRG*E_CHRG/kb/t/(dielc*perm_vac)*summ); // the inverse Debye screening length. Equation 4 in Held et al. 2008.
 
         if (kappa != 0) {
             double chi, sigma_k;
@@ -489,17 +693,19 @@ double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector
                 sigma_k = -2*chi+3/(1+kappa*s[i]);
                 summ += q[i]*q[i]*x[i]*sigma_k;
             }
-            Zion = -1*kappa/24./PI/kb/t/(cppargs.dielc*perm_vac)*summ;
+            Zion = -1*kappa/24./PI/kb/t/(dielc*perm_vac)*summ;
         }
     }
 
+    PCSAFT_TIMER_LAP(t_ion);
     double Z = Zid + Zhc + Zdisp + Zpolar + Zassoc + Zion;
+    PCSAFT_TRACE_RECORD(TRACE_Z, -1, rho, 0., &Z, 1);
     return Z;
 }
 
 
-vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs) {
+vector<double> pcsaft_fugcoef_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double rho, add_args &cppargs, const solver_tol *tol) {
     /**
     Calculate the fugacity coefficients for one phase of the system.
 
@@ -524,9 +730,9 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
         A struct containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : vector<double>, shape (n*n,)
+        k_ij : vector<double>, shape (n*n,) or (n*(n+1)/2,)
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, or the packed upper triangle)
         e_assoc : vector<double>, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -545,12 +751,25 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
         dielc : double
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+        dielc_model : vector<int>, shape (n,)
+            Model for the dielectric constant of each component (0 = not a 
+            solvent, 1 = water, 2 = dielc_coef). If given, the dielectric 
+            constant is calculated from the solvents instead of using dielc.
+        dielc_coef : vector<double>, shape (n*3,)
+            Coefficients a, b, c of the dielectric constant a + b*T + c*T^2 
+            of the components that use model 2.
+
+    tol : solver_tol*
+        Tolerances of the iterative solvers (see pcsaft_Z_cpp). Optional.
 
     Returns
     -------
     fugcoef : vector<double>, shape (n,)
         Fugacity coefficients of each component.
     */
+    PCSAFT_COUNT(evals, 1);
+    PCSAFT_TIMER_START();
+    PCSAFT_TRACE_SCOPE();
     int ncomp = x.size(); // number of components
     vector<double> d (ncomp);
     for (int i = 0; i < ncomp; i++) {
@@ -584,39 +803,33 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
 
     vector<double> ghs(ncomp, 0);
     vector<double> denghs(ncomp, 0);
-    vector<double> e_ij(ncomp*ncomp, 0);
-    vector<double> s_ij(ncomp*ncomp, 0);
-    double m2es3 = 0.;
-    double m2e2s3 = 0.;
+    mixing_cache local;
+    const mixing_cache &mixing = mixing_cache_get(m, s, e, cppargs, local);
+    const vector<double> &e_ij = mixing.e_ij;
+    const vector<double> &s_ij = mixing.s_ij;
+    // the dispersion mixing sums are quadratic forms xm^T*M*xm with xm_i = x_i*m_i, and M*xm
+    // gives the sums needed for all of the composition derivatives at once. M is symmetric, so
+    // M*xm is accumulated directly from the packed tables
+    VectorXd xm(ncomp);
+    VectorXd es3_xm = VectorXd::Zero(ncomp);
+    VectorXd e2s3_xm = VectorXd::Zero(ncomp);
+    for (int i = 0; i < ncomp; i++) {
+        xm(i) = x[i]*m[i];
+    }
+    double s3, es3, e2s3;
     int idx = -1;
     for (int i = 0; i < ncomp; i++) {
-        for (int j = 0; j < ncomp; j++) {
+        for (int j = i; j < ncomp; j++) {
             idx += 1;
-            if (cppargs.l_ij.empty()) {
-                s_ij[idx] = (s[i] + s[j])/2.;
-            }
-            else {
-                s_ij[idx] = (s[i] + s[j])/2.*(1-cppargs.l_ij[idx]);
-            }
-            if (!cppargs.z.empty()) {
-                if (cppargs.z[i]*cppargs.z[j] <= 0) { // for two cations or two anions e_ij is kept at zero to avoid dispersion between like ions (see Held et al. 2014)
-                    if (cppargs.k_ij.empty()) {
-                        e_ij[idx] = sqrt(e[i]*e[j]);
-                    }                    
-                    else {
-                        e_ij[idx] = sqrt(e[i]*e[j])*(1-cppargs.k_ij[idx]);
-                    }
-                }
-            } else {
-                if (cppargs.k_ij.empty()) {
-                    e_ij[idx] = sqrt(e[i]*e[j]);
-                }                    
-                else {
-                    e_ij[idx] = sqrt(e[i]*e[j])*(1-cppargs.k_ij[idx]);
-                }
+            s3 = s_ij[idx]*s_ij[idx]*s_ij[idx];
+            es3 = e_ij[idx]/t*s3;
+            e2s3 = e_ij[idx]/t*e_ij[idx]/t*s3;
+            es3_xm(i) += es3*xm(j);
+            e2s3_xm(i) += e2s3*xm(j);
+            if (j != i) {
+                es3_xm(j) += es3*xm(i);
+                e2s3_xm(j) += e2s3*xm(i);
             }
-            m2es3 = m2es3 + x[i]*x[j]*m[i]*m[j]*e_ij[idx]/t*pow(s_ij[idx], 3);
-            m2e2s3 = m2e2s3 + x[i]*x[j]*m[i]*m[j]*pow(e_ij[idx]/t,2)*pow(s_ij[idx], 3);
         }
         ghs[i] = 1/(1-zeta[3]) + (d[i]*d[i]/(d[i]+d[i]))*3*zeta[2]/(1-zeta[3])/(1-zeta[3]) + 
             pow(d[i]*d[i]/(d[i]+d[i]), 2)*2*zeta[2]*zeta[2]/pow(1-zeta[3], 3);
@@ -627,35 +840,25 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
             6*zeta[2]*zeta[2]*zeta[3]/pow(1-zeta[3], 4));
     }
 
+    double m2es3 = xm.dot(es3_xm);
+    double m2e2s3 = xm.dot(e2s3_xm);
+
     double ares_hs = 1/zeta[0]*(3*zeta[1]*zeta[2]/(1-zeta[3]) + pow(zeta[2], 3.)/(zeta[3]*pow(1-zeta[3],2)) 
             + (pow(zeta[2], 3.)/pow(zeta[3], 2.) - zeta[0])*log(1-zeta[3]));
     double Zhs = zeta[3]/(1-zeta[3]) + 3.*zeta[1]*zeta[2]/zeta[0]/(1.-zeta[3])/(1.-zeta[3]) + 
         (3.*pow(zeta[2], 3.) - zeta[3]*pow(zeta[2], 3.))/zeta[0]/pow(1.-zeta[3], 3.);
 
-    static double a0[7] = { 0.910563145, 0.636128145, 2.686134789, -26.54736249, 97.75920878, -159.5915409, 91.29777408 };
-    static double a1[7] = { -0.308401692, 0.186053116, -2.503004726, 21.41979363, -65.25588533, 83.31868048, -33.74692293 };
-    static double a2[7] = { -0.090614835, 0.452784281, 0.596270073, -1.724182913, -4.130211253, 13.77663187, -8.672847037 };
-    static double b0[7] = { 0.724094694, 2.238279186, -4.002584949, -21.00357682, 26.85564136, 206.5513384, -355.6023561 };
-    static double b1[7] = { -0.575549808, 0.699509552, 3.892567339, -17.21547165, 192.6722645, -161.8264617, -165.2076935 };
-    static double b2[7] = { 0.097688312, -0.255757498, -9.155856153, 20.64207597, -38.80443005, 93.62677408, -29.66690559 };
-
-    vector<double> a (7, 0);
-    vector<double> b (7, 0);
-    for (int i = 0; i < 7; i++) {
-        a[i] = a0[i] + (m_avg-1.)/m_avg*a1[i] + (m_avg-1.)/m_avg*(m_avg-2.)/m_avg*a2[i];
-        b[i] = b0[i] + (m_avg-1.)/m_avg*b1[i] + (m_avg-1.)/m_avg*(m_avg-2.)/m_avg*b2[i];
-    }
-
-    double detI1_det = 0.0;
-    double detI2_det = 0.0;
-    double I1 = 0.0;
-    double I2 = 0.0;
-    for (int i = 0; i < 7; i++) {
-        detI1_det += a[i]*(i+1)*pow(eta, i);
-        detI2_det += b[i]*(i+1)*pow(eta, i);
-        I2 += b[i]*pow(eta, i);
-        I1 += a[i]*pow(eta, i);
-    }
+    double a[7], b[7];
+    mix_coef(a0, a1, a2, m_avg, a);
+    mix_coef(b0, b1, b2, m_avg, b);
+
+    double I1_p[2], I2_p[2]; // I1 and I2 and their first derivatives with respect to eta
+    horner<1>(a, eta, I1_p);
+    horner<1>(b, eta, I2_p);
+    double detI1_det = I1_p[0] + eta*I1_p[1];
+    double detI2_det = I2_p[0] + eta*I2_p[1];
+    double I1 = I1_p[0];
+    double I2 = I2_p[0];
     double C1 = 1./(1. + m_avg*(8*eta-2*eta*eta)/pow(1-eta, 4) + (1-m_avg)*(20*eta-27*eta*eta+12*pow(eta, 3)-2*pow(eta, 4))/pow((1-eta)*(2-eta), 2.0));
     double C2 = -1.*C1*C1*(m_avg*(-4*eta*eta+20*eta+8)/pow(1-eta, 5) + (1-m_avg)*(2*pow(eta, 3)+12*eta*eta-48*eta+40)/pow((1-eta)*(2-eta), 3.0));
 
@@ -675,21 +878,28 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
     double Zhc = m_avg*Zhs - summ;
     double Zdisp = -2*PI*den*detI1_det*m2es3 - PI*den*m_avg*(C1*detI2_det + C2*eta*I2)*m2e2s3;
 
-    vector<double> dghs_dx(ncomp*ncomp, 0);
+    // sum_j x_j*(m_j-1)/ghs_j*dghs_j/dx_i is needed for each i. dghs_j/dx_i only depends on j
+    // through d_jj = d_j/2, so the sums over j are factored out and the cost is O(n)
+    double W0 = 0., W1 = 0., W2 = 0.;
+    double w_j, d_jj;
+    for (int j = 0; j < ncomp; j++) {
+        w_j = x[j]*(m[j]-1)/ghs[j];
+        d_jj = d[j]*d[j]/(d[j]+d[j]);
+        W0 += w_j;
+        W1 += w_j*d_jj;
+        W2 += w_j*d_jj*d_jj;
+    }
+
+    vector<double> dghs_sum(ncomp, 0);
     vector<double> dahs_dx(ncomp, 0);
     vector<double> dzeta_dx(4, 0);
-    idx = -1;
     for (int i = 0; i < ncomp; i++) {
         for (int l = 0; l < 4; l++) {
             dzeta_dx[l] = PI/6.*den*m[i]*pow(d[i],l);
         }
-        for (int j = 0; j < ncomp; j++) {
-            idx += 1;
-            dghs_dx[idx] = dzeta_dx[3]/(1-zeta[3])/(1-zeta[3]) + (d[j]*d[j]/(d[j]+d[j]))* 
-                    (3*dzeta_dx[2]/(1-zeta[3])/(1-zeta[3]) + 6*zeta[2]*dzeta_dx[3]/pow(1-zeta[3],3)) 
-                    + pow(d[j]*d[j]/(d[j]+d[j]),2)*(4*zeta[2]*dzeta_dx[2]/pow(1-zeta[3],3) 
-                    + 6*zeta[2]*zeta[2]*dzeta_dx[3]/pow(1-zeta[3],4));
-        }
+        dghs_sum[i] = dzeta_dx[3]/(1-zeta[3])/(1-zeta[3])*W0 
+            + (3*dzeta_dx[2]/(1-zeta[3])/(1-zeta[3]) + 6*zeta[2]*dzeta_dx[3]/pow(1-zeta[3],3))*W1 
+            + (4*zeta[2]*dzeta_dx[2]/pow(1-zeta[3],3) + 6*zeta[2]*zeta[2]*dzeta_dx[3]/pow(1-zeta[3],4))*W2;
         dahs_dx[i] = -dzeta_dx[0]/zeta[0]*ares_hs + 1/zeta[0]*(3*(dzeta_dx[1]*zeta[2] 
                 + zeta[1]*dzeta_dx[2])/(1-zeta[3]) + 3*zeta[1]*zeta[2]*dzeta_dx[3] 
                 /(1-zeta[3])/(1-zeta[3]) + 3*zeta[2]*zeta[2]*dzeta_dx[2]/zeta[3]/(1-zeta[3])/(1-zeta[3]) 
@@ -701,27 +911,24 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
 
     vector<double> dadisp_dx(ncomp, 0);
     vector<double> dahc_dx(ncomp, 0);
-    double dzeta3_dx, daa_dx, db_dx, dI1_dx, dI2_dx, dm2es3_dx, dm2e2s3_dx, dC1_dx;
+    // the derivatives of a and b with respect to x_i are m_i/m_avg^2*(a1 + (3-4/m_avg)*a2), so
+    // the corresponding series only needs to be evaluated once
+    double daa_dx[7], db_dx[7], daa_p[1], db_p[1];
+    for (int l = 0; l < 7; l++) {
+        daa_dx[l] = a1[l] + (3-4/m_avg)*a2[l];
+        db_dx[l] = b1[l] + (3-4/m_avg)*b2[l];
+    }
+    horner<0>(daa_dx, eta, daa_p);
+    horner<0>(db_dx, eta, db_p);
+
+    double dzeta3_dx, dI1_dx, dI2_dx, dm2es3_dx, dm2e2s3_dx, dC1_dx;
     for (int i = 0; i < ncomp; i++) {
         dzeta3_dx = PI/6.*den*m[i]*pow(d[i],3);
-        dI1_dx = 0.0;
-        dI2_dx = 0.0;
-        dm2es3_dx = 0.0;
-        dm2e2s3_dx = 0.0;
-        for (int l = 0; l < 7; l++) {
-            daa_dx = m[i]/m_avg/m_avg*a1[l] + m[i]/m_avg/m_avg*(3-4/m_avg)*a2[l];
-            db_dx = m[i]/m_avg/m_avg*b1[l] + m[i]/m_avg/m_avg*(3-4/m_avg)*b2[l];
-            dI1_dx += a[l]*l*dzeta3_dx*pow(eta,l-1) + daa_dx*pow(eta,l);
-            dI2_dx += b[l]*l*dzeta3_dx*pow(eta,l-1) + db_dx*pow(eta,l);
-        }
-        for (int j = 0; j < ncomp; j++) {
-            dm2es3_dx += x[j]*m[j]*(e_ij[i*ncomp+j]/t)*pow(s_ij[i*ncomp+j],3);
-            dm2e2s3_dx += x[j]*m[j]*pow(e_ij[i*ncomp+j]/t,2)*pow(s_ij[i*ncomp+j],3);
-            dahc_dx[i] += x[j]*(m[j]-1)/ghs[j]*dghs_dx[i*ncomp+j];
-        }
-        dm2es3_dx = dm2es3_dx*2*m[i];
-        dm2e2s3_dx = dm2e2s3_dx*2*m[i];
-        dahc_dx[i] = m[i]*ares_hs + m_avg*dahs_dx[i] - dahc_dx[i] - (m[i]-1)*log(ghs[i]);
+        dI1_dx = I1_p[1]*dzeta3_dx + m[i]/m_avg/m_avg*daa_p[0];
+        dI2_dx = I2_p[1]*dzeta3_dx + m[i]/m_avg/m_avg*db_p[0];
+        dm2es3_dx = es3_xm(i)*2*m[i];
+        dm2e2s3_dx = e2s3_xm(i)*2*m[i];
+        dahc_dx[i] = m[i]*ares_hs + m_avg*dahs_dx[i] - dghs_sum[i] - (m[i]-1)*log(ghs[i]);
         dC1_dx = C2*dzeta3_dx - C1*C1*(m[i]*(8*eta-2*eta*eta)/pow(1-eta,4) - 
             m[i]*(20*eta-27*eta*eta+12*pow(eta,3)-2*pow(eta,4))/pow((1-eta)*(2-eta),2));
 
@@ -730,20 +937,27 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
             + m_avg*C1*I2*dm2e2s3_dx);
     }
 
+    double xdahc_dx = 0.;
+    double xdadisp_dx = 0.;
+    for (int j = 0; j < ncomp; j++) {
+        xdahc_dx += x[j]*dahc_dx[j];
+        xdadisp_dx += x[j]*dadisp_dx[j];
+    }
     vector<double> mu_hc(ncomp, 0);
     vector<double> mu_disp(ncomp, 0);
     for (int i = 0; i < ncomp; i++) {
-        for (int j = 0; j < ncomp; j++) {
-            mu_hc[i] += x[j]*dahc_dx[j];
-            mu_disp[i] += x[j]*dadisp_dx[j];
-        }
-        mu_hc[i] = ares_hc + Zhc + dahc_dx[i] - mu_hc[i];
-        mu_disp[i] = ares_disp + Zdisp + dadisp_dx[i] - mu_disp[i];
+        mu_hc[i] = ares_hc + Zhc + dahc_dx[i] - xdahc_dx;
+        mu_disp[i] = ares_disp + Zdisp + dadisp_dx[i] - xdadisp_dx;
     }
 
+    PCSAFT_TIMER_LAP(t_hc_disp);
+
     // Dipole term (Gross and Vrabec term) --------------------------------------
     vector<double> mu_polar(ncomp, 0);
     if (!cppargs.dipm.empty()) {
+        const polar_subset &ps = mixing.polar;
+        int npairs = ps.pairs.size();
+        int ntriples = ps.triples.size();
         double A2 = 0.;
         double A3 = 0.;
         double dA2_det = 0.;
@@ -751,127 +965,96 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
         vector<double> dA2_dx(ncomp, 0);
         vector<double> dA3_dx(ncomp, 0);
 
-        static double a0dip[5] = { 0.3043504, -0.1358588, 1.4493329, 0.3556977, -2.0653308 };
-        static double a1dip[5] = { 0.9534641, -1.8396383, 2.0131180, -7.3724958, 8.2374135 };
-        static double a2dip[5] = { -1.1610080, 4.5258607, 0.9751222, -12.281038, 5.9397575 };
-        static double b0dip[5] = { 0.2187939, -1.1896431, 1.1626889, 0, 0 };
-        static double b1dip[5] = { -0.5873164, 1.2489132, -0.5085280, 0, 0 };
-        static double b2dip[5] = { 3.4869576, -14.915974, 15.372022, 0, 0 };
-        static double c0dip[5] = { -0.0646774, 0.1975882, -0.8087562, 0.6902849, 0 };
-        static double c1dip[5] = { -0.9520876, 2.9924258, -2.3802636, -0.2701261, 0 };
-        static double c2dip[5] = { -0.6260979, 1.2924686, 1.6542783, -3.4396744, 0 };
-
-        const static double conv = 7242.702976750923; // conversion factor, see the note below Table 2 in Gross and Vrabec 2006
-
-        vector<double> dipmSQ (ncomp, 0);
-        for (int i = 0; i < ncomp; i++) {     
-            dipmSQ[i] = pow(cppargs.dipm[i], 2.)/(m[i]*e[i]*pow(s[i],3.))*conv;
-        }
-
-        vector<double> adip (5, 0);
-        vector<double> bdip (5, 0);
-        vector<double> cdip (5, 0);
-        double J2, dJ2_det, J3, dJ3_det;
-        double m_ij;
-        double m_ijk;
+        vector<double> dzeta3_dx(ncomp, 0);
         for (int i = 0; i < ncomp; i++) {
-            for (int j = 0; j < ncomp; j++) {
-                m_ij = sqrt(m[i]*m[j]);
-                if (m_ij > 2) {
-                    m_ij = 2;
-                }
-                J2 = 0.;
-                dJ2_det = 0.;
-                for (int l = 0; l < 5; l++) {
-                    adip[l] = a0dip[l] + (m_ij-1)/m_ij*a1dip[l] + (m_ij-1)/m_ij*(m_ij-2)/m_ij*a2dip[l];
-                    bdip[l] = b0dip[l] + (m_ij-1)/m_ij*b1dip[l] + (m_ij-1)/m_ij*(m_ij-2)/m_ij*b2dip[l];
-                    J2 += (adip[l] + bdip[l]*e_ij[j*ncomp+j]/t)*pow(eta, l); // j*ncomp+j needs to be used for e_ij because it is formatted as a 1D vector                   
-                    dJ2_det += (adip[l] + bdip[l]*e_ij[j*ncomp+j]/t)*l*pow(eta, l-1);
-                }
-                A2 += x[i]*x[j]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)/
-                    pow(s_ij[i*ncomp+j],3)*cppargs.dip_num[i]*cppargs.dip_num[j]*dipmSQ[i]*dipmSQ[j]*J2;
-                dA2_det += x[i]*x[j]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*pow(s_ij[i*ncomp+i],3)*
-                    pow(s_ij[j*ncomp+j],3)/pow(s_ij[i*ncomp+j],3)*cppargs.dip_num[i]*cppargs.dip_num[j]*dipmSQ[i]*dipmSQ[j]*dJ2_det;
-                if (i == j) {
-                    dA2_dx[i] += e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3) 
-                        /pow(s_ij[i*ncomp+j],3)*cppargs.dip_num[i]*cppargs.dip_num[j]*dipmSQ[i]*dipmSQ[j]* 
-                        (x[i]*x[j]*dJ2_det*PI/6.*den*m[i]*pow(d[i],3) + 2*x[j]*J2);
-                }
-                else {
-                    dA2_dx[i] += e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3) 
-                        /pow(s_ij[i*ncomp+j],3)*cppargs.dip_num[i]*cppargs.dip_num[j]*dipmSQ[i]*dipmSQ[j]* 
-                        (x[i]*x[j]*dJ2_det*PI/6.*den*m[i]*pow(d[i],3) + x[j]*J2);
-                }
+            dzeta3_dx[i] = PI/6.*den*m[i]*pow(d[i],3);
+        }
+
+        double J2a_p[2], J2b_p[2], J3_p[2];
+        double J2, dJ2_det, w, xw;
+        int i, j;
+        for (int n = 0; n < npairs; n++) {
+            const polar_pair &pp = ps.pairs[n];
+            i = pp.i;
+            j = pp.j;
+            horner<1>(pp.adip, eta, J2a_p);
+            horner<1>(pp.bdip, eta, J2b_p);
+            w = pp.w/t/t;
+            xw = x[i]*x[j]*w;
+            A2 += xw*(pp.mult*J2a_p[0] + pp.e_b/t*J2b_p[0]);
+            dA2_det += xw*(pp.mult*J2a_p[1] + pp.e_b/t*J2b_p[1]);
+
+            // J2 for the pair (i, j) uses e_jj, so it differs from J2 for (j, i)
+            J2 = J2a_p[0] + J2b_p[0]*e_ij[sym_idx(j, j, ncomp)]/t;
+            dJ2_det = J2a_p[1] + J2b_p[1]*e_ij[sym_idx(j, j, ncomp)]/t;
+            if (i == j) {
+                dA2_dx[i] += w*(x[i]*x[j]*dJ2_det*dzeta3_dx[i] + 2*x[j]*J2);
+            }
+            else {
+                dA2_dx[i] += w*(x[i]*x[j]*dJ2_det*dzeta3_dx[i] + x[j]*J2);
+                J2 = J2a_p[0] + J2b_p[0]*e_ij[sym_idx(i, i, ncomp)]/t;
+                dJ2_det = J2a_p[1] + J2b_p[1]*e_ij[sym_idx(i, i, ncomp)]/t;
+                dA2_dx[j] += w*(x[j]*x[i]*dJ2_det*dzeta3_dx[j] + x[i]*J2);
+            }
+        }
 
-                for (int k = 0; k < ncomp; k++) {
-                    m_ijk = pow((m[i]*m[j]*m[k]),1/3.);
-                    if (m_ijk > 2) {
-                        m_ijk = 2;
-                    }
-                    J3 = 0.;
-                    dJ3_det = 0.;
-                    for (int l = 0; l < 5; l++) {
-                        cdip[l] = c0dip[l] + (m_ijk-1)/m_ijk*c1dip[l] + (m_ijk-1)/m_ijk*(m_ijk-2)/m_ijk*c2dip[l];
-                        J3 += cdip[l]*pow(eta, l);
-                        dJ3_det += cdip[l]*l*pow(eta, (l-1));
-                    }
-                    A3 += x[i]*x[j]*x[k]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*e_ij[k*ncomp+k]/t*
-                        pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)*pow(s_ij[k*ncomp+k],3)/s_ij[i*ncomp+j]/s_ij[i*ncomp+k]/
-                        s_ij[j*ncomp+k]*cppargs.dip_num[i]*cppargs.dip_num[j]*cppargs.dip_num[k]*dipmSQ[i]*
-                        dipmSQ[j]*dipmSQ[k]*J3;
-                    dA3_det += x[i]*x[j]*x[k]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*e_ij[k*ncomp+k]/t*
-                        pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)*pow(s_ij[k*ncomp+k],3)/s_ij[i*ncomp+j]/s_ij[i*ncomp+k]/
-                        s_ij[j*ncomp+k]*cppargs.dip_num[i]*cppargs.dip_num[j]*cppargs.dip_num[k]*dipmSQ[i]*
-                        dipmSQ[j]*dipmSQ[k]*dJ3_det;
-                    if ((i == j) && (i == k)) {
-                        dA3_dx[i] += e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*e_ij[k*ncomp+k]/t*pow(s_ij[i*ncomp+i],3) 
-                            *pow(s_ij[j*ncomp+j],3)*pow(s_ij[k*ncomp+k],3)/s_ij[i*ncomp+j]/s_ij[i*ncomp+k]/s_ij[j*ncomp+k] 
-                            *cppargs.dip_num[i]*cppargs.dip_num[j]*cppargs.dip_num[k]*dipmSQ[i]*dipmSQ[j] 
-                            *dipmSQ[k]*(x[i]*x[j]*x[k]*dJ3_det*PI/6.*den*m[i]*pow(d[i],3) 
-                            + 3*x[j]*x[k]*J3);
-                    }
-                    else if ((i == j) || (i == k)) {
-                        dA3_dx[i] += e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*e_ij[k*ncomp+k]/t*pow(s_ij[i*ncomp+i],3) 
-                            *pow(s_ij[j*ncomp+j],3)*pow(s_ij[k*ncomp+k],3)/s_ij[i*ncomp+j]/s_ij[i*ncomp+k]/s_ij[j*ncomp+k] 
-                            *cppargs.dip_num[i]*cppargs.dip_num[j]*cppargs.dip_num[k]*dipmSQ[i]*dipmSQ[j] 
-                            *dipmSQ[k]*(x[i]*x[j]*x[k]*dJ3_det*PI/6.*den*m[i]*pow(d[i],3) 
-                            + 2*x[j]*x[k]*J3);
-                    }
-                    else {
-                        dA3_dx[i] += e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*e_ij[k*ncomp+k]/t*pow(s_ij[i*ncomp+i],3) 
-                            *pow(s_ij[j*ncomp+j],3)*pow(s_ij[k*ncomp+k],3)/s_ij[i*ncomp+j]/s_ij[i*ncomp+k]/s_ij[j*ncomp+k] 
-                            *cppargs.dip_num[i]*cppargs.dip_num[j]*cppargs.dip_num[k]*dipmSQ[i]*dipmSQ[j] 
-                            *dipmSQ[k]*(x[i]*x[j]*x[k]*dJ3_det*PI/6.*den*m[i]*pow(d[i],3) 
-                            + x[j]*x[k]*J3);
-                    }
+        int ijk[3];
+        int r1, r2, nperm;
+        for (int n = 0; n < ntriples; n++) {
+            const polar_triple &pt = ps.triples[n];
+            horner<1>(pt.cdip, eta, J3_p);
+            w = pt.w/t/t/t;
+            xw = pt.mult*x[pt.i]*x[pt.j]*x[pt.k]*w;
+            A3 += xw*J3_p[0];
+            dA3_det += xw*J3_p[1];
+
+            // derivative with respect to each distinct component of the triple,
+            // summed over the orderings of the triple that start with it
+            ijk[0] = pt.i;
+            ijk[1] = pt.j;
+            ijk[2] = pt.k;
+            for (int a = 0; a < 3; a++) {
+                if ((a > 0) && (ijk[a] == ijk[a-1])) {
+                    continue;
                 }
+                i = ijk[a];
+                r1 = ijk[(a == 0) ? 1 : 0];
+                r2 = ijk[(a == 2) ? 1 : 2];
+                nperm = (r1 == r2) ? 1 : 2;
+                dA3_dx[i] += w*nperm*x[r1]*x[r2]*(x[i]*J3_p[1]*dzeta3_dx[i]
+                    + (1 + (r1 == i) + (r2 == i))*J3_p[0]);
             }
         }
 
-        A2 = -PI*den*A2;
-        A3 = -4/3.*PI*PI*den*den*A3;
-        dA2_det = -PI*den*dA2_det;
-        dA3_det = -4/3.*PI*PI*den*den*dA3_det;
-        for (int i = 0; i < ncomp; i++) {
-            dA2_dx[i] = -PI*den*dA2_dx[i];
-            dA3_dx[i] = -4/3.*PI*PI*den*den*dA3_dx[i];
-        }
+        if (npairs > 0) {
+            A2 = -PI*den*A2;
+            A3 = -4/3.*PI*PI*den*den*A3;
+            dA2_det = -PI*den*dA2_det;
+            dA3_det = -4/3.*PI*PI*den*den*dA3_det;
+            for (int i = 0; i < ncomp; i++) {
+                dA2_dx[i] = -PI*den*dA2_dx[i];
+                dA3_dx[i] = -4/3.*PI*PI*den*den*dA3_dx[i];
+            }
 
-        vector<double> dapolar_dx(ncomp);
-        for (int i = 0; i < ncomp; i++) {
-            dapolar_dx[i] = (dA2_dx[i]*(1-A3/A2) + (dA3_dx[i]*A2 - A3*dA2_dx[i])/A2)/pow(1-A3/A2,2);
-        }
+            vector<double> dapolar_dx(ncomp);
+            for (int i = 0; i < ncomp; i++) {
+                dapolar_dx[i] = (dA2_dx[i]*(1-A3/A2) + (dA3_dx[i]*A2 - A3*dA2_dx[i])/A2)/pow(1-A3/A2,2);
+            }
 
-        double ares_polar = A2/(1-A3/A2);
-        double Zpolar = eta*((dA2_det*(1-A3/A2)+(dA3_det*A2-A3*dA2_det)/A2)/(1-A3/A2)/(1-A3/A2));
-        for (int i = 0; i < ncomp; i++) {
+            double ares_polar = A2/(1-A3/A2);
+            double Zpolar = eta*((dA2_det*(1-A3/A2)+(dA3_det*A2-A3*dA2_det)/A2)/(1-A3/A2)/(1-A3/A2));
+            double xdapolar_dx = 0.;
             for (int j = 0; j < ncomp; j++) {
-                mu_polar[i] += x[j]*dapolar_dx[j];
+                xdapolar_dx += x[j]*dapolar_dx[j];
+            }
+            for (int i = 0; i < ncomp; i++) {
+                mu_polar[i] = ares_polar + Zpolar + dapolar_dx[i] - xdapolar_dx;
             }
-            mu_polar[i] = ares_polar + Zpolar + dapolar_dx[i] - mu_polar[i];
         }
     }
 
+    PCSAFT_TIMER_LAP(t_polar);
+
     // Association term -------------------------------------------------------
     // only the 2B association type is currently implemented
     vector<double> mu_assoc(ncomp, 0);
@@ -901,10 +1084,10 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
         int idx_ddelta = -1; // index for ddelta_dd vector
         double dghsd_dd;
         for (int i = 0; i < ncA; i++) {
-            idxi = iA[i]*ncomp+iA[i];
+            idxi = sym_idx(iA[i], iA[i], ncomp);
             for (int j = 0; j < ncA; j++) {
                 idxa += 1;
-                idxj = iA[j]*ncomp+iA[j];
+                idxj = sym_idx(iA[j], iA[j], ncomp);
                 eABij[idxa] = (cppargs.e_assoc[iA[i]]+cppargs.e_assoc[iA[j]])/2.;
                 if (cppargs.k_hb.empty()) {
                     volABij[idxa] = sqrt(cppargs.vol_a[iA[i]]*cppargs.vol_a[iA[j]])*pow(sqrt(s_ij[idxi]*
@@ -912,9 +1095,9 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
                 }
                 else {
                     volABij[idxa] = sqrt(cppargs.vol_a[iA[i]]*cppargs.vol_a[iA[j]])*pow(sqrt(s_ij[idxi]*
-                        s_ij[idxj])/(0.5*(s_ij[idxi]+s_ij[idxj])), 3)*(1-cppargs.k_hb[iA[i]*ncomp+iA[j]]);
+                        s_ij[idxj])/(0.5*(s_ij[idxi]+s_ij[idxj])), 3)*(1-pair_param(cppargs.k_hb, iA[i], iA[j], ncomp));
                 }
-                delta_ij[idxa] = ghs[iA[j]]*(exp(eABij[idxa]/t)-1)*pow(s_ij[iA[i]*ncomp+iA[j]], 3)*volABij[idxa];
+                delta_ij[idxa] = ghs[iA[j]]*(exp(eABij[idxa]/t)-1)*pow(s_ij[sym_idx(iA[i], iA[j], ncomp)], 3)*volABij[idxa];
                 for (int k = 0; k < ncomp; k++) {
                     idx_ddelta += 1;
                     dghsd_dd = PI/6.*m[k]*(pow(d[k], 3)/(1-zeta[3])/(1-zeta[3]) + 3*d[iA[i]]*d[iA[j]]/
@@ -922,7 +1105,7 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
                         zeta[2]/pow(1-zeta[3], 3)) + 2*pow((d[iA[i]]*d[iA[j]]/(d[iA[i]]+d[iA[j]])), 2)*
                         (2*d[k]*d[k]*zeta[2]/pow(1-zeta[3], 3)+3*(pow(d[k], 3)*zeta[2]*zeta[2]
                         /pow(1-zeta[3], 4))));
-                    ddelta_dd[idx_ddelta] = dghsd_dd*(exp(eABij[idxa]/t)-1)*pow(s_ij[iA[i]*ncomp+iA[j]], 3)*volABij[idxa];
+                    ddelta_dd[idx_ddelta] = dghsd_dd*(exp(eABij[idxa]/t)-1)*pow(s_ij[sym_idx(iA[i], iA[j], ncomp)], 3)*volABij[idxa];
                 }
             }           
             XA[i*2] = (-1 + sqrt(1+8*den*delta_ij[i*ncA+i]))/(4*den*delta_ij[i*ncA+i]);
@@ -940,7 +1123,8 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
         ctr = 0;
         double dif = 1000.;
         vector<double> XA_old = XA;
-        while ((ctr < 500) && (dif > 1e-9)) {
+        double dif_tol = (tol != NULL) ? tol->assoc : 1e-9;
+        while ((ctr < 500) && (dif > dif_tol)) {
             ctr += 1;
             XA = XA_find(XA, ncA, delta_ij, den, x_assoc);
             dif = 0.;
@@ -949,6 +1133,7 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
             }
             XA_old = XA;
         }
+        PCSAFT_COUNT_XA(ctr, dif > dif_tol);
 
         vector<double> dXA_dd(ncA*a_sites*ncomp, 0);
         dXA_dd = dXA_find(ncA, ncomp, iA, delta_ij, den, XA, ddelta_dd, x_assoc, a_sites);
@@ -969,6 +1154,8 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
         }
     }
 
+    PCSAFT_TIMER_LAP(t_assoc);
+
     // Ion term ---------------------------------------------------------------
     vector<double> mu_ion(ncomp, 0);    
     if (!cppargs.z.empty()) {
@@ -977,32 +1164,45 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
             q[i] = q[i]*E_CHRG;
         }
 
+        double ddielc_dt;
+        vector<double> ddielc_dx;
+        double dielc = dielc_cpp(x, t, cppargs, ddielc_dt, ddielc_dx);
+
         summ = 0.;
         for (int i = 0; i < ncomp; i++) {
             summ += cppargs.z[i]*cppargs.z[i]*x[i];
         }
-        double kappa = sqrt(den*E_CHRG*E_CHRG/kb/t/(cppargs.dielc*perm_vac)*summ); // the inverse Debye screening length. Equation 4 in Held et al. 2008.
+        double kappa = sqrt(den*E_CHRG*E_CHRG/kb/t/(dielc*perm_vac)*summ); // the inverse Debye screening length. Equation 4 in Held et al. 2008.
 
         if (kappa != 0) {
             vector<double> chi(ncomp); 
             vector<double> sigma_k(ncomp);
             double summ1 = 0.;
             double summ2 = 0.;
+            double summ3 = 0.;
+            double xddielc_dx = 0.;
             for (int i = 0; i < ncomp; i++) {
                 chi[i] = 3/pow(kappa*s[i], 3)*(1.5 + log(1+kappa*s[i]) - 2*(1+kappa*s[i]) +
                     0.5*pow(1+kappa*s[i], 2));
                 sigma_k[i] = -2*chi[i]+3/(1+kappa*s[i]);
                 summ1 += q[i]*q[i]*x[i]*sigma_k[i];
                 summ2 += x[i]*q[i]*q[i];
+                summ3 += x[i]*q[i]*q[i]*chi[i];
+                xddielc_dx += x[i]*ddielc_dx[i];
             }
 
+            // the ion term depends on the dielectric constant through kb*t*dielc, so that
+            // d(ares_ion)/d(dielc) = -(ares_ion + Zion)/dielc
+            double pre = kappa/24./PI/kb/t/(dielc*perm_vac);
+            double dares_ddielc = (2*pre*summ3 + pre*summ1)/dielc;
             for (int i = 0; i < ncomp; i++) {
-                mu_ion[i] = -q[i]*q[i]*kappa/24./PI/kb/t/(cppargs.dielc*perm_vac)* 
-                    (2*chi[i] + summ1/summ2);
+                mu_ion[i] = -q[i]*q[i]*pre*(2*chi[i] + summ1/summ2)
+                    + dares_ddielc*(ddielc_dx[i] - xddielc_dx);
             }
         }
     }
 
+    PCSAFT_TIMER_LAP(t_ion);
     double Z = pcsaft_Z_cpp(x, m, s, e, t, rho, cppargs);
 
     vector<double> mu(ncomp, 0);
@@ -1012,12 +1212,14 @@ vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<dou
         fugcoef[i] = exp(mu[i] - log(Z)); // the fugacity coefficients
     }
 
+    PCSAFT_TRACE_RECORD(TRACE_FUGCOEF, -1, rho, 0., &fugcoef[0], ncomp);
     return fugcoef;
 }
 
 
-double pcsaft_p_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs) {
+double pcsaft_p_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double rho, add_args &cppargs, vector<double> *XA_io,
+    const solver_tol *tol) {
     /**
     Calculate pressure.
 
@@ -1042,9 +1244,9 @@ double pcsaft_p_cpp(vector<double> x, vector<double> m, vector<double> s, vector
         A struct containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : vector<double>, shape (n*n,)
+        k_ij : vector<double>, shape (n*n,) or (n*(n+1)/2,)
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, or the packed upper triangle)
         e_assoc : vector<double>, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -1063,22 +1265,36 @@ double pcsaft_p_cpp(vector<double> x, vector<double> m, vector<double> s, vector
         dielc : double
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+        dielc_model : vector<int>, shape (n,)
+            Model for the dielectric constant of each component (0 = not a 
+            solvent, 1 = water, 2 = dielc_coef). If given, the dielectric 
+            constant is calculated from the solvents instead of using dielc.
+        dielc_coef : vector<double>, shape (n*3,)
+            Coefficients a, b, c of the dielectric constant a + b*T + c*T^2 
+            of the components that use model 2.
+    XA_io : vector<double>*
+        Starting point for the fraction of unbonded association sites, which
+        receives the converged values (see pcsaft_Z_cpp). Optional.
+    tol : solver_tol*
+        Tolerances of the iterative solvers (see pcsaft_Z_cpp). Optional.
 
     Returns
     -------
     P : double
         Pressure (Pa)
     */
+    PCSAFT_TRACE_SCOPE();
     double den = rho*N_AV/1.0e30;
 
-    double Z = pcsaft_Z_cpp(x, m, s, e, t, rho, cppargs);
+    double Z = pcsaft_Z_cpp(x, m, s, e, t, rho, cppargs, XA_io, tol);
     double P = Z*kb*t*den*1.0e30; // Pa
+    PCSAFT_TRACE_RECORD(TRACE_P, -1, rho, 0., &P, 1);
     return P;
 }
 
 
-double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs) {
+double pcsaft_ares_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double rho, add_args &cppargs) {
     /**
     Calculates the residual Helmholtz energy.
 
@@ -1103,9 +1319,9 @@ double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         A struct containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : vector<double>, shape (n*n,)
+        k_ij : vector<double>, shape (n*n,) or (n*(n+1)/2,)
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, or the packed upper triangle)
         e_assoc : vector<double>, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -1124,12 +1340,22 @@ double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         dielc : double
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+        dielc_model : vector<int>, shape (n,)
+            Model for the dielectric constant of each component (0 = not a 
+            solvent, 1 = water, 2 = dielc_coef). If given, the dielectric 
+            constant is calculated from the solvents instead of using dielc.
+        dielc_coef : vector<double>, shape (n*3,)
+            Coefficients a, b, c of the dielectric constant a + b*T + c*T^2 
+            of the components that use model 2.
 
     Returns
     -------
     ares : double
         Residual Helmholtz energy (J mol^-1)
     */     
+    PCSAFT_COUNT(evals, 1);
+    PCSAFT_TIMER_START();
+    PCSAFT_TRACE_SCOPE();
     int ncomp = x.size(); // number of components
     vector<double> d (ncomp);
     for (int i = 0; i < ncomp; i++) {
@@ -1162,39 +1388,21 @@ double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vec
     }
 
     vector<double> ghs (ncomp, 0);
-    vector<double> e_ij (ncomp*ncomp, 0);
-    vector<double> s_ij (ncomp*ncomp, 0);
+    mixing_cache local;
+    const mixing_cache &mixing = mixing_cache_get(m, s, e, cppargs, local);
+    const vector<double> &e_ij = mixing.e_ij;
+    const vector<double> &s_ij = mixing.s_ij;
     double m2es3 = 0.;
     double m2e2s3 = 0.;
+    double s3, w;
     int idx = -1;
     for (int i = 0; i < ncomp; i++) {
-        for (int j = 0; j < ncomp; j++) {
+        for (int j = i; j < ncomp; j++) {
             idx += 1;
-            if (cppargs.l_ij.empty()) {
-                s_ij[idx] = (s[i] + s[j])/2.;
-            }
-            else {
-                s_ij[idx] = (s[i] + s[j])/2.*(1-cppargs.l_ij[idx]);
-            }
-            if (!cppargs.z.empty()) {
-                if (cppargs.z[i]*cppargs.z[j] <= 0) { // for two cations or two anions e_ij is kept at zero to avoid dispersion between like ions (see Held et al. 2014)
-                    if (cppargs.k_ij.empty()) {
-                        e_ij[idx] = sqrt(e[i]*e[j]);
-                    }                    
-                    else {
-                        e_ij[idx] = sqrt(e[i]*e[j])*(1-cppargs.k_ij[idx]);
-                    }
-                }
-            } else {
-                if (cppargs.k_ij.empty()) {
-                    e_ij[idx] = sqrt(e[i]*e[j]);
-                }                    
-                else {
-                    e_ij[idx] = sqrt(e[i]*e[j])*(1-cppargs.k_ij[idx]);
-                }
-            }
-            m2es3 = m2es3 + x[i]*x[j]*m[i]*m[j]*e_ij[idx]/t*pow(s_ij[idx], 3);
-            m2e2s3 = m2e2s3 + x[i]*x[j]*m[i]*m[j]*pow(e_ij[idx]/t,2)*pow(s_ij[idx], 3);
+            w = (i == j) ? 1. : 2.; // the tables hold each unordered pair once
+            s3 = s_ij[idx]*s_ij[idx]*s_ij[idx];
+            m2es3 = m2es3 + w*x[i]*x[j]*m[i]*m[j]*e_ij[idx]/t*s3;
+            m2e2s3 = m2e2s3 + w*x[i]*x[j]*m[i]*m[j]*e_ij[idx]/t*e_ij[idx]/t*s3;
         }
         ghs[i] = 1/(1-zeta[3]) + (d[i]*d[i]/(d[i]+d[i]))*3*zeta[2]/(1-zeta[3])/(1-zeta[3]) + 
             pow(d[i]*d[i]/(d[i]+d[i]), 2)*2*zeta[2]*zeta[2]/pow(1-zeta[3], 3);
@@ -1203,26 +1411,15 @@ double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vec
     double ares_hs = 1/zeta[0]*(3*zeta[1]*zeta[2]/(1-zeta[3]) + pow(zeta[2], 3.)/(zeta[3]*pow(1-zeta[3],2)) 
             + (pow(zeta[2], 3.)/pow(zeta[3], 2.) - zeta[0])*log(1-zeta[3]));
 
-    static double a0[7] = { 0.910563145, 0.636128145, 2.686134789, -26.54736249, 97.75920878, -159.5915409, 91.29777408 };
-    static double a1[7] = { -0.308401692, 0.186053116, -2.503004726, 21.41979363, -65.25588533, 83.31868048, -33.74692293 };
-    static double a2[7] = { -0.090614835, 0.452784281, 0.596270073, -1.724182913, -4.130211253, 13.77663187, -8.672847037 };
-    static double b0[7] = { 0.724094694, 2.238279186, -4.002584949, -21.00357682, 26.85564136, 206.5513384, -355.6023561 };
-    static double b1[7] = { -0.575549808, 0.699509552, 3.892567339, -17.21547165, 192.6722645, -161.8264617, -165.2076935 };
-    static double b2[7] = { 0.097688312, -0.255757498, -9.155856153, 20.64207597, -38.80443005, 93.62677408, -29.66690559 };
-
-    vector<double> a (7, 0);
-    vector<double> b (7, 0);
-    for (int i = 0; i < 7; i++) {
-        a[i] = a0[i] + (m_avg-1.)/m_avg*a1[i] + (m_avg-1.)/m_avg*(m_avg-2.)/m_avg*a2[i];
-        b[i] = b0[i] + (m_avg-1.)/m_avg*b1[i] + (m_avg-1.)/m_avg*(m_avg-2.)/m_avg*b2[i];
-    }
+    double a[7], b[7];
+    mix_coef(a0, a1, a2, m_avg, a);
+    mix_coef(b0, b1, b2, m_avg, b);
     
-    double I1 = 0.0;
-    double I2 = 0.0;
-    for (int i = 0; i < 7; i++) {
-        I1 += a[i]*pow(eta, i);
-        I2 += b[i]*pow(eta, i);
-    }
+    double I1_p[1], I2_p[1];
+    horner<0>(a, eta, I1_p);
+    horner<0>(b, eta, I2_p);
+    double I1 = I1_p[0];
+    double I2 = I2_p[0];
     double C1 = 1./(1. + m_avg*(8*eta-2*eta*eta)/pow(1-eta, 4) + (1-m_avg)*(20*eta-27*eta*eta+12*pow(eta, 3)-2*pow(eta, 4))/pow((1-eta)*(2-eta), 2.0));    
     
     summ = 0.0;
@@ -1233,74 +1430,39 @@ double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vec
     double ares_hc = m_avg*ares_hs - summ;
     double ares_disp = -2*PI*den*I1*m2es3 - PI*den*m_avg*C1*I2*m2e2s3;
 
+    PCSAFT_TIMER_LAP(t_hc_disp);
+
     // Dipole term (Gross and Vrabec term) --------------------------------------
     double ares_polar = 0.;
     if (!cppargs.dipm.empty()) {
+        const polar_subset &ps = mixing.polar;
+        int npairs = ps.pairs.size();
+        int ntriples = ps.triples.size();
         double A2 = 0.;
         double A3 = 0.;
-        vector<double> dipmSQ (ncomp, 0);
-
-        static double a0dip[5] = { 0.3043504, -0.1358588, 1.4493329, 0.3556977, -2.0653308 };
-        static double a1dip[5] = { 0.9534641, -1.8396383, 2.0131180, -7.3724958, 8.2374135 };
-        static double a2dip[5] = { -1.1610080, 4.5258607, 0.9751222, -12.281038, 5.9397575 };
-        static double b0dip[5] = { 0.2187939, -1.1896431, 1.1626889, 0, 0 };
-        static double b1dip[5] = { -0.5873164, 1.2489132, -0.5085280, 0, 0 };
-        static double b2dip[5] = { 3.4869576, -14.915974, 15.372022, 0, 0 };
-        static double c0dip[5] = { -0.0646774, 0.1975882, -0.8087562, 0.6902849, 0 };
-        static double c1dip[5] = { -0.9520876, 2.9924258, -2.3802636, -0.2701261, 0 };
-        static double c2dip[5] = { -0.6260979, 1.2924686, 1.6542783, -3.4396744, 0 };
-
-        const static double conv = 7242.702976750923; // conversion factor, see the note below Table 2 in Gross and Vrabec 2006
-        
-        for (int i = 0; i < ncomp; i++) {     
-            dipmSQ[i] = pow(cppargs.dipm[i], 2.)/(m[i]*e[i]*pow(s[i],3.))*conv;
+        double J2a_p[1], J2b_p[1], J3_p[1];
+        for (int n = 0; n < npairs; n++) {
+            const polar_pair &pp = ps.pairs[n];
+            horner<0>(pp.adip, eta, J2a_p);
+            horner<0>(pp.bdip, eta, J2b_p);
+            A2 += x[pp.i]*x[pp.j]*pp.w/t/t*(pp.mult*J2a_p[0] + pp.e_b/t*J2b_p[0]);
+        }
+        for (int n = 0; n < ntriples; n++) {
+            const polar_triple &pt = ps.triples[n];
+            horner<0>(pt.cdip, eta, J3_p);
+            A3 += pt.mult*x[pt.i]*x[pt.j]*x[pt.k]*pt.w/t/t/t*J3_p[0];
         }
 
-        vector<double> adip (5, 0);
-        vector<double> bdip (5, 0);
-        vector<double> cdip (5, 0);
-        double J2, J3;
-        double m_ij;
-        double m_ijk;
-        for (int i = 0; i < ncomp; i++) {
-            for (int j = 0; j < ncomp; j++) {
-                m_ij = sqrt(m[i]*m[j]);
-                if (m_ij > 2) {
-                    m_ij = 2;
-                }
-                J2 = 0.;
-                for (int l = 0; l < 5; l++) {
-                    adip[l] = a0dip[l] + (m_ij-1)/m_ij*a1dip[l] + (m_ij-1)/m_ij*(m_ij-2)/m_ij*a2dip[l];
-                    bdip[l] = b0dip[l] + (m_ij-1)/m_ij*b1dip[l] + (m_ij-1)/m_ij*(m_ij-2)/m_ij*b2dip[l];
-                    J2 += (adip[l] + bdip[l]*e_ij[j*ncomp+j]/t)*pow(eta, l); // j*ncomp+j needs to be used for e_ij because it is formatted as a 1D vector                   
-                }
-                A2 += x[i]*x[j]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)/
-                    pow(s_ij[i*ncomp+j],3)*cppargs.dip_num[i]*cppargs.dip_num[j]*dipmSQ[i]*dipmSQ[j]*J2;
+        if (npairs > 0) {
+            A2 = -PI*den*A2;
+            A3 = -4/3.*PI*PI*den*den*A3;
 
-                for (int k = 0; k < ncomp; k++) {
-                    m_ijk = pow((m[i]*m[j]*m[k]),1/3.);
-                    if (m_ijk > 2) {
-                        m_ijk = 2;
-                    }
-                    J3 = 0.;
-                    for (int l = 0; l < 5; l++) {
-                        cdip[l] = c0dip[l] + (m_ijk-1)/m_ijk*c1dip[l] + (m_ijk-1)/m_ijk*(m_ijk-2)/m_ijk*c2dip[l];
-                        J3 += cdip[l]*pow(eta, l);
-                    }
-                    A3 += x[i]*x[j]*x[k]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*e_ij[k*ncomp+k]/t*
-                        pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)*pow(s_ij[k*ncomp+k],3)/s_ij[i*ncomp+j]/s_ij[i*ncomp+k]/
-                        s_ij[j*ncomp+k]*cppargs.dip_num[i]*cppargs.dip_num[j]*cppargs.dip_num[k]*dipmSQ[i]*
-                        dipmSQ[j]*dipmSQ[k]*J3;
-                }
-            }
+            ares_polar = A2/(1-A3/A2);
         }
-
-        A2 = -PI*den*A2;
-        A3 = -4/3.*PI*PI*den*den*A3;
-        
-        ares_polar = A2/(1-A3/A2);
     }
-    
+
+    PCSAFT_TIMER_LAP(t_polar);
+
     // Association term -------------------------------------------------------
     // only the 2B association type is currently implemented
     double ares_assoc = 0.;
@@ -1327,10 +1489,10 @@ double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         int idxi = 0; // index for the ii-th compound
         int idxj = 0; // index for the jj-th compound
         for (int i = 0; i < ncA; i++) {
-            idxi = iA[i]*ncomp+iA[i];
+            idxi = sym_idx(iA[i], iA[i], ncomp);
             for (int j = 0; j < ncA; j++) {
                 idxa += 1;
-                idxj = iA[j]*ncomp+iA[j];
+                idxj = sym_idx(iA[j], iA[j], ncomp);
                 eABij[idxa] = (cppargs.e_assoc[iA[i]]+cppargs.e_assoc[iA[j]])/2.;
                 if (cppargs.k_hb.empty()) {
                     volABij[idxa] = sqrt(cppargs.vol_a[iA[i]]*cppargs.vol_a[iA[j]])*pow(sqrt(s_ij[idxi]*
@@ -1338,9 +1500,9 @@ double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vec
                 }
                 else {
                     volABij[idxa] = sqrt(cppargs.vol_a[iA[i]]*cppargs.vol_a[iA[j]])*pow(sqrt(s_ij[idxi]*
-                        s_ij[idxj])/(0.5*(s_ij[idxi]+s_ij[idxj])), 3)*(1-cppargs.k_hb[iA[i]*ncomp+iA[j]]);
+                        s_ij[idxj])/(0.5*(s_ij[idxi]+s_ij[idxj])), 3)*(1-pair_param(cppargs.k_hb, iA[i], iA[j], ncomp));
                 }
-                delta_ij[idxa] = ghs[iA[j]]*(exp(eABij[idxa]/t)-1)*pow(s_ij[iA[i]*ncomp+iA[j]], 3)*volABij[idxa];
+                delta_ij[idxa] = ghs[iA[j]]*(exp(eABij[idxa]/t)-1)*pow(s_ij[sym_idx(iA[i], iA[j], ncomp)], 3)*volABij[idxa];
             }           
             XA[i*2] = (-1 + sqrt(1+8*den*delta_ij[i*ncA+i]))/(4*den*delta_ij[i*ncA+i]);
             if (!isfinite(XA[i*2])) {
@@ -1366,6 +1528,7 @@ double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vec
             }
             XA_old = XA;
         }
+        PCSAFT_COUNT_XA(ctr, dif > 1e-9);
         
         ares_assoc = 0.;
         for (int i = 0; i < ncA; i++) {
@@ -1378,6 +1541,8 @@ double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         }
     }
 
+    PCSAFT_TIMER_LAP(t_assoc);
+
     // Ion term ---------------------------------------------------------------
     double ares_ion = 0.;    
     if (!cppargs.z.empty()) {
@@ -1386,11 +1551,15 @@ double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vec
             q[i] = q[i]*E_CHRG;
         }
 
+        double ddielc_dt;
+        vector<double> ddielc_dx;
+        double dielc = dielc_cpp(x, t, cppargs, ddielc_dt, ddielc_dx);
+
         summ = 0.;
         for (int i = 0; i < ncomp; i++) {
             summ += cppargs.z[i]*cppargs.z[i]*x[i];
         }
-        double kappa = sqrt(den*E_CHRG*E_CHRG/kb/t/(cppargs.dielc*perm_vac)*summ); // the inverse Debye screening length. Equation 4 in Held et al. 2008.
+        double kappa = sqrt(den*E_CHRG*E_CHRG/kb/t/(dielc*perm_vac)*summ); // the inverse Debye screening length. Equation 4 in Held et al. 2008.
 
         if (kappa != 0) {
             vector<double> chi(ncomp); 
@@ -1402,17 +1571,19 @@ double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vec
                 summ += x[i]*q[i]*q[i]*chi[i]*kappa;
             }
 
-            ares_ion = -1/12./PI/kb/t/(cppargs.dielc*perm_vac)*summ;
+            ares_ion = -1/12./PI/kb/t/(dielc*perm_vac)*summ;
         }      
     }
    
+    PCSAFT_TIMER_LAP(t_ion);
     double ares = ares_hc + ares_disp + ares_polar + ares_assoc + ares_ion;
+    PCSAFT_TRACE_RECORD(TRACE_ARES, -1, rho, 0., &ares, 1);
     return ares;
 }
 
 
-double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs) {
+double pcsaft_dadt_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double rho, add_args &cppargs) {
     /**
     Calculate the temperature derivative of the residual Helmholtz energy at 
     constant density.
@@ -1438,9 +1609,9 @@ double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         A struct containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : vector<double>, shape (n*n,)
+        k_ij : vector<double>, shape (n*n,) or (n*(n+1)/2,)
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, or the packed upper triangle)
         e_assoc : vector<double>, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -1459,12 +1630,22 @@ double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         dielc : double
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+        dielc_model : vector<int>, shape (n,)
+            Model for the dielectric constant of each component (0 = not a 
+            solvent, 1 = water, 2 = dielc_coef). If given, the dielectric 
+            constant is calculated from the solvents instead of using dielc.
+        dielc_coef : vector<double>, shape (n*3,)
+            Coefficients a, b, c of the dielectric constant a + b*T + c*T^2 
+            of the components that use model 2.
         
     Returns
     -------
     dadt : double
         Temperature derivative of residual Helmholtz energy at constant density (J mol^-1 K^-1)
     */
+    PCSAFT_COUNT(evals, 1);
+    PCSAFT_TIMER_START();
+    PCSAFT_TRACE_SCOPE();
     int ncomp = x.size(); // number of components
     vector<double> d (ncomp), dd_dt(ncomp);
     for (int i = 0; i < ncomp; i++) {
@@ -1509,40 +1690,22 @@ double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vec
 
     vector<double> ghs (ncomp, 0);
     vector<double> dghs_dt (ncomp, 0);
-    vector<double> e_ij (ncomp*ncomp, 0);
-    vector<double> s_ij (ncomp*ncomp, 0);
+    mixing_cache local;
+    const mixing_cache &mixing = mixing_cache_get(m, s, e, cppargs, local);
+    const vector<double> &e_ij = mixing.e_ij;
+    const vector<double> &s_ij = mixing.s_ij;
     double m2es3 = 0.;
     double m2e2s3 = 0.;
+    double s3, w;
     double ddij_dt;
     int idx = -1;
     for (int i = 0; i < ncomp; i++) {
-        for (int j = 0; j < ncomp; j++) {
+        for (int j = i; j < ncomp; j++) {
             idx += 1;
-            if (cppargs.l_ij.empty()) {
-                s_ij[idx] = (s[i] + s[j])/2.;
-            }
-            else {
-                s_ij[idx] = (s[i] + s[j])/2.*(1-cppargs.l_ij[idx]);
-            }
-            if (!cppargs.z.empty()) {
-                if (cppargs.z[i]*cppargs.z[j] <= 0) { // for two cations or two anions e_ij is kept at zero to avoid dispersion between like ions (see Held et al. 2014)
-                    if (cppargs.k_ij.empty()) {
-                        e_ij[idx] = sqrt(e[i]*e[j]);
-                    }                    
-                    else {
-                        e_ij[idx] = sqrt(e[i]*e[j])*(1-cppargs.k_ij[idx]);
-                    }
-                }
-            } else {
-                if (cppargs.k_ij.empty()) {
-                    e_ij[idx] = sqrt(e[i]*e[j]);
-                }                    
-                else {
-                    e_ij[idx] = sqrt(e[i]*e[j])*(1-cppargs.k_ij[idx]);
-                }
-            }
-            m2es3 = m2es3 + x[i]*x[j]*m[i]*m[j]*e_ij[idx]/t*pow(s_ij[idx], 3);
-            m2e2s3 = m2e2s3 + x[i]*x[j]*m[i]*m[j]*pow(e_ij[idx]/t,2)*pow(s_ij[idx], 3);
+            w = (i == j) ? 1. : 2.; // the tables hold each unordered pair once
+            s3 = s_ij[idx]*s_ij[idx]*s_ij[idx];
+            m2es3 = m2es3 + w*x[i]*x[j]*m[i]*m[j]*e_ij[idx]/t*s3;
+            m2e2s3 = m2e2s3 + w*x[i]*x[j]*m[i]*m[j]*e_ij[idx]/t*e_ij[idx]/t*s3;
         }
         ghs[i] = 1/(1-zeta[3]) + (d[i]*d[i]/(d[i]+d[i]))*3*zeta[2]/(1-zeta[3])/(1-zeta[3]) + 
             pow(d[i]*d[i]/(d[i]+d[i]), 2)*2*zeta[2]*zeta[2]/pow(1-zeta[3], 3);
@@ -1562,29 +1725,17 @@ double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         * log(1-zeta[3])
         + (zeta[0]-pow(zeta[2],3)/pow(zeta[3],2.))*dzeta_dt[3]/(1-zeta[3]));
 
-    static double a0[7] = { 0.910563145, 0.636128145, 2.686134789, -26.54736249, 97.75920878, -159.5915409, 91.29777408 };
-    static double a1[7] = { -0.308401692, 0.186053116, -2.503004726, 21.41979363, -65.25588533, 83.31868048, -33.74692293 };
-    static double a2[7] = { -0.090614835, 0.452784281, 0.596270073, -1.724182913, -4.130211253, 13.77663187, -8.672847037 };
-    static double b0[7] = { 0.724094694, 2.238279186, -4.002584949, -21.00357682, 26.85564136, 206.5513384, -355.6023561 };
-    static double b1[7] = { -0.575549808, 0.699509552, 3.892567339, -17.21547165, 192.6722645, -161.8264617, -165.2076935 };
-    static double b2[7] = { 0.097688312, -0.255757498, -9.155856153, 20.64207597, -38.80443005, 93.62677408, -29.66690559 };
-
-    vector<double> a (7, 0);
-    vector<double> b (7, 0);
-    for (int i = 0; i < 7; i++) {
-        a[i] = a0[i] + (m_avg-1.)/m_avg*a1[i] + (m_avg-1.)/m_avg*(m_avg-2.)/m_avg*a2[i];
-        b[i] = b0[i] + (m_avg-1.)/m_avg*b1[i] + (m_avg-1.)/m_avg*(m_avg-2.)/m_avg*b2[i];
-    }
+    double a[7], b[7];
+    mix_coef(a0, a1, a2, m_avg, a);
+    mix_coef(b0, b1, b2, m_avg, b);
     
-    double I1 = 0.0;
-    double I2 = 0.0;
-    double dI1_dt = 0.0, dI2_dt = 0.;
-    for (int i = 0; i < 7; i++) {
-        I1 += a[i]*pow(eta, i);
-        I2 += b[i]*pow(eta, i);
-        dI1_dt += a[i]*dzeta_dt[3]*i*pow(eta, i-1);
-        dI2_dt += b[i]*dzeta_dt[3]*i*pow(eta, i-1);
-    }
+    double I1_p[2], I2_p[2]; // I1 and I2 and their first derivatives with respect to eta
+    horner<1>(a, eta, I1_p);
+    horner<1>(b, eta, I2_p);
+    double I1 = I1_p[0];
+    double I2 = I2_p[0];
+    double dI1_dt = I1_p[1]*dzeta_dt[3];
+    double dI2_dt = I2_p[1]*dzeta_dt[3];
     double C1 = 1./(1. + m_avg*(8*eta-2*eta*eta)/pow(1-eta, 4) + (1-m_avg)*(20*eta-27*eta*eta+12*pow(eta, 3)-2*pow(eta, 4))/pow((1-eta)*(2-eta), 2.0));
     double C2 = -1*C1*C1*(m_avg*(-4*eta*eta+20*eta+8)/pow(1-eta,5.) + (1-m_avg)*(2*pow(eta,3)+12*eta*eta-48*eta+40)/pow((1-eta)*(2-eta),3));
     double dC1_dt = C2*dzeta_dt[3];
@@ -1597,92 +1748,50 @@ double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vec
     double dadt_hc = m_avg*dadt_hs - summ;
     double dadt_disp = -2*PI*den*(dI1_dt-I1/t)*m2es3 - PI*den*m_avg*(dC1_dt*I2+C1*dI2_dt-2*C1*I2/t)*m2e2s3;
 
+    PCSAFT_TIMER_LAP(t_hc_disp);
+
     // Dipole term (Gross and Vrabec term) --------------------------------------
     double dadt_polar = 0.;
     if (!cppargs.dipm.empty()) {
+        const polar_subset &ps = mixing.polar;
+        int npairs = ps.pairs.size();
+        int ntriples = ps.triples.size();
         double A2 = 0.;
         double A3 = 0.;
         double dA2_dt = 0.;
         double dA3_dt = 0.;
-        vector<double> dipmSQ (ncomp, 0);
-
-        static double a0dip[5] = { 0.3043504, -0.1358588, 1.4493329, 0.3556977, -2.0653308 };
-        static double a1dip[5] = { 0.9534641, -1.8396383, 2.0131180, -7.3724958, 8.2374135 };
-        static double a2dip[5] = { -1.1610080, 4.5258607, 0.9751222, -12.281038, 5.9397575 };
-        static double b0dip[5] = { 0.2187939, -1.1896431, 1.1626889, 0, 0 };
-        static double b1dip[5] = { -0.5873164, 1.2489132, -0.5085280, 0, 0 };
-        static double b2dip[5] = { 3.4869576, -14.915974, 15.372022, 0, 0 };
-        static double c0dip[5] = { -0.0646774, 0.1975882, -0.8087562, 0.6902849, 0 };
-        static double c1dip[5] = { -0.9520876, 2.9924258, -2.3802636, -0.2701261, 0 };
-        static double c2dip[5] = { -0.6260979, 1.2924686, 1.6542783, -3.4396744, 0 };
-        
-        const static double conv = 7242.702976750923; // conversion factor, see the note below Table 2 in Gross and Vrabec 2006
-        
-        for (int i = 0; i < ncomp; i++) {     
-            dipmSQ[i] = pow(cppargs.dipm[i], 2.)/(m[i]*e[i]*pow(s[i],3.))*conv;
+        double J2a_p[2], J2b_p[2], J3_p[2];
+        double J2, dJ2_dt, xw;
+        for (int n = 0; n < npairs; n++) {
+            const polar_pair &pp = ps.pairs[n];
+            horner<1>(pp.adip, eta, J2a_p);
+            horner<1>(pp.bdip, eta, J2b_p);
+            xw = x[pp.i]*x[pp.j]*pp.w;
+            J2 = pp.mult*J2a_p[0] + pp.e_b/t*J2b_p[0];
+            dJ2_dt = (pp.mult*J2a_p[1] + pp.e_b/t*J2b_p[1])*dzeta_dt[3] - pp.e_b/pow(t,2.)*J2b_p[0];
+            A2 += xw/t/t*J2;
+            dA2_dt += xw*(dJ2_dt/pow(t,2)-2*J2/pow(t,3));
+        }
+        for (int n = 0; n < ntriples; n++) {
+            const polar_triple &pt = ps.triples[n];
+            horner<1>(pt.cdip, eta, J3_p);
+            xw = pt.mult*x[pt.i]*x[pt.j]*x[pt.k]*pt.w;
+            A3 += xw/t/t/t*J3_p[0];
+            dA3_dt += xw*(-3*J3_p[0]/pow(t,4) + J3_p[1]*dzeta_dt[3]/pow(t,3));
         }
 
+        if (npairs > 0) {
+            A2 = -PI*den*A2;
+            A3 = -4/3.*PI*PI*den*den*A3;
+            dA2_dt = -PI*den*dA2_dt;
+            dA3_dt = -4/3.*PI*PI*den*den*dA3_dt;
 
-        vector<double> adip (5, 0);
-        vector<double> bdip (5, 0);
-        vector<double> cdip (5, 0);
-        double J2, J3, dJ2_dt, dJ3_dt;
-        double m_ij;
-        double m_ijk;
-        for (int i = 0; i < ncomp; i++) {
-            for (int j = 0; j < ncomp; j++) {
-                m_ij = sqrt(m[i]*m[j]);
-                if (m_ij > 2) {
-                    m_ij = 2;
-                }
-                J2 = 0.;
-                dJ2_dt = 0.;
-                for (int l = 0; l < 5; l++) {
-                    adip[l] = a0dip[l] + (m_ij-1)/m_ij*a1dip[l] + (m_ij-1)/m_ij*(m_ij-2)/m_ij*a2dip[l];
-                    bdip[l] = b0dip[l] + (m_ij-1)/m_ij*b1dip[l] + (m_ij-1)/m_ij*(m_ij-2)/m_ij*b2dip[l];
-                    J2 += (adip[l] + bdip[l]*e_ij[j*ncomp+j]/t)*pow(eta, l); // j*ncomp+j needs to be used for e_ij because it is formatted as a 1D vector                   
-                    dJ2_dt += adip[l]*l*pow(eta, l-1)*dzeta_dt[3]
-                        + bdip[l]*e_ij[j*ncomp+j]*(1/t*l*pow(eta, l-1)*dzeta_dt[3]
-                        - 1/pow(t,2.)*pow(eta,l));            
-                }
-                A2 += x[i]*x[j]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)/
-                    pow(s_ij[i*ncomp+j],3)*cppargs.dip_num[i]*cppargs.dip_num[j]*dipmSQ[i]*dipmSQ[j]*J2;
-                dA2_dt += x[i]*x[j]*e_ij[i*ncomp+i]*e_ij[j*ncomp+j]*pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)
-                    /pow(s_ij[i*ncomp+j],3)*cppargs.dip_num[i]*cppargs.dip_num[j]*dipmSQ[i]*dipmSQ[j]*
-                    (dJ2_dt/pow(t,2)-2*J2/pow(t,3));
-
-                for (int k = 0; k < ncomp; k++) {
-                    m_ijk = pow((m[i]*m[j]*m[k]),1/3.);
-                    if (m_ijk > 2) {
-                        m_ijk = 2;
-                    }
-                    J3 = 0.;
-                    dJ3_dt = 0.;
-                    for (int l = 0; l < 5; l++) {
-                        cdip[l] = c0dip[l] + (m_ijk-1)/m_ijk*c1dip[l] + (m_ijk-1)/m_ijk*(m_ijk-2)/m_ijk*c2dip[l];
-                        J3 += cdip[l]*pow(eta, l);
-                        dJ3_dt += cdip[l]*l*pow(eta, l-1)*dzeta_dt[3];
-                    }
-                    A3 += x[i]*x[j]*x[k]*e_ij[i*ncomp+i]/t*e_ij[j*ncomp+j]/t*e_ij[k*ncomp+k]/t*
-                        pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)*pow(s_ij[k*ncomp+k],3)/s_ij[i*ncomp+j]/s_ij[i*ncomp+k]/
-                        s_ij[j*ncomp+k]*cppargs.dip_num[i]*cppargs.dip_num[j]*cppargs.dip_num[k]*dipmSQ[i]*
-                        dipmSQ[j]*dipmSQ[k]*J3;
-                    dA3_dt += x[i]*x[j]*x[k]*e_ij[i*ncomp+i]*e_ij[j*ncomp+j]*e_ij[k*ncomp+k]*
-                        pow(s_ij[i*ncomp+i],3)*pow(s_ij[j*ncomp+j],3)*pow(s_ij[k*ncomp+k],3)/s_ij[i*ncomp+j]/s_ij[i*ncomp+k]
-                        /s_ij[j*ncomp+k]*cppargs.dip_num[i]*cppargs.dip_num[j]*cppargs.dip_num[k]*dipmSQ[i]
-                        *dipmSQ[j]*dipmSQ[k]*(-3*J3/pow(t,4) + dJ3_dt/pow(t,3));
-                }
-            }
+            dadt_polar = (dA2_dt-2*A3/A2*dA2_dt+dA3_dt)/pow(1-A3/A2, 2.);
         }
-        
-        A2 = -PI*den*A2;
-        A3 = -4/3.*PI*PI*den*den*A3;
-        dA2_dt = -PI*den*dA2_dt;
-        dA3_dt = -4/3.*PI*PI*den*den*dA3_dt;
-
-        dadt_polar = (dA2_dt-2*A3/A2*dA2_dt+dA3_dt)/pow(1-A3/A2, 2.);
     }
-    
+
+    PCSAFT_TIMER_LAP(t_polar);
+
     // Association term -------------------------------------------------------
     // only the 2B association type is currently implemented
     double dadt_assoc = 0.;
@@ -1710,10 +1819,10 @@ double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         int idxi = 0; // index for the ii-th compound
         int idxj = 0; // index for the jj-th compound
         for (int i = 0; i < ncA; i++) {
-            idxi = iA[i]*ncomp+iA[i];
+            idxi = sym_idx(iA[i], iA[i], ncomp);
             for (int j = 0; j < ncA; j++) {
                 idxa += 1;
-                idxj = iA[j]*ncomp+iA[j];
+                idxj = sym_idx(iA[j], iA[j], ncomp);
                 eABij[idxa] = (cppargs.e_assoc[iA[i]]+cppargs.e_assoc[iA[j]])/2.;
                 if (cppargs.k_hb.empty()) {
                     volABij[idxa] = sqrt(cppargs.vol_a[iA[i]]*cppargs.vol_a[iA[j]])*pow(sqrt(s_ij[idxi]*
@@ -1721,9 +1830,9 @@ double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vec
                 }
                 else {
                     volABij[idxa] = sqrt(cppargs.vol_a[iA[i]]*cppargs.vol_a[iA[j]])*pow(sqrt(s_ij[idxi]*
-                        s_ij[idxj])/(0.5*(s_ij[idxi]+s_ij[idxj])), 3)*(1-cppargs.k_hb[iA[i]*ncomp+iA[j]]);
+                        s_ij[idxj])/(0.5*(s_ij[idxi]+s_ij[idxj])), 3)*(1-pair_param(cppargs.k_hb, iA[i], iA[j], ncomp));
                 }
-                delta_ij[idxa] = ghs[iA[j]]*(exp(eABij[idxa]/t)-1)*pow(s_ij[iA[i]*ncomp+iA[j]], 3)*volABij[idxa];
+                delta_ij[idxa] = ghs[iA[j]]*(exp(eABij[idxa]/t)-1)*pow(s_ij[sym_idx(iA[i], iA[j], ncomp)], 3)*volABij[idxa];
                 ddelta_dt[idxa] = pow(s_ij[idxj],3)*volABij[idxa]*(-eABij[idxa]/pow(t,2)
                     *exp(eABij[idxa]/t)*ghs[iA[j]] + dghs_dt[iA[j]]
                     *(exp(eABij[idxa]/t)-1));
@@ -1752,6 +1861,7 @@ double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vec
             }
             XA_old = XA;
         }
+        PCSAFT_COUNT_XA(ctr, dif > 1e-9);
         
         vector<double> dXA_dt (ncA*a_sites, 0);
         dXA_dt = dXAdt_find(ncA, delta_ij, den, XA, ddelta_dt, x_assoc, a_sites);
@@ -1765,6 +1875,8 @@ double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         }
     }
 
+    PCSAFT_TIMER_LAP(t_assoc);
+
     // Ion term ---------------------------------------------------------------
     double dadt_ion = 0.;    
     if (!cppargs.z.empty()) {
@@ -1773,11 +1885,15 @@ double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vec
             q[i] = q[i]*E_CHRG;
         }
 
+        double ddielc_dt;
+        vector<double> ddielc_dx;
+        double dielc = dielc_cpp(x, t, cppargs, ddielc_dt, ddielc_dx);
+
         summ = 0.;
         for (int i = 0; i < ncomp; i++) {
             summ += cppargs.z[i]*cppargs.z[i]*x[i];
         }
-        double kappa = sqrt(den*E_CHRG*E_CHRG/kb/t/(cppargs.dielc*perm_vac)*summ); // the inverse Debye screening length. Equation 4 in Held et al. 2008.        
+        double kappa = sqrt(den*E_CHRG*E_CHRG/kb/t/(dielc*perm_vac)*summ); // the inverse Debye screening length. Equation 4 in Held et al. 2008.
         
         double dkappa_dt;
         if (kappa != 0) {
@@ -1790,23 +1906,26 @@ double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vec
                 dchikap_dk[i] = -2*chi[i]+3/(1+kappa*s[i]);
                 summ += x[i]*cppargs.z[i]*cppargs.z[i];
             }            
-            dkappa_dt = -0.5*den*E_CHRG*E_CHRG/kb/t/t/(cppargs.dielc*perm_vac)*summ/kappa;       
+            double dlnte_dt = 1/t + ddielc_dt/dielc; // kappa and the prefactor depend on t through t*dielc
+            dkappa_dt = -0.5*kappa*dlnte_dt;
             
             summ = 0.;
             for (int i = 0; i < ncomp; i++) {
-                summ += x[i]*q[i]*q[i]*(dchikap_dk[i]*dkappa_dt/t-kappa*chi[i]/t/t);
+                summ += x[i]*q[i]*q[i]*(dchikap_dk[i]*dkappa_dt/t-kappa*chi[i]*dlnte_dt/t);
             }
-            dadt_ion = -1/12./PI/kb/(cppargs.dielc*perm_vac)*summ;
+            dadt_ion = -1/12./PI/kb/(dielc*perm_vac)*summ;
         }
     }
 
+    PCSAFT_TIMER_LAP(t_ion);
     double dadt = dadt_hc + dadt_disp + dadt_assoc + dadt_polar + dadt_ion;
+    PCSAFT_TRACE_RECORD(TRACE_DADT, -1, rho, 0., &dadt, 1);
     return dadt;
 }
 
 
-double pcsaft_hres_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs) {
+double pcsaft_hres_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double rho, add_args &cppargs) {
     /**
     Calculate the residual enthalpy for one phase of the system.
     
@@ -1831,9 +1950,9 @@ double pcsaft_hres_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         A struct containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : vector<double>, shape (n*n,)
+        k_ij : vector<double>, shape (n*n,) or (n*(n+1)/2,)
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, or the packed upper triangle)
         e_assoc : vector<double>, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -1852,22 +1971,31 @@ double pcsaft_hres_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         dielc : double
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+        dielc_model : vector<int>, shape (n,)
+            Model for the dielectric constant of each component (0 = not a 
+            solvent, 1 = water, 2 = dielc_coef). If given, the dielectric 
+            constant is calculated from the solvents instead of using dielc.
+        dielc_coef : vector<double>, shape (n*3,)
+            Coefficients a, b, c of the dielectric constant a + b*T + c*T^2 
+            of the components that use model 2.
         
     Returns
     -------
     hres : double
         Residual enthalpy (J mol^-1)
     */
+    PCSAFT_TRACE_SCOPE();
     double Z = pcsaft_Z_cpp(x, m, s, e, t, rho, cppargs);
     double dares_dt = pcsaft_dadt_cpp(x, m, s, e, t, rho, cppargs);
 
     double hres = (-t*dares_dt + (Z-1))*kb*N_AV*t; // Equation A.46 from Gross and Sadowski 2001
+    PCSAFT_TRACE_RECORD(TRACE_HRES, -1, rho, 0., &hres, 1);
     return hres;
 }
 
 
-double pcsaft_sres_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs) {
+double pcsaft_sres_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double rho, add_args &cppargs) {
     /**
     Calculate the residual entropy (constant volume) for one phase of the system.
     
@@ -1892,9 +2020,9 @@ double pcsaft_sres_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         A struct containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : vector<double>, shape (n*n,)
+        k_ij : vector<double>, shape (n*n,) or (n*(n+1)/2,)
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, or the packed upper triangle)
         e_assoc : vector<double>, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -1913,21 +2041,30 @@ double pcsaft_sres_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         dielc : double
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+        dielc_model : vector<int>, shape (n,)
+            Model for the dielectric constant of each component (0 = not a 
+            solvent, 1 = water, 2 = dielc_coef). If given, the dielectric 
+            constant is calculated from the solvents instead of using dielc.
+        dielc_coef : vector<double>, shape (n*3,)
+            Coefficients a, b, c of the dielectric constant a + b*T + c*T^2 
+            of the components that use model 2.
         
     Returns
     -------
     sres : double
         Residual entropy (J mol^-1 K^-1)
     */    
+    PCSAFT_TRACE_SCOPE();
     double gres = pcsaft_gres_cpp(x, m, s, e, t, rho, cppargs);
     double hres = pcsaft_hres_cpp(x, m, s, e, t, rho, cppargs);
 
     double sres = (hres - gres)/t;
+    PCSAFT_TRACE_RECORD(TRACE_SRES, -1, rho, 0., &sres, 1);
     return sres;
 }
 
-double pcsaft_gres_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs) {
+double pcsaft_gres_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double rho, add_args &cppargs) {
     /**
     Calculate the residual Gibbs energy for one phase of the system.
     
@@ -1952,9 +2089,9 @@ double pcsaft_gres_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         A struct containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : vector<double>, shape (n*n,)
+        k_ij : vector<double>, shape (n*n,) or (n*(n+1)/2,)
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, or the packed upper triangle)
         e_assoc : vector<double>, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -1973,22 +2110,32 @@ double pcsaft_gres_cpp(vector<double> x, vector<double> m, vector<double> s, vec
         dielc : double
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+        dielc_model : vector<int>, shape (n,)
+            Model for the dielectric constant of each component (0 = not a 
+            solvent, 1 = water, 2 = dielc_coef). If given, the dielectric 
+            constant is calculated from the solvents instead of using dielc.
+        dielc_coef : vector<double>, shape (n*3,)
+            Coefficients a, b, c of the dielectric constant a + b*T + c*T^2 
+            of the components that use model 2.
         
     Returns
     -------
     gres : double
         Residual Gibbs energy (J mol^-1)
     */   
+    PCSAFT_TRACE_SCOPE();
     double ares = pcsaft_ares_cpp(x, m, s, e, t, rho, cppargs);
     double Z = pcsaft_Z_cpp(x, m, s, e, t, rho, cppargs);
 
     double gres = (ares + (Z - 1) - log(Z))*kb*N_AV*t; // Equation A.50 from Gross and Sadowski 2001
+    PCSAFT_TRACE_RECORD(TRACE_GRES, -1, rho, 0., &gres, 1);
     return gres;
 }
 
 
-double pcsaft_den_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double p, int phase, add_args &cppargs) {
+double pcsaft_den_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double p, int phase, add_args &cppargs, double rho_guess,
+    double rho_lo, double rho_hi, const solver_tol *tol) {
     /**
     Solve for the molar density when temperature and pressure are given.
 
@@ -2004,7 +2151,7 @@ double pcsaft_den_cpp(vector<double> x, vector<double> m, vector<double> s, vect
         the hydrated ion. Units of Angstrom.
     e : vector<double>, shape (n,)
         Dispersion energy of each component. For ions this is the dispersion
-        energy of the hydrated ion. Units    struct den_params params = {x, m, s, e, t, p, cppargs}; of K.
+        energy of the hydrated ion. Units of K.
     t : double
         Temperature (K)
     p : double
@@ -2016,9 +2163,9 @@ double pcsaft_den_cpp(vector<double> x, vector<double> m, vector<double> s, vect
         A struct containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : vector<double>, shape (n*n,)
+        k_ij : vector<double>, shape (n*n,) or (n*(n+1)/2,)
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, or the packed upper triangle)
         e_assoc : vector<double>, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -2037,21 +2184,44 @@ double pcsaft_den_cpp(vector<double> x, vector<double> m, vector<double> s, vect
         dielc : double
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+        dielc_model : vector<int>, shape (n,)
+            Model for the dielectric constant of each component (0 = not a 
+            solvent, 1 = water, 2 = dielc_coef). If given, the dielectric 
+            constant is calculated from the solvents instead of using dielc.
+        dielc_coef : vector<double>, shape (n*3,)
+            Coefficients a, b, c of the dielectric constant a + b*T + c*T^2 
+            of the components that use model 2.
+    rho_guess : double
+        Initial guess for the density (mol m^-3), e.g. the density of the same
+        phase in the previous iteration of an outer solver. The density is
+        then solved with Newton's method, and the default solver is only used
+        if Newton's method leaves the branch of the phase. Not used if it is 0.
+    rho_lo, rho_hi : double
+        Bounds of the density (mol m^-3). If they are 0 the bounds follow from
+        packing fractions that are typical of the phase.
+    tol : solver_tol*
+        Tolerances of the iterative solvers. The density is solved until the
+        relative deviation of the pressure is below tol->den, tol is also
+        used for the pressure (see pcsaft_Z_cpp), and the fractions of
+        unbonded association sites are passed from one iteration to the
+        next. If NULL the default tolerances are used.
 
     Returns
     -------
     rho : double
         Molar density (mol m^-3)
     */
+    PCSAFT_COUNT(den_solves, 1);
+    PCSAFT_TRACE_SCOPE();
     double x_lo, x_hi;
-    double rho_guess;
+    double rho_start;
     if (phase == 0) {
-        rho_guess = 0.5;
+        rho_start = 0.5;
         x_lo = 0.2;
         x_hi = 0.7405;
     }
     else {
-        rho_guess = 1.0e-9;
+        rho_start = 1.0e-9;
         x_lo = 1.0e-12;
         x_hi = 0.06;
     }
@@ -2064,21 +2234,63 @@ double pcsaft_den_cpp(vector<double> x, vector<double> m, vector<double> s, vect
         summ += x[i]*m[i]*pow(d[i],3.);
     }
 
-    rho_guess = 6/PI*rho_guess/summ*1.0e30/N_AV;
+    rho_start = 6/PI*rho_start/summ*1.0e30/N_AV;
     x_lo = 6/PI*x_lo/summ*1.0e30/N_AV;
     x_hi = 6/PI*x_hi/summ*1.0e30/N_AV;
+    if (rho_lo > 0) {
+        x_lo = rho_lo;
+    }
+    if (rho_hi > 0) {
+        x_hi = rho_hi;
+    }
+    if (rho_start < x_lo || rho_start > x_hi) {
+        rho_start = (x_lo + x_hi)/2;
+    }
 
-    // solving for density using bounded secant method
     double rho, rho1, rho2, dx=1.0e-8, y1, y2=999.0;
+    double y_tol = (tol != NULL) ? pow(tol->den*100, 2.) : 1.0e-8; // tolerance of the squared relative deviation (%)
+    if (rho_guess > 0) {
+        // Newton's method on the pressure, which fails if the density leaves
+        // the mechanically stable part of the branch or the bounds. The same
+        // convergence criterion is used as for the secant method below.
+        vector<double> XA, XA_h;
+        double h, P1, P2, step;
+        rho = rho_guess;
+        for (int iter = 0; iter < 20; iter++) {
+            PCSAFT_COUNT(den_iter, 1);
+            P1 = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs, &XA, tol);
+            if (pow((P1-p)/p*100, 2.) <= y_tol) {
+                PCSAFT_TRACE_RECORD(TRACE_DEN, phase, p, rho_guess, &rho, 1);
+                return rho;
+            }
+            h = rho*1e-7;
+            XA_h = XA;
+            P2 = pcsaft_p_cpp(x, m, s, e, t, rho + h, cppargs, &XA_h, tol);
+            step = (P1 - p)*h/(P2 - P1);
+            if (P2 <= P1 || !(fabs(step) < 0.2*rho) || rho - step < x_lo || rho - step > x_hi) {
+                break;
+            }
+            rho -= step;
+        }
+        PCSAFT_COUNT(den_newton_fallback, 1);
+    }
+
+    // solving for density using bounded secant method. With a tolerance budget
+    // the association fractions are carried from one pressure to the next.
+    // Otherwise each pressure starts from the same guess, so that the result
+    // does not depend on the path of the iterations.
+    vector<double> XA_prev;
+    vector<double> *XA_sec = (tol != NULL) ? &XA_prev : NULL;
     int iter=1, maxiter=200;
-    rho1 = rho_guess;
+    rho1 = rho_start;
     rho2 = rho1 + dx;
-    P_fit = pcsaft_p_cpp(x, m, s, e, t, rho1, cppargs);
+    P_fit = pcsaft_p_cpp(x, m, s, e, t, rho1, cppargs, XA_sec, tol);
     y1 = pow((P_fit-p)/p*100, 2.);
     rho = rho2;
 
-    while (iter < maxiter && y2 > 1.0e-8) {
-        P_fit = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs);
+    while (iter < maxiter && y2 > y_tol) {
+        PCSAFT_COUNT(den_iter, 1);
+        P_fit = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs, XA_sec, tol);
         y2 = pow((P_fit-p)/p*100, 2.);
         if (y2 == y1) {
             break;
@@ -2096,11 +2308,13 @@ double pcsaft_den_cpp(vector<double> x, vector<double> m, vector<double> s, vect
         iter += 1;
     }
 
-    if (phase == 1 && y2 > 1.0e-3 && (rho - x_hi) < 1e-5) {
+    if (phase == 1 && y2 > 1.0e-3 && (rho - x_hi) < 1e-5 && !(rho_hi > 0)) {
+        PCSAFT_COUNT(den_vapor_widen, 1);
         x_hi = 0.14;
         x_hi = 6/PI*x_hi/summ*1.0e30/N_AV;
-        while (iter < maxiter && y2 > 1.0e-8) {
-            P_fit = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs);
+        while (iter < maxiter && y2 > y_tol) {
+            PCSAFT_COUNT(den_iter, 1);
+            P_fit = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs, XA_sec, tol);
             y2 = pow((P_fit-p)/p*100, 2.);
             rho = rho2-y2/(y2-y1)*(rho2-rho1);
             if (y2 == y1) {
@@ -2119,16 +2333,18 @@ double pcsaft_den_cpp(vector<double> x, vector<double> m, vector<double> s, vect
         }
     }
     else if (phase == 0 && y2 > 1.0e-3 && (rho - x_lo) < 1e-3) {
+        PCSAFT_COUNT(den_liquid_restart, 1);
         iter = 1;        
-        rho_guess = 0.74;
-        rho_guess = 6/PI*rho_guess/summ*1.0e30/N_AV;
-        rho1 = rho_guess;
+        rho_start = 0.74;
+        rho_start = min(6/PI*rho_start/summ*1.0e30/N_AV, x_hi);
+        rho1 = rho_start;
         rho2 = rho1 + dx;
-        P_fit = pcsaft_p_cpp(x, m, s, e, t, rho1, cppargs);
+        P_fit = pcsaft_p_cpp(x, m, s, e, t, rho1, cppargs, XA_sec, tol);
         y1 = pow((P_fit-p)/p*100, 2.);
     
-        while (iter < maxiter && y2 > 1.0e-8) {
-            P_fit = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs);
+        while (iter < maxiter && y2 > y_tol) {
+            PCSAFT_COUNT(den_iter, 1);
+            P_fit = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs, XA_sec, tol);
             y2 = pow((P_fit-p)/p*100, 2.);
             if (y2 == y1) {
                 break;
@@ -2146,20 +2362,30 @@ double pcsaft_den_cpp(vector<double> x, vector<double> m, vector<double> s, vect
             iter += 1;
         }
     }
+    PCSAFT_COUNT(den_unconverged, (y2 > y_tol) ? 1 : 0);
+    PCSAFT_TRACE_RECORD(TRACE_DEN, phase, p, rho_guess, &rho, 1);
 
     return rho;
 }
 
 
-double bubblePfit_cpp(double p_guess, vector<double> xv_guess, vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, add_args &cppargs) {
-    /**Minimize this function to calculate the bubble point pressure.*/
+double bubblePfit_cpp(double p_guess, const vector<double> &xv_guess, const vector<double> &x,
+    const vector<double> &m, const vector<double> &s, const vector<double> &e,
+    double t, add_args &cppargs, const solver_tol *tol) {
+    /**
+    Minimize this function to calculate the bubble point pressure.
+
+    tol gives the tolerances of the inner solvers (see solver_tol). A
+    minimizer can pass looser tolerances while it is still far from the
+    solution (see solver_tol_budget). If NULL the default tolerances are used.
+    */
     int ncomp = x.size();
     double error = 0.;
+    double dif_tol = (tol != NULL) ? tol->comp : 1e-9;
 
     if (cppargs.z.empty()) { // Check that the mixture does not contain electrolytes. For electrolytes, a different equilibrium criterion should be used. 
-        double rho = pcsaft_den_cpp(x, m, s, e, t, p_guess, 0, cppargs);       
-        vector<double> fugcoef_l = pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs);
+        double rho = pcsaft_den_cpp(x, m, s, e, t, p_guess, 0, cppargs, 0., 0., 0., tol);       
+        vector<double> fugcoef_l = pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs, tol);
         
         // internal iteration loop for vapor phase composition
         int itr = 0;
@@ -2168,10 +2394,12 @@ double bubblePfit_cpp(double p_guess, vector<double> xv_guess, vector<double> x,
         vector<double> xv = xv_guess;
         vector<double> xv_old = xv_guess;
         vector<double> fugcoef_v(ncomp, 0);
-        while ((dif>1e-9) && (itr<100)) {
+        double rho_v = 0.;
+        while ((dif>dif_tol) && (itr<100)) {
             xv_old = xv;
-            rho = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs); 
-            fugcoef_v = pcsaft_fugcoef_cpp(xv, m, s, e, t, rho, cppargs);
+            rho_v = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs, rho_v, 0., 0., tol); // starting from the previous iteration
+            rho = rho_v;
+            fugcoef_v = pcsaft_fugcoef_cpp(xv, m, s, e, t, rho, cppargs, tol);
             summ = 0.;
             for (int i = 0; i < ncomp; i++) {
                 xv[i] = fugcoef_l[i]*x[i]/fugcoef_v[i];
@@ -2189,8 +2417,8 @@ double bubblePfit_cpp(double p_guess, vector<double> xv_guess, vector<double> x,
         }
     }
     else {
-        double rho = pcsaft_den_cpp(x, m, s, e, t, p_guess, 0, cppargs);
-        vector<double> fugcoef_l = pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs);
+        double rho = pcsaft_den_cpp(x, m, s, e, t, p_guess, 0, cppargs, 0., 0., 0., tol);
+        vector<double> fugcoef_l = pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs, tol);
         
         // internal iteration loop for vapor phase composition
         int itr = 0;
@@ -2198,10 +2426,12 @@ double bubblePfit_cpp(double p_guess, vector<double> xv_guess, vector<double> x,
         vector<double> xv = xv_guess;
         vector<double> xv_old = xv_guess;
         vector<double> fugcoef_v(ncomp, 0);
-        while ((dif>1e-9) && (itr<100)) {
+        double rho_v = 0.;
+        while ((dif>dif_tol) && (itr<100)) {
             xv_old = xv;
-            rho = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs);
-            fugcoef_v = pcsaft_fugcoef_cpp(xv, m, s, e, t, rho, cppargs);
+            rho_v = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs, rho_v, 0., 0., tol); // starting from the previous iteration
+            rho = rho_v;
+            fugcoef_v = pcsaft_fugcoef_cpp(xv, m, s, e, t, rho, cppargs, tol);
             summ = 0.;
             for (int i = 0; i < ncomp; i++) {
                 if (cppargs.z[i] == 0) {            
@@ -2232,12 +2462,17 @@ double bubblePfit_cpp(double p_guess, vector<double> xv_guess, vector<double> x,
 }
 
 
-double PTzfit_cpp(double p_guess, vector<double> x_guess, double beta_guess, double mol, 
-    double vol, vector<double> x_total, vector<double> m, vector<double> s, vector<double> e,
-    double t, add_args &cppargs) {
-    /**Minimize this function to solve for the pressure to compare with PTz data.*/
+double PTzfit_cpp(double p_guess, const vector<double> &x_guess, double beta_guess, double mol, 
+    double vol, vector<double> x_total, const vector<double> &m, const vector<double> &s, const vector<double> &e,
+    double t, add_args &cppargs, const solver_tol *tol) {
+    /**
+    Minimize this function to solve for the pressure to compare with PTz data.
+
+    tol gives the tolerances of the inner solvers (see bubblePfit_cpp).
+    */
     int ncomp = x_total.size();
     double error; 
+    double dif_tol = (tol != NULL) ? tol->comp : 1e-9;
    
     if (cppargs.z.empty()) { // Check that the mixture does not contain electrolytes. For electrolytes, a different equilibrium criterion should be used. 
         // internal iteration loop to solve for compositions
@@ -2250,13 +2485,13 @@ double PTzfit_cpp(double p_guess, vector<double> x_guess, double beta_guess, dou
             xv[i] = (mol*x_total[i] - (1-beta)*mol*xl[i])/beta/mol;
         }
 
-        double rhol, rhov, summ, beta_old;
-        while ((dif>1e-9) && (itr<100)) {
+        double rhol = 0., rhov = 0., summ, beta_old;
+        while ((dif>dif_tol) && (itr<100)) {
             beta_old = beta;
-            rhol = pcsaft_den_cpp(xl, m, s, e, t, p_guess, 0, cppargs);     
-            fugcoef_l = pcsaft_fugcoef_cpp(xl, m, s, e, t, rhol, cppargs);
-            rhov = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs);    
-            fugcoef_v = pcsaft_fugcoef_cpp(xv, m, s, e, t, rhov, cppargs);
+            rhol = pcsaft_den_cpp(xl, m, s, e, t, p_guess, 0, cppargs, rhol, 0., 0., tol); // starting from the previous iteration
+            fugcoef_l = pcsaft_fugcoef_cpp(xl, m, s, e, t, rhol, cppargs, tol);
+            rhov = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs, rhov, 0., 0., tol);
+            fugcoef_v = pcsaft_fugcoef_cpp(xv, m, s, e, t, rhov, cppargs, tol);
 
             if (beta > 0.5) {
                 summ = 0.;
@@ -2299,7 +2534,7 @@ double PTzfit_cpp(double p_guess, vector<double> x_guess, double beta_guess, dou
         vector<double> xl = x_guess;
         double beta = beta_guess;
         vector<double> fugcoef_l(ncomp), fugcoef_v(ncomp), xv(ncomp, 0);
-        double rhol, rhov, summ=0., beta_old;
+        double rhol = 0., rhov = 0., summ=0., beta_old;
         for (int i = 0; i < ncomp; i++) {
             if (cppargs.z[i] == 0) {
                 xv[i] = (mol*x_total[i] - (1-beta)*mol*xl[i])/beta/mol;
@@ -2318,18 +2553,16 @@ double PTzfit_cpp(double p_guess, vector<double> x_guess, double beta_guess, dou
                 x_ions += x_total[i];
             }
         }
-        while ((dif>1e-9) && (itr<100)) {
-            if (itr < 3) {
-                xl = chem_equil_cpp(xl, m, s, e, t, p_guess, cppargs);
-                for (int i = 0; i < ncomp; i++) {
-                    x_total[i] = xl[i] + xv[i];
-                }
+        while ((dif>dif_tol) && (itr<100)) {
+            xl = chem_equil_cpp(xl, m, s, e, t, p_guess, cppargs);
+            for (int i = 0; i < ncomp; i++) {
+                x_total[i] = (1-beta)*xl[i] + beta*xv[i];
             }
             beta_old = beta;
-            rhol = pcsaft_den_cpp(xl, m, s, e, t, p_guess, 0, cppargs);     
-            fugcoef_l = pcsaft_fugcoef_cpp(xl, m, s, e, t, rhol, cppargs);
-            rhov = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs);    
-            fugcoef_v = pcsaft_fugcoef_cpp(xv, m, s, e, t, rhov, cppargs);
+            rhol = pcsaft_den_cpp(xl, m, s, e, t, p_guess, 0, cppargs, rhol, 0., 0., tol); // starting from the previous iteration
+            fugcoef_l = pcsaft_fugcoef_cpp(xl, m, s, e, t, rhol, cppargs, tol);
+            rhov = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs, rhov, 0., 0., tol);
+            fugcoef_v = pcsaft_fugcoef_cpp(xv, m, s, e, t, rhov, cppargs, tol);
 
             if (beta > 0.5) {
                 summ = 0.;
@@ -2383,3 +2616,170 @@ double PTzfit_cpp(double p_guess, vector<double> x_guess, double beta_guess, dou
     }
     return error;
 }
+
+
+vector<double> chem_equil_cpp(const vector<double> &x_guess, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double p, add_args &cppargs) {
+    /**
+    Solve for the speciation of a liquid phase with chemical reactions.
+
+    The unknowns are the extents of the reactions, so the composition only
+    changes along the reactions. Element balances, and the charge balance
+    for reactions that conserve charge, are therefore kept exactly.
+    Reactions that do not conserve charge are ignored. For each reaction
+
+        sum_i nu_i*ln(x_i*phi_i) = ln(K)
+
+    where phi_i are the fugacity coefficients from pcsaft_fugcoef_cpp, so the
+    equilibrium constants refer to the fugacity of the species. Each outer
+    iteration evaluates phi_i at the current composition and then solves the
+    equations with Newton's method, using the analytic derivatives of ln(x_i)
+    with respect to the extents, and ln(phi_i) linearized around the current
+    composition. The derivatives of ln(phi_i) with respect to the extents
+    are estimated from the previous outer iterations with Broyden updates.
+    Starting from the speciation of the previous call, e.g. in the
+    iterations of a flash, this usually takes one or two evaluations of the
+    fugacity coefficients.
+
+    Parameters
+    ----------
+    x_guess : vector<double>, shape (n,)
+        Mole fractions before the reactions, or a previous speciation.
+    m, s, e : vector<double>, shape (n,)
+        Segment number, segment diameter (Angstrom) and dispersion energy (K).
+    t : double
+        Temperature (K)
+    p : double
+        Pressure (Pa)
+    cppargs : add_args
+        A struct containing additional arguments (see pcsaft_Z_cpp). The
+        reactions are given by rxn_nu and rxn_lnk.
+
+    Returns
+    -------
+    x : vector<double>, shape (n,)
+        Mole fractions at chemical equilibrium. x_guess is returned if there
+        are no reactions.
+    */
+    int ncomp = x_guess.size();
+    int nrxn = cppargs.rxn_nu.size()/ncomp;
+    if (nrxn == 0) {
+        return x_guess;
+    }
+
+    // reactions that conserve charge, and the change of the total amount for each
+    vector<int> rxn;
+    for (int r = 0; r < nrxn; r++) {
+        double charge = 0.;
+        for (int i = 0; i < ncomp; i++) {
+            if (!cppargs.z.empty()) {
+                charge += cppargs.rxn_nu[r*ncomp+i]*cppargs.z[i];
+            }
+        }
+        if (fabs(charge) < 1e-12) {
+            rxn.push_back(r);
+        }
+    }
+    int nr = rxn.size();
+    if (nr == 0) {
+        return x_guess;
+    }
+    MatrixXd nu(nr, ncomp);
+    VectorXd lnK(nr), dn_tot(nr);
+    for (int k = 0; k < nr; k++) {
+        const double *c = &cppargs.rxn_lnk[rxn[k]*4];
+        lnK(k) = c[0] + c[1]/t + c[2]*log(t) + c[3]*t;
+        dn_tot(k) = 0.;
+        for (int i = 0; i < ncomp; i++) {
+            nu(k, i) = cppargs.rxn_nu[rxn[k]*ncomp+i];
+            dn_tot(k) += nu(k, i);
+        }
+    }
+
+    // amounts for 1 mol of the initial mixture. Species that take part in a
+    // reaction must be present, so reactions that form a missing species are
+    // advanced by a small extent.
+    VectorXd n = Map<const VectorXd>(&x_guess[0], ncomp);
+    for (int k = 0; k < nr; k++) {
+        int dir = 0;
+        for (int i = 0; i < ncomp; i++) {
+            if (nu(k, i) != 0 && n(i) <= 0) {
+                dir = (nu(k, i) > 0) ? 1 : -1;
+            }
+        }
+        if (dir != 0) {
+            n += dir*1e-12*nu.row(k).transpose();
+        }
+    }
+
+    // species in none of the reactions do not change, and may be absent
+    vector<int> species;
+    for (int i = 0; i < ncomp; i++) {
+        if (nu.col(i).cwiseAbs().maxCoeff() > 0) {
+            species.push_back(i);
+        }
+    }
+
+    VectorXd x(ncomp), lnphi(ncomp), F(nr), dxi(nr), dn(ncomp), lnx(ncomp), n_inv(ncomp);
+    VectorXd G(nr), G_old(nr), xi_step = VectorXd::Zero(nr);
+    MatrixXd J(nr, nr);
+    MatrixXd B = MatrixXd::Zero(nr, nr); // estimate of the derivative of nu*ln(phi) with respect to the extents
+    vector<double> xv(ncomp), fugcoef;
+    double n_tot, alpha;
+    for (int outer = 0; outer < 50; outer++) {
+        n_tot = n.sum();
+        x = n/n_tot;
+        Map<VectorXd>(&xv[0], ncomp) = x;
+        double rho = pcsaft_den_cpp(xv, m, s, e, t, p, 0, cppargs);
+        fugcoef = pcsaft_fugcoef_cpp(xv, m, s, e, t, rho, cppargs);
+        lnphi.setZero();
+        for (size_t k = 0; k < species.size(); k++) {
+            lnphi(species[k]) = log(fugcoef[species[k]]);
+        }
+        if (!lnphi.allFinite()) {
+            break;
+        }
+        G = nu*lnphi;
+        if (outer > 0 && xi_step.norm() > 1e-8*n_tot) { // smaller steps only give the noise of the density solver
+            B += (G - G_old - B*xi_step)*xi_step.transpose()/xi_step.squaredNorm();
+        }
+        G_old = G;
+        xi_step.setZero();
+
+        // Newton's method for the extents with ln(phi) linearized
+        for (int inner = 0; inner < 100; inner++) {
+            n_tot = n.sum();
+            lnx.setZero();
+            n_inv.setZero();
+            for (size_t k = 0; k < species.size(); k++) {
+                lnx(species[k]) = log(n(species[k])/n_tot);
+                n_inv(species[k]) = 1./n(species[k]);
+            }
+            F = nu*lnx + G + B*xi_step - lnK;
+            if (inner == 0 && F.cwiseAbs().maxCoeff() < 1e-8) {
+                return xv;
+            }
+            if (F.cwiseAbs().maxCoeff() < 1e-12) {
+                break;
+            }
+            J = nu*n_inv.asDiagonal()*nu.transpose() - dn_tot*dn_tot.transpose()/n_tot + B;
+            dxi = -J.colPivHouseholderQr().solve(F);
+            dn = nu.transpose()*dxi;
+            // keep the amounts positive
+            alpha = 1.;
+            for (int i = 0; i < ncomp; i++) {
+                if (dn(i) < 0 && n(i) + alpha*dn(i) < 0.1*n(i)) {
+                    alpha = 0.9*n(i)/(-dn(i));
+                }
+            }
+            n += alpha*dn;
+            xi_step += alpha*dxi;
+        }
+    }
+
+    n_tot = n.sum();
+    for (int i = 0; i < ncomp; i++) {
+        xv[i] = n(i)/n_tot;
+    }
+    return xv;
+}
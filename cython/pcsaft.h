@@ -1,55 +1,164 @@
+#ifndef PCSAFT_H
+#define PCSAFT_H
+
+/*
+Public C++ interface of the PC-SAFT core (libpcsaft): the property and
+phase equilibrium functions and the structs of their arguments and results.
+The caches, tables and instrumentation of the implementation are declared
+in pcsaft_internal.h, which is not installed. C programs use pcsaft_c.h.
+*/
 #include <vector>
+#include <cstddef>
 
-using namespace std;
+const static int SWEEP_FUGCOEF = 1; // properties of pcsaft_sweep_cpp: fugacity coefficients and residual Gibbs energy
+const static int SWEEP_HSRES = 2; // residual enthalpy and entropy (the residual Gibbs energy is included)
 
-const static double kb = 1.380648465952442093e-23; // Boltzmann constant, J K^-1
-const static double PI = 3.141592653589793;
-const static double N_AV = 6.022140857e23; // Avagadro's number
-const static double E_CHRG = 1.6021766208e-19; // elementary charge, units of coulomb
-const static double perm_vac = 8.854187817e-22; //permittivity in vacuum, C V^-1 Angstrom^-1
+struct mixing_cache;
 
 struct add_args {
-    vector<double> k_ij;
-    vector<double> e_assoc;
-    vector<double> vol_a;
-    vector<double> dipm;
-    vector<double> dip_num;
-    vector<double> z;
+    std::vector<double> k_ij;
+    std::vector<double> e_assoc;
+    std::vector<double> vol_a;
+    std::vector<double> dipm;
+    std::vector<double> dip_num;
+    std::vector<double> z;
     double dielc;
-    vector<double> k_hb;
-    vector<double> l_ij;
-};
-
-bool IsNotZero (double x) {return x != 0.0;}
-
-double pcsaft_Z_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs);
-vector<double> pcsaft_fugcoef_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs);
-double pcsaft_p_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs);
-double pcsaft_den_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double p, int phase, add_args &cppargs);
-double pcsaft_ares_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs);
-double pcsaft_dadt_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs);
-double pcsaft_hres_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs);
-double pcsaft_sres_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs);
-double pcsaft_gres_cpp(vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, double rho, add_args &cppargs);
-
-double bubblePfit_cpp(double p_guess, vector<double> xv_guess, vector<double> x, vector<double> m, vector<double> s, vector<double> e,
-    double t, add_args &cppargs);
-double PTzfit_cpp(double p_guess, vector<double> x_guess, double beta_guess, double mol, 
-    double vol, vector<double> x_total, vector<double> m, vector<double> s, vector<double> e,
-    double t, add_args &cppargs);
-
-vector<double> XA_find(vector<double> XA_guess, int ncomp, vector<double> delta_ij, double den,
-    vector<double> x);
-vector<double> dXA_find(int ncA, int ncomp, vector<int> iA, vector<double> delta_ij, 
-    double den, vector<double> XA, vector<double> ddelta_dd, vector<double> x, int n_sites);
-vector<double> dXAdt_find(int ncA, vector<double> delta_ij, double den, 
-    vector<double> XA, vector<double> ddelta_dt, vector<double> x, int n_sites);
+    std::vector<int> dielc_model; // dielectric model of each component: 0 = none (e.g. ions), 1 = water, 2 = dielc_coef. dielc is used if empty
+    std::vector<double> dielc_coef; // coefficients a, b, c of dielc_i = a + b*T + c*T^2 for the components with model 2, (n*3,)
+    std::vector<double> k_hb;
+    std::vector<double> l_ij;
+    std::vector<double> rxn_nu; // stoichiometric coefficients of the speciation reactions, (r*n,)
+    std::vector<double> rxn_lnk; // coefficients A, B, C, D of ln(K) = A + B/T + C*ln(T) + D*T for each reaction, (r*4,)
+    const mixing_cache *mixing; // tables precomputed by mixing_cache_setup_cpp, or NULL
+    add_args() : dielc(0.), mixing(NULL) {}
+};
+
+struct solver_tol {
+    double assoc; // sum of the changes of the fractions of unbonded association sites at which the iterations stop
+    double den; // relative deviation of the pressure at which the density solver stops
+    double comp; // change of the compositions (or of the vapor fraction) at which the phase equilibrium loops stop
+    solver_tol() : assoc(1e-9), den(1e-6), comp(1e-9) {}
+};
+
+struct fit_data {
+    std::vector<int> prop; // property of each data point: 0 = density, 1 = vapor pressure, 2 = enthalpy of vaporization
+    std::vector<int> phase; // phase of density data: 0 = liquid, 1 = vapor
+    std::vector<double> t; // temperature, K
+    std::vector<double> p; // pressure, Pa (the guess for the vapor pressure for prop 1 and 2)
+    std::vector<double> value; // measured value: mol m^-3, Pa or J mol^-1
+};
+
+struct fit_result {
+    std::vector<double> params;
+    std::vector<double> std_err; // standard errors of the parameters
+    std::vector<double> residuals; // relative deviation of each data point, %
+    double ssr; // sum of squared residuals
+    double ssr_initial; // sum of squared residuals for the initial guess
+    double grad_norm; // largest element of the gradient J^T*r in the last iteration
+    int iterations;
+    int n_evals; // number of evaluations of the residuals
+    int n_jac; // number of evaluations of the Jacobian
+    bool converged;
+    int status; // 1, 2, 3: small change of the sum of squares, step or gradient; 4: no further reduction possible;
+                // 0: maximum number of iterations; -1, -2: residuals or Jacobian not finite
+                // (-1 also for a mixture that is not binary in pcsaft_fit_binary_cpp)
+};
+
+struct saturation_result {
+    double p; // vapor pressure, Pa
+    double rho_l, rho_v; // densities of the coexisting liquid and vapor, mol m^-3
+    double hres_l, hres_v; // residual enthalpies, J mol^-1
+    double sres_l, sres_v; // residual entropies, J mol^-1 K^-1
+    double gres_l, gres_v; // residual Gibbs energies, J mol^-1
+    double hvap; // enthalpy of vaporization, J mol^-1
+};
+
+struct sweep_result {
+    std::vector<double> rho; // density of each state, mol m^-3
+    std::vector<int> phase; // phase of each state: 0 = liquid, 1 = vapor
+    std::vector<double> Z; // compressibility factor
+    std::vector<double> fugcoef; // fugacity coefficients, (k*n,) (only with SWEEP_FUGCOEF or SWEEP_HSRES)
+    std::vector<double> gres; // residual Gibbs energy, J mol^-1 (only with SWEEP_FUGCOEF or SWEEP_HSRES)
+    std::vector<double> hres; // residual enthalpy, J mol^-1 (only with SWEEP_HSRES)
+    std::vector<double> sres; // residual entropy, J mol^-1 K^-1 (only with SWEEP_HSRES)
+    int n_cold; // number of densities that were solved without a warm start
+};
+
+struct vle_data {
+    std::vector<int> type; // type of each data point: 0 = bubble point (T, x, P, y), 1 = PTz (T, V, n, P)
+    std::vector<double> t; // temperature, K
+    std::vector<double> p; // measured pressure, Pa
+    std::vector<double> x; // liquid (type 0) or overall (type 1) mole fractions, ncomp values per data point
+    std::vector<double> y; // measured vapor mole fractions of bubble points, ncomp values per data point (negative or NaN if not measured)
+    std::vector<double> mol; // total amount of substance of PTz points, mol
+    std::vector<double> vol; // total volume of PTz points, m^3
+};
+
+struct ensemble_result {
+    std::vector<double> mean; // mean of each property, (k*(n+1),): for each state the density and ln(phi_i) of each component
+    std::vector<double> var; // sample variance of each property
+    std::vector<double> quantiles; // estimated quantiles of each property, (k*(n+1)*q,)
+    std::vector<int> count; // number of parameter sets that gave a finite value for each property
+};
+
+double pcsaft_Z_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, double t, double rho, add_args &cppargs, std::vector<double> *XA_io = NULL,
+    const solver_tol *tol = NULL);
+std::vector<double> pcsaft_fugcoef_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, double t, double rho, add_args &cppargs, const solver_tol *tol = NULL);
+double pcsaft_p_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, double t, double rho, add_args &cppargs, std::vector<double> *XA_io = NULL,
+    const solver_tol *tol = NULL);
+double pcsaft_den_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, double t, double p, int phase, add_args &cppargs, double rho_guess = 0.,
+    double rho_lo = 0., double rho_hi = 0., const solver_tol *tol = NULL);
+double pcsaft_ares_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, double t, double rho, add_args &cppargs);
+double pcsaft_dadt_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, double t, double rho, add_args &cppargs);
+double pcsaft_hres_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, double t, double rho, add_args &cppargs);
+double pcsaft_sres_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, double t, double rho, add_args &cppargs);
+double pcsaft_gres_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, double t, double rho, add_args &cppargs);
+
+std::vector<double> pcsaft_Z_batch_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, const std::vector<double> &t, const std::vector<double> &rho, add_args &cppargs);
+std::vector<double> pcsaft_lnfugcoef_batch_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, const std::vector<double> &t, const std::vector<double> &rho, add_args &cppargs);
+std::vector<double> pcsaft_den_batch_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, const std::vector<double> &t, const std::vector<double> &p, int phase, add_args &cppargs);
+ensemble_result pcsaft_ensemble_cpp(const std::vector<double> &params, int nsets, const std::vector<double> &x,
+    const std::vector<double> &t, const std::vector<double> &p, const std::vector<int> &phase,
+    const std::vector<double> &quantiles, add_args &cppargs);
+
+double pcsaft_vaporP_cpp(double p_guess, const std::vector<double> &x, const std::vector<double> &m,
+    const std::vector<double> &s, const std::vector<double> &e, double t, add_args &cppargs);
+sweep_result pcsaft_sweep_cpp(const std::vector<double> &x, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, const std::vector<double> &t, const std::vector<double> &p, int phase, int props,
+    add_args &cppargs);
+saturation_result pcsaft_saturation_cpp(double p_guess, const std::vector<double> &x, const std::vector<double> &m,
+    const std::vector<double> &s, const std::vector<double> &e, double t, add_args &cppargs);
+double pcsaft_bubbleP_cpp(double p_guess, std::vector<double> &xv, const std::vector<double> &x,
+    const std::vector<double> &m, const std::vector<double> &s, const std::vector<double> &e, double t,
+    add_args &cppargs);
+bool pcsaft_flash_cpp(double p, double t, const std::vector<double> &z, const std::vector<double> &m,
+    const std::vector<double> &s, const std::vector<double> &e, add_args &cppargs, std::vector<double> &K, double &beta,
+    double &rho_l, double &rho_v);
+fit_result pcsaft_fit_pure_cpp(const std::vector<double> &params_guess, const fit_data &data,
+    add_args &cppargs, int maxiter, double tol);
+fit_result pcsaft_fit_binary_cpp(const std::vector<double> &params_guess, const std::vector<int> &param_type,
+    const vle_data &data, const std::vector<double> &m, const std::vector<double> &s, const std::vector<double> &e,
+    add_args &cppargs, int maxiter, double tol);
+double bubblePfit_cpp(double p_guess, const std::vector<double> &xv_guess, const std::vector<double> &x,
+    const std::vector<double> &m, const std::vector<double> &s, const std::vector<double> &e,
+    double t, add_args &cppargs, const solver_tol *tol = NULL);
+double PTzfit_cpp(double p_guess, const std::vector<double> &x_guess, double beta_guess, double mol, 
+    double vol, std::vector<double> x_total, const std::vector<double> &m, const std::vector<double> &s, const std::vector<double> &e,
+    double t, add_args &cppargs, const solver_tol *tol = NULL);
+
+std::vector<double> chem_equil_cpp(const std::vector<double> &x_guess, const std::vector<double> &m, const std::vector<double> &s,
+    const std::vector<double> &e, double t, double p, add_args &cppargs);
+
+#endif
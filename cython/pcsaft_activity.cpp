@@ -0,0 +1,203 @@
+#include <vector>
+#include <map>
+#include <cmath>
+#include <limits>
+
+#include "pcsaft_internal.h"
+
+using namespace std;
+
+/*
+Activity coefficients and osmotic coefficients of liquid solutions.
+
+The activity coefficients follow from the fugacity coefficients of the
+solution and of the reference states, gamma_i = phi_i/phi_i^ref. The solvent
+is referred to the pure solvent at the temperature and pressure of the
+solution (Raoult's law), the solutes to infinite dilution in the solvent. The
+fugacity coefficient of a solute at infinite dilution is its fugacity
+coefficient in the pure solvent, so both reference states follow from a
+single evaluation for the pure solvent. These values only depend on the
+temperature and pressure, so they are stored in a solvent_ref_cache and are
+reused for all compositions at the same state, e.g. when a series of brine
+concentrations is evaluated. A cache belongs to one mixture and solvent, and
+is emptied when it is used for another one.
+*/
+
+const static double NaN = numeric_limits<double>::quiet_NaN();
+const static size_t SOLVENT_REF_MAX = 4096; // states kept by a solvent_ref_cache before it is emptied
+
+
+static void solvent_reference_select(int solvent, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, add_args &cppargs, solvent_ref_cache &cache) {
+    /**Empty the cache if its values belong to another mixture or solvent.*/
+    uint64_t mixture = mixture_hash_cpp(m, s, e, cppargs);
+    if (cache.mixture != mixture || cache.solvent != solvent) {
+        cache.lnfugcoef.clear();
+        cache.mixture = mixture;
+        cache.solvent = solvent;
+    }
+}
+
+
+static const vector<double>& solvent_reference(int solvent, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double p, add_args &cppargs, solvent_ref_cache &cache) {
+    /**
+    Return ln(phi_i) of each component in the pure solvent at t and p,
+    solving for it only if it is not in the cache yet. The cache must
+    already belong to the mixture and solvent (see solvent_reference_select),
+    and t and p must be finite, as NaN keys break the ordering of the map.
+    */
+    pair<double, double> key(t, p);
+    map<pair<double, double>, vector<double> >::iterator it = cache.lnfugcoef.find(key);
+    if (it != cache.lnfugcoef.end()) {
+        return it->second;
+    }
+    if (cache.lnfugcoef.size() >= SOLVENT_REF_MAX) {
+        cache.lnfugcoef.clear();
+    }
+
+    int ncomp = m.size();
+    vector<double> x0(ncomp, 0.);
+    x0[solvent] = 1.;
+    vector<double> lnfugcoef0(ncomp, NaN);
+    double rho0 = pcsaft_den_cpp(x0, m, s, e, t, p, 0, cppargs);
+    if (isfinite(rho0)) {
+        vector<double> fugcoef0 = pcsaft_fugcoef_cpp(x0, m, s, e, t, rho0, cppargs);
+        for (int i = 0; i < ncomp; i++) {
+            lnfugcoef0[i] = log(fugcoef0[i]);
+        }
+    }
+    return cache.lnfugcoef[key] = lnfugcoef0;
+}
+
+
+static activity_result activity_state(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double p, int solvent, double mw_solvent, add_args &cppargs,
+    const vector<double> *lnfugcoef0) {
+    /**Activity and osmotic coefficients for the reference state lnfugcoef0 (NULL if t or p is not finite).*/
+    int ncomp = x.size();
+    activity_result result;
+    result.gamma_x.assign(ncomp, NaN);
+    result.gamma_m.assign(ncomp, NaN);
+    result.molality.assign(ncomp, 0.);
+    result.gamma_pm = NaN;
+    result.osmotic = NaN;
+
+    double kg_solvent = x[solvent]*mw_solvent/1000.; // kg of solvent per mol of solution
+    double sum_molality = 0.;
+    for (int i = 0; i < ncomp; i++) {
+        if (i != solvent) {
+            result.molality[i] = x[i]/kg_solvent;
+            sum_molality += result.molality[i];
+        }
+    }
+
+    if (lnfugcoef0 == NULL || !isfinite((*lnfugcoef0)[solvent])) {
+        return result;
+    }
+    double rho = pcsaft_den_cpp(x, m, s, e, t, p, 0, cppargs);
+    if (!isfinite(rho)) {
+        return result;
+    }
+    vector<double> fugcoef = pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs);
+
+    double sum_x_ion = 0., sum_lngamma_ion = 0.;
+    for (int i = 0; i < ncomp; i++) {
+        double lngamma = log(fugcoef[i]) - (*lnfugcoef0)[i];
+        result.gamma_x[i] = exp(lngamma);
+        // converting from the mole fraction to the molality scale only affects the solutes
+        result.gamma_m[i] = (i == solvent) ? result.gamma_x[i] : result.gamma_x[i]*x[solvent];
+        if (!cppargs.z.empty() && cppargs.z[i] != 0) {
+            sum_x_ion += x[i];
+            sum_lngamma_ion += x[i]*log(result.gamma_m[i]);
+        }
+    }
+    if (sum_x_ion > 0) {
+        result.gamma_pm = exp(sum_lngamma_ion/sum_x_ion);
+    }
+    if (sum_molality > 0) {
+        result.osmotic = -log(x[solvent]*result.gamma_x[solvent])/(mw_solvent/1000.)/sum_molality;
+    }
+    return result;
+}
+
+
+activity_result pcsaft_activity_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double p, int solvent, double mw_solvent, add_args &cppargs,
+    solvent_ref_cache &cache) {
+    /**
+    Calculate the activity coefficients and the osmotic coefficient of a
+    liquid solution.
+
+    Parameters
+    ----------
+    x : vector<double>, shape (n,)
+        Mole fractions of each component.
+    m, s, e : vector<double>, shape (n,)
+        Segment number, segment diameter (Angstrom) and dispersion energy (K)
+        of each component.
+    t : double
+        Temperature (K)
+    p : double
+        Pressure (Pa)
+    solvent : int
+        Index of the solvent.
+    mw_solvent : double
+        Molar mass of the solvent (g mol^-1)
+    cppargs : add_args
+        Additional arguments of PC-SAFT.
+    cache : solvent_ref_cache
+        Fugacity coefficients of the reference states from previous calls.
+        It is filled for t and p if they are not in it yet.
+
+    Returns
+    -------
+    result : activity_result
+        The activity coefficients of the solvent are relative to the pure
+        solvent and those of the solutes to infinite dilution in the solvent.
+        The mean ionic activity coefficient is averaged over the ions
+        weighted by their mole fractions, which for a single salt is the usual
+        (gamma_+^nu_+ gamma_-^nu_-)^(1/nu). All values are NaN if t or p is
+        not finite, or if the density of the solution or of the pure solvent
+        could not be found.
+    */
+    solvent_reference_select(solvent, m, s, e, cppargs, cache);
+    const vector<double> *lnfugcoef0 = NULL;
+    if (isfinite(t) && isfinite(p)) {
+        lnfugcoef0 = &solvent_reference(solvent, m, s, e, t, p, cppargs, cache);
+    }
+    return activity_state(x, m, s, e, t, p, solvent, mw_solvent, cppargs, lnfugcoef0);
+}
+
+
+vector<activity_result> pcsaft_activity_batch_cpp(const vector<double> &x, const vector<double> &m,
+    const vector<double> &s, const vector<double> &e, const vector<double> &t, const vector<double> &p,
+    int solvent, double mw_solvent, add_args &cppargs, solvent_ref_cache &cache) {
+    /**
+    Calculate the activity coefficients for many compositions and states.
+
+    x contains the mole fractions of each state, one after another (k*n
+    values), and t and p one value per state. The reference state is solved
+    once for each distinct temperature and pressure, after which the states
+    are evaluated in parallel if the code is compiled with OpenMP. The
+    parallel loop only reads copies of the reference states.
+    */
+    int ncomp = m.size();
+    int nstates = t.size();
+    solvent_reference_select(solvent, m, s, e, cppargs, cache);
+    vector<vector<double> > lnfugcoef0(nstates);
+    for (int k = 0; k < nstates; k++) {
+        if (isfinite(t[k]) && isfinite(p[k])) {
+            lnfugcoef0[k] = solvent_reference(solvent, m, s, e, t[k], p[k], cppargs, cache);
+        }
+    }
+
+    vector<activity_result> result(nstates);
+    #pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < nstates; k++) {
+        vector<double> xk(x.begin() + k*ncomp, x.begin() + (k+1)*ncomp);
+        result[k] = activity_state(xk, m, s, e, t[k], p[k], solvent, mw_solvent, cppargs,
+            lnfugcoef0[k].empty() ? NULL : &lnfugcoef0[k]);
+    }
+    return result;
+}
@@ -0,0 +1,870 @@
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <Eigen/Dense>
+
+#include "pcsaft_internal.h"
+#include "pcsaft_poly.h"
+
+using namespace std;
+using namespace Eigen;
+
+/*
+Batch evaluation of PC-SAFT for many states of the same mixture.
+
+The states are processed in packs of PACK_SIZE. Within a pack every quantity
+that depends on the state (temperature, density, segment diameters, zeta,
+etc.) is stored as an Eigen array with one entry per state (structure of
+arrays). The arithmetic on these arrays, including exp, log and sqrt, is
+vectorized by Eigen using the SIMD instruction set that the code is compiled
+for (SSE2, AVX2 or AVX-512), and falls back to scalar code otherwise.
+
+Only the hard chain, dispersion and ion terms are implemented in this form.
+For mixtures that use the dipole or association terms the functions fall back
+to the scalar functions for each state.
+
+The kernels are templates on the type of the parameters. For an ensemble of
+parameter sets (pcsaft_ensemble_cpp) each entry of a pack is one parameter
+set at the same state, so the parameters are also arrays with one entry per
+parameter set.
+*/
+
+const static int PACK_SIZE = 64; // number of states evaluated together
+
+template <typename P>
+struct batch_mixture_t {
+    /**
+    Quantities that only depend on the mixture and the composition. P is
+    double when all states of a pack share the parameters, or ArrayXd with
+    one entry per state when they have different parameters (ensembles).
+    */
+    int ncomp;
+    P m_avg;
+    P m2es3_t; // m2es3*t, which is independent of the temperature
+    P m2e2s3_t2; // m2e2s3*t^2
+    vector<P> m2es3_row_t; // sum_j x_j*m_j*e_ij*s_ij^3, used for the composition derivatives
+    vector<P> m2e2s3_row_t2; // sum_j x_j*m_j*e_ij^2*s_ij^3
+    P a[7], b[7]; // dispersion coefficients for m_avg
+    P da[7], db[7]; // derivative of the coefficients with respect to x_i, divided by m_i/m_avg^2
+    bool ions;
+};
+
+typedef batch_mixture_t<double> batch_mixture;
+
+
+inline ArrayXd lanes(int n, double v) {
+    /**Broadcast a parameter that is shared by all states of a pack.*/
+    return ArrayXd::Constant(n, v);
+}
+
+
+inline const ArrayXd &lanes(int /*n*/, const ArrayXd &v) {
+    return v;
+}
+
+
+static bool batch_supported(add_args &cppargs) {
+    /**Check whether the mixture only uses the terms that are implemented for batches.*/
+    return cppargs.dipm.empty() && cppargs.e_assoc.empty();
+}
+
+
+static batch_mixture batch_setup(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, add_args &cppargs) {
+    /**Precompute the temperature and density independent parts of the mixture.*/
+    batch_mixture bm;
+    int ncomp = x.size();
+    bm.ncomp = ncomp;
+    bm.ions = !cppargs.z.empty();
+
+    bm.m_avg = 0;
+    for (int i = 0; i < ncomp; i++) {
+        bm.m_avg += x[i]*m[i];
+    }
+    double m_avg = bm.m_avg;
+    mix_coef(a0, a1, a2, m_avg, bm.a);
+    mix_coef(b0, b1, b2, m_avg, bm.b);
+    for (int i = 0; i < 7; i++) {
+        bm.da[i] = a1[i] + (3-4/m_avg)*a2[i];
+        bm.db[i] = b1[i] + (3-4/m_avg)*b2[i];
+    }
+
+    bm.m2es3_t = 0.;
+    bm.m2e2s3_t2 = 0.;
+    bm.m2es3_row_t.assign(ncomp, 0.);
+    bm.m2e2s3_row_t2.assign(ncomp, 0.);
+    mixing_cache local;
+    const mixing_cache &mixing = mixing_cache_get(m, s, e, cppargs, local);
+    const vector<double> &e_ij = mixing.e_ij;
+    const vector<double> &s_ij = mixing.s_ij;
+    double s3, es3, e2s3;
+    int idx = -1;
+    for (int i = 0; i < ncomp; i++) {
+        for (int j = i; j < ncomp; j++) {
+            idx += 1;
+            s3 = s_ij[idx]*s_ij[idx]*s_ij[idx];
+            es3 = e_ij[idx]*s3;
+            e2s3 = e_ij[idx]*e_ij[idx]*s3;
+            bm.m2es3_row_t[i] += x[j]*m[j]*es3;
+            bm.m2e2s3_row_t2[i] += x[j]*m[j]*e2s3;
+            if (j != i) {
+                bm.m2es3_row_t[j] += x[i]*m[i]*es3;
+                bm.m2e2s3_row_t2[j] += x[i]*m[i]*e2s3;
+            }
+        }
+    }
+    for (int i = 0; i < ncomp; i++) {
+        bm.m2es3_t += x[i]*m[i]*bm.m2es3_row_t[i];
+        bm.m2e2s3_t2 += x[i]*m[i]*bm.m2e2s3_row_t2[i];
+    }
+
+    return bm;
+}
+
+
+static batch_mixture_t<ArrayXd> batch_gather(const vector<batch_mixture> &bms) {
+    /**Combine the setup of several parameter sets into one pack, with one entry per parameter set.*/
+    int n = bms.size();
+    int ncomp = bms[0].ncomp;
+    batch_mixture_t<ArrayXd> bm;
+    bm.ncomp = ncomp;
+    bm.ions = bms[0].ions;
+    bm.m_avg.resize(n);
+    bm.m2es3_t.resize(n);
+    bm.m2e2s3_t2.resize(n);
+    bm.m2es3_row_t.assign(ncomp, ArrayXd(n));
+    bm.m2e2s3_row_t2.assign(ncomp, ArrayXd(n));
+    for (int i = 0; i < 7; i++) {
+        bm.a[i].resize(n);
+        bm.b[i].resize(n);
+        bm.da[i].resize(n);
+        bm.db[i].resize(n);
+    }
+    for (int l = 0; l < n; l++) {
+        bm.m_avg[l] = bms[l].m_avg;
+        bm.m2es3_t[l] = bms[l].m2es3_t;
+        bm.m2e2s3_t2[l] = bms[l].m2e2s3_t2;
+        for (int i = 0; i < ncomp; i++) {
+            bm.m2es3_row_t[i][l] = bms[l].m2es3_row_t[i];
+            bm.m2e2s3_row_t2[i][l] = bms[l].m2e2s3_row_t2[i];
+        }
+        for (int i = 0; i < 7; i++) {
+            bm.a[i][l] = bms[l].a[i];
+            bm.b[i][l] = bms[l].b[i];
+            bm.da[i][l] = bms[l].da[i];
+            bm.db[i][l] = bms[l].db[i];
+        }
+    }
+    return bm;
+}
+
+
+template <typename P>
+static void batch_pack(const batch_mixture_t<P> &bm, const vector<double> &x, const vector<P> &m,
+    const vector<P> &s, const vector<P> &e, const ArrayXd &t, const ArrayXd &rho,
+    add_args &cppargs, ArrayXd &Z, ArrayXXd *lnfugcoef) {
+    /**
+    Evaluate one pack of states.
+
+    Z receives the compressibility factor of each state. If lnfugcoef is not
+    NULL it receives the natural log of the fugacity coefficients, with one
+    row per state and one column per component.
+    */
+    int ncomp = bm.ncomp;
+    int n = t.size();
+    P m_avg = bm.m_avg;
+
+    vector<ArrayXd> d(ncomp);
+    for (int i = 0; i < ncomp; i++) {
+        if (bm.ions && cppargs.z[i] != 0) {
+            d[i] = lanes(n, s[i]*(1-0.12)); // for ions the diameter is assumed to be temperature independent (see Held et al. 2014)
+        }
+        else {
+            d[i] = s[i]*(1-0.12*(-3*e[i]/t).exp());
+        }
+    }
+
+    ArrayXd den = rho*N_AV/1.0e30;
+
+    ArrayXd zeta[4];
+    for (int l = 0; l < 4; l++) {
+        zeta[l] = ArrayXd::Zero(n);
+    }
+    ArrayXd dpow;
+    for (int j = 0; j < ncomp; j++) {
+        dpow = lanes(n, x[j]*m[j]);
+        for (int l = 0; l < 4; l++) {
+            zeta[l] += dpow;
+            dpow *= d[j];
+        }
+    }
+    for (int l = 0; l < 4; l++) {
+        zeta[l] *= PI/6*den;
+    }
+
+    ArrayXd eta = zeta[3];
+    ArrayXd z3c = 1 - zeta[3]; // 1 - zeta3
+    ArrayXd z3c2 = z3c*z3c;
+    ArrayXd z3c3 = z3c2*z3c;
+    ArrayXd z3c4 = z3c3*z3c;
+
+    vector<ArrayXd> ghs(ncomp);
+    ArrayXd summ = ArrayXd::Zero(n);
+    ArrayXd dij, denghs;
+    for (int i = 0; i < ncomp; i++) {
+        dij = d[i]/2.; // d[i]*d[i]/(d[i]+d[i])
+        ghs[i] = 1/z3c + dij*3*zeta[2]/z3c2 + dij*dij*2*zeta[2]*zeta[2]/z3c3;
+        denghs = zeta[3]/z3c2 + dij*(3*zeta[2]/z3c2 + 6*zeta[2]*zeta[3]/z3c3)
+            + dij*dij*(4*zeta[2]*zeta[2]/z3c3 + 6*zeta[2]*zeta[2]*zeta[3]/z3c4);
+        summ += x[i]*(m[i]-1)/ghs[i]*denghs;
+    }
+
+    ArrayXd zeta2_3 = zeta[2]*zeta[2]*zeta[2];
+    ArrayXd Zhs = zeta[3]/z3c + 3.*zeta[1]*zeta[2]/zeta[0]/z3c2 + (3.*zeta2_3 - zeta[3]*zeta2_3)/zeta[0]/z3c3;
+    ArrayXd Zhc = m_avg*Zhs - summ;
+
+    ArrayXd I1_p[2], I2_p[2]; // I1 and I2 and their first derivatives with respect to eta
+    horner<1>(bm.a, eta, I1_p);
+    horner<1>(bm.b, eta, I2_p);
+    ArrayXd I1 = I1_p[0];
+    ArrayXd I2 = I2_p[0];
+    ArrayXd detI1_det = I1 + eta*I1_p[1];
+    ArrayXd detI2_det = I2 + eta*I2_p[1];
+
+    ArrayXd eta2 = eta*eta;
+    ArrayXd eta3 = eta2*eta;
+    ArrayXd eta4 = eta3*eta;
+    ArrayXd c12 = (1-eta)*(2-eta);
+    ArrayXd c1_hs = (8*eta-2*eta2)/z3c4;
+    ArrayXd c1_ch = (20*eta-27*eta2+12*eta3-2*eta4)/(c12*c12);
+    ArrayXd C1 = 1./(1. + m_avg*c1_hs + (1-m_avg)*c1_ch);
+    ArrayXd C2 = -1.*C1*C1*(m_avg*(-4*eta2+20*eta+8)/(z3c4*z3c) + (1-m_avg)*(2*eta3+12*eta2-48*eta+40)/(c12*c12*c12));
+
+    ArrayXd m2es3 = bm.m2es3_t/t;
+    ArrayXd m2e2s3 = bm.m2e2s3_t2/(t*t);
+    ArrayXd Zdisp = -2*PI*den*detI1_det*m2es3 - PI*den*m_avg*(C1*detI2_det + C2*eta*I2)*m2e2s3;
+
+    // Ion term ---------------------------------------------------------------
+    ArrayXd Zion = ArrayXd::Zero(n);
+    vector<ArrayXd> chi;
+    ArrayXd kappa, ion_pre, ion_summ1, dielc;
+    ArrayXXd ddielc_dx; // derivative of the dielectric constant with respect to x_i, minus its sum weighted by x
+    double ion_summ2 = 0.;
+    bool kappa_nonzero = false;
+    if (bm.ions) {
+        double zsumm = 0.;
+        for (int i = 0; i < ncomp; i++) {
+            zsumm += cppargs.z[i]*cppargs.z[i]*x[i];
+            ion_summ2 += x[i]*pow(cppargs.z[i]*E_CHRG, 2);
+        }
+        kappa_nonzero = (zsumm != 0);
+        if (kappa_nonzero) {
+            dielc = ArrayXd::Constant(n, cppargs.dielc);
+            if (!cppargs.dielc_model.empty()) {
+                ddielc_dx.resize(n, ncomp);
+                double ddielc_dt, xdx;
+                vector<double> dx;
+                for (int l = 0; l < n; l++) {
+                    dielc[l] = dielc_cpp(x, t[l], cppargs, ddielc_dt, dx);
+                    xdx = 0.;
+                    for (int i = 0; i < ncomp; i++) {
+                        xdx += x[i]*dx[i];
+                    }
+                    for (int i = 0; i < ncomp; i++) {
+                        ddielc_dx(l, i) = dx[i] - xdx;
+                    }
+                }
+            }
+            kappa = (den*E_CHRG*E_CHRG/kb/t/(dielc*perm_vac)*zsumm).sqrt(); // the inverse Debye screening length. Equation 4 in Held et al. 2008.
+            chi.resize(ncomp);
+            ion_summ1 = ArrayXd::Zero(n);
+            ArrayXd ks, ks1;
+            for (int i = 0; i < ncomp; i++) {
+                ks = kappa*s[i];
+                ks1 = 1 + ks;
+                chi[i] = 3/(ks*ks*ks)*(1.5 + ks1.log() - 2*ks1 + 0.5*ks1*ks1);
+                ion_summ1 += pow(cppargs.z[i]*E_CHRG, 2)*x[i]*(-2*chi[i] + 3/ks1);
+            }
+            ion_pre = kappa/24./PI/kb/t/(dielc*perm_vac);
+            Zion = -1*ion_pre*ion_summ1;
+        }
+    }
+
+    Z = 1. + Zhc + Zdisp + Zion;
+
+    if (lnfugcoef == NULL) {
+        return;
+    }
+
+    // Fugacity coefficients --------------------------------------------------
+    ArrayXd ares_hs = 1/zeta[0]*(3*zeta[1]*zeta[2]/z3c + zeta2_3/(zeta[3]*z3c2)
+        + (zeta2_3/(zeta[3]*zeta[3]) - zeta[0])*z3c.log());
+    ArrayXd ares_hc = m_avg*ares_hs;
+    for (int i = 0; i < ncomp; i++) {
+        ares_hc -= x[i]*(m[i]-1)*ghs[i].log();
+    }
+    ArrayXd ares_disp = -2*PI*den*I1*m2es3 - PI*den*m_avg*C1*I2*m2e2s3;
+
+    // the sums over j in the composition derivative of the hard chain term
+    // are factored so that they only need to be evaluated once
+    ArrayXd W0 = ArrayXd::Zero(n), W1 = ArrayXd::Zero(n), W2 = ArrayXd::Zero(n), w;
+    for (int j = 0; j < ncomp; j++) {
+        w = x[j]*(m[j]-1)/ghs[j];
+        W0 += w;
+        W1 += w*d[j]/2.;
+        W2 += w*d[j]*d[j]/4.;
+    }
+
+    // series for the composition derivatives of the dispersion coefficients
+    ArrayXd Q1[1], Q2[1];
+    horner<0>(bm.da, eta, Q1);
+    horner<0>(bm.db, eta, Q2);
+
+    ArrayXXd dadx(n, ncomp); // composition derivatives of ares_hc + ares_disp
+    ArrayXd dz0, dz1, dz2, dz3, dahs_dx, dahc_dx, dI1_dx, dI2_dx, dC1_dx, dadisp_dx;
+    for (int i = 0; i < ncomp; i++) {
+        dz0 = PI/6.*den*m[i];
+        dz1 = dz0*d[i];
+        dz2 = dz1*d[i];
+        dz3 = dz2*d[i];
+
+        dahs_dx = -dz0/zeta[0]*ares_hs + 1/zeta[0]*(3*(dz1*zeta[2] + zeta[1]*dz2)/z3c
+            + 3*zeta[1]*zeta[2]*dz3/z3c2 + 3*zeta[2]*zeta[2]*dz2/zeta[3]/z3c2
+            + zeta2_3*dz3*(3*zeta[3]-1)/zeta[3]/zeta[3]/z3c3
+            + z3c.log()*((3*zeta[2]*zeta[2]*dz2*zeta[3] - 2*zeta2_3*dz3)/(zeta[3]*zeta[3]*zeta[3]) - dz0)
+            + (zeta[0]-zeta2_3/zeta[3]/zeta[3])*dz3/z3c);
+        dahc_dx = m[i]*ares_hs + m_avg*dahs_dx - (dz3/z3c2*W0 + (3*dz2/z3c2 + 6*zeta[2]*dz3/z3c3)*W1
+            + (4*zeta[2]*dz2/z3c3 + 6*zeta[2]*zeta[2]*dz3/z3c4)*W2) - (m[i]-1)*ghs[i].log();
+
+        dI1_dx = I1_p[1]*dz3 + m[i]/m_avg/m_avg*Q1[0];
+        dI2_dx = I2_p[1]*dz3 + m[i]/m_avg/m_avg*Q2[0];
+        dC1_dx = C2*dz3 - C1*C1*(m[i]*c1_hs - m[i]*c1_ch);
+        dadisp_dx = -2*PI*den*(dI1_dx*m2es3 + I1*2*m[i]*bm.m2es3_row_t[i]/t) - PI*den
+            *((m[i]*C1*I2 + m_avg*dC1_dx*I2 + m_avg*C1*dI2_dx)*m2e2s3
+            + m_avg*C1*I2*2*m[i]*bm.m2e2s3_row_t2[i]/(t*t));
+
+        dadx.col(i) = dahc_dx + dadisp_dx;
+    }
+
+    ArrayXd xdadx = ArrayXd::Zero(n);
+    for (int j = 0; j < ncomp; j++) {
+        xdadx += x[j]*dadx.col(j);
+    }
+
+    ArrayXd base = ares_hc + ares_disp + Zhc + Zdisp - xdadx - Z.log();
+    ArrayXd dares_ddielc; // derivative of the ion term with respect to the dielectric constant
+    if (kappa_nonzero && ddielc_dx.size() > 0) {
+        dares_ddielc = ArrayXd::Zero(n);
+        for (int i = 0; i < ncomp; i++) {
+            dares_ddielc += pow(cppargs.z[i]*E_CHRG, 2)*x[i]*chi[i];
+        }
+        dares_ddielc = (2*ion_pre*dares_ddielc - Zion)/dielc;
+    }
+    lnfugcoef->resize(n, ncomp);
+    for (int i = 0; i < ncomp; i++) {
+        lnfugcoef->col(i) = base + dadx.col(i);
+        if (kappa_nonzero) {
+            double q2 = pow(cppargs.z[i]*E_CHRG, 2);
+            lnfugcoef->col(i) += -q2*ion_pre*(2*chi[i] + ion_summ1/ion_summ2);
+            if (ddielc_dx.size() > 0) {
+                lnfugcoef->col(i) += dares_ddielc*ddielc_dx.col(i);
+            }
+        }
+    }
+}
+
+
+template <typename P>
+static void batch_den_pack(const batch_mixture_t<P> &bm, const vector<double> &x, const vector<P> &m,
+    const vector<P> &s, const vector<P> &e, const ArrayXd &tp, const ArrayXd &pp, int phase,
+    add_args &cppargs, ArrayXd &rho, Array<bool, Dynamic, 1> &ok) {
+    /**
+    Solve for the density of one pack of states.
+
+    The density of all states is solved simultaneously with a bounded secant
+    method on the relative pressure error. Each state has its own convergence
+    flag, and states that have converged are no longer updated. ok is false
+    for the states that did not converge.
+    */
+    int ncomp = bm.ncomp;
+    int n = tp.size();
+    double eta_guess, eta_lo, eta_hi;
+    if (phase == 0) {
+        eta_guess = 0.5;
+        eta_lo = 0.2;
+        eta_hi = 0.7405;
+    }
+    else {
+        eta_guess = 1.0e-9;
+        eta_lo = 1.0e-12;
+        eta_hi = 0.06;
+    }
+
+    // conversion from reduced density to molar density
+    ArrayXd summ = ArrayXd::Zero(n);
+    for (int i = 0; i < ncomp; i++) {
+        summ += x[i]*m[i]*(s[i]*(1-0.12*(-3*e[i]/tp).exp())).cube();
+    }
+    ArrayXd conv = 6/PI/summ*1.0e30/N_AV;
+    ArrayXd x_lo = eta_lo*conv;
+    ArrayXd x_hi = eta_hi*conv;
+
+    int maxiter = 200;
+    ArrayXd Zpack;
+    ArrayXd rho1 = eta_guess*conv;
+    ArrayXd rho2 = rho1*(1 + 1.0e-6);
+    batch_pack(bm, x, m, s, e, tp, rho1, cppargs, Zpack, NULL);
+    ArrayXd y1 = Zpack*kb*tp*rho1*N_AV/pp - 1;
+    ArrayXd y2, rho_new;
+    Array<bool, Dynamic, 1> active = Array<bool, Dynamic, 1>::Constant(n, true);
+
+    int iter = 0;
+    while (iter < maxiter && active.any()) {
+        batch_pack(bm, x, m, s, e, tp, rho2, cppargs, Zpack, NULL);
+        y2 = Zpack*kb*tp*rho2*N_AV/pp - 1;
+        rho = rho2; // the densities at which y2 was evaluated
+        active = active && (y2.abs() > 1.0e-10) && (y2 != y1);
+
+        rho_new = rho2 - y2/(y2-y1)*(rho2-rho1);
+        rho_new = (rho_new < x_lo).select((x_lo + rho2)/2, rho_new);
+        rho_new = (rho_new > x_hi).select((x_hi + rho2)/2, rho_new);
+        rho_new = (rho_new == rho_new).select(rho_new, (x_lo + x_hi)/2); // NaN check
+
+        rho1 = active.select(rho2, rho1);
+        y1 = active.select(y2, y1);
+        rho2 = active.select(rho_new, rho2);
+        iter += 1;
+    }
+
+    // for the states that are still active after maxiter, rho2 is a secant
+    // step that was not evaluated, so rho is the density of the last evaluation
+    ok = y2.abs() < 1.0e-6;
+}
+
+
+vector<double> pcsaft_Z_batch_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, const vector<double> &t, const vector<double> &rho, add_args &cppargs) {
+    /**
+    Calculate the compressibility factor for many states of one mixture.
+
+    Parameters
+    ----------
+    x : vector<double>, shape (n,)
+        Mole fractions of each component, which are the same for all states.
+    m : vector<double>, shape (n,)
+        Segment number for each component.
+    s : vector<double>, shape (n,)
+        Segment diameter for each component. Units of Angstrom.
+    e : vector<double>, shape (n,)
+        Dispersion energy of each component. Units of K.
+    t : vector<double>, shape (k,)
+        Temperature of each state (K)
+    rho : vector<double>, shape (k,)
+        Molar density of each state (mol m^{-3})
+    cppargs : add_args
+        A struct containing additional arguments (see pcsaft_Z_cpp).
+
+    Returns
+    -------
+    Z : vector<double>, shape (k,)
+        Compressibility factor of each state
+    */
+    int nstates = t.size();
+    vector<double> Z(nstates);
+
+    if (!batch_supported(cppargs)) {
+        for (int k = 0; k < nstates; k++) {
+            Z[k] = pcsaft_Z_cpp(x, m, s, e, t[k], rho[k], cppargs);
+        }
+        return Z;
+    }
+
+    batch_mixture bm = batch_setup(x, m, s, e, cppargs);
+    ArrayXd Zpack;
+    for (int start = 0; start < nstates; start += PACK_SIZE) {
+        int n = min(PACK_SIZE, nstates - start);
+        batch_pack(bm, x, m, s, e, Map<const ArrayXd>(&t[start], n), Map<const ArrayXd>(&rho[start], n),
+            cppargs, Zpack, NULL);
+        Map<ArrayXd>(&Z[start], n) = Zpack;
+    }
+    return Z;
+}
+
+
+vector<double> pcsaft_lnfugcoef_batch_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, const vector<double> &t, const vector<double> &rho, add_args &cppargs) {
+    /**
+    Calculate the natural log of the fugacity coefficients for many states of
+    one mixture.
+
+    The parameters are the same as for pcsaft_Z_batch_cpp.
+
+    Returns
+    -------
+    lnfugcoef : vector<double>, shape (k*n,)
+        Natural log of the fugacity coefficients. The values for state k start
+        at index k*n.
+    */
+    int nstates = t.size();
+    int ncomp = x.size();
+    vector<double> lnfugcoef(nstates*ncomp);
+
+    if (!batch_supported(cppargs)) {
+        vector<double> fugcoef;
+        for (int k = 0; k < nstates; k++) {
+            fugcoef = pcsaft_fugcoef_cpp(x, m, s, e, t[k], rho[k], cppargs);
+            for (int i = 0; i < ncomp; i++) {
+                lnfugcoef[k*ncomp+i] = log(fugcoef[i]);
+            }
+        }
+        return lnfugcoef;
+    }
+
+    batch_mixture bm = batch_setup(x, m, s, e, cppargs);
+    ArrayXd Zpack;
+    ArrayXXd lnpack;
+    for (int start = 0; start < nstates; start += PACK_SIZE) {
+        int n = min(PACK_SIZE, nstates - start);
+        batch_pack(bm, x, m, s, e, Map<const ArrayXd>(&t[start], n), Map<const ArrayXd>(&rho[start], n),
+            cppargs, Zpack, &lnpack);
+        for (int k = 0; k < n; k++) {
+            for (int i = 0; i < ncomp; i++) {
+                lnfugcoef[(start+k)*ncomp+i] = lnpack(k, i);
+            }
+        }
+    }
+    return lnfugcoef;
+}
+
+
+vector<double> pcsaft_den_batch_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, const vector<double> &t, const vector<double> &p, int phase, add_args &cppargs) {
+    /**
+    Solve for the molar density of many states of one mixture.
+
+    The density of all states in a pack is solved simultaneously (see
+    batch_den_pack). States that do not converge are solved again with
+    pcsaft_den_cpp.
+
+    Parameters
+    ----------
+    x, m, s, e : vector<double>, shape (n,)
+        See pcsaft_Z_batch_cpp.
+    t : vector<double>, shape (k,)
+        Temperature of each state (K)
+    p : vector<double>, shape (k,)
+        Pressure of each state (Pa)
+    phase : int
+        The phase for which the calculation is performed. Options: 0 (liquid),
+        1 (vapor).
+    cppargs : add_args
+        A struct containing additional arguments (see pcsaft_Z_cpp).
+
+    Returns
+    -------
+    rho : vector<double>, shape (k,)
+        Molar density of each state (mol m^-3)
+    */
+    int nstates = t.size();
+    vector<double> rho_out(nstates);
+
+    if (!batch_supported(cppargs)) {
+        for (int k = 0; k < nstates; k++) {
+            rho_out[k] = pcsaft_den_cpp(x, m, s, e, t[k], p[k], phase, cppargs);
+        }
+        return rho_out;
+    }
+
+    batch_mixture bm = batch_setup(x, m, s, e, cppargs);
+    ArrayXd rho_pack;
+    Array<bool, Dynamic, 1> ok;
+    for (int start = 0; start < nstates; start += PACK_SIZE) {
+        int n = min(PACK_SIZE, nstates - start);
+        batch_den_pack(bm, x, m, s, e, Map<const ArrayXd>(&t[start], n), Map<const ArrayXd>(&p[start], n),
+            phase, cppargs, rho_pack, ok);
+        for (int k = 0; k < n; k++) {
+            if (ok[k]) {
+                rho_out[start+k] = rho_pack[k];
+            }
+            else {
+                rho_out[start+k] = pcsaft_den_cpp(x, m, s, e, t[start+k], p[start+k], phase, cppargs);
+            }
+        }
+    }
+    return rho_out;
+}
+
+
+struct running_stats {
+    /**Running mean and variance with Welford's algorithm.*/
+    int n;
+    double mean;
+    double m2; // sum of squared deviations from the mean
+
+    running_stats() : n(0), mean(0.), m2(0.) {}
+
+    void add(double v) {
+        n += 1;
+        double delta = v - mean;
+        mean += delta/n;
+        m2 += delta*(v - mean);
+    }
+};
+
+
+struct p2_quantile {
+    /**
+    Running estimate of a quantile with the P^2 algorithm (Jain and Chlamtac
+    1985), which keeps five markers instead of all of the observations.
+    */
+    double q;
+    int n;
+    double h[5]; // marker heights
+    double pos[5]; // actual marker positions
+    double want[5]; // desired marker positions
+
+    p2_quantile(double q) : q(q), n(0) {}
+
+    void add(double v) {
+        if (n < 5) {
+            h[n] = v;
+            n += 1;
+            if (n == 5) {
+                sort(h, h+5);
+                for (int i = 0; i < 5; i++) {
+                    pos[i] = i + 1;
+                }
+                want[0] = 1;
+                want[1] = 1 + 2*q;
+                want[2] = 1 + 4*q;
+                want[3] = 3 + 2*q;
+                want[4] = 5;
+            }
+            return;
+        }
+        n += 1;
+
+        int k;
+        if (v < h[0]) {
+            h[0] = v;
+            k = 0;
+        }
+        else if (v >= h[4]) {
+            h[4] = v;
+            k = 3;
+        }
+        else {
+            k = 0;
+            while (v >= h[k+1]) {
+                k += 1;
+            }
+        }
+        for (int i = k+1; i < 5; i++) {
+            pos[i] += 1;
+        }
+        want[1] += q/2;
+        want[2] += q;
+        want[3] += (1 + q)/2;
+        want[4] += 1;
+
+        // move the middle markers towards their desired positions
+        for (int i = 1; i < 4; i++) {
+            double d = want[i] - pos[i];
+            if ((d >= 1 && pos[i+1] - pos[i] > 1) || (d <= -1 && pos[i-1] - pos[i] < -1)) {
+                int ds = (d > 0) ? 1 : -1;
+                double hp = h[i] + ds/(pos[i+1] - pos[i-1])*((pos[i] - pos[i-1] + ds)*(h[i+1] - h[i])/(pos[i+1] - pos[i])
+                    + (pos[i+1] - pos[i] - ds)*(h[i] - h[i-1])/(pos[i] - pos[i-1]));
+                if (h[i-1] < hp && hp < h[i+1]) {
+                    h[i] = hp;
+                }
+                else {
+                    h[i] += ds*(h[i+ds] - h[i])/(pos[i+ds] - pos[i]);
+                }
+                pos[i] += ds;
+            }
+        }
+    }
+
+    double value() const {
+        if (n >= 5) {
+            return h[2];
+        }
+        if (n == 0) {
+            return numeric_limits<double>::quiet_NaN();
+        }
+        // too few observations for the markers, so interpolate between them
+        double v[5];
+        copy(h, h+n, v);
+        sort(v, v+n);
+        if (n == 1) {
+            return v[0];
+        }
+        double r = q*(n - 1);
+        int i = min((int)r, n - 2);
+        return v[i] + (r - i)*(v[i+1] - v[i]);
+    }
+};
+
+
+ensemble_result pcsaft_ensemble_cpp(const vector<double> &params, int nsets, const vector<double> &x,
+    const vector<double> &t, const vector<double> &p, const vector<int> &phase,
+    const vector<double> &quantiles, add_args &cppargs) {
+    /**
+    Calculate statistics of the density and the fugacity coefficients of a
+    mixture at several states for an ensemble of parameter sets, e.g. for the
+    propagation of the uncertainty of the parameters.
+
+    The parameter sets are processed in packs of PACK_SIZE, which are
+    evaluated together with the batch kernels, one parameter set per entry of
+    the pack. The setup of a pack is shared by all states, and the states are
+    evaluated in parallel with OpenMP when the code is compiled with OpenMP
+    support. The results of each parameter set are added to running
+    statistics (Welford's algorithm for the mean and variance, and the P^2
+    algorithm for the quantiles), so memory use does not grow with the number
+    of parameter sets, and the results do not depend on the number of threads.
+
+    Parameters
+    ----------
+    params : vector<double>, shape (nsets*r,)
+        The parameter sets, one row of r values per set: m, s (Angstrom) and e
+        (K) of each component, optionally followed by k_ij for i < j (the
+        strict upper triangle, row by row). If k_ij are not given they are
+        taken from cppargs.
+    nsets : int
+        Number of parameter sets.
+    x : vector<double>, shape (n,)
+        Mole fractions of each component.
+    t : vector<double>, shape (k,)
+        Temperature of each state (K)
+    p : vector<double>, shape (k,)
+        Pressure of each state (Pa)
+    phase : vector<int>, shape (k,)
+        Phase of each state: 0 (liquid) or 1 (vapor).
+    quantiles : vector<double>, shape (q,)
+        The quantiles to estimate, between 0 and 1 (e.g. 0.05, 0.5, 0.95).
+    cppargs : add_args
+        A struct containing additional arguments that are the same for all
+        parameter sets (see pcsaft_Z_cpp).
+
+    Returns
+    -------
+    result : ensemble_result
+        Mean, sample variance and quantiles of the density (mol m^-3) and of
+        ln(phi_i) of each component, for each state (see ensemble_result in
+        pcsaft.h). Parameter sets for which a property is not finite are
+        left out of its statistics.
+    */
+    int ncomp = x.size();
+    int nstates = t.size();
+    int nprop = ncomp + 1;
+    int nq = quantiles.size();
+    int row = (nsets > 0) ? params.size()/nsets : 0;
+    bool with_kij = row > 3*ncomp;
+    bool vectorized = batch_supported(cppargs);
+
+    vector<running_stats> stats(nstates*nprop);
+    vector<p2_quantile> est;
+    est.reserve(nstates*nprop*nq);
+    for (int k = 0; k < nstates*nprop; k++) {
+        for (int iq = 0; iq < nq; iq++) {
+            est.push_back(p2_quantile(quantiles[iq]));
+        }
+    }
+
+    for (int start = 0; start < nsets; start += PACK_SIZE) {
+        int n = min(PACK_SIZE, nsets - start);
+
+        // parameters of each set in the pack, and the same parameters with
+        // one entry per set for the batch kernels
+        vector<vector<double> > mv(n), sv(n), ev(n);
+        vector<add_args> args(n, cppargs);
+        vector<batch_mixture> bms(n);
+        vector<ArrayXd> m_pack(ncomp, ArrayXd(n)), s_pack(ncomp, ArrayXd(n)), e_pack(ncomp, ArrayXd(n));
+        for (int l = 0; l < n; l++) {
+            const double *r = &params[(start+l)*row];
+            mv[l].assign(r, r + ncomp);
+            sv[l].assign(r + ncomp, r + 2*ncomp);
+            ev[l].assign(r + 2*ncomp, r + 3*ncomp);
+            if (with_kij) {
+                args[l].k_ij.assign(ncomp*(ncomp+1)/2, 0.);
+                int idx = 3*ncomp;
+                for (int i = 0; i < ncomp; i++) {
+                    for (int j = i+1; j < ncomp; j++) {
+                        args[l].k_ij[sym_idx(i, j, ncomp)] = r[idx++];
+                    }
+                }
+            }
+            for (int i = 0; i < ncomp; i++) {
+                m_pack[i][l] = mv[l][i];
+                s_pack[i][l] = sv[l][i];
+                e_pack[i][l] = ev[l][i];
+            }
+            if (vectorized) {
+                bms[l] = batch_setup(x, mv[l], sv[l], ev[l], args[l]);
+            }
+        }
+        batch_mixture_t<ArrayXd> bm;
+        if (vectorized) {
+            bm = batch_gather(bms);
+        }
+
+        #pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < nstates; k++) {
+            ArrayXd rho, Z;
+            ArrayXXd lnfugcoef(n, ncomp);
+            if (vectorized) {
+                ArrayXd tk = ArrayXd::Constant(n, t[k]);
+                Array<bool, Dynamic, 1> ok;
+                batch_den_pack(bm, x, m_pack, s_pack, e_pack, tk, ArrayXd::Constant(n, p[k]), phase[k],
+                    cppargs, rho, ok);
+                for (int l = 0; l < n; l++) {
+                    if (!ok[l]) {
+                        rho[l] = pcsaft_den_cpp(x, mv[l], sv[l], ev[l], t[k], p[k], phase[k], args[l]);
+                    }
+                }
+                batch_pack(bm, x, m_pack, s_pack, e_pack, tk, rho, cppargs, Z, &lnfugcoef);
+            }
+            else {
+                rho.resize(n);
+                vector<double> fugcoef;
+                for (int l = 0; l < n; l++) {
+                    rho[l] = pcsaft_den_cpp(x, mv[l], sv[l], ev[l], t[k], p[k], phase[k], args[l]);
+                    fugcoef = pcsaft_fugcoef_cpp(x, mv[l], sv[l], ev[l], t[k], rho[l], args[l]);
+                    for (int i = 0; i < ncomp; i++) {
+                        lnfugcoef(l, i) = log(fugcoef[i]);
+                    }
+                }
+            }
+
+            double v;
+            for (int l = 0; l < n; l++) {
+                for (int j = 0; j < nprop; j++) {
+                    v = (j == 0) ? rho[l] : lnfugcoef(l, j-1);
+                    if (!isfinite(v)) {
+                        continue;
+                    }
+                    stats[k*nprop+j].add(v);
+                    for (int iq = 0; iq < nq; iq++) {
+                        est[(k*nprop+j)*nq+iq].add(v);
+                    }
+                }
+            }
+        }
+    }
+
+    ensemble_result res;
+    res.mean.resize(nstates*nprop);
+    res.var.resize(nstates*nprop);
+    res.count.resize(nstates*nprop);
+    res.quantiles.resize(nstates*nprop*nq);
+    for (int k = 0; k < nstates*nprop; k++) {
+        res.count[k] = stats[k].n;
+        res.mean[k] = (stats[k].n > 0) ? stats[k].mean : numeric_limits<double>::quiet_NaN();
+        res.var[k] = (stats[k].n > 1) ? stats[k].m2/(stats[k].n - 1) : numeric_limits<double>::quiet_NaN();
+        for (int iq = 0; iq < nq; iq++) {
+            res.quantiles[k*nq+iq] = est[k*nq+iq].value();
+        }
+    }
+    return res;
+}
@@ -0,0 +1,820 @@
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+
+#include "pcsaft_internal.h"
+#include "pcsaft_c.h"
+
+using namespace std;
+
+/*
+Implementation of the C interface declared in pcsaft_c.h.
+
+The handle owns copies of the parameters in the form used by the C++
+functions, so a call only converts the state and the composition. Each
+public function checks its arguments, and catches every exception: the
+core does not throw, so the only exceptions are failed allocations.
+*/
+
+struct pcsaft_mixture {
+    vector<double> m, s, e;
+    mutable add_args cppargs; // the C++ functions take a non-const reference, but do not modify it
+    mutable eos_cache cache; // disabled unless pcsaft_mixture_set_cache is called
+    mixing_cache mixing; // attached to cppargs, updated by the functions that change k_ij, l_ij, dipoles or charges
+};
+
+struct pcsaft_db {
+    param_db db;
+    ~pcsaft_db() {param_db_close_cpp(db);}
+};
+
+const static int C_BATCH_CHUNK = 256; // states per task of the batch functions with a shared composition
+
+
+static bool finite_array(const double *v, int n) {
+    for (int i = 0; i < n; i++) {
+        if (!isfinite(v[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+static int check_state(double t, double p) {
+    return (isfinite(t) && t > 0 && isfinite(p) && p > 0) ? PCSAFT_OK : PCSAFT_ERR_ARGUMENT;
+}
+
+
+static int read_composition(const pcsaft_mixture *mix, const double *x, vector<double> &xv) {
+    /**Copy a composition, which must be non-negative with a positive sum, normalized to a sum of 1.*/
+    int ncomp = mix->m.size();
+    double sum = 0.;
+    for (int i = 0; i < ncomp; i++) {
+        if (!(x[i] >= 0) || !isfinite(x[i])) {
+            return PCSAFT_ERR_ARGUMENT;
+        }
+        sum += x[i];
+    }
+    if (!(sum > 0)) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    xv.resize(ncomp);
+    for (int i = 0; i < ncomp; i++) {
+        xv[i] = x[i]/sum;
+    }
+    return PCSAFT_OK;
+}
+
+
+static int set_vector(const double *values, int n, vector<double> &target) {
+    if (values == NULL) {
+        target.clear();
+        return PCSAFT_OK;
+    }
+    if (!finite_array(values, n)) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    target.assign(values, values + n);
+    return PCSAFT_OK;
+}
+
+
+static int set_pair_matrix(const double *values, int n, vector<double> &target) {
+    // only one of (i, j) and (j, i) is used, so an asymmetric matrix is
+    // rejected with the tolerance of np.allclose in the Python interface
+    if (values != NULL) {
+        for (int i = 0; i < n; i++) {
+            for (int j = i+1; j < n; j++) {
+                double a = values[i*n+j];
+                double b = values[j*n+i];
+                if (fabs(a - b) > 1e-8 + 1e-5*fabs(b)) {
+                    return PCSAFT_ERR_ARGUMENT;
+                }
+            }
+        }
+    }
+    return set_vector(values, n*n, target);
+}
+
+
+static int update_mixing(pcsaft_mixture *mix, int status) {
+    mixing_cache_setup_cpp(mix->m, mix->s, mix->e, mix->cppargs, mix->mixing);
+    return status;
+}
+
+
+static int density_state(const pcsaft_mixture *mix, double t, double p, const vector<double> &x, int phase,
+    double &rho) {
+    rho = pcsaft_den_cached_cpp(x, mix->m, mix->s, mix->e, t, p, phase, mix->cppargs, mix->cache);
+    return (isfinite(rho) && rho > 0) ? PCSAFT_OK : PCSAFT_ERR_NOT_CONVERGED;
+}
+
+
+static int fugacity_state(const pcsaft_mixture *mix, double t, double p, const vector<double> &x, int phase,
+    double *fugcoef, double &rho) {
+    int status = density_state(mix, t, p, x, phase, rho);
+    if (status != PCSAFT_OK) {
+        return status;
+    }
+    vector<double> phi = pcsaft_fugcoef_cached_cpp(x, mix->m, mix->s, mix->e, t, rho, mix->cppargs, mix->cache);
+    copy(phi.begin(), phi.end(), fugcoef);
+    return finite_array(fugcoef, phi.size()) ? PCSAFT_OK : PCSAFT_ERR_NOT_CONVERGED;
+}
+
+
+static int residual_state(const pcsaft_mixture *mix, double t, double p, const vector<double> &x, int phase,
+    double *res, double &rho) {
+    int status = density_state(mix, t, p, x, phase, rho);
+    if (status != PCSAFT_OK) {
+        return status;
+    }
+    res[0] = pcsaft_hres_cpp(x, mix->m, mix->s, mix->e, t, rho, mix->cppargs);
+    res[1] = pcsaft_sres_cpp(x, mix->m, mix->s, mix->e, t, rho, mix->cppargs);
+    res[2] = pcsaft_gres_cpp(x, mix->m, mix->s, mix->e, t, rho, mix->cppargs);
+    return finite_array(res, 3) ? PCSAFT_OK : PCSAFT_ERR_NOT_CONVERGED;
+}
+
+
+static int flash_state(const pcsaft_mixture *mix, double t, double p, const vector<double> &z, double &beta,
+    double *x_out, double *y_out, double *rho_out) {
+    /**Isothermal flash of a normalized feed with pcsaft_flash_cpp.*/
+    int ncomp = z.size();
+    vector<double> K;
+    double rho_l = 0., rho_v = 0.;
+    beta = 0.5;
+    if (!pcsaft_flash_cpp(p, t, z, mix->m, mix->s, mix->e, mix->cppargs, K, beta, rho_l, rho_v)) {
+        return PCSAFT_ERR_NOT_CONVERGED;
+    }
+    if (beta == 0 || beta == 1) {
+        // a single phase, whose compositions are the feed
+        copy(z.begin(), z.end(), x_out);
+        copy(z.begin(), z.end(), y_out);
+        rho_l = rho_v = (beta == 0) ? rho_l : rho_v;
+    }
+    else {
+        for (int i = 0; i < ncomp; i++) {
+            x_out[i] = z[i]/(1 + beta*(K[i] - 1));
+            y_out[i] = K[i]*x_out[i];
+        }
+    }
+    if (rho_out != NULL) {
+        rho_out[0] = rho_l;
+        rho_out[1] = rho_v;
+    }
+    bool finite = isfinite(beta) && isfinite(rho_l) && isfinite(rho_v) && finite_array(x_out, ncomp) &&
+        finite_array(y_out, ncomp);
+    return finite ? PCSAFT_OK : PCSAFT_ERR_NOT_CONVERGED;
+}
+
+
+static int batch_status(int n, const vector<int> &st, int *status) {
+    /**Copy the status of each state, and return the first failure.*/
+    int first = PCSAFT_OK;
+    for (int k = 0; k < n; k++) {
+        if (status != NULL) {
+            status[k] = st[k];
+        }
+        if (first == PCSAFT_OK) {
+            first = st[k];
+        }
+    }
+    return first;
+}
+
+
+extern "C" {
+
+int pcsaft_api_version(void) {
+    return PCSAFT_C_API_VERSION;
+}
+
+
+const char *pcsaft_status_string(int status) {
+    switch (status) {
+        case PCSAFT_OK: return "success";
+        case PCSAFT_ERR_NULL: return "a required pointer is NULL";
+        case PCSAFT_ERR_ARGUMENT: return "an argument is out of range";
+        case PCSAFT_ERR_NOT_CONVERGED: return "the solver did not converge";
+        case PCSAFT_ERR_MEMORY: return "memory could not be allocated";
+        case PCSAFT_ERR_FILE: return "the file cannot be read or has an invalid format";
+    }
+    return "unknown status";
+}
+
+
+int pcsaft_mixture_create(int ncomp, const double *m, const double *s, const double *e, pcsaft_mixture **mix) {
+    if (mix == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    *mix = NULL;
+    if (m == NULL || s == NULL || e == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    if (ncomp < 1) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    for (int i = 0; i < ncomp; i++) {
+        if (!(m[i] > 0 && s[i] > 0 && e[i] >= 0) || !isfinite(m[i]) || !isfinite(s[i]) || !isfinite(e[i])) {
+            return PCSAFT_ERR_ARGUMENT;
+        }
+    }
+    try {
+        pcsaft_mixture *created = new pcsaft_mixture();
+        created->m.assign(m, m + ncomp);
+        created->s.assign(s, s + ncomp);
+        created->e.assign(e, e + ncomp);
+        created->cppargs.dielc = 0.;
+        update_mixing(created, PCSAFT_OK);
+        *mix = created;
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+    return PCSAFT_OK;
+}
+
+
+void pcsaft_mixture_destroy(pcsaft_mixture *mix) {
+    delete mix;
+}
+
+
+int pcsaft_mixture_ncomp(const pcsaft_mixture *mix) {
+    return (mix == NULL) ? 0 : (int)mix->m.size();
+}
+
+
+int pcsaft_mixture_set_kij(pcsaft_mixture *mix, const double *k_ij) {
+    if (mix == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    int ncomp = mix->m.size();
+    try {
+        return update_mixing(mix, set_pair_matrix(k_ij, ncomp, mix->cppargs.k_ij));
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_mixture_set_lij(pcsaft_mixture *mix, const double *l_ij) {
+    if (mix == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    int ncomp = mix->m.size();
+    try {
+        return update_mixing(mix, set_pair_matrix(l_ij, ncomp, mix->cppargs.l_ij));
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_mixture_set_khb(pcsaft_mixture *mix, const double *k_hb) {
+    if (mix == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    int ncomp = mix->m.size();
+    try {
+        return set_pair_matrix(k_hb, ncomp, mix->cppargs.k_hb);
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_mixture_set_association(pcsaft_mixture *mix, const double *e_assoc, const double *vol_a) {
+    if (mix == NULL || (e_assoc == NULL) != (vol_a == NULL)) {
+        return PCSAFT_ERR_NULL;
+    }
+    int ncomp = mix->m.size();
+    if (e_assoc != NULL && (!finite_array(e_assoc, ncomp) || !finite_array(vol_a, ncomp))) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        set_vector(e_assoc, ncomp, mix->cppargs.e_assoc);
+        set_vector(vol_a, ncomp, mix->cppargs.vol_a);
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+    return PCSAFT_OK;
+}
+
+
+int pcsaft_mixture_set_dipole(pcsaft_mixture *mix, const double *dipm, const double *dip_num) {
+    if (mix == NULL || (dipm == NULL) != (dip_num == NULL)) {
+        return PCSAFT_ERR_NULL;
+    }
+    int ncomp = mix->m.size();
+    if (dipm != NULL && (!finite_array(dipm, ncomp) || !finite_array(dip_num, ncomp))) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        set_vector(dipm, ncomp, mix->cppargs.dipm);
+        set_vector(dip_num, ncomp, mix->cppargs.dip_num);
+        update_mixing(mix, PCSAFT_OK);
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+    return PCSAFT_OK;
+}
+
+
+int pcsaft_mixture_set_ions(pcsaft_mixture *mix, const double *z, double dielc) {
+    if (mix == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    if (z != NULL && !(dielc > 0 && isfinite(dielc))) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        int status = set_vector(z, mix->m.size(), mix->cppargs.z);
+        mix->cppargs.dielc = (z != NULL && status == PCSAFT_OK) ? dielc : 0.;
+        return update_mixing(mix, status);
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_mixture_set_dielectric(pcsaft_mixture *mix, const int *dielc_model, const double *dielc_coef) {
+    if (mix == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    int ncomp = mix->m.size();
+    if (dielc_model == NULL) {
+        mix->cppargs.dielc_model.clear();
+        mix->cppargs.dielc_coef.clear();
+        return PCSAFT_OK;
+    }
+    for (int i = 0; i < ncomp; i++) {
+        if (dielc_model[i] < 0 || dielc_model[i] > 2) {
+            return PCSAFT_ERR_ARGUMENT;
+        }
+        if (dielc_model[i] == 2 && dielc_coef == NULL) {
+            return PCSAFT_ERR_NULL;
+        }
+    }
+    if (dielc_coef != NULL && !finite_array(dielc_coef, ncomp*3)) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        mix->cppargs.dielc_model.assign(dielc_model, dielc_model + ncomp);
+        if (dielc_coef != NULL) {
+            mix->cppargs.dielc_coef.assign(dielc_coef, dielc_coef + ncomp*3);
+        }
+        else {
+            mix->cppargs.dielc_coef.assign(ncomp*3, 0.);
+        }
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+    return PCSAFT_OK;
+}
+
+
+int pcsaft_db_open(const char *path, pcsaft_db **db) {
+    if (path == NULL || db == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    *db = NULL;
+    try {
+        pcsaft_db *opened = new pcsaft_db();
+        if (!param_db_open_cpp(path, opened->db)) {
+            delete opened;
+            return PCSAFT_ERR_FILE;
+        }
+        *db = opened;
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+    return PCSAFT_OK;
+}
+
+
+void pcsaft_db_close(pcsaft_db *db) {
+    delete db;
+}
+
+
+int pcsaft_db_ncomp(const pcsaft_db *db) {
+    return (db == NULL) ? 0 : db->db.ncomp;
+}
+
+
+int pcsaft_db_find(const pcsaft_db *db, const char *name) {
+    if (db == NULL || name == NULL) {
+        return -1;
+    }
+    try {
+        return param_db_find_cpp(db->db, name);
+    }
+    catch (...) {
+        return -1;
+    }
+}
+
+
+const char *pcsaft_db_name(const pcsaft_db *db, int id) {
+    return (db == NULL) ? NULL : param_db_name_cpp(db->db, id);
+}
+
+
+int pcsaft_db_mixture(const pcsaft_db *db, int ncomp, const int *ids, pcsaft_mixture **mix) {
+    if (mix == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    *mix = NULL;
+    if (db == NULL || ids == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    if (ncomp < 1) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        vector<double> m, s, e;
+        add_args cppargs;
+        if (!param_db_mixture_cpp(db->db, vector<int>(ids, ids + ncomp), m, s, e, cppargs)) {
+            return PCSAFT_ERR_ARGUMENT;
+        }
+        // the checks of the parameters of pcsaft_mixture_create also apply to the database
+        int status = pcsaft_mixture_create(ncomp, &m[0], &s[0], &e[0], mix);
+        if (status == PCSAFT_OK) {
+            (*mix)->cppargs = cppargs;
+            update_mixing(*mix, PCSAFT_OK);
+        }
+        return status;
+    }
+    catch (...) {
+        pcsaft_mixture_destroy(*mix);
+        *mix = NULL;
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_mixture_set_cache(pcsaft_mixture *mix, long capacity) {
+    if (mix == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    if (capacity < 0) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    eos_cache_resize_cpp(mix->cache, capacity);
+    return PCSAFT_OK;
+}
+
+
+int pcsaft_mixture_cache_stats(const pcsaft_mixture *mix, long *hits, long *misses, long *size) {
+    if (mix == NULL || hits == NULL || misses == NULL || size == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    eos_cache_stats stats = eos_cache_stats_cpp(mix->cache);
+    *hits = stats.hits;
+    *misses = stats.misses;
+    *size = stats.size;
+    return PCSAFT_OK;
+}
+
+
+int pcsaft_density(const pcsaft_mixture *mix, double t, double p, const double *x, int phase, double *rho) {
+    if (mix == NULL || x == NULL || rho == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    if (phase != PCSAFT_LIQUID && phase != PCSAFT_VAPOR) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        vector<double> xv;
+        int status = check_state(t, p);
+        if (status == PCSAFT_OK) {
+            status = read_composition(mix, x, xv);
+        }
+        if (status == PCSAFT_OK) {
+            status = density_state(mix, t, p, xv, phase, *rho);
+        }
+        return status;
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_fugacity(const pcsaft_mixture *mix, double t, double p, const double *x, int phase,
+    double *fugcoef, double *rho) {
+    if (mix == NULL || x == NULL || fugcoef == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    if (phase != PCSAFT_LIQUID && phase != PCSAFT_VAPOR) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        vector<double> xv;
+        double rho_state;
+        int status = check_state(t, p);
+        if (status == PCSAFT_OK) {
+            status = read_composition(mix, x, xv);
+        }
+        if (status == PCSAFT_OK) {
+            status = fugacity_state(mix, t, p, xv, phase, fugcoef, rho_state);
+            if (rho != NULL) {
+                *rho = rho_state;
+            }
+        }
+        return status;
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_residual(const pcsaft_mixture *mix, double t, double p, const double *x, int phase,
+    double *res, double *rho) {
+    if (mix == NULL || x == NULL || res == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    if (phase != PCSAFT_LIQUID && phase != PCSAFT_VAPOR) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        vector<double> xv;
+        double rho_state;
+        int status = check_state(t, p);
+        if (status == PCSAFT_OK) {
+            status = read_composition(mix, x, xv);
+        }
+        if (status == PCSAFT_OK) {
+            status = residual_state(mix, t, p, xv, phase, res, rho_state);
+            if (rho != NULL) {
+                *rho = rho_state;
+            }
+        }
+        return status;
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_flash(const pcsaft_mixture *mix, double t, double p, const double *z, double *beta,
+    double *x, double *y, double *rho) {
+    if (mix == NULL || z == NULL || beta == NULL || x == NULL || y == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    try {
+        vector<double> zv;
+        int status = check_state(t, p);
+        if (status == PCSAFT_OK) {
+            status = read_composition(mix, z, zv);
+        }
+        if (status == PCSAFT_OK) {
+            status = flash_state(mix, t, p, zv, *beta, x, y, rho);
+        }
+        return status;
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_density_batch(const pcsaft_mixture *mix, int n, const double *t, const double *p,
+    const double *x, int x_stride, int phase, double *rho, int *status) {
+    if (mix == NULL || t == NULL || p == NULL || x == NULL || rho == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    int ncomp = mix->m.size();
+    if (n < 0 || (x_stride != 0 && x_stride < ncomp) || (phase != PCSAFT_LIQUID && phase != PCSAFT_VAPOR)) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        vector<int> st(n);
+        if (x_stride == 0 && mix->cache.capacity == 0) {
+            // one composition: chunks of states are solved together by the vectorized batch solver,
+            // unless the states are looked up in the cache one by one
+            vector<double> xv;
+            int status_x = read_composition(mix, x, xv);
+            int nchunk = (n + C_BATCH_CHUNK - 1)/C_BATCH_CHUNK;
+            #pragma omp parallel for schedule(dynamic)
+            for (int c = 0; c < nchunk; c++) {
+                try {
+                    vector<int> idx;
+                    vector<double> tk, pk;
+                    for (int k = c*C_BATCH_CHUNK; k < min(n, (c + 1)*C_BATCH_CHUNK); k++) {
+                        st[k] = (status_x != PCSAFT_OK) ? status_x : check_state(t[k], p[k]);
+                        if (st[k] == PCSAFT_OK) {
+                            idx.push_back(k);
+                            tk.push_back(t[k]);
+                            pk.push_back(p[k]);
+                        }
+                    }
+                    vector<double> rk = pcsaft_den_batch_cpp(xv, mix->m, mix->s, mix->e, tk, pk, phase,
+                        mix->cppargs);
+                    for (size_t j = 0; j < idx.size(); j++) {
+                        rho[idx[j]] = rk[j];
+                        st[idx[j]] = (isfinite(rk[j]) && rk[j] > 0) ? PCSAFT_OK : PCSAFT_ERR_NOT_CONVERGED;
+                    }
+                }
+                catch (...) {
+                    for (int k = c*C_BATCH_CHUNK; k < min(n, (c + 1)*C_BATCH_CHUNK); k++) {
+                        st[k] = PCSAFT_ERR_MEMORY;
+                    }
+                }
+            }
+        }
+        else {
+            #pragma omp parallel for schedule(dynamic)
+            for (int k = 0; k < n; k++) {
+                try {
+                    vector<double> xv;
+                    st[k] = check_state(t[k], p[k]);
+                    if (st[k] == PCSAFT_OK) {
+                        st[k] = read_composition(mix, x + (size_t)k*x_stride, xv);
+                    }
+                    if (st[k] == PCSAFT_OK) {
+                        st[k] = density_state(mix, t[k], p[k], xv, phase, rho[k]);
+                    }
+                }
+                catch (...) {
+                    st[k] = PCSAFT_ERR_MEMORY;
+                }
+            }
+        }
+        return batch_status(n, st, status);
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_fugacity_batch(const pcsaft_mixture *mix, int n, const double *t, const double *p,
+    const double *x, int x_stride, int phase, double *fugcoef, double *rho, int *status) {
+    if (mix == NULL || t == NULL || p == NULL || x == NULL || fugcoef == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    int ncomp = mix->m.size();
+    if (n < 0 || (x_stride != 0 && x_stride < ncomp) || (phase != PCSAFT_LIQUID && phase != PCSAFT_VAPOR)) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        vector<int> st(n);
+        if (x_stride == 0 && mix->cache.capacity == 0) {
+            vector<double> xv;
+            int status_x = read_composition(mix, x, xv);
+            int nchunk = (n + C_BATCH_CHUNK - 1)/C_BATCH_CHUNK;
+            #pragma omp parallel for schedule(dynamic)
+            for (int c = 0; c < nchunk; c++) {
+                try {
+                    vector<int> idx;
+                    vector<double> tk, pk;
+                    for (int k = c*C_BATCH_CHUNK; k < min(n, (c + 1)*C_BATCH_CHUNK); k++) {
+                        st[k] = (status_x != PCSAFT_OK) ? status_x : check_state(t[k], p[k]);
+                        if (st[k] == PCSAFT_OK) {
+                            idx.push_back(k);
+                            tk.push_back(t[k]);
+                            pk.push_back(p[k]);
+                        }
+                    }
+                    vector<double> rk = pcsaft_den_batch_cpp(xv, mix->m, mix->s, mix->e, tk, pk, phase,
+                        mix->cppargs);
+                    vector<double> lnphi = pcsaft_lnfugcoef_batch_cpp(xv, mix->m, mix->s, mix->e, tk, rk,
+                        mix->cppargs);
+                    for (size_t j = 0; j < idx.size(); j++) {
+                        int k = idx[j];
+                        double *phi = fugcoef + (size_t)k*ncomp;
+                        for (int i = 0; i < ncomp; i++) {
+                            phi[i] = exp(lnphi[j*ncomp+i]);
+                        }
+                        if (rho != NULL) {
+                            rho[k] = rk[j];
+                        }
+                        bool ok = isfinite(rk[j]) && rk[j] > 0 && finite_array(phi, ncomp);
+                        st[k] = ok ? PCSAFT_OK : PCSAFT_ERR_NOT_CONVERGED;
+                    }
+                }
+                catch (...) {
+                    for (int k = c*C_BATCH_CHUNK; k < min(n, (c + 1)*C_BATCH_CHUNK); k++) {
+                        st[k] = PCSAFT_ERR_MEMORY;
+                    }
+                }
+            }
+        }
+        else {
+            #pragma omp parallel for schedule(dynamic)
+            for (int k = 0; k < n; k++) {
+                try {
+                    vector<double> xv;
+                    double rho_state;
+                    st[k] = check_state(t[k], p[k]);
+                    if (st[k] == PCSAFT_OK) {
+                        st[k] = read_composition(mix, x + (size_t)k*x_stride, xv);
+                    }
+                    if (st[k] == PCSAFT_OK) {
+                        st[k] = fugacity_state(mix, t[k], p[k], xv, phase, fugcoef + (size_t)k*ncomp, rho_state);
+                        if (rho != NULL) {
+                            rho[k] = rho_state;
+                        }
+                    }
+                }
+                catch (...) {
+                    st[k] = PCSAFT_ERR_MEMORY;
+                }
+            }
+        }
+        return batch_status(n, st, status);
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_residual_batch(const pcsaft_mixture *mix, int n, const double *t, const double *p,
+    const double *x, int x_stride, int phase, double *res, double *rho, int *status) {
+    if (mix == NULL || t == NULL || p == NULL || x == NULL || res == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    int ncomp = mix->m.size();
+    if (n < 0 || (x_stride != 0 && x_stride < ncomp) || (phase != PCSAFT_LIQUID && phase != PCSAFT_VAPOR)) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        vector<int> st(n);
+        #pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < n; k++) {
+            try {
+                vector<double> xv;
+                double rho_state;
+                st[k] = check_state(t[k], p[k]);
+                if (st[k] == PCSAFT_OK) {
+                    st[k] = read_composition(mix, x + (size_t)k*x_stride, xv);
+                }
+                if (st[k] == PCSAFT_OK) {
+                    st[k] = residual_state(mix, t[k], p[k], xv, phase, res + 3*(size_t)k, rho_state);
+                    if (rho != NULL) {
+                        rho[k] = rho_state;
+                    }
+                }
+            }
+            catch (...) {
+                st[k] = PCSAFT_ERR_MEMORY;
+            }
+        }
+        return batch_status(n, st, status);
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+
+int pcsaft_flash_batch(const pcsaft_mixture *mix, int n, const double *t, const double *p,
+    const double *z, int z_stride, double *beta, double *x, double *y, double *rho, int *status) {
+    if (mix == NULL || t == NULL || p == NULL || z == NULL || beta == NULL || x == NULL || y == NULL) {
+        return PCSAFT_ERR_NULL;
+    }
+    int ncomp = mix->m.size();
+    if (n < 0 || (z_stride != 0 && z_stride < ncomp)) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    try {
+        vector<int> st(n);
+        #pragma omp parallel for schedule(dynamic)
+        for (int k = 0; k < n; k++) {
+            try {
+                vector<double> zv;
+                st[k] = check_state(t[k], p[k]);
+                if (st[k] == PCSAFT_OK) {
+                    st[k] = read_composition(mix, z + (size_t)k*z_stride, zv);
+                }
+                if (st[k] == PCSAFT_OK) {
+                    st[k] = flash_state(mix, t[k], p[k], zv, beta[k], x + (size_t)k*ncomp, y + (size_t)k*ncomp,
+                        (rho != NULL) ? rho + 2*(size_t)k : NULL);
+                }
+            }
+            catch (...) {
+                st[k] = PCSAFT_ERR_MEMORY;
+            }
+        }
+        return batch_status(n, st, status);
+    }
+    catch (...) {
+        return PCSAFT_ERR_MEMORY;
+    }
+}
+
+}
@@ -0,0 +1,183 @@
+#ifndef PCSAFT_C_H
+#define PCSAFT_C_H
+
+/*
+C interface of the library, for embedding PC-SAFT in process simulators and
+other programs written in C, Fortran (through iso_c_binding) or any language
+with a C foreign function interface.
+
+A mixture is created once with pcsaft_mixture_create and the optional
+parameters are set on the opaque handle. The handle is then passed to the
+calculations. Only plain C types cross the interface: arrays are passed as
+pointers to memory owned by the caller, and the results are written to
+output arrays of the documented size that the caller provides. Every
+function returns a status code (PCSAFT_OK on success) and no exception or
+C++ type leaves the library.
+
+Arrays of a pair parameter (k_ij, l_ij, k_hb) are dense ncomp x ncomp
+matrices in row-major order. Compositions are mole fractions, and are
+normalized if they do not sum to 1 (e.g. amounts of substance). Units are K,
+Pa and mol m^-3 throughout.
+
+A handle may be used by several threads at the same time for calculations,
+but must not be modified (pcsaft_mixture_set_*) or destroyed while it is
+in use.
+*/
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Version of this interface. It changes only when existing declarations change. */
+#define PCSAFT_C_API_VERSION 1
+
+/* Status codes */
+#define PCSAFT_OK 0
+#define PCSAFT_ERR_NULL 1            /* a required pointer (handle, input or output) is NULL */
+#define PCSAFT_ERR_ARGUMENT 2        /* an argument is out of range, e.g. ncomp < 1, t <= 0 or a NaN input */
+#define PCSAFT_ERR_NOT_CONVERGED 3   /* a solver did not converge, or the result is not finite */
+#define PCSAFT_ERR_MEMORY 4          /* memory could not be allocated */
+#define PCSAFT_ERR_FILE 5            /* a file cannot be read or has an invalid format */
+
+/* Phases */
+#define PCSAFT_LIQUID 0
+#define PCSAFT_VAPOR 1
+
+typedef struct pcsaft_mixture pcsaft_mixture;
+typedef struct pcsaft_db pcsaft_db;
+
+/* Return PCSAFT_C_API_VERSION of the library, to check it against the header. */
+int pcsaft_api_version(void);
+
+/* Return a static description of a status code. */
+const char *pcsaft_status_string(int status);
+
+/*
+Create a mixture of ncomp components with the segment number m, the segment
+diameter s (Angstrom) and the dispersion energy e (K) of each component.
+The handle is written to *mix and is released with pcsaft_mixture_destroy.
+*/
+int pcsaft_mixture_create(int ncomp, const double *m, const double *s, const double *e, pcsaft_mixture **mix);
+
+/* Release a mixture. NULL is ignored. */
+void pcsaft_mixture_destroy(pcsaft_mixture *mix);
+
+/* Return the number of components of a mixture, or 0 for NULL. */
+int pcsaft_mixture_ncomp(const pcsaft_mixture *mix);
+
+/*
+Optional parameters. Each function replaces the previous values; NULL
+removes the parameter again.
+
+k_ij, l_ij, k_hb : binary interaction parameters of the dispersion energy,
+    the segment diameter and the association, (ncomp*ncomp), symmetric
+    (PCSAFT_ERR_ARGUMENT otherwise)
+e_assoc, vol_a : association energy (K) and effective association volume of
+    each component, 0 for non-associating components, (ncomp)
+dipm, dip_num : dipole moment (Debye) and number of dipolar groups of each
+    component, (ncomp)
+z : charge of each component, 0 for molecules, (ncomp), with the relative
+    permittivity dielc of the solvent
+dielc_model, dielc_coef : dielectric model of each component (0 = none,
+    1 = water, 2 = dielc_coef), (ncomp), and the coefficients a, b, c of
+    dielc_i = a + b*T + c*T^2 for the components with model 2, (ncomp*3)
+*/
+int pcsaft_mixture_set_kij(pcsaft_mixture *mix, const double *k_ij);
+int pcsaft_mixture_set_lij(pcsaft_mixture *mix, const double *l_ij);
+int pcsaft_mixture_set_khb(pcsaft_mixture *mix, const double *k_hb);
+int pcsaft_mixture_set_association(pcsaft_mixture *mix, const double *e_assoc, const double *vol_a);
+int pcsaft_mixture_set_dipole(pcsaft_mixture *mix, const double *dipm, const double *dip_num);
+int pcsaft_mixture_set_ions(pcsaft_mixture *mix, const double *z, double dielc);
+int pcsaft_mixture_set_dielectric(pcsaft_mixture *mix, const int *dielc_model, const double *dielc_coef);
+
+/*
+Parameter databases (see cython/pcsaft_db.cpp and tools/pcsaft_db.cpp). A
+database is memory-mapped by pcsaft_db_open, so it opens in constant time
+and processes that open the same file share its memory. Components are
+identified by their id (0 .. pcsaft_db_ncomp - 1), which pcsaft_db_find
+returns for a name, or -1 if there is no such component. pcsaft_db_name
+returns the name of a component, which is valid until the database is
+closed.
+pcsaft_db_mixture creates a mixture of the components ids (ncomp) with
+their parameters and binary interaction parameters; its handle does not
+depend on the database, which may be closed afterwards. The relative
+permittivity of a mixture with ions and without dielectric models must
+still be set with pcsaft_mixture_set_ions. A database can be used by
+several threads at the same time.
+*/
+int pcsaft_db_open(const char *path, pcsaft_db **db);
+void pcsaft_db_close(pcsaft_db *db);
+int pcsaft_db_ncomp(const pcsaft_db *db);
+int pcsaft_db_find(const pcsaft_db *db, const char *name);
+const char *pcsaft_db_name(const pcsaft_db *db, int id);
+int pcsaft_db_mixture(const pcsaft_db *db, int ncomp, const int *ids, pcsaft_mixture **mix);
+
+/*
+Keep the densities and fugacity coefficients of the most recently evaluated
+states of the mixture (at most capacity results, 0 disables the cache), so
+that repeated states are looked up instead of solved again. With the cache
+the batches with a shared composition (x_stride = 0) evaluate the states
+one by one instead of with the vectorized solver, so it pays off when
+states repeat, e.g. in a server or in iterative calculations.
+pcsaft_mixture_cache_stats reports the number of lookups that found a
+result (hits), that did not (misses) and the number of stored results.
+*/
+int pcsaft_mixture_set_cache(pcsaft_mixture *mix, long capacity);
+int pcsaft_mixture_cache_stats(const pcsaft_mixture *mix, long *hits, long *misses, long *size);
+
+/* Molar density *rho of the phase (PCSAFT_LIQUID or PCSAFT_VAPOR) at t, p and the composition x (ncomp). */
+int pcsaft_density(const pcsaft_mixture *mix, double t, double p, const double *x, int phase, double *rho);
+
+/*
+Fugacity coefficients fugcoef (ncomp) of the phase at t, p and the
+composition x (ncomp). The molar density of the phase is written to *rho
+unless rho is NULL.
+*/
+int pcsaft_fugacity(const pcsaft_mixture *mix, double t, double p, const double *x, int phase,
+    double *fugcoef, double *rho);
+
+/*
+Residual enthalpy res[0] (J mol^-1), entropy res[1] (J mol^-1 K^-1) and
+Gibbs energy res[2] (J mol^-1) of the phase at t, p and the composition x
+(ncomp). The molar density of the phase is written to *rho unless rho is
+NULL.
+*/
+int pcsaft_residual(const pcsaft_mixture *mix, double t, double p, const double *x, int phase,
+    double *res, double *rho);
+
+/*
+Isothermal flash of the feed z (ncomp) at t and p. Writes the vapor
+fraction *beta and the compositions x of the liquid and y of the vapor
+(ncomp each). If the feed is a single phase, beta is 0 (liquid) or 1
+(vapor) and x and y are the feed. Unless rho is NULL, the densities of the
+liquid and of the vapor are written to rho[0] and rho[1] (both are the
+density of the feed for a single phase). Charged components are assumed to
+stay in the liquid, and the speciation reactions are not solved.
+*/
+int pcsaft_flash(const pcsaft_mixture *mix, double t, double p, const double *z, double *beta,
+    double *x, double *y, double *rho);
+
+/*
+Batch versions for n states, evaluated in parallel. t and p have n values.
+The composition of state k starts at x + k*x_stride, so x_stride = ncomp
+gives each state its own composition and x_stride = 0 uses one composition
+for all states. Outputs have n values per scalar (rho, beta), n*ncomp per
+composition (fugcoef, x, y) and 3*n for res, and rho of pcsaft_flash_batch
+has 2*n. The status of each state is written to status (n) unless it is
+NULL. The return value is the status of the first state that failed, or
+PCSAFT_OK.
+*/
+int pcsaft_density_batch(const pcsaft_mixture *mix, int n, const double *t, const double *p,
+    const double *x, int x_stride, int phase, double *rho, int *status);
+int pcsaft_fugacity_batch(const pcsaft_mixture *mix, int n, const double *t, const double *p,
+    const double *x, int x_stride, int phase, double *fugcoef, double *rho, int *status);
+int pcsaft_residual_batch(const pcsaft_mixture *mix, int n, const double *t, const double *p,
+    const double *x, int x_stride, int phase, double *res, double *rho, int *status);
+int pcsaft_flash_batch(const pcsaft_mixture *mix, int n, const double *t, const double *p,
+    const double *z, int z_stride, double *beta, double *x, double *y, double *rho, int *status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,213 @@
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstring>
+#include <cstdint>
+
+#include "pcsaft_internal.h"
+
+using namespace std;
+
+/*
+Memoization of the density and the fugacity coefficients.
+
+Solvers such as the Nelder-Mead minimizations of the vapor and bubble point
+pressure repeatedly evaluate the same states, and the Python wrappers solve
+the final state again after the minimization. An eos_cache stores the
+results of pcsaft_den_cpp and pcsaft_fugcoef_cpp for the most recently used
+states, so that these repeated evaluations become lookups. The key contains
+a hash of all parameters of the mixture, so one cache can be shared by
+several mixtures, and the exact state (temperature, pressure or density and
+mole fractions). Only identical states are found in the cache.
+
+The cache is divided into EOS_CACHE_SHARDS shards that are locked
+independently, so threads that evaluate different states rarely wait for
+each other. Each shard is a least recently used list with a hash index.
+*/
+
+static inline uint64_t hash_mix(uint64_t h, uint64_t v) {
+    /**Combine a 64 bit value into a hash (FNV-1a over its bytes).*/
+    for (int i = 0; i < 8; i++) {
+        h ^= (v >> (8*i)) & 0xff;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+
+static inline uint64_t hash_double(uint64_t h, double v) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    return hash_mix(h, bits);
+}
+
+
+static uint64_t hash_vector(uint64_t h, const vector<double> &v) {
+    h = hash_mix(h, v.size()); // so that e.g. an empty k_ij and an empty e_assoc are not interchangeable
+    for (size_t i = 0; i < v.size(); i++) {
+        h = hash_double(h, v[i]);
+    }
+    return h;
+}
+
+
+size_t eos_cache_key_hash::operator()(const eos_cache_key &key) const {
+    uint64_t h = hash_mix(key.mixture, key.kind);
+    h = hash_double(h, key.t);
+    h = hash_double(h, key.y);
+    return hash_vector(h, key.x);
+}
+
+
+uint64_t mixture_hash_cpp(const vector<double> &m, const vector<double> &s, const vector<double> &e,
+    const add_args &cppargs) {
+    /**
+    Calculate a hash of all parameters of a mixture, which identifies the
+    mixture in the keys of an eos_cache.
+    */
+    uint64_t h = 14695981039346656037ULL;
+    h = hash_vector(h, m);
+    h = hash_vector(h, s);
+    h = hash_vector(h, e);
+    h = hash_vector(h, cppargs.k_ij);
+    h = hash_vector(h, cppargs.e_assoc);
+    h = hash_vector(h, cppargs.vol_a);
+    h = hash_vector(h, cppargs.dipm);
+    h = hash_vector(h, cppargs.dip_num);
+    h = hash_vector(h, cppargs.z);
+    h = hash_double(h, cppargs.z.empty() ? 0. : cppargs.dielc); // dielc is not initialized without ions
+    h = hash_vector(h, vector<double>(cppargs.dielc_model.begin(), cppargs.dielc_model.end()));
+    h = hash_vector(h, cppargs.dielc_coef);
+    h = hash_vector(h, cppargs.k_hb);
+    h = hash_vector(h, cppargs.l_ij);
+    h = hash_vector(h, cppargs.rxn_nu);
+    h = hash_vector(h, cppargs.rxn_lnk);
+    return h;
+}
+
+
+static bool cache_find(eos_cache &cache, const eos_cache_key &key, size_t hash, vector<double> &value) {
+    /**Look up a key and mark it as the most recently used entry of its shard.*/
+    eos_cache_shard &shard = cache.shards[hash % EOS_CACHE_SHARDS];
+    lock_guard<mutex> guard(shard.lock);
+    unordered_map<eos_cache_key, list<pair<eos_cache_key, vector<double> > >::iterator,
+        eos_cache_key_hash>::iterator it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        shard.misses += 1;
+        return false;
+    }
+    shard.hits += 1;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    value = it->second->second;
+    return true;
+}
+
+
+static void cache_store(eos_cache &cache, const eos_cache_key &key, size_t hash, const vector<double> &value) {
+    /**Add a result, removing the least recently used entries if the shard is full.*/
+    eos_cache_shard &shard = cache.shards[hash % EOS_CACHE_SHARDS];
+    lock_guard<mutex> guard(shard.lock);
+    if (shard.index.count(key) > 0) { // another thread stored the same state in the meantime
+        return;
+    }
+    shard.entries.push_front(make_pair(key, value));
+    shard.index[key] = shard.entries.begin();
+    while (shard.entries.size() > cache.capacity) {
+        shard.index.erase(shard.entries.back().first);
+        shard.entries.pop_back();
+        shard.evictions += 1;
+    }
+}
+
+
+double pcsaft_den_cached_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double p, int phase, add_args &cppargs, eos_cache &cache,
+    double rho_guess) {
+    /**
+    Solve for the density like pcsaft_den_cpp, returning the stored result
+    if the same state was solved before. rho_guess is only used if the state
+    is not in the cache.
+    */
+    if (cache.capacity == 0) {
+        return pcsaft_den_cpp(x, m, s, e, t, p, phase, cppargs, rho_guess);
+    }
+    eos_cache_key key;
+    key.mixture = mixture_hash_cpp(m, s, e, cppargs);
+    key.kind = phase;
+    key.t = t;
+    key.y = p;
+    key.x = x;
+    size_t hash = eos_cache_key_hash()(key);
+
+    vector<double> value;
+    if (cache_find(cache, key, hash, value)) {
+        return value[0];
+    }
+    value.assign(1, pcsaft_den_cpp(x, m, s, e, t, p, phase, cppargs, rho_guess));
+    cache_store(cache, key, hash, value);
+    return value[0];
+}
+
+
+vector<double> pcsaft_fugcoef_cached_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double rho, add_args &cppargs, eos_cache &cache) {
+    /**
+    Calculate the fugacity coefficients like pcsaft_fugcoef_cpp, returning
+    the stored result if the same state was evaluated before.
+    */
+    if (cache.capacity == 0) {
+        return pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs);
+    }
+    eos_cache_key key;
+    key.mixture = mixture_hash_cpp(m, s, e, cppargs);
+    key.kind = 2;
+    key.t = t;
+    key.y = rho;
+    key.x = x;
+    size_t hash = eos_cache_key_hash()(key);
+
+    vector<double> value;
+    if (cache_find(cache, key, hash, value)) {
+        return value;
+    }
+    value = pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs);
+    cache_store(cache, key, hash, value);
+    return value;
+}
+
+
+void eos_cache_resize_cpp(eos_cache &cache, size_t capacity) {
+    /**
+    Set the maximum number of stored results. The capacity is divided among
+    the shards, and 0 clears the cache and disables it. The counters are
+    reset.
+    */
+    cache.capacity = (capacity + EOS_CACHE_SHARDS - 1)/EOS_CACHE_SHARDS;
+    for (int k = 0; k < EOS_CACHE_SHARDS; k++) {
+        eos_cache_shard &shard = cache.shards[k];
+        lock_guard<mutex> guard(shard.lock);
+        while (shard.entries.size() > cache.capacity) {
+            shard.index.erase(shard.entries.back().first);
+            shard.entries.pop_back();
+        }
+        shard.hits = 0;
+        shard.misses = 0;
+        shard.evictions = 0;
+    }
+}
+
+
+eos_cache_stats eos_cache_stats_cpp(eos_cache &cache) {
+    /**Sum the counters and the number of stored results over the shards.*/
+    eos_cache_stats stats = {0, 0, 0, 0};
+    for (int k = 0; k < EOS_CACHE_SHARDS; k++) {
+        eos_cache_shard &shard = cache.shards[k];
+        lock_guard<mutex> guard(shard.lock);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.evictions += shard.evictions;
+        stats.size += shard.entries.size();
+    }
+    return stats;
+}
@@ -0,0 +1,458 @@
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "pcsaft_internal.h"
+
+using namespace std;
+
+/*
+Binary database of component parameters, which is memory-mapped instead of
+parsed, so that opening it costs the same for ten or ten thousand
+components, and processes that open the same file share its pages.
+
+The file starts with a param_db_header, followed by sections that start at
+multiples of 8 bytes:
+
+components  ncomp param_db_component records, in the order of the
+            component ids
+pairs       npairs param_db_pair records with i < j, sorted by i and j.
+            Only the pairs with a nonzero parameter are stored.
+pair_start  ncomp + 1 uint32, the index of the first pair of each
+            component, so the pairs of a component are found by a binary
+            search over its own pairs
+by_name     ncomp uint32, the component ids sorted by name
+names       the names, each terminated by a zero byte
+
+Values are stored in the byte order of the machine that wrote the file;
+a file of the other byte order is rejected. A database is written once by
+param_db_write_cpp (see tools/pcsaft_db.cpp) and is not modified: a new
+version replaces the file, so processes that have the old file mapped keep
+a consistent view of it.
+*/
+
+const static char PARAM_DB_MAGIC[8] = {'P', 'C', 'S', 'A', 'F', 'T', 'D', 'B'};
+const static uint32_t PARAM_DB_VERSION = 1;
+const static uint32_t PARAM_DB_BYTE_ORDER = 0x01020304;
+
+struct param_db_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t ncomp, npairs;
+    uint64_t components, pairs, pair_start, by_name, names; // offsets of the sections
+    uint64_t names_size;
+    uint64_t size; // size of the file
+};
+
+
+static inline uint64_t align8(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+
+static bool pair_less(const param_db_pair &a, const param_db_pair &b) {
+    return (a.i != b.i) ? a.i < b.i : a.j < b.j;
+}
+
+
+bool param_db_write_cpp(const string &path, const vector<string> &names,
+    const vector<param_db_component> &components, const vector<param_db_pair> &pairs) {
+    /**
+    Write a parameter database.
+
+    Parameters
+    ----------
+    path : string
+        Path of the database. The file is written under a temporary name and
+        then renamed, so processes that have the previous version open are
+        not affected.
+    names : vector<string>
+        Unique, nonempty name of each component.
+    components : vector<param_db_component>
+        Parameters of each component, in the same order. The name field is
+        set by this function.
+    pairs : vector<param_db_pair>
+        Binary interaction parameters, at most one entry per pair of
+        different components, in any order. Pairs whose parameters are all
+        zero are not stored.
+
+    Returns
+    -------
+    ok : bool
+        False if the input is invalid or the file cannot be written.
+    */
+    uint32_t ncomp = components.size();
+    if (names.size() != ncomp) {
+        return false;
+    }
+    vector<param_db_component> records(components);
+    string name_data;
+    for (uint32_t k = 0; k < ncomp; k++) {
+        if (names[k].empty() || names[k].find('\0') != string::npos) {
+            return false;
+        }
+        records[k].name = name_data.size();
+        name_data += names[k];
+        name_data += '\0';
+    }
+    vector<uint32_t> by_name(ncomp);
+    for (uint32_t k = 0; k < ncomp; k++) {
+        by_name[k] = k;
+    }
+    sort(by_name.begin(), by_name.end(), [&](uint32_t a, uint32_t b) {return names[a] < names[b];});
+    for (uint32_t k = 1; k < ncomp; k++) {
+        if (names[by_name[k]] == names[by_name[k-1]]) {
+            return false;
+        }
+    }
+
+    vector<param_db_pair> sorted;
+    for (size_t k = 0; k < pairs.size(); k++) {
+        param_db_pair pair = pairs[k];
+        if (pair.i > pair.j) {
+            swap(pair.i, pair.j);
+        }
+        if (pair.i == pair.j || pair.j >= ncomp) {
+            return false;
+        }
+        if (pair.k_ij != 0 || pair.l_ij != 0 || pair.k_hb != 0) {
+            sorted.push_back(pair);
+        }
+    }
+    sort(sorted.begin(), sorted.end(), pair_less);
+    vector<uint32_t> pair_start(ncomp + 1, 0);
+    for (size_t k = 0; k < sorted.size(); k++) {
+        if (k > 0 && sorted[k].i == sorted[k-1].i && sorted[k].j == sorted[k-1].j) {
+            return false;
+        }
+        pair_start[sorted[k].i + 1] += 1;
+    }
+    for (uint32_t k = 0; k < ncomp; k++) {
+        pair_start[k+1] += pair_start[k];
+    }
+
+    param_db_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PARAM_DB_MAGIC, sizeof(PARAM_DB_MAGIC));
+    header.version = PARAM_DB_VERSION;
+    header.byte_order = PARAM_DB_BYTE_ORDER;
+    header.ncomp = ncomp;
+    header.npairs = sorted.size();
+    header.components = align8(sizeof(header));
+    header.pairs = align8(header.components + ncomp*sizeof(param_db_component));
+    header.pair_start = align8(header.pairs + sorted.size()*sizeof(param_db_pair));
+    header.by_name = align8(header.pair_start + (ncomp + 1)*sizeof(uint32_t));
+    header.names = align8(header.by_name + ncomp*sizeof(uint32_t));
+    header.names_size = name_data.size();
+    header.size = header.names + name_data.size();
+
+    vector<char> data(header.size, 0);
+    memcpy(&data[0], &header, sizeof(header));
+    if (ncomp > 0) {
+        memcpy(&data[header.components], &records[0], ncomp*sizeof(param_db_component));
+        memcpy(&data[header.by_name], &by_name[0], ncomp*sizeof(uint32_t));
+        memcpy(&data[header.names], name_data.data(), name_data.size());
+    }
+    if (!sorted.empty()) {
+        memcpy(&data[header.pairs], &sorted[0], sorted.size()*sizeof(param_db_pair));
+    }
+    memcpy(&data[header.pair_start], &pair_start[0], (ncomp + 1)*sizeof(uint32_t));
+
+    string tmp_path = path + ".tmp";
+    FILE *fp = fopen(tmp_path.c_str(), "wb");
+    if (fp == NULL) {
+        return false;
+    }
+    bool ok = fwrite(&data[0], 1, data.size(), fp) == data.size();
+    ok = (fclose(fp) == 0) && ok;
+#ifdef _WIN32
+    remove(path.c_str()); // rename does not replace an existing file on Windows
+#endif
+    if (!ok || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+static bool section_ok(const param_db_header &header, uint64_t offset, uint64_t count, size_t item_size) {
+    return offset % 8 == 0 && offset >= sizeof(header) && offset <= header.size &&
+        count <= (header.size - offset)/item_size;
+}
+
+
+static bool map_file(const string &path, param_db &db) {
+    /**Map the file read-only, or read it into memory where memory maps are not available.*/
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(param_db_header)) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping stays valid
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    db.data = (const char *)data;
+    db.size = st.st_size;
+    db.mapped = true;
+    return true;
+#else
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    vector<char> buf;
+    char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), fp)) > 0) {
+        buf.insert(buf.end(), chunk, chunk + n);
+    }
+    fclose(fp);
+    if (buf.size() < sizeof(param_db_header)) {
+        return false;
+    }
+    char *data = new char[buf.size()];
+    memcpy(data, &buf[0], buf.size());
+    db.data = data;
+    db.size = buf.size();
+    db.mapped = false;
+    return true;
+#endif
+}
+
+
+bool param_db_open_cpp(const string &path, param_db &db) {
+    /**
+    Open a parameter database written by param_db_write_cpp.
+
+    The file is memory-mapped, so only the header and the index of the
+    pairs are read here, and the pages of the components are loaded when
+    they are first used. The database must be closed with
+    param_db_close_cpp, and can then be used by several threads at the same
+    time.
+
+    Returns
+    -------
+    ok : bool
+        False if the file cannot be read, or is not a database of this
+        version and byte order. db is then left closed.
+    */
+    param_db_close_cpp(db);
+    if (!map_file(path, db)) {
+        return false;
+    }
+    param_db_header header;
+    memcpy(&header, db.data, sizeof(header));
+    uint32_t ncomp = header.ncomp;
+    bool ok = memcmp(header.magic, PARAM_DB_MAGIC, sizeof(PARAM_DB_MAGIC)) == 0 &&
+        header.version == PARAM_DB_VERSION && header.byte_order == PARAM_DB_BYTE_ORDER &&
+        header.size == db.size &&
+        section_ok(header, header.components, ncomp, sizeof(param_db_component)) &&
+        section_ok(header, header.pairs, header.npairs, sizeof(param_db_pair)) &&
+        section_ok(header, header.pair_start, (uint64_t)ncomp + 1, sizeof(uint32_t)) &&
+        section_ok(header, header.by_name, ncomp, sizeof(uint32_t)) &&
+        section_ok(header, header.names, header.names_size, 1) &&
+        (header.names_size == 0 || db.data[header.names + header.names_size - 1] == '\0');
+    if (ok) {
+        db.ncomp = ncomp;
+        db.npairs = header.npairs;
+        db.components = (const param_db_component *)(db.data + header.components);
+        db.pairs = (const param_db_pair *)(db.data + header.pairs);
+        db.pair_start = (const uint32_t *)(db.data + header.pair_start);
+        db.by_name = (const uint32_t *)(db.data + header.by_name);
+        db.names = db.data + header.names;
+        db.names_size = header.names_size;
+        // the pair index is checked once, so that the lookups can rely on it
+        ok = db.pair_start[0] == 0 && db.pair_start[ncomp] == db.npairs;
+        for (uint32_t k = 0; k < ncomp && ok; k++) {
+            ok = db.pair_start[k] <= db.pair_start[k+1] && db.by_name[k] < ncomp;
+        }
+    }
+    if (!ok) {
+        param_db_close_cpp(db);
+    }
+    return ok;
+}
+
+
+void param_db_close_cpp(param_db &db) {
+    /**Release the memory of a database. Closing a database that is not open does nothing.*/
+    if (db.data != NULL) {
+#ifndef _WIN32
+        if (db.mapped) {
+            munmap((void *)db.data, db.size);
+        }
+        else {
+            delete[] db.data;
+        }
+#else
+        delete[] db.data;
+#endif
+    }
+    db = param_db();
+}
+
+
+const char *param_db_name_cpp(const param_db &db, int id) {
+    /**Return the name of a component, or NULL if the id or the record is invalid.*/
+    if (id < 0 || (uint32_t)id >= db.ncomp || db.components[id].name >= db.names_size) {
+        return NULL;
+    }
+    return db.names + db.components[id].name;
+}
+
+
+int param_db_find_cpp(const param_db &db, const string &name) {
+    /**Return the id of the component with the given name (binary search), or -1.*/
+    int lo = 0, hi = db.ncomp;
+    while (lo < hi) {
+        int mid = lo + (hi - lo)/2;
+        const char *mid_name = param_db_name_cpp(db, db.by_name[mid]);
+        if (mid_name == NULL) {
+            return -1;
+        }
+        int cmp = strcmp(mid_name, name.c_str());
+        if (cmp == 0) {
+            return db.by_name[mid];
+        }
+        if (cmp < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+    return -1;
+}
+
+
+static const param_db_pair *find_pair(const param_db &db, uint32_t a, uint32_t b) {
+    if (a > b) {
+        swap(a, b);
+    }
+    const param_db_pair *first = db.pairs + db.pair_start[a], *last = db.pairs + db.pair_start[a+1];
+    param_db_pair key;
+    key.i = a;
+    key.j = b;
+    const param_db_pair *found = lower_bound(first, last, key, pair_less);
+    return (found != last && found->i == a && found->j == b) ? found : NULL;
+}
+
+
+bool param_db_mixture_cpp(const param_db &db, const vector<int> &ids, vector<double> &m, vector<double> &s,
+    vector<double> &e, add_args &cppargs) {
+    /**
+    Assemble the parameters of a mixture of database components.
+
+    Parameters
+    ----------
+    db : param_db
+        An open database.
+    ids : vector<int>
+        Ids of the components of the mixture, e.g. from param_db_find_cpp.
+    m, s, e : vector<double>
+        Receive the segment number, segment diameter and dispersion energy.
+    cppargs : add_args
+        Receives the other parameters. As in the Python functions, a
+        parameter is left empty if it is zero for all components of the
+        mixture (all pairs for k_ij, l_ij and k_hb, which are dense
+        ncomp x ncomp matrices). The dielectric models are only set for
+        mixtures with ions, and dielc and the reactions are not part of the
+        database.
+
+    Returns
+    -------
+    ok : bool
+        False if an id is not a component of the database.
+    */
+    int ncomp = ids.size();
+    for (int i = 0; i < ncomp; i++) {
+        if (ids[i] < 0 || (uint32_t)ids[i] >= db.ncomp) {
+            return false;
+        }
+    }
+    m.resize(ncomp);
+    s.resize(ncomp);
+    e.resize(ncomp);
+    cppargs = add_args();
+    vector<double> e_assoc(ncomp), vol_a(ncomp), dipm(ncomp), dip_num(ncomp), z(ncomp), dielc_coef(ncomp*3);
+    vector<int> dielc_model(ncomp);
+    bool assoc = false, polar = false, ions = false, dielectric = false;
+    for (int i = 0; i < ncomp; i++) {
+        const param_db_component &c = db.components[ids[i]];
+        m[i] = c.m;
+        s[i] = c.s;
+        e[i] = c.e;
+        e_assoc[i] = c.e_assoc;
+        vol_a[i] = c.vol_a;
+        dipm[i] = c.dipm;
+        dip_num[i] = c.dip_num;
+        z[i] = c.z;
+        dielc_model[i] = c.dielc_model;
+        copy(c.dielc_coef, c.dielc_coef + 3, dielc_coef.begin() + i*3);
+        assoc = assoc || c.e_assoc != 0 || c.vol_a != 0;
+        polar = polar || c.dipm != 0;
+        ions = ions || c.z != 0;
+        dielectric = dielectric || c.dielc_model != 0;
+    }
+    if (assoc) {
+        cppargs.e_assoc = e_assoc;
+        cppargs.vol_a = vol_a;
+    }
+    if (polar) {
+        cppargs.dipm = dipm;
+        cppargs.dip_num = dip_num;
+    }
+    if (ions) {
+        cppargs.z = z;
+        if (dielectric) {
+            cppargs.dielc_model = dielc_model;
+            cppargs.dielc_coef = dielc_coef;
+        }
+    }
+
+    vector<double> k_ij(ncomp*ncomp, 0.), l_ij(ncomp*ncomp, 0.), k_hb(ncomp*ncomp, 0.);
+    bool has_k = false, has_l = false, has_hb = false;
+    for (int i = 0; i < ncomp; i++) {
+        for (int j = i + 1; j < ncomp; j++) {
+            const param_db_pair *pair = (ids[i] != ids[j]) ? find_pair(db, ids[i], ids[j]) : NULL;
+            if (pair == NULL) {
+                continue;
+            }
+            k_ij[i*ncomp+j] = k_ij[j*ncomp+i] = pair->k_ij;
+            l_ij[i*ncomp+j] = l_ij[j*ncomp+i] = pair->l_ij;
+            k_hb[i*ncomp+j] = k_hb[j*ncomp+i] = pair->k_hb;
+            has_k = has_k || pair->k_ij != 0;
+            has_l = has_l || pair->l_ij != 0;
+            has_hb = has_hb || pair->k_hb != 0;
+        }
+    }
+    if (has_k) {
+        cppargs.k_ij = k_ij;
+    }
+    if (has_l) {
+        cppargs.l_ij = l_ij;
+    }
+    if (has_hb) {
+        cppargs.k_hb = k_hb;
+    }
+    return true;
+}
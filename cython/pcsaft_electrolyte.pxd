@@ -6,35 +6,90 @@ Created on Thu Jul 19 14:23:00 2018
 @author: Zach Baird
 """
 from libcpp.vector cimport vector
+from libcpp.string cimport string
 
-cdef extern from "pcsaft.cpp":
-    double pcsaft_p_cpp(vector[double] x, vector[double] m, vector[double] s, vector[double] e, \
-        double t, double rho, add_args &cppargs)
-    double pcsaft_Z_cpp(vector[double] x, vector[double] m, vector[double] s, vector[double] e, \
-        double t, double rho, add_args &cppargs)
-    vector[double] pcsaft_fugcoef_cpp(vector[double] x, vector[double] m, vector[double] s, vector[double] e, \
-        double t, double rho, add_args &cppargs)
-    double pcsaft_den_cpp(vector[double] x, vector[double] m, vector[double] s, vector[double] e, \
-        double t, double p, int phase, add_args &cppargs)
-    double bubblePfit_cpp(double p_guess, vector[double] xv_guess, vector[double] x, vector[double] m, \
-        vector[double] s, vector[double] e, double t, add_args &cppargs)
-    double PTzfit_cpp(double p_guess, vector[double] x_guess, double beta_guess, double mol, \
-        double vol, vector[double] x_total, vector[double] m, vector[double] s, vector[double] e, \
-        double t, add_args &cppargs)
-    vector[double] chem_equil_cpp(vector[double] x_guess, vector[double] m, vector[double] s, \
-        vector[double] e, double t, double p, add_args &cppargs)
-    double pcsaft_ares_cpp(vector[double] x, vector[double] m, vector[double] s, vector[double] e, \
-        double t, double rho, add_args &cppargs)
-    double pcsaft_dadt_cpp(vector[double] x, vector[double] m, vector[double] s, vector[double] e, \
-        double t, double rho, add_args &cppargs)
-    double pcsaft_hres_cpp(vector[double] x, vector[double] m, vector[double] s, vector[double] e, \
-        double t, double rho, add_args &cppargs)
-    double pcsaft_sres_cpp(vector[double] x, vector[double] m, vector[double] s, vector[double] e, \
-        double t, double rho, add_args &cppargs)
-    double pcsaft_gres_cpp(vector[double] x, vector[double] m, vector[double] s, vector[double] e, \
-        double t, double rho, add_args &cppargs)
+cdef extern from "pcsaft_internal.h":
+    double pcsaft_p_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double rho, add_args &cppargs)
+    double pcsaft_Z_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double rho, add_args &cppargs)
+    vector[double] pcsaft_fugcoef_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double rho, add_args &cppargs)
+    double pcsaft_den_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double p, int phase, add_args &cppargs, double rho_guess, \
+        double rho_lo, double rho_hi)
+    vector[double] pcsaft_Z_batch_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, const vector[double] &t, const vector[double] &rho, add_args &cppargs)
+    vector[double] pcsaft_lnfugcoef_batch_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, const vector[double] &t, const vector[double] &rho, add_args &cppargs)
+    vector[double] pcsaft_den_batch_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, const vector[double] &t, const vector[double] &p, int phase, add_args &cppargs)
+    ensemble_result pcsaft_ensemble_cpp(const vector[double] &params, int nsets, const vector[double] &x, \
+        const vector[double] &t, const vector[double] &p, const vector[int] &phase, \
+        const vector[double] &quantiles, add_args &cppargs)
+    double pcsaft_vaporP_cpp(double p_guess, const vector[double] &x, const vector[double] &m, \
+        const vector[double] &s, const vector[double] &e, double t, add_args &cppargs)
+    sweep_result pcsaft_sweep_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, const vector[double] &t, const vector[double] &p, int phase, int props, \
+        add_args &cppargs)
+    saturation_result pcsaft_saturation_cpp(double p_guess, const vector[double] &x, const vector[double] &m, \
+        const vector[double] &s, const vector[double] &e, double t, add_args &cppargs)
+    fit_result pcsaft_fit_pure_cpp(const vector[double] &params_guess, const fit_data &data, \
+        add_args &cppargs, int maxiter, double tol)
+    double pcsaft_bubbleP_cpp(double p_guess, vector[double] &xv, const vector[double] &x, \
+        const vector[double] &m, const vector[double] &s, const vector[double] &e, double t, add_args &cppargs)
+    fit_result pcsaft_fit_binary_cpp(const vector[double] &params_guess, const vector[int] &param_type, \
+        const vle_data &data, const vector[double] &m, const vector[double] &s, const vector[double] &e, \
+        add_args &cppargs, int maxiter, double tol)
+    activity_result pcsaft_activity_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double p, int solvent, double mw_solvent, add_args &cppargs, \
+        solvent_ref_cache &cache)
+    vector[activity_result] pcsaft_activity_batch_cpp(const vector[double] &x, const vector[double] &m, \
+        const vector[double] &s, const vector[double] &e, const vector[double] &t, const vector[double] &p, \
+        int solvent, double mw_solvent, add_args &cppargs, solvent_ref_cache &cache)
+    double pcsaft_den_cached_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double p, int phase, add_args &cppargs, eos_cache &cache, \
+        double rho_guess)
+    vector[double] pcsaft_fugcoef_cached_cpp(const vector[double] &x, const vector[double] &m, \
+        const vector[double] &s, const vector[double] &e, double t, double rho, add_args &cppargs, \
+        eos_cache &cache)
+    void eos_cache_resize_cpp(eos_cache &cache, size_t capacity)
+    void mixing_cache_setup_cpp(const vector[double] &m, const vector[double] &s, const vector[double] &e, \
+        add_args &cppargs, mixing_cache &cache)
+    eos_cache_stats eos_cache_stats_cpp(eos_cache &cache)
+    bint instrument_enabled_cpp()
+    vector[instrument_counters] instrument_snapshot_cpp()
+    void instrument_reset_cpp()
+    bint trace_start_cpp(const string &path)
+    void trace_stop_cpp()
+    bint param_db_open_cpp(const string &path, param_db &db)
+    void param_db_close_cpp(param_db &db)
+    int param_db_find_cpp(const param_db &db, const string &name)
+    const char *param_db_name_cpp(const param_db &db, int id)
+    bint param_db_mixture_cpp(const param_db &db, const vector[int] &ids, vector[double] &m, vector[double] &s, \
+        vector[double] &e, add_args &cppargs)
+    double bubblePfit_cpp(double p_guess, const vector[double] &xv_guess, const vector[double] &x, \
+        const vector[double] &m, const vector[double] &s, const vector[double] &e, double t, add_args &cppargs, \
+        const solver_tol *tol)
+    solver_tol solver_tol_budget(const solver_tol &final, double residual)
+    double PTzfit_cpp(double p_guess, const vector[double] &x_guess, double beta_guess, double mol, \
+        double vol, vector[double] x_total, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, add_args &cppargs)
+    vector[double] chem_equil_cpp(const vector[double] &x_guess, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double p, add_args &cppargs)
+    double dielc_water_cpp(double t, double &ddielc_dt)
+    double pcsaft_ares_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double rho, add_args &cppargs)
+    double pcsaft_dadt_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double rho, add_args &cppargs)
+    double pcsaft_hres_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double rho, add_args &cppargs)
+    double pcsaft_sres_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double rho, add_args &cppargs)
+    double pcsaft_gres_cpp(const vector[double] &x, const vector[double] &m, const vector[double] &s, \
+        const vector[double] &e, double t, double rho, add_args &cppargs)
    
-    ctypedef struct add_args: 
+    cdef cppclass add_args:
         vector[double] k_ij
         vector[double] e_assoc
         vector[double] vol_a
@@ -42,5 +97,118 @@ cdef extern from "pcsaft.cpp":
         vector[double] dip_num
         vector[double] z
         double dielc
+        vector[int] dielc_model
+        vector[double] dielc_coef
         vector[double] k_hb
         vector[double] l_ij
+        vector[double] rxn_nu
+        vector[double] rxn_lnk
+
+    cdef cppclass fit_data:
+        vector[int] prop
+        vector[int] phase
+        vector[double] t
+        vector[double] p
+        vector[double] value
+
+    cdef int SWEEP_FUGCOEF
+    cdef int SWEEP_HSRES
+
+    cdef cppclass sweep_result:
+        vector[double] rho
+        vector[int] phase
+        vector[double] Z
+        vector[double] fugcoef
+        vector[double] gres
+        vector[double] hres
+        vector[double] sres
+        int n_cold
+
+    cdef cppclass saturation_result:
+        double p
+        double rho_l
+        double rho_v
+        double hres_l
+        double hres_v
+        double sres_l
+        double sres_v
+        double gres_l
+        double gres_v
+        double hvap
+
+    cdef cppclass vle_data:
+        vector[int] type
+        vector[double] t
+        vector[double] p
+        vector[double] x
+        vector[double] y
+        vector[double] mol
+        vector[double] vol
+
+    cdef cppclass fit_result:
+        vector[double] params
+        vector[double] std_err
+        vector[double] residuals
+        double ssr
+        double ssr_initial
+        double grad_norm
+        int iterations
+        int n_evals
+        int n_jac
+        bint converged
+        int status
+
+    cdef cppclass ensemble_result:
+        vector[double] mean
+        vector[double] var
+        vector[double] quantiles
+        vector[int] count
+
+    cdef cppclass activity_result:
+        vector[double] gamma_x
+        vector[double] gamma_m
+        vector[double] molality
+        double gamma_pm
+        double osmotic
+
+    cdef cppclass solver_tol:
+        double assoc
+        double den
+        double comp
+
+    cdef cppclass eos_cache:
+        pass
+
+    cdef cppclass mixing_cache:
+        pass
+
+    cdef cppclass param_db:
+        unsigned int ncomp
+
+    cdef cppclass eos_cache_stats:
+        long hits
+        long misses
+        long evictions
+        long size
+
+    cdef cppclass instrument_counters:
+        long evals
+        long den_solves
+        long den_iter
+        long den_newton_fallback
+        long den_vapor_widen
+        long den_liquid_restart
+        long den_unconverged
+        long xa_solves
+        long xa_iter
+        long xa_unconverged
+        long lu_solves
+        long lu_rows
+        long lu_max_rows
+        double t_hc_disp
+        double t_polar
+        double t_assoc
+        double t_ion
+
+    cdef cppclass solvent_ref_cache:
+        int solvent
@@ -14,10 +14,16 @@ Functions
 - pcsaft_vaporP : calculate the vapor pressure
 - pcsaft_bubbleP : calculate the bubble point pressure of a mixture
 - pcsaft_Hvap : calculate the enthalpy of vaporization
+- pcsaft_saturation : calculate the vapor pressure and the properties of both saturated phases
 - pcsaft_osmoticC : calculate the osmotic coefficient for the mixture
+- pcsaft_activity : calculate activity, mean ionic activity and osmotic coefficients
 - pcsaft_cp : calculate the heat capacity
 - pcsaft_PTz : allows PTz data to be used for parameter fitting
+- pcsaft_fit_pure : fits the parameters of a pure component to experimental data
+- pcsaft_fit_binary : fits the interaction parameters of a binary mixture to phase equilibrium data
+- pcsaft_ensemble : statistics of the density and fugacity coefficients for an ensemble of parameter sets
 - pcsaft_den : calculate the molar density
+- pcsaft_sweep : calculate the density and residual properties along an isobar, isotherm or other path
 - pcsaft_p : calculate the pressure
 - pcsaft_hres : calculate the residual enthalpy
 - pcsaft_sres : calculate the residual entropy
@@ -31,9 +37,14 @@ Functions
 - dXAdt_find : used internally to solve for the derivative of XA wrt temperature
 - vaporPfit : used internally to solve for the vapor pressure
 - PTzfit : used internally to solve for pressure and compositions
+- chem_equil : solves for the speciation of a liquid phase with chemical reactions
 - aly_lee : returns the ideal gas heat capacity
 - dielc_water : returns the dielectric constant of water
+- PyMixture : holds the converted parameters of a mixture for repeated calls
+- ParamDB : memory-mapped database of component parameters that creates PyMixtures
+- as_view : converts an array to a contiguous float64 array for the PyMixture methods
 - np_to_vector : converts a numpy array to a C++ vector
+- pair_to_vector : converts interaction parameters to a packed C++ vector
 - create_struct : converts additional arguments to a C++ struct
     
 References
@@ -84,6 +95,9 @@ from libcpp.vector cimport vector
 cimport pcsaft_electrolyte
 import pylab as pl
 
+# reference states of the solvent of pcsaft_activity and pcsaft_osmoticC, kept for later calls with the same mixture
+cdef solvent_ref_cache shared_ref_cache
+
 
 def pcsaft_p(x, m, s, e, t, rho, pyargs):
     """
@@ -110,9 +124,10 @@ def pcsaft_p(x, m, s, e, t, rho, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -137,8 +152,7 @@ def pcsaft_p(x, m, s, e, t, rho, pyargs):
     P : float
         Pressure (Pa)
     """ 
-    cppargs = create_struct(pyargs)
-    return pcsaft_p_cpp(x, m, s, e, t, rho, cppargs)
+    return PyMixture(m, s, e, pyargs).p(as_view(x), t, rho)
     
     
 def pcsaft_fugcoef(x, m, s, e, t, rho, pyargs):
@@ -166,9 +180,10 @@ def pcsaft_fugcoef(x, m, s, e, t, rho, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -193,8 +208,7 @@ def pcsaft_fugcoef(x, m, s, e, t, rho, pyargs):
     fugcoef : ndarray, shape (n,)
         Fugacity coefficients of each component.
     """    
-    cppargs = create_struct(pyargs)
-    return pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs)
+    return PyMixture(m, s, e, pyargs).fugcoef(as_view(x), t, rho)
     
 
 def pcsaft_Z(x, m, s, e, t, rho, pyargs):
@@ -222,9 +236,10 @@ def pcsaft_Z(x, m, s, e, t, rho, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -249,8 +264,7 @@ def pcsaft_Z(x, m, s, e, t, rho, pyargs):
     Z : float
         Compressibility factor
     """
-    cppargs = create_struct(pyargs)
-    return pcsaft_Z_cpp(x, m, s, e, t, rho, cppargs)
+    return PyMixture(m, s, e, pyargs).Z(as_view(x), t, rho)
 
    
 def pcsaft_vaporP(p_guess, x, m, s, e, t, pyargs):
@@ -278,9 +292,10 @@ def pcsaft_vaporP(p_guess, x, m, s, e, t, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -305,8 +320,10 @@ def pcsaft_vaporP(p_guess, x, m, s, e, t, pyargs):
     Pvap : float
         Vapor pressure (Pa)    
     """
-    cppargs = create_struct(pyargs)  
-    Pvap = minimize(vaporPfit, p_guess, args=(x, m, s, e, t, cppargs), tol=1e-10, method='Nelder-Mead', options={'maxiter': 100}).x
+    mix = PyMixture(m, s, e, pyargs, cache_size=1024) # the minimizer and the final evaluation repeat states
+    x = as_view(x)
+    rho = [0., 0.] # densities of the previous evaluation, used as initial guesses
+    Pvap = minimize(vaporPfit, p_guess, args=(x, t, mix, rho), tol=1e-10, method='Nelder-Mead', options={'maxiter': 100}).x
     return Pvap
 
 
@@ -335,9 +352,10 @@ def pcsaft_bubbleP(p_guess, xv_guess, x, m, s, e, t, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -364,41 +382,49 @@ def pcsaft_bubbleP(p_guess, xv_guess, x, m, s, e, t, pyargs):
             0 : Bubble point pressure (Pa)
             1 : Composition of the liquid phase
     """
-    cppargs = create_struct(pyargs)
+    mix = PyMixture(m, s, e, pyargs, cache_size=1024) # the minimizer and the final evaluation repeat states
+    x = as_view(x)
+    xv_guess = as_view(xv_guess)
     
-    result = minimize(bubblePfit, p_guess, args=(xv_guess, x, m, s, e, t, cppargs), tol=1e-10, method='Nelder-Mead', options={'maxiter': 100})
+    # the objective is evaluated with fixed tolerances: Nelder-Mead compares values of different
+    # evaluations, so tolerances that follow its progress make it stop at the wrong pressure
+    result = minimize(bubblePfit, p_guess, args=(xv_guess, x, t, mix), tol=1e-10, method='Nelder-Mead', options={'maxiter': 100})
     bubP = result.x
 
 #     Determine vapor phase composition at bubble pressure    
-    if cppargs['z'] == []: # Check that the mixture does not contain electrolytes. For electrolytes, a different equilibrium criterion should be used. 
-        rho = pcsaft_den_cpp(x, m, s, e, t, p_guess, 0, cppargs)        
-        fugcoef_l = np.asarray(pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs))
+    if not mix.ions: # Check that the mixture does not contain electrolytes. For electrolytes, a different equilibrium criterion should be used. 
+        rho = mix.den(x, t, p_guess, 'liq')        
+        fugcoef_l = mix.fugcoef(x, t, rho)
         
         itr = 0
         dif = 10000.
         xv = np.copy(xv_guess)
         xv_old = np.zeros_like(xv)
+        rho_v = 0. # density of the previous iteration
         while (dif>1e-9) and (itr<100):
             xv_old[:] = xv
-            rho = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs)        
-            fugcoef_v = np.asarray(pcsaft_fugcoef_cpp(xv, m, s, e, t, rho, cppargs))
+            rho = mix.den(xv, t, p_guess, 'vap', rho_v)
+            rho_v = rho
+            fugcoef_v = mix.fugcoef(xv, t, rho)
             xv = fugcoef_l*x/fugcoef_v
             xv = xv/np.sum(xv)
             dif = np.sum(abs(xv - xv_old))
             itr += 1
     else:
-        z = np.asarray(cppargs['z'])
-        rho = pcsaft_den_cpp(x, m, s, e, t, p_guess, 0, cppargs)        
-        fugcoef_l = np.asarray(pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs))       
+        z = np.asarray(mix.z)
+        rho = mix.den(x, t, p_guess, 'liq')        
+        fugcoef_l = mix.fugcoef(x, t, rho)       
         
         itr = 0
         dif = 10000.
         xv = np.copy(xv_guess)
         xv_old = np.zeros_like(xv)
+        rho_v = 0. # density of the previous iteration
         while (dif>1e-9) and (itr<100):
             xv_old[:] = xv
-            rho = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs)        
-            fugcoef_v = np.asarray(pcsaft_fugcoef_cpp(xv, m, s, e, t, rho, cppargs))
+            rho = mix.den(xv, t, p_guess, 'vap', rho_v)
+            rho_v = rho
+            fugcoef_v = mix.fugcoef(xv, t, rho)
        
             xv[np.where(z == 0)[0]] = (fugcoef_l*x/fugcoef_v)[np.where(z == 0)[0]] # here it is assumed that the ionic compounds are nonvolatile
             xv = xv/np.sum(xv)
@@ -434,9 +460,10 @@ def pcsaft_Hvap(p_guess, x, m, s, e, t, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -463,21 +490,60 @@ def pcsaft_Hvap(p_guess, x, m, s, e, t, pyargs):
             0 : enthalpy of vaporization (J/mol), float            
             1 : vapor pressure (Pa), float
     """
-    cppargs = create_struct(pyargs)
-    
-    Pvap = minimize(vaporPfit, p_guess, args=(x, m, s, e, t, cppargs), tol=1e-10, method='Nelder-Mead', options={'maxiter': 100}).x
-
-    rho = pcsaft_den_cpp(x, m, s, e, t, Pvap, 0, cppargs)        
-    hres_l = pcsaft_hres_cpp(x, m, s, e, t, rho, cppargs)
-    rho = pcsaft_den_cpp(x, m, s, e, t, Pvap, 1, cppargs)
-    hres_v = pcsaft_hres_cpp(x, m, s, e, t, rho, cppargs)
-    Hvap = hres_v - hres_l
-    
-    output = [Hvap, Pvap]    
+    sat = pcsaft_saturation(p_guess, x, m, s, e, t, pyargs)
+    output = [sat['hvap'], sat['p']]
     return output
 
+
+def pcsaft_saturation(p_guess, x, m, s, e, t, pyargs=None):
+    """
+    Calculate the vapor pressure together with the densities and residual 
+    properties of the saturated liquid and vapor.
+
+    The vapor pressure is solved with Newton's method in C++, and the 
+    densities, compressibility factors and fugacity coefficients from the 
+    last iteration are reused for the residual properties.
+
+    Parameters
+    ----------
+    p_guess : float
+        Guess for the vapor pressure (Pa)
+    x : ndarray, shape (n,)
+        Mole fractions of each component (a single 1 for a pure component).
+    m : ndarray, shape (n,)
+        Segment number for each component.
+    s : ndarray, shape (n,)
+        Segment diameter for each component (Angstrom).
+    e : ndarray, shape (n,)
+        Dispersion energy of each component (K).
+    t : float
+        Temperature (K)
+    pyargs : dict
+        Additional arguments (see pcsaft_Hvap).
+
+    Returns
+    -------
+    result : dict
+        p : vapor pressure (Pa)
+        rho_l, rho_v : densities of the liquid and the vapor (mol m^{-3})
+        hres_l, hres_v : residual enthalpies (J mol^{-1})
+        sres_l, sres_v : residual entropies (J mol^{-1} K^{-1})
+        gres_l, gres_v : residual Gibbs energies (J mol^{-1})
+        hvap : enthalpy of vaporization (J mol^{-1})
+        All values are NaN if the vapor pressure could not be found.
+    """
+    x = as_view(x)
+    cdef add_args cppargs
+    if pyargs:
+        create_struct(cppargs, pyargs, x.shape[0])
+    cdef saturation_result res = pcsaft_saturation_cpp(p_guess, np_to_vector(x), np_to_vector(m),
+        np_to_vector(s), np_to_vector(e), t, cppargs)
+    return {'p': res.p, 'rho_l': res.rho_l, 'rho_v': res.rho_v, 'hres_l': res.hres_l, 'hres_v': res.hres_v,
+            'sres_l': res.sres_l, 'sres_v': res.sres_v, 'gres_l': res.gres_l, 'gres_v': res.gres_v,
+            'hvap': res.hvap}
+
     
-def pcsaft_osmoticC(x, m, s, e, t, rho, pyargs):
+def pcsaft_osmoticC(x, m, s, e, t, rho, pyargs, solvent=None, mw_solvent=18.0153):
     """
     Calculate the osmotic coefficient.
     
@@ -502,9 +568,10 @@ def pcsaft_osmoticC(x, m, s, e, t, rho, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -523,32 +590,82 @@ def pcsaft_osmoticC(x, m, s, e, t, rho, pyargs):
         dielc : float
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+    solvent : int
+        Index of the solvent. If it is not given, the solvent is water,
+        identified by its dispersion energy (353.9449 K).
+    mw_solvent : float
+        Molar mass of the solvent (g mol^{-1})
         
     Returns
     -------
     osmC : float
         Molal osmotic coefficient
     """
-    cppargs = create_struct(pyargs)    
-    
-    indx_water = np.where(e == 353.9449)[0] # to find index for water    
-    molality = x/(x[indx_water]*18.0153/1000.)
-    molality[indx_water] = 0
-    x0 = np.zeros_like(x)
-    x0[indx_water] = 1.
-    
-    fugcoef = np.asarray(pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs))
-    p = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs)
-    if rho < 900:
-        ph = 1
-    else:
-        ph = 0
-    rho0 = pcsaft_den_cpp(x0, m, s, e, t, p, ph, cppargs)
-    fugcoef0 = np.asarray(pcsaft_fugcoef_cpp(x0, m, s, e, t, rho0, cppargs))
-    gamma = fugcoef[indx_water]/fugcoef0[indx_water]    
-    
-    osmC = -1000*np.log(x[indx_water]*gamma)/18.0153/np.sum(molality)
-    return osmC
+    if solvent is None:
+        solvent = np.where(np.asarray(e) == 353.9449)[0][0] # to find index for water
+    x = as_view(x)
+    cdef PyMixture mix = PyMixture(m, s, e, pyargs)
+    p = mix.p(x, t, rho)
+    return mix.activity_cached(x, t, p, solvent, mw_solvent, shared_ref_cache)['osmotic']
+
+
+def pcsaft_activity(x, m, s, e, t, p, solvent, pyargs=None, mw_solvent=18.0153):
+    """
+    Calculate the activity coefficients, the mean ionic activity coefficient
+    and the osmotic coefficient of a liquid solution.
+
+    The activity coefficient of the solvent is relative to the pure solvent
+    and those of the solutes to infinite dilution in the solvent, both at the
+    temperature and pressure of the solution. The fugacity coefficients of
+    the reference states are solved once for each distinct temperature and 
+    pressure, so evaluating many compositions at the same state (e.g. a 
+    series of concentrations) only costs one extra density solution. They
+    are kept for later calls with the same mixture and solvent.
+
+    Parameters
+    ----------
+    x : ndarray, shape (n,) or (k, n)
+        Mole fractions of each component, or one row of mole fractions for
+        each of k solutions.
+    m : ndarray, shape (n,)
+        Segment number for each component.
+    s : ndarray, shape (n,)
+        Segment diameter for each component. For ions this is the diameter of
+        the hydrated ion. Units of Angstrom.
+    e : ndarray, shape (n,)
+        Dispersion energy of each component. For ions this is the dispersion
+        energy of the hydrated ion. Units of K.
+    t : float or ndarray, shape (k,)
+        Temperature (K)
+    p : float or ndarray, shape (k,)
+        Pressure (Pa)
+    solvent : int
+        Index of the solvent.
+    pyargs : dict
+        Additional arguments (see pcsaft_osmoticC).
+    mw_solvent : float
+        Molar mass of the solvent (g mol^{-1})
+
+    Returns
+    -------
+    result : dict
+        gamma_x : ndarray, shape (n,) or (k, n)
+            Activity coefficients on the mole fraction scale.
+        gamma_m : ndarray, shape (n,) or (k, n)
+            Activity coefficients of the solutes on the molality scale (the 
+            value of the solvent is the same as in gamma_x).
+        molality : ndarray, shape (n,) or (k, n)
+            Molality of the solutes (mol kg^{-1}).
+        gamma_pm : float or ndarray, shape (k,)
+            Mean ionic activity coefficient on the molality scale, averaged 
+            over the ions weighted by their mole fractions. For a single salt
+            this is (gamma_+^nu_+ * gamma_-^nu_-)^(1/nu). NaN without ions.
+        osmotic : float or ndarray, shape (k,)
+            Molal osmotic coefficient.
+    """
+    cdef PyMixture mix = PyMixture(m, s, e, pyargs)
+    return mix.activity_cached(x, t, p, solvent, mw_solvent, shared_ref_cache)
+
     
 def pcsaft_cp(x, m, s, e, t, rho, params, pyargs):
     """
@@ -579,9 +696,10 @@ def pcsaft_cp(x, m, s, e, t, rho, params, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-            k_ij : ndarray, shape (n,n)
+            k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
                 Binary interaction parameters between components in the mixture. 
-                (dimensions: ncomp x ncomp)
+                (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+                {(i, j): k_ij} with only the nonzero parameters)
             e_assoc : ndarray, shape (n,)
                 Association energy of the associating components. For non associating
                 compounds this is set to 0. Units of K.
@@ -607,17 +725,18 @@ def pcsaft_cp(x, m, s, e, t, rho, params, pyargs):
         Specific molar isobaric heat capacity (J mol^-1 K^-1)
     """
     if rho > 900:
-        ph = 0
+        ph = 'liq'
     else:
-        ph = 1
+        ph = 'vap'
     
-    cppargs = create_struct(pyargs)
+    mix = PyMixture(m, s, e, pyargs)
+    x = as_view(x)
     cp_ideal = aly_lee(t, params)
-    p = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs)
-    rho0 = pcsaft_den_cpp(x, m, s, e, t-0.001, p, ph, cppargs)
-    hres0 = pcsaft_hres_cpp(x, m, s, e, t-0.001, rho0, cppargs)
-    rho1 = pcsaft_den_cpp(x, m, s, e, t+0.001, p, ph, cppargs)
-    hres1 = pcsaft_hres_cpp(x, m, s, e, t+0.001, rho1, cppargs)
+    p = mix.p(x, t, rho)
+    rho0 = mix.den(x, t-0.001, p, ph)
+    hres0 = mix.hres(x, t-0.001, rho0)
+    rho1 = mix.den(x, t+0.001, p, ph)
+    hres1 = mix.hres(x, t+0.001, rho1)
     dhdt = (hres1-hres0)/0.002 # a numerical derivative is used for now until analytical derivatives are ready
     return cp_ideal + dhdt
 
@@ -657,9 +776,10 @@ def pcsaft_PTz(p_guess, x_guess, beta_guess, mol, vol, x_total, m, s, e, t, pyar
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -678,6 +798,12 @@ def pcsaft_PTz(p_guess, x_guess, beta_guess, mol, vol, x_total, m, s, e, t, pyar
         dielc : float
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+        rxn_nu : ndarray, shape (r,n)
+            Stoichiometric coefficients of the speciation reactions in the 
+            liquid phase (see chem_equil).
+        rxn_lnk : ndarray, shape (r,4)
+            Coefficients A, B, C, D of the equilibrium constant of each 
+            reaction, ln(K) = A + B/T + C*ln(T) + D*T.
         
     Returns
     -------
@@ -688,22 +814,25 @@ def pcsaft_PTz(p_guess, x_guess, beta_guess, mol, vol, x_total, m, s, e, t, pyar
             2 : composition of the vapor phase, ndarray, shape (n,)
             3 : mole fraction of the mixture vaporized
     """ 
-    cppargs = create_struct(pyargs)    
-    result = minimize(PTzfit, p_guess, args=(x_guess, beta_guess, mol, vol, x_total, m, s, e, t, cppargs), tol=1e-10, method='Nelder-Mead', options={'maxiter': 100})
+    mix = PyMixture(m, s, e, pyargs, cache_size=1024) # the minimizer and the final evaluation repeat states
+    x_guess = as_view(x_guess)
+    x_total = as_view(x_total)
+    result = minimize(PTzfit, p_guess, args=(x_guess, beta_guess, mol, vol, x_total, t, mix), tol=1e-10, method='Nelder-Mead', options={'maxiter': 100})
     p = result.x
 
-    if cppargs['z'] == []: # Check that the mixture does not contain electrolytes. For electrolytes, a different equilibrium criterion should be used.
+    if not mix.ions: # Check that the mixture does not contain electrolytes. For electrolytes, a different equilibrium criterion should be used.
         itr = 0
         dif = 10000.
         xl = np.copy(x_guess)
         beta = beta_guess
         xv = (mol*x_total - (1-beta)*mol*xl)/beta/mol
+        rhol = rhov = 0. # densities of the previous iteration
         while (dif>1e-9) and (itr<100):
             beta_old = beta
-            rhol = pcsaft_den_cpp(xl, m, s, e, t, p, 0, cppargs)        
-            fugcoef_l = np.asarray(pcsaft_fugcoef_cpp(xl, m, s, e, t, rhol, cppargs))
-            rhov = pcsaft_den_cpp(xv, m, s, e, t, p, 1, cppargs)        
-            fugcoef_v = np.asarray(pcsaft_fugcoef_cpp(xv, m, s, e, t, rhov, cppargs))
+            rhol = mix.den(xl, t, p[0], 'liq', rhol)
+            fugcoef_l = mix.fugcoef(xl, t, rhol)
+            rhov = mix.den(xv, t, p[0], 'vap', rhov)
+            fugcoef_v = mix.fugcoef(xv, t, rhov)
             if beta > 0.5:     
                 xl = fugcoef_v*xv/fugcoef_l
                 xl = xl/np.sum(xl)
@@ -716,7 +845,7 @@ def pcsaft_PTz(p_guess, x_guess, beta_guess, mol, vol, x_total, m, s, e, t, pyar
             dif = np.sum(abs(beta - beta_old))
             itr += 1
     else:
-        z = np.asarray(cppargs['z'])
+        z = np.asarray(mix.z)
         # internal iteration loop to solve for compositions
         itr = 0
         dif = 10000.
@@ -725,14 +854,15 @@ def pcsaft_PTz(p_guess, x_guess, beta_guess, mol, vol, x_total, m, s, e, t, pyar
         xv = (mol*x_total - (1-beta)*mol*xl)/beta/mol
         xv[np.where(z != 0)[0]] = 0.
         xv = xv/np.sum(xv)
+        rhol = rhov = 0. # densities of the previous iteration
         while (dif>1e-9) and (itr<100):
-            xl = chem_equil(xl, m, s, e, t, p, pyargs)
-            x_total = xl + xv
+            xl = chem_equil(xl, m, s, e, t, p[0], pyargs)
+            x_total = (1-beta)*xl + beta*xv
             beta_old = beta
-            rhol = pcsaft_den_cpp(xl, m, s, e, t, p, 0, cppargs)        
-            fugcoef_l = np.asarray(pcsaft_fugcoef_cpp(xl, m, s, e, t, rhol, cppargs))
-            rhov = pcsaft_den_cpp(xv, m, s, e, t, p, 1, cppargs)        
-            fugcoef_v = np.asarray(pcsaft_fugcoef_cpp(xv, m, s, e, t, rhov, cppargs))
+            rhol = mix.den(xl, t, p[0], 'liq', rhol)
+            fugcoef_l = mix.fugcoef(xl, t, rhol)
+            rhov = mix.den(xv, t, p[0], 'vap', rhov)
+            fugcoef_v = mix.fugcoef(xv, t, rhov)
             if beta > 0.5:
                 xl = fugcoef_v*xv/fugcoef_l
                 xl = xl/np.sum(xl)*(((1-beta) - np.sum(x_total[np.where(z != 0)[0]]))/(1-beta)) # ensures that mole fractions add up to 1
@@ -751,7 +881,219 @@ def pcsaft_PTz(p_guess, x_guess, beta_guess, mol, vol, x_total, m, s, e, t, pyar
     output = [p, xl, xv, beta]
     return output
 
-def pcsaft_den(x, m, s, e, t, p, pyargs, phase='liq'):
+def pcsaft_fit_pure(params, prop, T, P, value, pyargs=None, phase=None, maxiter=100, tol=1e-8):
+    """
+    Fit the PC-SAFT parameters of a pure component to experimental data.
+
+    The Levenberg-Marquardt method is used, and the residuals are evaluated
+    in C++ (in parallel over the data points if the module was compiled with
+    OpenMP).
+
+    Parameters
+    ----------
+    params : ndarray, shape (3,) or (5,)
+        Initial guess for m, s (Angstrom) and e (K). If five values are given
+        the association energy e_assoc (K) and the association volume vol_a are
+        also fit.
+    prop : ndarray, shape (k,)
+        Property type of each data point (0 = density, 1 = vapor pressure, 
+        2 = enthalpy of vaporization).
+    T : ndarray, shape (k,)
+        Temperature (K)
+    P : ndarray, shape (k,)
+        Pressure (Pa). For vapor pressure and enthalpy of vaporization data
+        this is only used as the initial guess for the vapor pressure.
+    value : ndarray, shape (k,)
+        Measured values: molar density (mol m^{-3}), vapor pressure (Pa) or
+        enthalpy of vaporization (J mol^{-1}).
+    pyargs : dict
+        Additional arguments that are kept constant during the fit, e.g. dipm
+        and dip_num (see pcsaft_den).
+    phase : ndarray, shape (k,)
+        Phase of the density data (0 = liquid, 1 = vapor). If it is not given,
+        densities below 900 mol m^{-3} are treated as vapor densities.
+    maxiter : int
+        Maximum number of iterations.
+    tol : float
+        Convergence tolerance.
+
+    Returns
+    -------
+    result : dict
+        params : fitted parameters
+        std_err : standard errors of the parameters
+        residuals : relative deviation of each data point (%)
+        ssr, ssr_initial : sum of squared residuals at the solution and for the initial guess
+        grad_norm : largest element of the gradient in the last iteration
+        iterations, n_evals, n_jac : number of iterations, residual evaluations and Jacobians
+        converged : bool
+        status : int (see fit_result in pcsaft.h)
+    """
+    cdef add_args cppargs
+    if pyargs:
+        create_struct(cppargs, pyargs, 1)
+    prop = np.asarray(prop, dtype=int)
+    value = np.asarray(value, dtype=np.float64)
+    if phase is None:
+        phase = np.where((prop == 0) & (value < 900), 1, 0)
+    cdef fit_data data
+    data.prop = [int(v) for v in prop]
+    data.phase = [int(v) for v in np.asarray(phase, dtype=int)]
+    data.t = np_to_vector(T)
+    data.p = np_to_vector(P)
+    data.value = np_to_vector(value)
+    cdef fit_result res = pcsaft_fit_pure_cpp(np_to_vector(params), data, cppargs, maxiter, tol)
+    return {'params': vector_to_np(res.params), 'std_err': vector_to_np(res.std_err),
+            'residuals': vector_to_np(res.residuals), 'ssr': res.ssr, 'ssr_initial': res.ssr_initial,
+            'grad_norm': res.grad_norm, 'iterations': res.iterations, 'n_evals': res.n_evals,
+            'n_jac': res.n_jac, 'converged': res.converged, 'status': res.status}
+
+
+def pcsaft_fit_binary(params, fit, m, s, e, T, P, x, pyargs=None, y=None, mol=None, vol=None,
+                      maxiter=100, tol=1e-8):
+    """
+    Fit the interaction parameters of a binary mixture to bubble point and 
+    PTz data.
+
+    The Levenberg-Marquardt method is used. The phase equilibrium of each 
+    data point is solved in C++ (in parallel over the data points if the 
+    module was compiled with OpenMP), starting from the solution for the 
+    previous accepted parameters.
+
+    Parameters
+    ----------
+    params : ndarray, shape (k,)
+        Initial guess for the interaction parameters.
+    fit : list of str, length k
+        The parameter that each element of params refers to: 'k_ij', 'l_ij'
+        or 'k_hb'.
+    m, s, e : ndarray, shape (2,)
+        Segment number, segment diameter (Angstrom) and dispersion energy (K).
+    T : ndarray, shape (d,)
+        Temperature (K)
+    P : ndarray, shape (d,)
+        Measured pressure (Pa). This is also the initial guess for the 
+        calculated pressure.
+    x : ndarray, shape (d,2)
+        Liquid mole fractions of bubble points, or the overall mole fractions
+        of PTz points.
+    pyargs : dict
+        Additional arguments that are kept constant during the fit (see
+        pcsaft_den). Interaction parameters that are not fit are taken from
+        here.
+    y : ndarray, shape (d,2)
+        Measured vapor mole fractions of bubble points. Rows of NaN are used
+        for points where the vapor composition was not measured.
+    mol, vol : ndarray, shape (d,)
+        Total amount of substance (mol) and total volume (m^{3}) of PTz 
+        points. Points where these are NaN are treated as bubble points.
+    maxiter : int
+        Maximum number of iterations.
+    tol : float
+        Convergence tolerance.
+
+    Returns
+    -------
+    result : dict
+        The same entries as for pcsaft_fit_pure. The residuals are given in 
+        the order of the data points: the relative deviation of the pressure
+        (%) of each point, directly followed by the deviation of y_0 (mol %)
+        if it is a bubble point with a measured vapor composition.
+    """
+    if len(m) != 2 or np.shape(x)[-1] != 2:
+        raise ValueError('pcsaft_fit_binary requires a binary mixture')
+    cdef add_args cppargs
+    if pyargs:
+        create_struct(cppargs, pyargs, 2)
+    names = {'k_ij': 0, 'l_ij': 1, 'k_hb': 2}
+    cdef vector[int] param_type = [names[f] for f in fit]
+    x = np.asarray(x, dtype=np.float64).reshape(-1, 2)
+    npoints = x.shape[0]
+    if mol is None or vol is None:
+        mol = np.full(npoints, np.nan)
+        vol = np.full(npoints, np.nan)
+    mol = np.asarray(mol, dtype=np.float64)
+    vol = np.asarray(vol, dtype=np.float64)
+    if y is None:
+        y = np.full((npoints, 2), np.nan)
+    y = np.asarray(y, dtype=np.float64).reshape(-1, 2)
+    cdef vle_data data
+    data.type = [int(v) for v in np.where(np.isfinite(mol) & np.isfinite(vol), 1, 0)]
+    data.t = np_to_vector(T)
+    data.p = np_to_vector(P)
+    data.x = np_to_vector(x)
+    data.y = np_to_vector(np.where(np.isfinite(y), y, -1.))
+    data.mol = np_to_vector(mol)
+    data.vol = np_to_vector(vol)
+    cdef fit_result res = pcsaft_fit_binary_cpp(np_to_vector(params), param_type, data, np_to_vector(m),
+        np_to_vector(s), np_to_vector(e), cppargs, maxiter, tol)
+    return {'params': vector_to_np(res.params), 'std_err': vector_to_np(res.std_err),
+            'residuals': vector_to_np(res.residuals), 'ssr': res.ssr, 'ssr_initial': res.ssr_initial,
+            'grad_norm': res.grad_norm, 'iterations': res.iterations, 'n_evals': res.n_evals,
+            'n_jac': res.n_jac, 'converged': res.converged, 'status': res.status}
+
+
+def pcsaft_ensemble(params, x, T, P, pyargs=None, phase='liq', quantiles=(0.05, 0.5, 0.95)):
+    """
+    Calculate the mean, variance and quantiles of the density and the 
+    fugacity coefficients at several states for an ensemble of parameter 
+    sets, e.g. samples from the uncertainty of fitted parameters.
+
+    The parameter sets are evaluated together in C++ using SIMD instructions
+    where possible (in parallel over the states if the module was compiled
+    with OpenMP), and only the running statistics are stored.
+
+    Parameters
+    ----------
+    params : ndarray, shape (nsets, 3*n) or (nsets, 3*n + n*(n-1)/2)
+        One parameter set per row: m, s (Angstrom) and e (K) of each 
+        component, optionally followed by k_ij for i < j (the strict upper 
+        triangle of the k_ij matrix, row by row).
+    x : ndarray, shape (n,)
+        Mole fractions of each component.
+    T : ndarray, shape (k,)
+        Temperature of each state (K)
+    P : ndarray, shape (k,)
+        Pressure of each state (Pa)
+    pyargs : dict
+        Additional arguments that are the same for all parameter sets (see
+        pcsaft_den). k_ij is taken from here if params does not contain it.
+    phase : string or ndarray, shape (k,)
+        The phase of all states ("liq" or "vap"), or the phase of each state
+        (0 = liquid, 1 = vapor).
+    quantiles : sequence of float
+        The quantiles to estimate, between 0 and 1.
+
+    Returns
+    -------
+    result : dict
+        mean, var : ndarray, shape (k, n+1)
+            Mean and sample variance of the density (mol m^{-3}, column 0) and
+            of the natural log of the fugacity coefficient of each component.
+        quantiles : ndarray, shape (k, n+1, q)
+            Estimated quantiles of the same properties (P^2 algorithm).
+        count : ndarray, shape (k, n+1)
+            Number of parameter sets that gave a finite value.
+    """
+    x = as_view(x)
+    cdef int ncomp = x.shape[0]
+    params = np.atleast_2d(np.asarray(params, dtype=np.float64))
+    cdef add_args cppargs
+    if pyargs:
+        create_struct(cppargs, pyargs, ncomp)
+    nstates = np.asarray(T).size
+    if isinstance(phase, str):
+        phase = np.full(nstates, 0 if phase == 'liq' else 1)
+    cdef vector[int] phase_vec = [int(v) for v in np.asarray(phase, dtype=int)]
+    cdef ensemble_result res = pcsaft_ensemble_cpp(np_to_vector(params), params.shape[0], np_to_vector(x),
+        np_to_vector(T), np_to_vector(P), phase_vec, np_to_vector(quantiles), cppargs)
+    return {'mean': vector_to_np(res.mean).reshape(nstates, ncomp+1),
+            'var': vector_to_np(res.var).reshape(nstates, ncomp+1),
+            'quantiles': vector_to_np(res.quantiles).reshape(nstates, ncomp+1, -1),
+            'count': np.asarray(res.count).reshape(nstates, ncomp+1)}
+
+
+def pcsaft_den(x, m, s, e, t, p, pyargs, phase='liq', rho_guess=0., bracket=None):
     """
     Wrapper for C++ pcsaft_den_cpp function because a C++ struct is needed for 
     that function.
@@ -780,9 +1122,10 @@ def pcsaft_den(x, m, s, e, t, p, pyargs, phase='liq'):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -801,21 +1144,96 @@ def pcsaft_den(x, m, s, e, t, p, pyargs, phase='liq'):
         dielc : float
             Dielectric constant of the medium to be used for electrolyte
             calculations.
+    rho_guess : float
+        Initial guess for the density (mol m^{-3}), e.g. the density of the 
+        same phase at a nearby state. It is refined with Newton's method, and
+        the default solver is used if that fails.
+    bracket : tuple of float
+        Lower and upper bound of the density (mol m^{-3}). By default they 
+        follow from the phase.
         
     Returns
     -------
     rho : float
         Molar density (mol m^{-3})
     """    
-    cppargs = create_struct(pyargs)    
-    if phase == 'liq':
-        phase_num = 0
-    else:
-        phase_num = 1
-        
-    return pcsaft_den_cpp(x, m, s, e, t, p, phase_num, cppargs)
+    return PyMixture(m, s, e, pyargs).den(as_view(x), t, p, phase, rho_guess, bracket)
     
 
+def pcsaft_sweep(x, m, s, e, T, P, pyargs=None, phase='liq', props=()):
+    """
+    Calculate the density and other properties for a sequence of states, 
+    e.g. along an isobar or an isotherm.
+
+    The states are solved in order, and the density of each state is 
+    extrapolated from the previous states and refined with Newton's method,
+    so a sweep needs far fewer evaluations of the equation of state than 
+    solving each state separately with pcsaft_den.
+
+    Parameters
+    ----------
+    x : ndarray, shape (n,)
+        Mole fractions of each component.
+    m : ndarray, shape (n,)
+        Segment number for each component.
+    s : ndarray, shape (n,)
+        Segment diameter for each component (Angstrom).
+    e : ndarray, shape (n,)
+        Dispersion energy of each component (K).
+    T : float or ndarray, shape (k,)
+        Temperature of each state (K), ordered along the path.
+    P : float or ndarray, shape (k,)
+        Pressure of each state (Pa)
+    pyargs : dict
+        Additional arguments (see pcsaft_den).
+    phase : string
+        "liq", "vap" or "stable". With "stable" both phases are followed and
+        the one with the lower Gibbs energy is returned for each state.
+    props : sequence of string
+        Additional properties to calculate: "fugcoef", "gres", "hres" and 
+        "sres".
+
+    Returns
+    -------
+    result : dict
+        rho : ndarray, shape (k,)
+            Molar density (mol m^{-3}), NaN where no density was found.
+        phase : ndarray, shape (k,)
+            Phase of each state (0 = liquid, 1 = vapor).
+        Z : ndarray, shape (k,)
+            Compressibility factor.
+        fugcoef : ndarray, shape (k, n)
+            Fugacity coefficients, if requested.
+        gres, hres, sres : ndarray, shape (k,)
+            Residual Gibbs energy, enthalpy (J mol^{-1}) and entropy 
+            (J mol^{-1} K^{-1}), if requested.
+        n_cold : int
+            Number of states whose density was solved without a warm start.
+    """
+    x = as_view(x)
+    cdef int ncomp = x.shape[0]
+    T, P = np.broadcast_arrays(np.asarray(T, dtype=np.float64), np.asarray(P, dtype=np.float64))
+    cdef add_args cppargs
+    if pyargs:
+        create_struct(cppargs, pyargs, ncomp)
+    cdef int phase_num = {'liq': 0, 'vap': 1, 'stable': 2}[phase]
+    cdef int flags = 0
+    if 'fugcoef' in props or 'gres' in props:
+        flags |= SWEEP_FUGCOEF
+    if 'hres' in props or 'sres' in props:
+        flags |= SWEEP_HSRES
+    cdef sweep_result res = pcsaft_sweep_cpp(np_to_vector(x), np_to_vector(m), np_to_vector(s), np_to_vector(e),
+        np_to_vector(np.atleast_1d(T)), np_to_vector(np.atleast_1d(P)), phase_num, flags, cppargs)
+    result = {'rho': vector_to_np(res.rho), 'phase': np.asarray(res.phase), 'Z': vector_to_np(res.Z),
+              'n_cold': res.n_cold}
+    if 'fugcoef' in props:
+        result['fugcoef'] = vector_to_np(res.fugcoef).reshape(-1, ncomp)
+    for name, values in (('gres', res.gres), ('hres', res.hres), ('sres', res.sres)):
+        if name in props:
+            result[name] = vector_to_np(values)
+    return result
+
+
 def pcsaft_hres(x, m, s, e, t, rho, pyargs):
     """
     Calculate the residual enthalpy for one phase of the system.
@@ -841,9 +1259,10 @@ def pcsaft_hres(x, m, s, e, t, rho, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -868,8 +1287,7 @@ def pcsaft_hres(x, m, s, e, t, rho, pyargs):
     hres : float
         Residual enthalpy (J mol^{-1})
     """
-    cppargs = create_struct(pyargs)
-    return pcsaft_hres_cpp(x, m, s, e, t, rho, cppargs)
+    return PyMixture(m, s, e, pyargs).hres(as_view(x), t, rho)
 
 def pcsaft_sres(x, m, s, e, t, rho, pyargs):
     """
@@ -896,9 +1314,10 @@ def pcsaft_sres(x, m, s, e, t, rho, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -923,8 +1342,7 @@ def pcsaft_sres(x, m, s, e, t, rho, pyargs):
     sres : float
         Residual entropy (J mol^{-1} K^{-1})
     """    
-    cppargs = create_struct(pyargs)
-    return pcsaft_sres_cpp(x, m, s, e, t, rho, cppargs)
+    return PyMixture(m, s, e, pyargs).sres(as_view(x), t, rho)
 
 def pcsaft_gres(x, m, s, e, t, rho, pyargs):
     """
@@ -951,9 +1369,10 @@ def pcsaft_gres(x, m, s, e, t, rho, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -978,8 +1397,7 @@ def pcsaft_gres(x, m, s, e, t, rho, pyargs):
     gres : float
         Residual Gibbs energy (J mol^{-1})
     """
-    cppargs = create_struct(pyargs)
-    return pcsaft_gres_cpp(x, m, s, e, t, rho, cppargs)
+    return PyMixture(m, s, e, pyargs).gres(as_view(x), t, rho)
 
 
 def pcsaft_ares(x, m, s, e, t, rho, pyargs):
@@ -1007,9 +1425,10 @@ def pcsaft_ares(x, m, s, e, t, rho, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -1034,8 +1453,7 @@ def pcsaft_ares(x, m, s, e, t, rho, pyargs):
     ares : float
         Residual Helmholtz energy (J mol^{-1})
     """    
-    cppargs = create_struct(pyargs)
-    return pcsaft_ares_cpp(x, m, s, e, t, rho, cppargs)
+    return PyMixture(m, s, e, pyargs).ares(as_view(x), t, rho)
     
 
 def pcsaft_dadt(x, m, s, e, t, rho, pyargs):
@@ -1063,9 +1481,10 @@ def pcsaft_dadt(x, m, s, e, t, rho, pyargs):
         A dictionary containing additional arguments that can be passed for 
         use in PC-SAFT:
         
-        k_ij : ndarray, shape (n,n)
+        k_ij : ndarray, shape (n,n) or (n*(n+1)/2,), or dict
             Binary interaction parameters between components in the mixture. 
-            (dimensions: ncomp x ncomp)
+            (dimensions: ncomp x ncomp, the packed upper triangle, or a dict
+            {(i, j): k_ij} with only the nonzero parameters)
         e_assoc : ndarray, shape (n,)
             Association energy of the associating components. For non associating
             compounds this is set to 0. Units of K.
@@ -1090,8 +1509,7 @@ def pcsaft_dadt(x, m, s, e, t, rho, pyargs):
     dadt : float
         Temperature derivative of the residual Helmholtz energy (J mol^{-1})
     """    
-    cppargs = create_struct(pyargs)
-    return pcsaft_dadt_cpp(x, m, s, e, t, rho, cppargs)
+    return PyMixture(m, s, e, pyargs).dadt(as_view(x), t, rho)
 
 
 def dXAdt_find(ncA, ncomp, delta_ij, den, XA, ddelta_dt, x, n_sites):
@@ -1117,42 +1535,55 @@ def dXAdt_find(ncA, ncomp, delta_ij, den, XA, ddelta_dt, x, n_sites):
     return dXAdt_dd
 
 
-def bubblePfit(p_guess, xv_guess, x, m, s, e, t, cppargs):
+def bubblePfit(p_guess, xv_guess, x, t, PyMixture mix):
     """Minimize this function to calculate the bubble point pressure."""
-    error = bubblePfit_cpp(p_guess, xv_guess, x, m, s, e, t, cppargs)
-    return error
+    mix.load(mix.xbuf, x)
+    mix.load(mix.xbuf2, xv_guess)
+    return bubblePfit_cpp(p_guess[0], mix.xbuf2, mix.xbuf, mix.m, mix.s, mix.e, t, mix.cppargs, NULL)
     
-def vaporPfit(p_guess, x, m, s, e, t, cppargs):
-    """Minimize this function to calculate the vapor pressure."""
-    if p_guess <= 0:
+def vaporPfit(p_guess, x, t, PyMixture mix, rho=None):
+    """
+    Minimize this function to calculate the vapor pressure.
+
+    If rho is a list [rho_l, rho_v], the densities are solved starting from 
+    it and it is updated with the new densities for the next call.
+    """
+    cdef double p = p_guess[0]
+    if rho is None:
+        rho = [0., 0.]
+    if p <= 0:
         error = 10000000000.
     else:
-        rho = pcsaft_den_cpp(x, m, s, e, t, p_guess, 0, cppargs)
-        fugcoef_l = np.asarray(pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs))
-        rho = pcsaft_den_cpp(x, m, s, e, t, p_guess, 1, cppargs)
-        fugcoef_v = np.asarray(pcsaft_fugcoef_cpp(x, m, s, e, t, rho, cppargs))
+        rho[0] = mix.den(x, t, p, 'liq', rho[0])
+        fugcoef_l = mix.fugcoef(x, t, rho[0])
+        rho[1] = mix.den(x, t, p, 'vap', rho[1])
+        fugcoef_v = mix.fugcoef(x, t, rho[1])
         error = 100000*np.sum((fugcoef_l-fugcoef_v)**2)
         if np.isnan(error):
             error = 100000000.
     return error
     
-def PTzfit(p_guess, x_guess, beta_guess, mol, vol, x_total, m, s, e, t, cppargs):
+def PTzfit(p_guess, x_guess, beta_guess, mol, vol, x_total, t, PyMixture mix):
     """Minimize this function to solve for the pressure to compare with PTz data."""
-    error = PTzfit_cpp(p_guess, x_guess, beta_guess, mol, vol, x_total, m, s, e, t, cppargs)
+    p_guess = p_guess[0]
+    mix.load(mix.xbuf, x_guess)
+    mix.load(mix.xbuf2, x_total)
+    error = PTzfit_cpp(p_guess, mix.xbuf, beta_guess, mol, vol, mix.xbuf2, mix.m, mix.s, mix.e, t, mix.cppargs)
 
-    if cppargs['z'] == []: # Check that the mixture does not contain electrolytes. For electrolytes, a different equilibrium criterion should be used.
+    if not mix.ions: # Check that the mixture does not contain electrolytes. For electrolytes, a different equilibrium criterion should be used.
         # internal iteration loop to solve for compositions
         itr = 0
         dif = 10000.
         xl = np.copy(x_guess)
         beta = beta_guess
         xv = (mol*x_total - (1-beta)*mol*xl)/beta/mol
+        rhol = rhov = 0. # densities of the previous iteration
         while (dif>1e-9) and (itr<100):
             beta_old = beta
-            rhol = pcsaft_den_cpp(xl, m, s, e, t, p_guess, 0, cppargs)        
-            fugcoef_l = np.asarray(pcsaft_fugcoef_cpp(xl, m, s, e, t, rhol, cppargs))
-            rhov = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs)        
-            fugcoef_v = np.asarray(pcsaft_fugcoef_cpp(xv, m, s, e, t, rhov, cppargs))
+            rhol = mix.den(xl, t, p_guess, 'liq', rhol)
+            fugcoef_l = mix.fugcoef(xl, t, rhol)
+            rhov = mix.den(xv, t, p_guess, 'vap', rhov)
+            fugcoef_v = mix.fugcoef(xv, t, rhov)
             xl = fugcoef_v*xv/fugcoef_l
             xl = xl/np.sum(xl)
             xv = (mol*x_total - (1-beta)*mol*xl)/beta/mol
@@ -1163,7 +1594,7 @@ def PTzfit(p_guess, x_guess, beta_guess, mol, vol, x_total, m, s, e, t, cppargs)
         error += np.sum((xl*fugcoef_l - xv*fugcoef_v)**2)
         error += np.sum((mol*x_total - beta*mol*xv - (1-beta)*mol*xl)**2)
     else:
-        z = np.asarray(cppargs['z'])
+        z = np.asarray(mix.z)
         # internal iteration loop to solve for compositions
         itr = 0
         dif = 10000.
@@ -1172,12 +1603,13 @@ def PTzfit(p_guess, x_guess, beta_guess, mol, vol, x_total, m, s, e, t, cppargs)
         xv = (mol*x_total - (1-beta)*mol*xl)/beta/mol
         xv[np.where(z == 0)[0]] = 0.
         xv = xv/np.sum(xv)
+        rhol = rhov = 0. # densities of the previous iteration
         while (dif>1e-9) and (itr<100):
             beta_old = beta
-            rhol = pcsaft_den_cpp(xl, m, s, e, t, p_guess, 0, cppargs)        
-            fugcoef_l = np.asarray(pcsaft_fugcoef_cpp(xl, m, s, e, t, rhol, cppargs))
-            rhov = pcsaft_den_cpp(xv, m, s, e, t, p_guess, 1, cppargs)        
-            fugcoef_v = np.asarray(pcsaft_fugcoef_cpp(xv, m, s, e, t, rhov, cppargs))
+            rhol = mix.den(xl, t, p_guess, 'liq', rhol)
+            fugcoef_l = mix.fugcoef(xl, t, rhol)
+            rhov = mix.den(xv, t, p_guess, 'vap', rhov)
+            fugcoef_v = mix.fugcoef(xv, t, rhov)
             xl = fugcoef_v*xv/fugcoef_l
             xl = xl/np.sum(xl)
             xv = (mol*x_total - (1-beta)*mol*xl)/beta/mol
@@ -1194,6 +1626,48 @@ def PTzfit(p_guess, x_guess, beta_guess, mol, vol, x_total, m, s, e, t, cppargs)
         error = 100000000.
     return error
 
+def chem_equil(x_guess, m, s, e, t, p, pyargs):
+    """
+    Solve for the speciation of a liquid phase with chemical reactions, e.g. 
+    the dissociation of weak acids and bases.
+
+    The equilibrium condition of each reaction is
+    sum_i nu_i*ln(x_i*phi_i) = ln(K), with the fugacity coefficients phi_i 
+    from PC-SAFT. The composition only changes by the extents of the 
+    reactions, so element balances and the charge balance are kept. 
+    Reactions that do not conserve charge are ignored.
+
+    Parameters
+    ----------
+    x_guess : ndarray, shape (n,)
+        Mole fractions before the reactions (or a previous speciation).
+    m, s, e : ndarray, shape (n,)
+        Segment number, segment diameter (Angstrom) and dispersion energy (K).
+    t : float
+        Temperature (K)
+    p : float
+        Pressure (Pa)
+    pyargs : dict
+        Additional arguments (see pcsaft_den). The reactions are given by
+        
+        rxn_nu : ndarray, shape (r,n)
+            Stoichiometric coefficients of each reaction (negative for the
+            reactants).
+        rxn_lnk : ndarray, shape (r,4)
+            Coefficients A, B, C, D of the equilibrium constant of each 
+            reaction, ln(K) = A + B/T + C*ln(T) + D*T.
+
+    Returns
+    -------
+    x : ndarray, shape (n,)
+        Mole fractions at chemical equilibrium.
+    """
+    cdef add_args cppargs
+    create_struct(cppargs, pyargs, np.asarray(m).size)
+    return vector_to_np(chem_equil_cpp(np_to_vector(x_guess), np_to_vector(m), np_to_vector(s),
+        np_to_vector(e), t, p, cppargs))
+
+
 def aly_lee(t, c):
     """
     Calculate the ideal gas isobaric heat capacity using the Aly-Lee equation.
@@ -1228,36 +1702,131 @@ def dielc_water(t):
     
     This equation was fit to values given in the reference. For temperatures
     from 263.15 to 368.15 K values at 1 bar were used. For temperatures from
-    368.15 to 443.15 K values at 10 bar were used.
+    368.15 to 443.15 K values at 10 bar were used. The same correlation is 
+    used for water in C++ when dielc_model is given (see PyMixture).
     
     Reference:
     D. G. Archer and P. Wang, “The Dielectric Constant of Water and Debye‐Hückel 
     Limiting Law Slopes,” J. Phys. Chem. Ref. Data, vol. 19, no. 2, pp. 371–411, 
     Mar. 1990.
     """
-    if t <= 368.15:
-        dielc = 7.6555618295E-04*t**2 - 8.1783881423E-01*t + 2.5419616803E+02
-    else:
-        dielc = 0.0005003272124*t**2 - 0.6285556029*t + 220.4467027
-    return dielc
+    cdef double ddielc_dt = 0.
+    return dielc_water_cpp(t, ddielc_dt)
     
     
-def np_to_vector(np_array):
+def instrument_snapshot(per_thread=False):
+    """
+    Return the counters of the solver instrumentation.
+
+    The counters are only recorded if the extension was compiled with
+    PCSAFT_INSTRUMENT (e.g. PCSAFT_INSTRUMENT=1 python setup.py build_ext);
+    otherwise None is returned. The times of the contributions to the
+    Helmholtz energy (t_hc_disp, t_polar, t_assoc and t_ion) are in seconds.
+
+    per_thread : bool
+        If True a list with the counters of each thread is returned instead
+        of the sums over all threads.
+    """
+    cdef vector[instrument_counters] snapshot
+    cdef instrument_counters c
+    if not instrument_enabled_cpp():
+        return None
+    snapshot = instrument_snapshot_cpp()
+    threads = []
+    for k in range(snapshot.size()):
+        c = snapshot[k]
+        threads.append({'evals': c.evals, 'den_solves': c.den_solves, 'den_iter': c.den_iter,
+                        'den_newton_fallback': c.den_newton_fallback, 'den_vapor_widen': c.den_vapor_widen,
+                        'den_liquid_restart': c.den_liquid_restart, 'den_unconverged': c.den_unconverged,
+                        'xa_solves': c.xa_solves, 'xa_iter': c.xa_iter, 'xa_unconverged': c.xa_unconverged,
+                        'lu_solves': c.lu_solves, 'lu_rows': c.lu_rows, 'lu_max_rows': c.lu_max_rows,
+                        't_hc_disp': c.t_hc_disp, 't_polar': c.t_polar, 't_assoc': c.t_assoc, 't_ion': c.t_ion})
+    if per_thread:
+        return threads
+    total = dict.fromkeys(['evals', 'den_solves', 'den_iter', 'den_newton_fallback', 'den_vapor_widen',
+                           'den_liquid_restart', 'den_unconverged', 'xa_solves', 'xa_iter', 'xa_unconverged',
+                           'lu_solves', 'lu_rows', 'lu_max_rows', 't_hc_disp', 't_polar', 't_assoc', 't_ion'], 0)
+    for counters in threads:
+        for key in total:
+            if key == 'lu_max_rows':
+                total[key] = max(total[key], counters[key])
+            else:
+                total[key] += counters[key]
+    return total
+
+
+def instrument_reset():
+    """Set the counters of the solver instrumentation of all threads to zero."""
+    instrument_reset_cpp()
+
+
+def trace_start(path):
+    """
+    Start recording the calls of the equation of state to a binary trace
+    file, which can be replayed with benchmarks/pcsaft_replay.cpp.
+
+    Calls are only recorded if the extension was compiled with PCSAFT_TRACE
+    (e.g. PCSAFT_TRACE=1 python setup.py build_ext). Returns True if the
+    trace was started.
+    """
+    return trace_start_cpp(path.encode())
+
+
+def trace_stop():
+    """Stop recording calls and close the trace file."""
+    trace_stop_cpp()
+
+
+def as_view(np_array):
+    """Return the array as a contiguous float64 array that can be passed as a memoryview."""
+    return np.ascontiguousarray(np_array, dtype=np.float64).ravel()
+
+
+cdef vector[double] np_to_vector(np_array):
     """Take a numpy array and return a C++ vector."""
-    np_array = np_array.flatten()
-    N = np_array.shape[0]
     cdef vector[double] cpp_vector
-    
-    for i in range(N):
-        cpp_vector.push_back(np_array[i])   
+    cdef double[::1] view = as_view(np_array)
+    if view.shape[0] > 0:
+        cpp_vector.assign(&view[0], &view[0] + view.shape[0])
     return cpp_vector
-    
-def create_struct(pyargs):
-    """Convert additional arguments to a C++ struct."""
-    cdef add_args cppargs
 
+
+cdef vector[double] pair_to_vector(params, int ncomp):
+    """
+    Convert symmetric interaction parameters to a packed C++ vector.
+
+    The parameters can be given as a symmetric (n,n) matrix, as the packed
+    upper triangle of length n*(n+1)/2, or as a dict {(i, j): value}
+    holding only the nonzero parameters. A matrix that is not symmetric
+    raises ValueError, as only one of (i, j) and (j, i) is kept. If all
+    of the parameters are zero an empty vector is returned, so that the
+    parameter does not cost anything in the calculations.
+    """
+    cdef vector[double] cpp_vector
+    if isinstance(params, dict):
+        packed = np.zeros(ncomp*(ncomp+1)//2)
+        for (i, j), value in params.items():
+            if i > j:
+                i, j = j, i
+            packed[i*ncomp - i*(i-1)//2 + j - i] = value
+    else:
+        params = np.asarray(params, dtype=np.float64)
+        if params.size == ncomp*ncomp and ncomp > 1:
+            params = params.reshape(ncomp, ncomp)
+            if not np.allclose(params, params.T):
+                raise ValueError('the matrix of interaction parameters is not symmetric')
+            packed = params[np.triu_indices(ncomp)]
+        else:
+            packed = params.ravel()
+    if np.any(packed != 0):
+        cpp_vector = np_to_vector(packed)
+    return cpp_vector
+
+
+cdef void create_struct(add_args &cppargs, pyargs, int ncomp):
+    """Convert additional arguments to a C++ struct."""
     if 'k_ij' in pyargs:
-        cppargs.k_ij = np_to_vector(pyargs['k_ij'])
+        cppargs.k_ij = pair_to_vector(pyargs['k_ij'], ncomp)
     if 'e_assoc' in pyargs:
         cppargs.e_assoc = np_to_vector(pyargs['e_assoc'])
     if 'vol_a' in pyargs:
@@ -1270,9 +1839,320 @@ def create_struct(pyargs):
         cppargs.z = np_to_vector(pyargs['z'])
     if 'dielc' in pyargs:
         cppargs.dielc = pyargs['dielc']
+    if 'dielc_model' in pyargs:
+        cppargs.dielc_model = [int(v) for v in np.ravel(pyargs['dielc_model'])]
+        cppargs.dielc_coef = np_to_vector(pyargs.get('dielc_coef', np.zeros((ncomp, 3))))
     if 'k_hb' in pyargs:
-        cppargs.k_hb = np_to_vector(pyargs['k_hb'])
+        cppargs.k_hb = pair_to_vector(pyargs['k_hb'], ncomp)
     if 'l_ij' in pyargs:
-        cppargs.l_ij = np_to_vector(pyargs['l_ij'])
-    
-    return cppargs
+        cppargs.l_ij = pair_to_vector(pyargs['l_ij'], ncomp)
+    if 'rxn_nu' in pyargs:
+        cppargs.rxn_nu = np_to_vector(pyargs['rxn_nu'])
+    if 'rxn_lnk' in pyargs:
+        cppargs.rxn_lnk = np_to_vector(pyargs['rxn_lnk'])
+
+
+cdef vector_to_np(const vector[double] &cpp_vector):
+    """Copy a C++ vector into a new numpy array."""
+    result = np.empty(cpp_vector.size(), dtype=np.float64)
+    cdef double[::1] view = result
+    cdef size_t i
+    for i in range(cpp_vector.size()):
+        view[i] = cpp_vector[i]
+    return result
+
+
+cdef class PyMixture:
+    """
+    Parameters of a mixture converted once to C++ types.
+
+    Creating a PyMixture converts m, s, e and the additional arguments to
+    C++ vectors and an add_args struct a single time. The methods then only
+    need to pass the state to the C++ functions, which makes them suitable
+    for use inside solver loops. Mole fractions are accepted as contiguous
+    float64 arrays (typed memoryviews) and are written into buffers owned
+    by the mixture, so repeated calls do not allocate.
+
+    Parameters
+    ----------
+    m : ndarray, shape (n,)
+        Segment number for each component.
+    s : ndarray, shape (n,)
+        Segment diameter for each component. For ions this is the diameter of
+        the hydrated ion. Units of Angstrom.
+    e : ndarray, shape (n,)
+        Dispersion energy of each component. For ions this is the dispersion
+        energy of the hydrated ion. Units of K.
+    pyargs : dict
+        A dictionary containing additional arguments that can be passed for 
+        use in PC-SAFT. The same keys as for the other functions are used
+        (k_ij, e_assoc, vol_a, dipm, dip_num, z, dielc, k_hb, l_ij, rxn_nu, 
+        rxn_lnk). k_ij, k_hb
+        and l_ij can also be given as the packed upper triangle or as a dict
+        {(i, j): value}. Instead of a constant dielc, the dielectric constant
+        can be calculated for each state from the solvents:
+
+        dielc_model : ndarray, shape (n,)
+            Model for the dielectric constant of each component: 0 = not a
+            solvent (e.g. ions), 1 = water (dielc_water), 2 = a + b*T + c*T^2.
+            The dielectric constant of the mixture is the mole fraction 
+            average over the solvents, on a salt free basis, and its 
+            temperature and composition derivatives are included in the 
+            fugacity coefficients and the residual enthalpy and entropy.
+        dielc_coef : ndarray, shape (n,3)
+            Coefficients a, b, c for the components with model 2.
+    cache_size : int
+        Number of densities and fugacity coefficients to keep. If it is 
+        greater than 0, den and fugcoef return the stored result when they are
+        called again for exactly the same state, e.g. when a minimizer 
+        evaluates the same pressure more than once. See cache_stats.
+    """
+    cdef vector[double] m, s, e
+    cdef add_args cppargs
+    cdef vector[double] xbuf, xbuf2
+    cdef solvent_ref_cache ref_cache
+    cdef eos_cache cache
+    cdef mixing_cache mixing
+
+    def __cinit__(self, m, s, e, pyargs=None, cache_size=0):
+        self.m = np_to_vector(m)
+        self.s = np_to_vector(s)
+        self.e = np_to_vector(e)
+        if pyargs:
+            create_struct(self.cppargs, pyargs, self.m.size())
+        # the pair tables and the dipole subset are calculated once for all methods
+        mixing_cache_setup_cpp(self.m, self.s, self.e, self.cppargs, self.mixing)
+        if cache_size > 0:
+            eos_cache_resize_cpp(self.cache, cache_size)
+
+    cdef inline void load(self, vector[double] &buf, const double[::1] x):
+        """Copy the mole fractions into one of the buffers of the mixture."""
+        buf.resize(x.shape[0])
+        cdef Py_ssize_t i
+        for i in range(x.shape[0]):
+            buf[i] = x[i]
+
+    @property
+    def ncomp(self):
+        return self.m.size()
+
+    @property
+    def ions(self):
+        """True if the mixture contains charged components."""
+        return not self.cppargs.z.empty()
+
+    @property
+    def z(self):
+        return vector_to_np(self.cppargs.z)
+
+    def p(self, const double[::1] x, double t, double rho):
+        """Calculate pressure (Pa). See pcsaft_p."""
+        self.load(self.xbuf, x)
+        return pcsaft_p_cpp(self.xbuf, self.m, self.s, self.e, t, rho, self.cppargs)
+
+    def Z(self, const double[::1] x, double t, double rho):
+        """Calculate the compressibility factor. See pcsaft_Z."""
+        self.load(self.xbuf, x)
+        return pcsaft_Z_cpp(self.xbuf, self.m, self.s, self.e, t, rho, self.cppargs)
+
+    def fugcoef(self, const double[::1] x, double t, double rho):
+        """Calculate the fugacity coefficients. See pcsaft_fugcoef."""
+        self.load(self.xbuf, x)
+        return vector_to_np(pcsaft_fugcoef_cached_cpp(self.xbuf, self.m, self.s, self.e, t, rho, self.cppargs,
+                                                      self.cache))
+
+    def den(self, const double[::1] x, double t, double p, phase='liq', double rho_guess=0., bracket=None):
+        """Calculate the molar density (mol m^-3). See pcsaft_den."""
+        cdef int phase_num = 0 if (phase == 'liq' or phase == 0) else 1
+        cdef double rho_lo = 0., rho_hi = 0.
+        if bracket is not None:
+            rho_lo, rho_hi = bracket
+        if not rho_guess > 0: # e.g. NaN from a previous iteration that failed
+            rho_guess = 0.
+        self.load(self.xbuf, x)
+        if bracket is None:
+            return pcsaft_den_cached_cpp(self.xbuf, self.m, self.s, self.e, t, p, phase_num, self.cppargs,
+                                         self.cache, rho_guess)
+        return pcsaft_den_cpp(self.xbuf, self.m, self.s, self.e, t, p, phase_num, self.cppargs, rho_guess,
+                              rho_lo, rho_hi)
+
+    def cache_stats(self):
+        """
+        Return the number of hits, misses and evictions of the cache of 
+        densities and fugacity coefficients, the number of stored results 
+        (size) and the fraction of the lookups that were hits (hit_rate).
+        """
+        cdef eos_cache_stats stats = eos_cache_stats_cpp(self.cache)
+        lookups = stats.hits + stats.misses
+        return {'hits': stats.hits, 'misses': stats.misses, 'evictions': stats.evictions, 'size': stats.size,
+                'hit_rate': stats.hits/lookups if lookups > 0 else 0.}
+
+    def resize_cache(self, size_t cache_size):
+        """Set the size of the cache (0 disables it) and reset its counters."""
+        eos_cache_resize_cpp(self.cache, cache_size)
+
+    def ares(self, const double[::1] x, double t, double rho):
+        """Calculate the residual Helmholtz energy. See pcsaft_ares."""
+        self.load(self.xbuf, x)
+        return pcsaft_ares_cpp(self.xbuf, self.m, self.s, self.e, t, rho, self.cppargs)
+
+    def dadt(self, const double[::1] x, double t, double rho):
+        """Calculate the temperature derivative of the residual Helmholtz energy. See pcsaft_dadt."""
+        self.load(self.xbuf, x)
+        return pcsaft_dadt_cpp(self.xbuf, self.m, self.s, self.e, t, rho, self.cppargs)
+
+    def hres(self, const double[::1] x, double t, double rho):
+        """Calculate the residual enthalpy (J mol^-1). See pcsaft_hres."""
+        self.load(self.xbuf, x)
+        return pcsaft_hres_cpp(self.xbuf, self.m, self.s, self.e, t, rho, self.cppargs)
+
+    def sres(self, const double[::1] x, double t, double rho):
+        """Calculate the residual entropy (J mol^-1 K^-1). See pcsaft_sres."""
+        self.load(self.xbuf, x)
+        return pcsaft_sres_cpp(self.xbuf, self.m, self.s, self.e, t, rho, self.cppargs)
+
+    def gres(self, const double[::1] x, double t, double rho):
+        """Calculate the residual Gibbs energy (J mol^-1). See pcsaft_gres."""
+        self.load(self.xbuf, x)
+        return pcsaft_gres_cpp(self.xbuf, self.m, self.s, self.e, t, rho, self.cppargs)
+
+    def Z_batch(self, const double[::1] x, t, rho):
+        """
+        Calculate the compressibility factor for many states with the same
+        composition. t and rho are arrays with one entry per state. The
+        states are evaluated together using SIMD instructions where possible.
+        """
+        self.load(self.xbuf, x)
+        return vector_to_np(pcsaft_Z_batch_cpp(self.xbuf, self.m, self.s, self.e, np_to_vector(t),
+            np_to_vector(rho), self.cppargs))
+
+    def fugcoef_batch(self, const double[::1] x, t, rho):
+        """
+        Calculate the fugacity coefficients for many states with the same
+        composition. Returns an array with one row per state.
+        """
+        self.load(self.xbuf, x)
+        lnfugcoef = vector_to_np(pcsaft_lnfugcoef_batch_cpp(self.xbuf, self.m, self.s, self.e, np_to_vector(t),
+            np_to_vector(rho), self.cppargs))
+        return np.exp(lnfugcoef).reshape(-1, x.shape[0])
+
+    def den_batch(self, const double[::1] x, t, p, phase='liq'):
+        """
+        Calculate the molar density (mol m^-3) for many states with the same
+        composition. t and p are arrays with one entry per state.
+        """
+        cdef int phase_num = 0 if (phase == 'liq' or phase == 0) else 1
+        self.load(self.xbuf, x)
+        return vector_to_np(pcsaft_den_batch_cpp(self.xbuf, self.m, self.s, self.e, np_to_vector(t),
+            np_to_vector(p), phase_num, self.cppargs))
+
+    def activity(self, x, t, p, int solvent, double mw_solvent=18.0153):
+        """
+        Calculate activity and osmotic coefficients. See pcsaft_activity. The
+        reference states of the solvent are kept by the mixture, so later
+        calls at the same temperature and pressure reuse them.
+        """
+        return self.activity_cached(x, t, p, solvent, mw_solvent, self.ref_cache)
+
+    cdef activity_cached(self, x, t, p, int solvent, double mw_solvent, solvent_ref_cache &ref_cache):
+        """Calculate activity and osmotic coefficients with the reference states of ref_cache."""
+        x = np.asarray(x, dtype=np.float64)
+        single = x.ndim == 1
+        x = np.atleast_2d(x)
+        cdef int nstates = x.shape[0]
+        t = np.full(nstates, t, dtype=np.float64) if np.ndim(t) == 0 else t
+        p = np.full(nstates, p, dtype=np.float64) if np.ndim(p) == 0 else p
+        cdef vector[activity_result] res = pcsaft_activity_batch_cpp(np_to_vector(x), self.m, self.s,
+            self.e, np_to_vector(t), np_to_vector(p), solvent, mw_solvent, self.cppargs, ref_cache)
+        result = {'gamma_x': np.asarray([vector_to_np(r.gamma_x) for r in res]),
+                  'gamma_m': np.asarray([vector_to_np(r.gamma_m) for r in res]),
+                  'molality': np.asarray([vector_to_np(r.molality) for r in res]),
+                  'gamma_pm': np.asarray([r.gamma_pm for r in res]),
+                  'osmotic': np.asarray([r.osmotic for r in res])}
+        if single:
+            result = {key: value[0] for key, value in result.items()}
+        return result
+
+
+cdef class ParamDB:
+    """
+    Database of component parameters, written by tools/pcsaft_db (see
+    pcsaft_db.cpp).
+
+    The file is memory-mapped instead of parsed, so opening it takes the
+    same time for any number of components, and processes that open the
+    same file share its memory. The parameters of a mixture are assembled
+    from the components and the stored binary interaction parameters.
+
+    Parameters
+    ----------
+    path : str
+        Path of the database.
+    """
+    cdef param_db db
+
+    def __cinit__(self, path):
+        if not param_db_open_cpp(path.encode(), self.db):
+            raise IOError('{} is not a valid parameter database'.format(path))
+
+    def __dealloc__(self):
+        param_db_close_cpp(self.db)
+
+    def __len__(self):
+        return self.db.ncomp
+
+    def names(self):
+        """Return the names of the components, in the order of their ids."""
+        return [param_db_name_cpp(self.db, i).decode() for i in range(self.db.ncomp)]
+
+    def find(self, name):
+        """Return the id of a component, or -1 if the database does not contain it."""
+        return param_db_find_cpp(self.db, name.encode())
+
+    cdef vector[int] ids(self, names):
+        cdef vector[int] ids
+        for name in names:
+            ids.push_back(self.find(name) if isinstance(name, str) else name)
+            if ids.back() < 0 or ids.back() >= <int>self.db.ncomp:
+                raise KeyError(name)
+        return ids
+
+    def params(self, names):
+        """
+        Return m, s, e and pyargs of the mixture of the components, given by
+        name or id, for the functions of this module. As for the other
+        functions, the parameters that are zero for all components are left
+        out of pyargs. dielc, which the database does not contain, must be
+        added to pyargs for mixtures with ions but without dielc_model.
+        """
+        cdef vector[double] m, s, e
+        cdef add_args cppargs
+        param_db_mixture_cpp(self.db, self.ids(names), m, s, e, cppargs)
+        ncomp = m.size()
+        pyargs = {}
+        for key, value in [('k_ij', cppargs.k_ij), ('l_ij', cppargs.l_ij), ('k_hb', cppargs.k_hb)]:
+            if value.size() > 0:
+                pyargs[key] = vector_to_np(value).reshape(ncomp, ncomp)
+        for key, value in [('e_assoc', cppargs.e_assoc), ('vol_a', cppargs.vol_a), ('dipm', cppargs.dipm),
+                           ('dip_num', cppargs.dip_num), ('z', cppargs.z)]:
+            if value.size() > 0:
+                pyargs[key] = vector_to_np(value)
+        if cppargs.dielc_model.size() > 0:
+            pyargs['dielc_model'] = np.asarray(cppargs.dielc_model)
+            pyargs['dielc_coef'] = vector_to_np(cppargs.dielc_coef).reshape(ncomp, 3)
+        return vector_to_np(m), vector_to_np(s), vector_to_np(e), pyargs
+
+    def mixture(self, names, cache_size=0, dielc=None):
+        """
+        Return a PyMixture of the components, given by name or id, without
+        converting the parameters to numpy arrays. See params. dielc is the
+        dielectric constant of mixtures with ions but without dielc_model,
+        for which it is required.
+        """
+        cdef PyMixture mix = PyMixture(np.zeros(0), np.zeros(0), np.zeros(0), None, cache_size)
+        param_db_mixture_cpp(self.db, self.ids(names), mix.m, mix.s, mix.e, mix.cppargs)
+        if dielc is not None:
+            mix.cppargs.dielc = dielc
+        elif mix.cppargs.z.size() > 0 and mix.cppargs.dielc_model.size() == 0:
+            raise ValueError('dielc is required for a mixture with ions but without dielc_model')
+        return mix
@@ -0,0 +1,1017 @@
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <Eigen/Dense>
+
+#include "pcsaft_internal.h"
+
+using namespace std;
+using namespace Eigen;
+
+/*
+Regression of PC-SAFT parameters.
+
+Pure component parameters are fit to density, vapor pressure and enthalpy of
+vaporization data, and the interaction parameters of a binary mixture to
+bubble point and PTz data, with the Levenberg-Marquardt method. Each data point
+is independent of the others, so the residuals and the rows of the Jacobian are
+evaluated in parallel with OpenMP when the code is compiled with OpenMP support.
+The phase equilibrium of each data point is warm started from its solution for
+the previous parameters.
+
+The sensitivities of the residuals with respect to the parameters are taken
+from central differences. The densities are solved with Newton's method,
+starting from the density of the phase in the previous iteration of the
+equilibrium solvers, and the equilibria are solved to a tight tolerance, so
+that the differences are not dominated by the tolerance of the solvers.
+*/
+
+const static double NaN = numeric_limits<double>::quiet_NaN();
+
+
+static double den_refined(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double p, int phase, add_args &cppargs, double rho_guess = 0.,
+    const solver_tol *tol = NULL) {
+    /**
+    Solve for the density with Newton's method on the pressure.
+
+    If rho_guess is given (e.g. the density of the same phase in the previous
+    iteration of an outer solver) Newton's method starts from it. Otherwise,
+    or if the iterations leave the branch of the phase, the density is solved
+    with pcsaft_den_cpp and refined with one Newton step. NaN is returned if
+    pcsaft_den_cpp did not find a density for the pressure. The iterations
+    stop when the relative Newton step is below tol->den (1e-12 if tol is
+    NULL). With tol the fractions of unbonded association sites are carried
+    between the Newton iterations, and tol is passed on to the pressure.
+    */
+    double rho, h, P1, P2, step;
+    double step_tol = (tol != NULL) ? tol->den : 1e-12;
+    vector<double> XA, XA_h;
+    if (rho_guess > 0) {
+        rho = rho_guess;
+        for (int iter = 0; iter < 10; iter++) {
+            h = rho*1e-7;
+            P1 = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs, (tol != NULL) ? &XA : NULL, tol);
+            XA_h = XA;
+            P2 = pcsaft_p_cpp(x, m, s, e, t, rho + h, cppargs, (tol != NULL) ? &XA_h : NULL, tol);
+            step = (P1 - p)*h/(P2 - P1);
+            if (P2 <= P1 || !(fabs(step) < 0.2*rho)) {
+                break;
+            }
+            rho -= step;
+            if (fabs(step) < step_tol*rho) {
+                return rho;
+            }
+        }
+    }
+
+    rho = pcsaft_den_cpp(x, m, s, e, t, p, phase, cppargs);
+    h = rho*1e-7;
+    P1 = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs);
+    P2 = pcsaft_p_cpp(x, m, s, e, t, rho + h, cppargs);
+    if (fabs(P1 - p) > 1e-3*p || P2 <= P1) {
+        return NaN;
+    }
+    return rho - (P1 - p)*h/(P2 - P1);
+}
+
+
+static bool vaporP_solve(double p_guess, const vector<double> &x, const vector<double> &m,
+    const vector<double> &s, const vector<double> &e, double t, add_args &cppargs, double &lnp,
+    double &step, double &rho_l, double &rho_v, double &Z_l, double &Z_v, vector<double> &fugcoef_l,
+    vector<double> &fugcoef_v) {
+    /**
+    Solve for the vapor pressure (see pcsaft_vaporP_cpp).
+
+    On convergence lnp is the log of the pressure at which the densities,
+    compressibility factors and fugacity coefficients of both phases were
+    evaluated last, and step is the final Newton step. Returns false if the
+    solver did not converge.
+    */
+    int ncomp = x.size();
+    double p, f;
+    lnp = log(p_guess);
+    rho_l = 0.;
+    rho_v = 0.;
+    int trivial = 0;
+    for (int iter = 0; iter < 100; iter++) {
+        p = exp(lnp);
+        rho_l = den_refined(x, m, s, e, t, p, 0, cppargs, rho_l);
+        rho_v = den_refined(x, m, s, e, t, p, 1, cppargs, rho_v);
+        Z_l = pcsaft_Z_cpp(x, m, s, e, t, rho_l, cppargs);
+        Z_v = pcsaft_Z_cpp(x, m, s, e, t, rho_v, cppargs);
+        if (fabs(rho_l - rho_v) < 1e-3*rho_l) {
+            // only one phase was found at this pressure, so move towards the
+            // pressures where the missing phase exists
+            trivial += 1;
+            if (trivial > 20) {
+                return false;
+            }
+            lnp += (Z_l < 0.3) ? -0.5 : 0.5;
+            rho_l = rho_v = 0.;
+            continue;
+        }
+        fugcoef_l = pcsaft_fugcoef_cpp(x, m, s, e, t, rho_l, cppargs);
+        fugcoef_v = pcsaft_fugcoef_cpp(x, m, s, e, t, rho_v, cppargs);
+        f = 0;
+        for (int i = 0; i < ncomp; i++) {
+            f += x[i]*log(fugcoef_l[i]/fugcoef_v[i]);
+        }
+        step = -f/(Z_l - Z_v);
+        if (!isfinite(step)) {
+            return false;
+        }
+        if (step > 1) {
+            step = 1;
+        }
+        else if (step < -1) {
+            step = -1;
+        }
+        if (fabs(step) < 1e-8) {
+            return true;
+        }
+        lnp += step;
+    }
+    return false;
+}
+
+
+double pcsaft_vaporP_cpp(double p_guess, const vector<double> &x, const vector<double> &m,
+    const vector<double> &s, const vector<double> &e, double t, add_args &cppargs) {
+    /**
+    Calculate the vapor pressure of a pure component.
+
+    Newton's method is used on ln(p) for the equality of the fugacity of the
+    liquid and vapor phases. For a pure component the derivative of
+    ln(phi_l/phi_v) with respect to ln(p) is Z_l - Z_v. For a mixture the
+    mole fraction weighted sum of ln(phi_l/phi_v) is used, which treats the
+    mixture as a pseudo-pure component with the same composition in both phases.
+
+    Parameters
+    ----------
+    p_guess : double
+        Guess for the vapor pressure (Pa)
+    x : vector<double>, shape (n,)
+        Mole fractions of each component (a single 1 for a pure component).
+    m, s, e : vector<double>, shape (n,)
+        Segment number, segment diameter (Angstrom) and dispersion energy (K).
+    t : double
+        Temperature (K)
+    cppargs : add_args
+        A struct containing additional arguments (see pcsaft_Z_cpp).
+
+    Returns
+    -------
+    Pvap : double
+        Vapor pressure (Pa). NaN is returned if the solver does not converge,
+        which happens for example above the critical temperature.
+    */
+    double lnp, step, rho_l, rho_v, Z_l, Z_v;
+    vector<double> fugcoef_l, fugcoef_v;
+    if (!vaporP_solve(p_guess, x, m, s, e, t, cppargs, lnp, step, rho_l, rho_v, Z_l, Z_v,
+        fugcoef_l, fugcoef_v)) {
+        return NaN;
+    }
+    return exp(lnp + step);
+}
+
+
+saturation_result pcsaft_saturation_cpp(double p_guess, const vector<double> &x, const vector<double> &m,
+    const vector<double> &s, const vector<double> &e, double t, add_args &cppargs) {
+    /**
+    Calculate the vapor pressure along with the densities and the residual
+    properties of both coexisting phases.
+
+    The properties are evaluated at the state of the last iteration of the
+    vapor pressure solver, so its densities, compressibility factors and
+    fugacity coefficients are reused: the residual Gibbs energy is
+    R*T*sum(x_i*ln(phi_i)) and only the temperature derivative of the
+    residual Helmholtz energy is evaluated in addition for each phase.
+
+    Parameters
+    ----------
+    p_guess : double
+        Guess for the vapor pressure (Pa)
+    x : vector<double>, shape (n,)
+        Mole fractions of each component (a single 1 for a pure component).
+    m, s, e : vector<double>, shape (n,)
+        Segment number, segment diameter (Angstrom) and dispersion energy (K).
+    t : double
+        Temperature (K)
+    cppargs : add_args
+        A struct containing additional arguments (see pcsaft_Z_cpp).
+
+    Returns
+    -------
+    result : saturation_result
+        All values are NaN if the vapor pressure solver does not converge.
+    */
+    saturation_result result;
+    result.p = result.rho_l = result.rho_v = NaN;
+    result.hres_l = result.hres_v = result.sres_l = result.sres_v = NaN;
+    result.gres_l = result.gres_v = result.hvap = NaN;
+
+    double lnp, step, Z_l, Z_v;
+    vector<double> fugcoef_l, fugcoef_v;
+    if (!vaporP_solve(p_guess, x, m, s, e, t, cppargs, lnp, step, result.rho_l, result.rho_v, Z_l, Z_v,
+        fugcoef_l, fugcoef_v)) {
+        return result;
+    }
+    result.p = exp(lnp);
+
+    int ncomp = x.size();
+    double RT = kb*N_AV*t;
+    result.gres_l = 0.;
+    result.gres_v = 0.;
+    for (int i = 0; i < ncomp; i++) {
+        result.gres_l += x[i]*log(fugcoef_l[i])*RT;
+        result.gres_v += x[i]*log(fugcoef_v[i])*RT;
+    }
+    double dadt_l = pcsaft_dadt_cpp(x, m, s, e, t, result.rho_l, cppargs);
+    double dadt_v = pcsaft_dadt_cpp(x, m, s, e, t, result.rho_v, cppargs);
+    result.hres_l = (-t*dadt_l + (Z_l-1))*RT; // Equation A.46 from Gross and Sadowski 2001
+    result.hres_v = (-t*dadt_v + (Z_v-1))*RT;
+    result.sres_l = (result.hres_l - result.gres_l)/t;
+    result.sres_v = (result.hres_v - result.gres_v)/t;
+    result.hvap = result.hres_v - result.hres_l;
+    return result;
+}
+
+
+double pcsaft_bubbleP_cpp(double p_guess, vector<double> &xv, const vector<double> &x,
+    const vector<double> &m, const vector<double> &s, const vector<double> &e, double t,
+    add_args &cppargs) {
+    /**
+    Calculate the bubble point pressure and the vapor composition of a mixture.
+
+    The pressure and the vapor composition are updated together by successive
+    substitution: with K_i = phi_l,i/phi_v,i and S = sum(K_i*x_i) the new
+    pressure is p*S and the new vapor composition is K_i*x_i/S. For
+    electrolytes the ions are assumed to be nonvolatile. The densities and
+    the association term are solved with tolerances that follow the residual
+    of the previous iteration (see solver_tol_budget), so they are only
+    solved tightly in the last iterations.
+
+    Parameters
+    ----------
+    p_guess : double
+        Guess for the bubble point pressure (Pa)
+    xv : vector<double>, shape (n,)
+        Guess for the vapor composition. On return it contains the vapor
+        composition at the bubble point, so it can be used to warm start the
+        next calculation.
+    x : vector<double>, shape (n,)
+        Liquid mole fractions.
+    m, s, e : vector<double>, shape (n,)
+        Segment number, segment diameter (Angstrom) and dispersion energy (K).
+    t : double
+        Temperature (K)
+    cppargs : add_args
+        A struct containing additional arguments (see pcsaft_Z_cpp).
+
+    Returns
+    -------
+    P : double
+        Bubble point pressure (Pa). NaN is returned if the solver does not
+        converge, or if the vapor phase collapses onto the liquid phase.
+    */
+    int ncomp = x.size();
+    bool ions = !cppargs.z.empty();
+    double p = p_guess;
+    double rho_l = 0., rho_v = 0., summ, dif;
+    vector<double> fugcoef_l, fugcoef_v;
+    vector<double> K (ncomp);
+    solver_tol tol_final, tol;
+    tol_final.den = 1e-12; // relative Newton step of den_refined, as the fits take differences of the results
+    double residual = 1.;
+    for (int iter = 0; iter < 200; iter++) {
+        tol = solver_tol_budget(tol_final, residual);
+        rho_l = den_refined(x, m, s, e, t, p, 0, cppargs, rho_l, &tol);
+        rho_v = den_refined(xv, m, s, e, t, p, 1, cppargs, rho_v, &tol);
+        if (isnan(rho_v)) {
+            // the vapor guess may have no vapor root yet, but the closest density
+            // still moves the composition in the right direction
+            rho_v = pcsaft_den_cpp(xv, m, s, e, t, p, 1, cppargs);
+        }
+        fugcoef_l = pcsaft_fugcoef_cpp(x, m, s, e, t, rho_l, cppargs, &tol);
+        fugcoef_v = pcsaft_fugcoef_cpp(xv, m, s, e, t, rho_v, cppargs, &tol);
+        if (!(fabs(rho_l - rho_v) >= 1e-3*rho_l)) {
+            return NaN;
+        }
+        summ = 0.;
+        for (int i = 0; i < ncomp; i++) {
+            K[i] = (ions && cppargs.z[i] != 0) ? 0. : fugcoef_l[i]/fugcoef_v[i];
+            summ += K[i]*x[i];
+        }
+        if (!isfinite(summ) || summ <= 0) {
+            return NaN;
+        }
+        dif = 0.;
+        for (int i = 0; i < ncomp; i++) {
+            dif += fabs(K[i]*x[i]/summ - xv[i]);
+            xv[i] = K[i]*x[i]/summ;
+        }
+        p *= summ;
+        residual = fabs(summ - 1) + dif;
+        if (fabs(summ - 1) < 1e-10 && dif < 1e-10 && tol.den == tol_final.den) {
+            return p;
+        }
+    }
+    return NaN;
+}
+
+
+static int rachford_rice(const vector<double> &z, const vector<double> &K, double &beta) {
+    /**
+    Solve the Rachford-Rice equation for the vapor fraction beta. Returns 0 if
+    a solution between 0 and 1 was found, or -1 (liquid) or 1 (vapor) if the
+    mixture is a single phase for these K values.
+    */
+    int ncomp = z.size();
+    double f0 = 0., f1 = 0.;
+    for (int i = 0; i < ncomp; i++) {
+        f0 += z[i]*(K[i] - 1);
+        if (K[i] > 0) {
+            f1 += z[i]*(K[i] - 1)/K[i];
+        }
+        else if (z[i] > 0) {
+            f1 = -numeric_limits<double>::infinity(); // a nonvolatile component (K = 0) keeps a liquid
+        }
+    }
+    if (f0 <= 0) {
+        beta = 0.;
+        return -1;
+    }
+    if (f1 >= 0) {
+        beta = 1.;
+        return 1;
+    }
+
+    double lo = 0., hi = 1., f, df;
+    beta = isnan(beta) ? 0.5 : min(max(beta, 0.), 1.);
+    for (int iter = 0; iter < 100; iter++) {
+        f = 0.;
+        df = 0.;
+        for (int i = 0; i < ncomp; i++) {
+            f += z[i]*(K[i] - 1)/(1 + beta*(K[i] - 1));
+            df -= z[i]*(K[i] - 1)*(K[i] - 1)/pow(1 + beta*(K[i] - 1), 2);
+        }
+        if (f > 0) {
+            lo = beta;
+        }
+        else {
+            hi = beta;
+        }
+        beta -= f/df;
+        if (!(beta > lo && beta < hi)) {
+            beta = (lo + hi)/2; // fall back to bisection when the Newton step leaves the bracket
+        }
+        if (hi - lo < 1e-14 || fabs(f) < 1e-14) {
+            break;
+        }
+    }
+    return 0;
+}
+
+
+static bool flash_init(double p, double t, const vector<double> &z, const vector<double> &m,
+    const vector<double> &s, const vector<double> &e, add_args &cppargs, vector<double> &K) {
+    /**
+    Initialize the K values of a PT flash with a stability test of the
+    overall composition z. A vapor-like trial phase is tested against z as
+    the liquid, and a liquid-like trial phase against z as the vapor, each by
+    successive substitution starting from an ideal gas. Returns true and the
+    K values of the trial phase if z is unstable, false otherwise.
+    */
+    int ncomp = z.size();
+    bool ions = !cppargs.z.empty();
+    vector<double> w (ncomp), fugcoef_z, fugcoef_w;
+    double rho_z, rho_w = 0., summ;
+    K.assign(ncomp, 0.);
+    for (int trial = 0; trial < 2; trial++) {
+        // trial 0: z is the liquid, the trial phase is a vapor; trial 1: the reverse
+        rho_z = pcsaft_den_cpp(z, m, s, e, t, p, trial, cppargs);
+        fugcoef_z = pcsaft_fugcoef_cpp(z, m, s, e, t, rho_z, cppargs);
+        summ = 0.;
+        for (int i = 0; i < ncomp; i++) {
+            K[i] = (ions && cppargs.z[i] != 0) ? 0. : ((trial == 0) ? fugcoef_z[i] : 1./fugcoef_z[i]);
+            w[i] = (trial == 0) ? K[i]*z[i] : ((K[i] > 0) ? z[i]/K[i] : 0.);
+            summ += w[i];
+        }
+        for (int iter = 0; iter < 50 && isfinite(summ) && summ > 0; iter++) {
+            for (int i = 0; i < ncomp; i++) {
+                w[i] /= summ;
+            }
+            rho_w = pcsaft_den_cpp(w, m, s, e, t, p, 1 - trial, cppargs);
+            if (fabs(rho_w - rho_z) < 1e-3*rho_z) {
+                break; // trivial solution
+            }
+            fugcoef_w = pcsaft_fugcoef_cpp(w, m, s, e, t, rho_w, cppargs);
+            double summ_new = 0.;
+            for (int i = 0; i < ncomp; i++) {
+                if (!(ions && cppargs.z[i] != 0)) {
+                    K[i] = (trial == 0) ? fugcoef_z[i]/fugcoef_w[i] : fugcoef_w[i]/fugcoef_z[i];
+                }
+                w[i] = (trial == 0) ? K[i]*z[i] : ((K[i] > 0) ? z[i]/K[i] : 0.);
+                summ_new += w[i];
+            }
+            if (fabs(summ_new - summ) < 1e-10*summ) {
+                summ = summ_new;
+                break;
+            }
+            summ = summ_new;
+        }
+        if (isfinite(summ) && summ > 1 + 1e-8 && fabs(rho_w - rho_z) >= 1e-3*rho_z) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+bool pcsaft_flash_cpp(double p, double t, const vector<double> &z, const vector<double> &m,
+    const vector<double> &s, const vector<double> &e, add_args &cppargs, vector<double> &K, double &beta,
+    double &rho_l, double &rho_v) {
+    /**
+    Isothermal flash of a mixture at t and p by successive substitution of
+    the K values.
+
+    Parameters
+    ----------
+    p : double
+        Pressure (Pa)
+    t : double
+        Temperature (K)
+    z : vector<double>, shape (n,)
+        Mole fractions of the feed.
+    m, s, e : vector<double>, shape (n,)
+        Segment number, segment diameter (Angstrom) and dispersion energy (K).
+    cppargs : add_args
+        A struct containing additional arguments (see pcsaft_Z_cpp). Charged
+        components stay in the liquid (K = 0).
+    K, beta, rho_l, rho_v : vector<double>, shape (n,), and double
+        K values, vapor fraction and densities of the liquid and the vapor
+        (mol m^-3). They are used as the initial guess and contain the
+        solution on return. If K is empty, or if the K values of the previous
+        solution do not give two phases, they are initialized with a
+        stability test (see flash_init).
+
+    Returns
+    -------
+    converged : bool
+        True if the K values converged. For two phases the compositions are
+        x_i = z_i/(1 + beta*(K_i - 1)) and y_i = K_i*x_i. A single phase has
+        beta = 0 (liquid, density rho_l) or 1 (vapor, density rho_v). beta is
+        NaN if the iterations failed.
+    */
+    int ncomp = z.size();
+    bool ions = !cppargs.z.empty();
+    vector<double> xl (ncomp), xv (ncomp), fugcoef_l, fugcoef_v;
+    double dif, K_new;
+    bool cold = (int)K.size() != ncomp;
+    int phase = 0;
+    for (int iter = 0; iter < 500; iter++) {
+        if (cold && !flash_init(p, t, z, m, s, e, cppargs, K)) {
+            // the mixture is stable, so take the phase with the lower Gibbs energy
+            rho_l = den_refined(z, m, s, e, t, p, 0, cppargs);
+            rho_v = den_refined(z, m, s, e, t, p, 1, cppargs);
+            if (isnan(rho_l) || isnan(rho_v)) {
+                beta = isnan(rho_l) ? 1. : 0.;
+                if (isnan(rho_l) && isnan(rho_v)) {
+                    beta = NaN;
+                }
+                return !isnan(beta);
+            }
+            fugcoef_l = pcsaft_fugcoef_cpp(z, m, s, e, t, rho_l, cppargs);
+            fugcoef_v = pcsaft_fugcoef_cpp(z, m, s, e, t, rho_v, cppargs);
+            double g_l = 0., g_v = 0.;
+            for (int i = 0; i < ncomp; i++) {
+                g_l += z[i]*log(fugcoef_l[i]);
+                g_v += z[i]*log(fugcoef_v[i]);
+            }
+            beta = (g_v < g_l) ? 1. : 0.;
+            return true;
+        }
+        else if (cold) {
+            beta = 0.5;
+            rho_l = rho_v = 0.;
+        }
+        phase = rachford_rice(z, K, beta);
+        if (phase != 0 && !cold && iter == 0) {
+            // the K values of the previous solution may no longer give two
+            // phases after a change of the pressure or the parameters
+            cold = true;
+            continue;
+        }
+        cold = false;
+        if (phase == -1) {
+            rho_l = den_refined(z, m, s, e, t, p, 0, cppargs, rho_l);
+            if (isnan(rho_l)) {
+                rho_l = pcsaft_den_cpp(z, m, s, e, t, p, 0, cppargs);
+            }
+            return !isnan(rho_l);
+        }
+        else if (phase == 1) {
+            rho_v = den_refined(z, m, s, e, t, p, 1, cppargs, rho_v);
+            if (isnan(rho_v)) {
+                rho_v = pcsaft_den_cpp(z, m, s, e, t, p, 1, cppargs);
+            }
+            return !isnan(rho_v);
+        }
+        for (int i = 0; i < ncomp; i++) {
+            xl[i] = z[i]/(1 + beta*(K[i] - 1));
+            xv[i] = K[i]*xl[i];
+        }
+        rho_l = den_refined(xl, m, s, e, t, p, 0, cppargs, rho_l);
+        rho_v = den_refined(xv, m, s, e, t, p, 1, cppargs, rho_v);
+        if (isnan(rho_l)) {
+            rho_l = pcsaft_den_cpp(xl, m, s, e, t, p, 0, cppargs);
+        }
+        if (isnan(rho_v)) {
+            rho_v = pcsaft_den_cpp(xv, m, s, e, t, p, 1, cppargs);
+        }
+        fugcoef_l = pcsaft_fugcoef_cpp(xl, m, s, e, t, rho_l, cppargs);
+        fugcoef_v = pcsaft_fugcoef_cpp(xv, m, s, e, t, rho_v, cppargs);
+        dif = 0.;
+        for (int i = 0; i < ncomp; i++) {
+            if (ions && cppargs.z[i] != 0) {
+                continue;
+            }
+            K_new = fugcoef_l[i]/fugcoef_v[i];
+            dif = max(dif, fabs(log(K_new/K[i])));
+            K[i] = K_new;
+        }
+        if (!isfinite(dif)) {
+            beta = NaN;
+            return false;
+        }
+        if (dif < 1e-10) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static double flash_volume(double p, double t, const vector<double> &z, const vector<double> &m,
+    const vector<double> &s, const vector<double> &e, add_args &cppargs, vector<double> &K, double &beta,
+    double &rho_l, double &rho_v) {
+    /**
+    Calculate the molar volume (m^3 mol^-1) of a mixture at t and p from a PT
+    flash (see pcsaft_flash_cpp). K, beta and the densities of the phases are
+    used as the initial guess and contain the solution on return.
+    */
+    pcsaft_flash_cpp(p, t, z, m, s, e, cppargs, K, beta, rho_l, rho_v);
+    if (isnan(beta)) {
+        return NaN;
+    }
+    if (beta == 0) {
+        return 1./rho_l;
+    }
+    if (beta == 1) {
+        return 1./rho_v;
+    }
+    return beta/rho_v + (1 - beta)/rho_l;
+}
+
+
+template <class Problem>
+static bool lm_residuals(Problem &prob, const vector<double> &params, VectorXd &r) {
+    /**
+    Evaluate the residuals of all data points. Returns false if one of them
+    is not finite. The solutions are only kept as warm starts if the
+    parameters are accepted with prob.accept().
+    */
+    int npoints = prob.offset.size() - 1;
+    r.resize(prob.offset[npoints]);
+    #pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < npoints; k++) {
+        prob.eval(params, k, true, &r(prob.offset[k]));
+    }
+    return r.allFinite();
+}
+
+
+template <class Problem>
+static bool lm_jacobian(Problem &prob, const vector<double> &params, MatrixXd &J) {
+    /**Evaluate the Jacobian of the residuals with central differences, one block of rows per data point.*/
+    int npoints = prob.offset.size() - 1;
+    int npar = params.size();
+    J.resize(prob.offset[npoints], npar);
+    #pragma omp parallel for schedule(dynamic)
+    for (int k = 0; k < npoints; k++) {
+        int nres = prob.offset[k+1] - prob.offset[k];
+        vector<double> pp = params;
+        vector<double> r_plus (nres), r_minus (nres);
+        double h;
+        for (int j = 0; j < npar; j++) {
+            h = 1e-5*max(fabs(params[j]), 0.1);
+            pp[j] = params[j] + h;
+            prob.eval(pp, k, false, &r_plus[0]);
+            pp[j] = params[j] - h;
+            prob.eval(pp, k, false, &r_minus[0]);
+            pp[j] = params[j];
+            for (int l = 0; l < nres; l++) {
+                J(prob.offset[k]+l, j) = (r_plus[l] - r_minus[l])/(2*h);
+            }
+        }
+    }
+    return J.allFinite();
+}
+
+
+template <class Problem>
+static fit_result levenberg_marquardt(Problem &prob, const vector<double> &params_guess, int maxiter, double tol) {
+    /**
+    Minimize the sum of squared residuals of a fitting problem with the
+    Levenberg-Marquardt method.
+
+    The problem provides offset, the index of the first residual of each data
+    point (with the total number of residuals as the last element), positive,
+    which restricts the parameters to positive values, and
+    eval(params, k, warm, r), which writes the residuals of data point k to r.
+    If warm is true the evaluation may store its solution, and accept() makes
+    the solutions stored since the last call the warm starts of the following
+    evaluations. This is done for the residuals of accepted parameters, but
+    not for rejected steps or the perturbed parameters of the Jacobian.
+    */
+    int npar = params_guess.size();
+    fit_result res;
+    res.params = params_guess;
+    res.iterations = 0;
+    res.n_evals = 1;
+    res.n_jac = 0;
+    res.converged = false;
+    res.status = 0;
+    res.grad_norm = NaN;
+
+    VectorXd r, r_trial;
+    if (!lm_residuals(prob, res.params, r)) {
+        res.status = -1;
+        res.ssr = res.ssr_initial = NaN;
+        res.residuals.assign(r.data(), r.data() + r.size());
+        return res;
+    }
+    prob.accept();
+    int nres = r.size();
+    double ssr = r.squaredNorm();
+    res.ssr_initial = ssr;
+
+    MatrixXd J, A;
+    VectorXd g, step;
+    vector<double> trial (npar);
+    double lambda = 1e-3, ssr_trial;
+    bool feasible;
+    while (res.iterations < maxiter && res.status == 0) {
+        res.iterations += 1;
+        res.n_jac += 1;
+        if (!lm_jacobian(prob, res.params, J)) {
+            res.status = -2;
+            break;
+        }
+        A = J.transpose()*J;
+        g = J.transpose()*r;
+        res.grad_norm = g.lpNorm<Infinity>();
+        if (res.grad_norm <= tol*(ssr + tol)) {
+            res.status = 3;
+            break;
+        }
+
+        while (true) {
+            MatrixXd A_damped = A;
+            A_damped.diagonal() += lambda*A.diagonal();
+            step = A_damped.ldlt().solve(-g);
+            feasible = step.allFinite();
+            for (int j = 0; j < npar; j++) {
+                trial[j] = res.params[j] + step(j);
+                if (prob.positive && trial[j] <= 0) {
+                    feasible = false;
+                }
+            }
+            if (feasible) {
+                res.n_evals += 1;
+                feasible = lm_residuals(prob, trial, r_trial);
+            }
+            ssr_trial = feasible ? r_trial.squaredNorm() : NaN;
+            if (feasible && ssr_trial < ssr) {
+                lambda = max(lambda/10., 1e-12);
+                bool small_step = true;
+                for (int j = 0; j < npar; j++) {
+                    if (fabs(step(j)) > tol*(fabs(res.params[j]) + tol)) {
+                        small_step = false;
+                    }
+                }
+                if (ssr - ssr_trial <= tol*ssr) {
+                    res.status = 1;
+                }
+                else if (small_step) {
+                    res.status = 2;
+                }
+                prob.accept();
+                res.params = trial;
+                r = r_trial;
+                ssr = ssr_trial;
+                break;
+            }
+            lambda *= 10.;
+            if (lambda > 1e12) {
+                res.status = 4; // no step reduces the sum of squares, so the parameters are at a minimum within the accuracy of the Jacobian
+                break;
+            }
+        }
+    }
+
+    res.converged = (res.status > 0);
+    res.ssr = ssr;
+    res.residuals.assign(r.data(), r.data() + nres);
+
+    // standard errors of the parameters from the covariance matrix s^2*(J^T*J)^-1
+    res.std_err.assign(npar, NaN);
+    if (nres > npar) {
+        if (res.n_jac == 0 || res.status != 3) {
+            lm_jacobian(prob, res.params, J);
+            res.n_jac += 1;
+        }
+        MatrixXd cov = (J.transpose()*J).inverse()*ssr/(nres - npar);
+        for (int j = 0; j < npar; j++) {
+            res.std_err[j] = sqrt(cov(j,j));
+        }
+    }
+    return res;
+}
+
+
+struct pure_problem {
+    /**Residuals of pure component data for pcsaft_fit_pure_cpp.*/
+    const fit_data &data;
+    add_args &cppargs;
+    vector<int> offset;
+    bool positive;
+    vector<double> p_warm; // vapor pressure for the last accepted parameters
+    vector<double> p_next; // vapor pressure from the last evaluation
+
+    pure_problem(const fit_data &data, add_args &cppargs) : data(data), cppargs(cppargs), positive(true) {
+        int npoints = data.prop.size();
+        for (int k = 0; k <= npoints; k++) {
+            offset.push_back(k);
+        }
+        p_warm = p_next = data.p;
+    }
+
+    void accept() {
+        p_warm = p_next;
+    }
+
+    void eval(const vector<double> &params, int k, bool warm, double *r) {
+        /**Relative deviation (%) between the calculated and the measured value of data point k.*/
+        vector<double> x (1, 1.);
+        vector<double> m (1, params[0]);
+        vector<double> s (1, params[1]);
+        vector<double> e (1, params[2]);
+        add_args args = cppargs;
+        if (params.size() > 3) {
+            args.e_assoc.assign(1, params[3]);
+            args.vol_a.assign(1, params[4]);
+        }
+
+        double t = data.t[k];
+        double calc = NaN;
+        if (data.prop[k] == 0) {
+            calc = den_refined(x, m, s, e, t, data.p[k], data.phase[k], args);
+        }
+        else if (data.prop[k] == 1 || data.prop[k] == 2) {
+            double Pvap;
+            if (data.prop[k] == 1) {
+                Pvap = pcsaft_vaporP_cpp(p_warm[k], x, m, s, e, t, args);
+                calc = Pvap;
+            }
+            else {
+                saturation_result sat = pcsaft_saturation_cpp(p_warm[k], x, m, s, e, t, args);
+                Pvap = sat.p;
+                calc = sat.hvap;
+            }
+            if (warm && isfinite(Pvap)) {
+                p_next[k] = Pvap;
+            }
+        }
+        r[0] = (calc - data.value[k])/data.value[k]*100;
+    }
+};
+
+
+fit_result pcsaft_fit_pure_cpp(const vector<double> &params_guess, const fit_data &data,
+    add_args &cppargs, int maxiter, double tol) {
+    /**
+    Fit PC-SAFT parameters of a pure component to experimental data.
+
+    Parameters
+    ----------
+    params_guess : vector<double>, shape (3,) or (5,)
+        Initial guess for the parameters m, s (Angstrom) and e (K). If five
+        values are given the association energy e_assoc (K) and the
+        association volume vol_a are also fit, using the 2B scheme.
+    data : fit_data
+        The experimental data. For each data point it contains the property
+        type (0 = density, 1 = vapor pressure, 2 = enthalpy of vaporization),
+        the phase of density data (0 = liquid, 1 = vapor), the temperature
+        (K), the pressure (Pa) and the measured value (mol m^-3, Pa or J mol^-1).
+        For vapor pressure and enthalpy of vaporization data the pressure is
+        used as the initial guess for the vapor pressure.
+    cppargs : add_args
+        A struct containing additional arguments that are kept constant
+        during the fit, e.g. the dipole moment (see pcsaft_Z_cpp).
+    maxiter : int
+        Maximum number of Levenberg-Marquardt iterations.
+    tol : double
+        Convergence tolerance for the relative change of the sum of squares,
+        the relative step size and the gradient.
+
+    Returns
+    -------
+    result : fit_result
+        The fitted parameters, the residuals (relative deviation in %) and
+        statistics of the convergence (see fit_result in pcsaft.h).
+    */
+    pure_problem prob(data, cppargs);
+    return levenberg_marquardt(prob, params_guess, maxiter, tol);
+}
+
+
+struct binary_problem {
+    /**Residuals of phase equilibrium data for pcsaft_fit_binary_cpp.*/
+    const vector<int> &param_type;
+    const vle_data &data;
+    const vector<double> &m, &s, &e;
+    add_args &cppargs;
+    vector<int> offset;
+    bool positive;
+    vector<double> p_warm; // pressure for the last accepted parameters
+    vector<vector<double> > c_warm; // vapor composition (bubble points) or K values (PTz)
+    vector<double> beta_warm;
+    vector<double> p_next; // the same from the last evaluation
+    vector<vector<double> > c_next;
+    vector<double> beta_next;
+
+    binary_problem(const vector<int> &param_type, const vle_data &data, const vector<double> &m,
+        const vector<double> &s, const vector<double> &e, add_args &cppargs)
+        : param_type(param_type), data(data), m(m), s(s), e(e), cppargs(cppargs), positive(false) {
+        int npoints = data.type.size();
+        int ncomp = m.size();
+        offset.push_back(0);
+        for (int k = 0; k < npoints; k++) {
+            offset.push_back(offset.back() + 1 + (has_y(k) ? 1 : 0));
+            if (data.type[k] == 0) {
+                if (has_y(k)) {
+                    c_warm.push_back(vector<double>(data.y.begin() + k*ncomp, data.y.begin() + (k+1)*ncomp));
+                }
+                else {
+                    c_warm.push_back(vector<double>(data.x.begin() + k*ncomp, data.x.begin() + (k+1)*ncomp));
+                }
+            }
+            else {
+                c_warm.push_back(vector<double>());
+            }
+        }
+        p_warm = data.p;
+        beta_warm.assign(npoints, 0.5);
+        p_next = p_warm;
+        c_next = c_warm;
+        beta_next = beta_warm;
+    }
+
+    void accept() {
+        p_warm = p_next;
+        c_warm = c_next;
+        beta_warm = beta_next;
+    }
+
+    bool has_y(int k) {
+        /**True if the vapor composition of bubble point k was measured.*/
+        int ncomp = m.size();
+        return data.type[k] == 0 && (int)data.y.size() > k*ncomp && data.y[k*ncomp] >= 0;
+    }
+
+    void eval(const vector<double> &params, int k, bool warm, double *r) {
+        /**Relative deviation (%) of the pressure and deviation of y_0 (mol %) of data point k.*/
+        int ncomp = m.size();
+        add_args args = cppargs;
+        vector<double> *target;
+        for (size_t j = 0; j < params.size(); j++) {
+            if (param_type[j] == 0) {
+                target = &args.k_ij;
+            }
+            else if (param_type[j] == 1) {
+                target = &args.l_ij;
+            }
+            else {
+                target = &args.k_hb;
+            }
+            vector<double> packed (3);
+            for (int a = 0, idx = 0; a < 2; a++) {
+                for (int b = a; b < 2; b++, idx++) {
+                    packed[idx] = pair_param(*target, a, b, ncomp);
+                }
+            }
+            packed[1] = params[j];
+            *target = packed;
+        }
+
+        double t = data.t[k];
+        vector<double> x (data.x.begin() + k*ncomp, data.x.begin() + (k+1)*ncomp);
+        if (data.type[k] == 0) {
+            vector<double> xv = c_warm[k];
+            double P = pcsaft_bubbleP_cpp(p_warm[k], xv, x, m, s, e, t, args);
+            if (warm && isfinite(P)) {
+                p_next[k] = P;
+                c_next[k] = xv;
+            }
+            r[0] = (P - data.p[k])/data.p[k]*100;
+            if (has_y(k)) {
+                r[1] = (xv[0] - data.y[k*ncomp])*100;
+            }
+        }
+        else {
+            // secant method on ln(p) for the pressure at which the flash gives the measured volume
+            double v = data.vol[k]/data.mol[k];
+            vector<double> K = c_warm[k];
+            double beta = beta_warm[k];
+            double rho_l = 0., rho_v = 0.;
+            double lnp1 = log(p_warm[k]), lnp2 = lnp1 + 1e-3, lnp;
+            double f1 = log(flash_volume(exp(lnp1), t, x, m, s, e, args, K, beta, rho_l, rho_v)/v);
+            double f2 = 0.;
+            for (int iter = 0; iter < 50; iter++) {
+                f2 = log(flash_volume(exp(lnp2), t, x, m, s, e, args, K, beta, rho_l, rho_v)/v);
+                if (!isfinite(f2) || fabs(f2) < 1e-9 || f2 == f1) { // the flash volume is not more accurate than about 1e-10
+                    break;
+                }
+                lnp = lnp2 - f2*(lnp2 - lnp1)/(f2 - f1);
+                lnp = min(max(lnp, lnp2 - 1.), lnp2 + 1.);
+                lnp1 = lnp2;
+                f1 = f2;
+                lnp2 = lnp;
+            }
+            double P = (isfinite(f2) && fabs(f2) < 1e-7) ? exp(lnp2) : NaN;
+            if (warm && isfinite(P)) {
+                p_next[k] = P;
+                c_next[k] = K;
+                beta_next[k] = beta;
+            }
+            r[0] = (P - data.p[k])/data.p[k]*100;
+        }
+    }
+};
+
+
+fit_result pcsaft_fit_binary_cpp(const vector<double> &params_guess, const vector<int> &param_type,
+    const vle_data &data, const vector<double> &m, const vector<double> &s, const vector<double> &e,
+    add_args &cppargs, int maxiter, double tol) {
+    /**
+    Fit interaction parameters of a binary mixture to phase equilibrium data.
+
+    The phase equilibrium of each data point is solved again for each set of
+    parameters, starting from the solution found for the previous accepted
+    parameters, and the data points are evaluated in parallel.
+
+    Parameters
+    ----------
+    params_guess : vector<double>, shape (k,)
+        Initial guess for the interaction parameters.
+    param_type : vector<int>, shape (k,)
+        The interaction parameter that each element of params_guess refers to:
+        0 = k_ij, 1 = l_ij, 2 = k_hb, for the pair of components 0 and 1.
+    data : vle_data
+        The experimental data (see vle_data in pcsaft.h). Bubble points give
+        the relative deviation of the pressure (%) and, if the vapor
+        composition was measured, the deviation of y_0 (mol %) as residuals.
+        PTz points give the relative deviation of the pressure at which a
+        PT flash of the overall composition has the measured volume.
+    m, s, e : vector<double>, shape (2,)
+        Segment number, segment diameter (Angstrom) and dispersion energy (K).
+    cppargs : add_args
+        A struct containing additional arguments. Interaction parameters that
+        are not fit keep the values given here.
+    maxiter : int
+        Maximum number of Levenberg-Marquardt iterations.
+    tol : double
+        Convergence tolerance (see pcsaft_fit_pure_cpp).
+
+    Returns
+    -------
+    result : fit_result
+        The fitted parameters, the residuals and statistics of the
+        convergence (see fit_result in pcsaft.h). The status is -1 if the
+        mixture is not a binary mixture.
+    */
+    if (m.size() != 2) {
+        fit_result res;
+        res.params = params_guess;
+        res.std_err.assign(params_guess.size(), NaN);
+        res.ssr = res.ssr_initial = res.grad_norm = NaN;
+        res.iterations = res.n_evals = res.n_jac = 0;
+        res.converged = false;
+        res.status = -1;
+        return res;
+    }
+    binary_problem prob(param_type, data, m, s, e, cppargs);
+    return levenberg_marquardt(prob, params_guess, maxiter, tol);
+}
@@ -0,0 +1,72 @@
+#include <vector>
+#include <mutex>
+
+#include "pcsaft_internal.h"
+
+using namespace std;
+
+/*
+Counters of the opt-in instrumentation (see PCSAFT_INSTRUMENT in pcsaft_internal.h).
+
+Each thread updates its own instrument_counters without locking. The
+counters of a thread are created on its first use and registered in a list,
+so that a snapshot can report every thread. They are never freed, so the
+counts of threads that have finished (e.g. of an OpenMP pool that was shut
+down) are kept until the next reset. The counters are read and reset while
+other threads may write them, so snapshots should be taken when no
+calculation is running.
+*/
+
+#ifdef PCSAFT_INSTRUMENT
+static mutex registry_lock;
+static vector<instrument_counters*> registry;
+
+instrument_counters &instrument_thread_cpp() {
+    /**Return the counters of the calling thread.*/
+    static thread_local instrument_counters *local = NULL;
+    if (local == NULL) {
+        local = new instrument_counters();
+        lock_guard<mutex> guard(registry_lock);
+        registry.push_back(local);
+    }
+    return *local;
+}
+#endif
+
+
+bool instrument_enabled_cpp() {
+    /**Return true if the library was compiled with PCSAFT_INSTRUMENT.*/
+#ifdef PCSAFT_INSTRUMENT
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+vector<instrument_counters> instrument_snapshot_cpp() {
+    /**
+    Return a copy of the counters of each thread that has used the
+    equation of state, in the order in which the threads first used it.
+    The vector is empty without PCSAFT_INSTRUMENT.
+    */
+    vector<instrument_counters> snapshot;
+#ifdef PCSAFT_INSTRUMENT
+    lock_guard<mutex> guard(registry_lock);
+    for (size_t k = 0; k < registry.size(); k++) {
+        snapshot.push_back(*registry[k]);
+    }
+#endif
+    return snapshot;
+}
+
+
+void instrument_reset_cpp() {
+    /**Set the counters of all threads to zero.*/
+#ifdef PCSAFT_INSTRUMENT
+    lock_guard<mutex> guard(registry_lock);
+    for (size_t k = 0; k < registry.size(); k++) {
+        *registry[k] = instrument_counters();
+    }
+#endif
+}
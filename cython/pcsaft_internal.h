@@ -0,0 +1,372 @@
+#ifndef PCSAFT_INTERNAL_H
+#define PCSAFT_INTERNAL_H
+
+/*
+Declarations shared by the translation units of the C++ core, the Cython
+extension and the benchmarks, in addition to the public interface of
+pcsaft.h. This header is not installed.
+*/
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+#include "pcsaft.h"
+
+using namespace std;
+
+const static double kb = 1.380648465952442093e-23; // Boltzmann constant, J K^-1
+const static double PI = 3.141592653589793;
+const static double N_AV = 6.022140857e23; // Avagadro's number
+const static double E_CHRG = 1.6021766208e-19; // elementary charge, units of coulomb
+const static double perm_vac = 8.854187817e-22; //permittivity in vacuum, C V^-1 Angstrom^-1
+
+const static int EOS_CACHE_SHARDS = 16; // number of independently locked parts of an eos_cache
+
+inline solver_tol solver_tol_budget(const solver_tol &final, double residual) {
+    /**
+    Tolerances for the inner solvers of an outer solver whose current
+    residual is given (inexact Newton). The inner solvers only need to be a
+    factor of 100 more accurate than the outer iterate, so they are loose in
+    the first outer iterations and reach the final tolerances as the outer
+    solver converges. The association tolerance is scaled down further,
+    because the successive substitution of XA converges slowly and its true
+    error is much larger than the last change.
+    */
+    solver_tol tol;
+    double eta = 0.01*residual;
+    if (!(eta >= 0)) {
+        eta = 1.; // e.g. a NaN residual: use the loosest tolerances
+    }
+    tol.assoc = min(max(final.assoc, 1e-4*eta), 1e-8);
+    tol.den = min(max(final.den, eta), 1e-4);
+    tol.comp = min(max(final.comp, eta), 1e-5);
+    return tol;
+}
+
+struct instrument_counters {
+    long evals; // evaluations of the equation of state
+    long den_solves; // calls of pcsaft_den_cpp
+    long den_iter; // iterations of the density solver (Newton and secant)
+    long den_newton_fallback; // warm starts that left the branch and fell back to the secant method
+    long den_vapor_widen; // vapor solves that widened the upper density bound
+    long den_liquid_restart; // liquid solves restarted from a high density
+    long den_unconverged; // solves that stopped without reaching the tolerance
+    long xa_solves; // solutions of the fractions of unbonded association sites
+    long xa_iter; // iterations of XA_find
+    long xa_unconverged; // XA solutions that stopped at the iteration limit
+    long lu_solves; // LU solves for the derivatives of XA
+    long lu_rows; // sum of the sizes of the LU matrices
+    long lu_max_rows; // size of the largest LU matrix
+    double t_hc_disp; // time in the hard chain and dispersion terms (s), which share their intermediate quantities
+    double t_polar; // time in the dipole term (s)
+    double t_assoc; // time in the association term (s)
+    double t_ion; // time in the ion term (s)
+    instrument_counters() : evals(0), den_solves(0), den_iter(0), den_newton_fallback(0), den_vapor_widen(0),
+        den_liquid_restart(0), den_unconverged(0), xa_solves(0), xa_iter(0), xa_unconverged(0),
+        lu_solves(0), lu_rows(0), lu_max_rows(0), t_hc_disp(0), t_polar(0), t_assoc(0), t_ion(0) {}
+};
+
+// Opt-in instrumentation of the solvers, compiled in with -DPCSAFT_INSTRUMENT.
+// The counters are kept per thread, so that the hot paths do not share cache
+// lines or locks, and are summed by instrument_snapshot_cpp. Without
+// PCSAFT_INSTRUMENT the macros expand to nothing.
+#ifdef PCSAFT_INSTRUMENT
+#include <chrono>
+
+instrument_counters &instrument_thread_cpp();
+
+struct instrument_timer {
+    chrono::steady_clock::time_point last;
+    instrument_timer() : last(chrono::steady_clock::now()) {}
+    void lap(double &elapsed) {
+        /**Add the time since the previous lap to elapsed.*/
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        elapsed += chrono::duration<double>(now - last).count();
+        last = now;
+    }
+};
+
+inline void instrument_lu(long rows) {
+    instrument_counters &c = instrument_thread_cpp();
+    c.lu_solves += 1;
+    c.lu_rows += rows;
+    c.lu_max_rows = max(c.lu_max_rows, rows);
+}
+
+#define PCSAFT_COUNT(field, n) (instrument_thread_cpp().field += (n))
+#define PCSAFT_COUNT_XA(iter, unconverged) (PCSAFT_COUNT(xa_solves, 1), PCSAFT_COUNT(xa_iter, iter), \
+    PCSAFT_COUNT(xa_unconverged, (unconverged) ? 1 : 0))
+#define PCSAFT_COUNT_LU(rows) instrument_lu(rows)
+#define PCSAFT_TIMER_START() instrument_timer pcsaft_timer_
+#define PCSAFT_TIMER_LAP(field) pcsaft_timer_.lap(instrument_thread_cpp().field)
+#else
+#define PCSAFT_COUNT(field, n)
+#define PCSAFT_COUNT_XA(iter, unconverged)
+#define PCSAFT_COUNT_LU(rows)
+#define PCSAFT_TIMER_START()
+#define PCSAFT_TIMER_LAP(field)
+#endif
+
+const static int TRACE_Z = 1; // function ids of the calls in a trace (see pcsaft_trace.cpp)
+const static int TRACE_P = 2;
+const static int TRACE_FUGCOEF = 3;
+const static int TRACE_DEN = 4;
+const static int TRACE_ARES = 5;
+const static int TRACE_DADT = 6;
+const static int TRACE_HRES = 7;
+const static int TRACE_SRES = 8;
+const static int TRACE_GRES = 9;
+
+struct trace_mixture {
+    uint64_t hash; // mixture_hash_cpp of the parameters
+    vector<double> m, s, e;
+    add_args cppargs;
+};
+
+struct trace_call {
+    int fn; // TRACE_Z, TRACE_P, ...
+    int phase; // phase of TRACE_DEN, otherwise -1
+    size_t mixture; // index of the mixture in the trace
+    double t;
+    double state; // density (mol m^-3), or pressure (Pa) for TRACE_DEN
+    double rho_guess; // rho_guess of TRACE_DEN, otherwise 0
+    vector<double> x;
+    vector<double> result; // the recorded result
+};
+
+// Opt-in capture of the calls of the public functions, compiled in with
+// -DPCSAFT_TRACE and started with trace_start_cpp. Only the outermost call of
+// each thread is recorded, e.g. pcsaft_den_cpp but not the pressures that it
+// evaluates. PCSAFT_TRACE_RECORD uses the argument names x, m, s, e, t and
+// cppargs of the function that it is placed in.
+#ifdef PCSAFT_TRACE
+#include <atomic>
+
+extern atomic<bool> trace_active;
+extern thread_local int trace_depth;
+
+void trace_record_cpp(int fn, int phase, const vector<double> &x, const vector<double> &m,
+    const vector<double> &s, const vector<double> &e, double t, double state, double rho_guess,
+    const add_args &cppargs, const double *result, int nresult);
+
+struct trace_scope {
+    bool entered; // tracing was active when the function was entered
+    bool top; // this is the outermost traced call of the thread
+    trace_scope() : entered(false), top(false) {
+        if (trace_active.load(memory_order_relaxed)) {
+            entered = true;
+            top = (trace_depth++ == 0);
+        }
+    }
+    ~trace_scope() {
+        if (entered) {
+            trace_depth--;
+        }
+    }
+};
+
+#define PCSAFT_TRACE_SCOPE() trace_scope pcsaft_trace_
+#define PCSAFT_TRACE_RECORD(fn, phase, state, rho_guess, result, nresult) \
+    if (pcsaft_trace_.top) trace_record_cpp(fn, phase, x, m, s, e, t, state, rho_guess, cppargs, result, nresult)
+#else
+#define PCSAFT_TRACE_SCOPE()
+#define PCSAFT_TRACE_RECORD(fn, phase, state, rho_guess, result, nresult)
+#endif
+
+struct polar_pair {
+    int i, j; // component indices, i <= j
+    int mult; // number of orderings of the pair
+    double w; // weight of the pair in A2, without the temperature
+    double e_b; // energy multiplying the bdip series, summed over the orderings
+    double adip[5];
+    double bdip[5];
+};
+
+struct polar_triple {
+    int i, j, k; // component indices, i <= j <= k
+    int mult; // number of orderings of the triple
+    double w; // weight of the triple in A3, without the temperature
+    double cdip[5];
+};
+
+struct polar_subset {
+    vector<int> ip; // indices of the components with a dipole moment
+    vector<polar_pair> pairs;
+    vector<polar_triple> triples;
+};
+
+struct mixing_cache {
+    // tables of a mixture that do not depend on the state (see mixing_cache_setup_cpp)
+    vector<double> e_ij, s_ij; // see mixing_tables
+    polar_subset polar; // see polar_subset_setup, empty without dipoles
+    const vector<double> *m, *s, *e; // the parameters the tables were calculated for
+    const add_args *cppargs;
+    mixing_cache() : m(NULL), s(NULL), e(NULL), cppargs(NULL) {}
+};
+
+struct activity_result {
+    vector<double> gamma_x; // activity coefficients on the mole fraction scale
+    vector<double> gamma_m; // activity coefficients on the molality scale (the solvent keeps its mole fraction based value)
+    vector<double> molality; // molality of each solute, mol kg^-1 (0 for the solvent)
+    double gamma_pm; // mean ionic activity coefficient on the molality scale
+    double osmotic; // molal osmotic coefficient
+};
+
+struct solvent_ref_cache {
+    uint64_t mixture; // mixture_hash_cpp of the mixture the stored values belong to
+    int solvent; // index of the solvent the stored values belong to
+    map<pair<double, double>, vector<double> > lnfugcoef; // ln(phi_i) in the pure solvent for each (t, p)
+    solvent_ref_cache() : mixture(0), solvent(-1) {}
+};
+
+struct eos_cache_key {
+    uint64_t mixture; // hash of the parameters of the mixture (see mixture_hash_cpp)
+    int kind; // 0, 1: density of the liquid or vapor at (t, y = p); 2: fugacity coefficients at (t, y = rho)
+    double t, y;
+    vector<double> x;
+    bool operator==(const eos_cache_key &other) const {
+        return mixture == other.mixture && kind == other.kind && t == other.t && y == other.y && x == other.x;
+    }
+};
+
+struct eos_cache_key_hash {
+    size_t operator()(const eos_cache_key &key) const;
+};
+
+struct eos_cache_shard {
+    mutex lock;
+    list<pair<eos_cache_key, vector<double> > > entries; // most recently used first
+    unordered_map<eos_cache_key, list<pair<eos_cache_key, vector<double> > >::iterator, eos_cache_key_hash> index;
+    long hits, misses, evictions;
+    eos_cache_shard() : hits(0), misses(0), evictions(0) {}
+};
+
+struct eos_cache {
+    size_t capacity; // maximum number of entries of each shard, 0 = the cache is not used
+    eos_cache_shard shards[EOS_CACHE_SHARDS];
+    eos_cache() : capacity(0) {}
+};
+
+struct eos_cache_stats {
+    long hits, misses, evictions;
+    long size; // number of stored results
+};
+
+struct param_db_component {
+    // record of a component in a parameter database (see pcsaft_db.cpp), 0 for the parameters it does not have
+    double m, s, e;
+    double e_assoc, vol_a;
+    double dipm, dip_num;
+    double z;
+    double dielc_coef[3];
+    int32_t dielc_model;
+    uint32_t name; // offset of the name in the names of the database
+};
+
+struct param_db_pair {
+    // binary interaction parameters of the components i < j
+    uint32_t i, j;
+    double k_ij, l_ij, k_hb;
+};
+
+struct param_db {
+    // read-only view of a parameter database opened with param_db_open_cpp
+    const char *data;
+    size_t size;
+    bool mapped; // data is a memory map, otherwise a copy of the file
+    uint32_t ncomp, npairs;
+    const param_db_component *components;
+    const param_db_pair *pairs; // sorted by i and j
+    const uint32_t *pair_start; // the pairs of component i are pairs[pair_start[i]] .. pairs[pair_start[i+1]-1]
+    const uint32_t *by_name; // component indices sorted by name
+    const char *names;
+    size_t names_size;
+    param_db() : data(NULL), size(0), mapped(false), ncomp(0), npairs(0), components(NULL), pairs(NULL),
+        pair_start(NULL), by_name(NULL), names(NULL), names_size(0) {}
+};
+
+inline bool IsNotZero (double x) {return x != 0.0;}
+
+inline int sym_idx(int i, int j, int ncomp) {
+    /**Index of element (i, j) of a symmetric matrix stored as its packed upper triangle, row by row.*/
+    if (i > j) {
+        int tmp = i;
+        i = j;
+        j = tmp;
+    }
+    return i*ncomp - i*(i-1)/2 + j - i;
+}
+
+inline double pair_param(const vector<double> &p, int i, int j, int ncomp) {
+    /**
+    Return the interaction parameter for components i and j.
+
+    The parameters (k_ij, l_ij, k_hb) can be given as a dense ncomp x ncomp
+    matrix, as the packed upper triangle with ncomp*(ncomp+1)/2 elements, or
+    as an empty vector when all of them are zero.
+    */
+    if (p.empty()) {
+        return 0.;
+    }
+    if ((int)p.size() == ncomp*ncomp) {
+        return p[i*ncomp+j];
+    }
+    return p[sym_idx(i, j, ncomp)];
+}
+
+activity_result pcsaft_activity_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double p, int solvent, double mw_solvent, add_args &cppargs,
+    solvent_ref_cache &cache);
+vector<activity_result> pcsaft_activity_batch_cpp(const vector<double> &x, const vector<double> &m,
+    const vector<double> &s, const vector<double> &e, const vector<double> &t, const vector<double> &p,
+    int solvent, double mw_solvent, add_args &cppargs, solvent_ref_cache &cache);
+uint64_t mixture_hash_cpp(const vector<double> &m, const vector<double> &s, const vector<double> &e,
+    const add_args &cppargs);
+double pcsaft_den_cached_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double p, int phase, add_args &cppargs, eos_cache &cache,
+    double rho_guess = 0.);
+vector<double> pcsaft_fugcoef_cached_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, double t, double rho, add_args &cppargs, eos_cache &cache);
+void eos_cache_resize_cpp(eos_cache &cache, size_t capacity);
+eos_cache_stats eos_cache_stats_cpp(eos_cache &cache);
+bool instrument_enabled_cpp();
+vector<instrument_counters> instrument_snapshot_cpp();
+void instrument_reset_cpp();
+bool trace_start_cpp(const string &path);
+void trace_stop_cpp();
+bool trace_read_cpp(const string &path, vector<trace_mixture> &mixtures, vector<trace_call> &calls);
+vector<double> trace_eval_cpp(const trace_call &call, trace_mixture &mixture);
+bool param_db_write_cpp(const string &path, const vector<string> &names,
+    const vector<param_db_component> &components, const vector<param_db_pair> &pairs);
+bool param_db_open_cpp(const string &path, param_db &db);
+void param_db_close_cpp(param_db &db);
+int param_db_find_cpp(const param_db &db, const string &name);
+const char *param_db_name_cpp(const param_db &db, int id);
+bool param_db_mixture_cpp(const param_db &db, const vector<int> &ids, vector<double> &m, vector<double> &s,
+    vector<double> &e, add_args &cppargs);
+
+double dielc_water_cpp(double t, double &ddielc_dt);
+double dielc_cpp(const vector<double> &x, double t, add_args &cppargs, double &ddielc_dt,
+    vector<double> &ddielc_dx);
+void mixing_tables(const vector<double> &s, const vector<double> &e, add_args &cppargs,
+    vector<double> &e_ij, vector<double> &s_ij);
+polar_subset polar_subset_setup(const vector<double> &m, const vector<double> &s, const vector<double> &e,
+    const vector<double> &e_ij, const vector<double> &s_ij, add_args &cppargs);
+const mixing_cache &mixing_cache_get(const vector<double> &m, const vector<double> &s, const vector<double> &e,
+    add_args &cppargs, mixing_cache &local);
+void mixing_cache_setup_cpp(const vector<double> &m, const vector<double> &s, const vector<double> &e,
+    add_args &cppargs, mixing_cache &cache);
+vector<double> XA_find(vector<double> XA_guess, int ncomp, vector<double> delta_ij, double den,
+    vector<double> x);
+vector<double> dXA_find(int ncA, int ncomp, vector<int> iA, vector<double> delta_ij, 
+    double den, vector<double> XA, vector<double> ddelta_dd, vector<double> x, int n_sites);
+vector<double> dXAdt_find(int ncA, vector<double> delta_ij, double den, 
+    vector<double> XA, vector<double> ddelta_dt, vector<double> x, int n_sites);
+
+#endif
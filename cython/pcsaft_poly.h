@@ -0,0 +1,79 @@
+#ifndef PCSAFT_POLY_H
+#define PCSAFT_POLY_H
+
+/*
+Coefficient tables and polynomial kernels shared by the property functions.
+
+The dispersion integrals I1 and I2 and the dipole integrals J2 and J3 are
+power series in the packing fraction eta, whose coefficients depend on the
+(mean) segment number. The universal constants are defined here once, and
+the series are evaluated with Horner's method instead of calling pow(eta, i).
+*/
+
+// Universal model constants of the dispersion term (Table 1 in Gross and Sadowski 2001)
+constexpr double a0[7] = { 0.910563145, 0.636128145, 2.686134789, -26.54736249, 97.75920878, -159.5915409, 91.29777408 };
+constexpr double a1[7] = { -0.308401692, 0.186053116, -2.503004726, 21.41979363, -65.25588533, 83.31868048, -33.74692293 };
+constexpr double a2[7] = { -0.090614835, 0.452784281, 0.596270073, -1.724182913, -4.130211253, 13.77663187, -8.672847037 };
+constexpr double b0[7] = { 0.724094694, 2.238279186, -4.002584949, -21.00357682, 26.85564136, 206.5513384, -355.6023561 };
+constexpr double b1[7] = { -0.575549808, 0.699509552, 3.892567339, -17.21547165, 192.6722645, -161.8264617, -165.2076935 };
+constexpr double b2[7] = { 0.097688312, -0.255757498, -9.155856153, 20.64207597, -38.80443005, 93.62677408, -29.66690559 };
+
+// Model constants of the dipole term (Table 2 in Gross and Vrabec 2006)
+constexpr double a0dip[5] = { 0.3043504, -0.1358588, 1.4493329, 0.3556977, -2.0653308 };
+constexpr double a1dip[5] = { 0.9534641, -1.8396383, 2.0131180, -7.3724958, 8.2374135 };
+constexpr double a2dip[5] = { -1.1610080, 4.5258607, 0.9751222, -12.281038, 5.9397575 };
+constexpr double b0dip[5] = { 0.2187939, -1.1896431, 1.1626889, 0, 0 };
+constexpr double b1dip[5] = { -0.5873164, 1.2489132, -0.5085280, 0, 0 };
+constexpr double b2dip[5] = { 3.4869576, -14.915974, 15.372022, 0, 0 };
+constexpr double c0dip[5] = { -0.0646774, 0.1975882, -0.8087562, 0.6902849, 0 };
+constexpr double c1dip[5] = { -0.9520876, 2.9924258, -2.3802636, -0.2701261, 0 };
+constexpr double c2dip[5] = { -0.6260979, 1.2924686, 1.6542783, -3.4396744, 0 };
+
+template <int N>
+inline void mix_coef(const double (&c0)[N], const double (&c1)[N], const double (&c2)[N], double m, double (&c)[N]) {
+    /**
+    Calculate the coefficients of a series for the segment number m:
+    c = c0 + (m-1)/m*c1 + (m-1)/m*(m-2)/m*c2
+    */
+    double f1 = (m-1.)/m;
+    double f2 = f1*(m-2.)/m;
+    for (int i = 0; i < N; i++) {
+        c[i] = c0[i] + f1*c1[i] + f2*c2[i];
+    }
+}
+
+template <int D, int N, typename C, typename T>
+inline void horner(const C (&c)[N], const T &x, T (&p)[D+1]) {
+    /**
+    Evaluate the polynomial sum_i c[i]*x^i and its derivatives with respect
+    to x in one pass of Horner's method.
+
+    Parameters
+    ----------
+    c : double[N] or Eigen array[N]
+        Coefficients of the polynomial, starting with the constant term.
+        Arrays hold different coefficients for each element of x.
+    x : double or Eigen array
+        Value at which the polynomial is evaluated. For an array the
+        polynomial is evaluated element-wise.
+    p : same type as x, [D+1]
+        Output. p[k] is the k-th derivative of the polynomial at x, for k up
+        to D (D <= 3 is used in practice).
+    */
+    for (int k = 0; k <= D; k++) {
+        p[k] = 0.*x;
+    }
+    for (int i = N-1; i >= 0; i--) {
+        for (int k = D; k > 0; k--) {
+            p[k] = p[k]*x + p[k-1];
+        }
+        p[0] = p[0]*x + c[i];
+    }
+    double fact = 1.;
+    for (int k = 2; k <= D; k++) {
+        fact *= k;
+        p[k] *= fact;
+    }
+}
+
+#endif
@@ -0,0 +1,222 @@
+#include <vector>
+#include <cmath>
+#include <limits>
+
+#include "pcsaft_internal.h"
+
+using namespace std;
+
+/*
+Properties along a path of states, e.g. an isobar or an isotherm.
+
+The states are solved in the order in which they are given. The density and
+the fractions of unbonded association sites of each state are extrapolated
+from the two previous states on the same branch (liquid or vapor), and the
+density is refined with Newton's method, which usually needs two or three
+iterations. The density is only solved from scratch with pcsaft_den_cpp for
+the first state, or when Newton's method leaves the branch because the phase
+no longer exists. When the stable phase is requested both branches are
+followed, and the one with the lower Gibbs energy is returned, so that phase
+changes along the path show up as a change of the phase of the states.
+*/
+
+const static double NaN = numeric_limits<double>::quiet_NaN();
+
+
+struct sweep_branch {
+    int phase; // 0 = liquid, 1 = vapor
+    int n; // number of previous states in the history (at most 2)
+    double rho[2]; // densities of the previous states, the latest first
+    vector<double> XA[2]; // fractions of unbonded association sites of the previous states
+    double dist; // distance between the two previous states
+};
+
+
+static double path_distance(double t0, double p0, double t1, double p1) {
+    /**Distance between two states used to scale the extrapolation.*/
+    return fabs(log(t1/t0)) + fabs(log(p1/p0));
+}
+
+
+static double branch_solve(sweep_branch &b, double dist, const vector<double> &x, const vector<double> &m,
+    const vector<double> &s, const vector<double> &e, double t, double p, add_args &cppargs,
+    vector<double> &XA, int &n_cold) {
+    /**
+    Solve for the density of the next state on a branch and add it to the
+    history of the branch. dist is the distance from the previous state.
+    */
+    double rho = NaN;
+    if (b.n > 0) {
+        rho = b.rho[0];
+        XA = b.XA[0];
+        if (b.n == 2 && b.dist > 0) {
+            double r = dist/b.dist;
+            double rho_ex = b.rho[0] + (b.rho[0] - b.rho[1])*r;
+            if (rho_ex > 0) {
+                rho = rho_ex;
+                for (size_t i = 0; i < XA.size(); i++) {
+                    XA[i] = min(max(b.XA[0][i] + (b.XA[0][i] - b.XA[1][i])*r, 1e-3*b.XA[0][i]), 1.);
+                }
+            }
+        }
+
+        // Newton's method on the pressure, which fails if the density leaves
+        // the mechanically stable part of the branch
+        double h, P1, P2, step;
+        vector<double> XA_h;
+        bool converged = false;
+        for (int iter = 0; iter < 20; iter++) {
+            h = rho*1e-7;
+            P1 = pcsaft_p_cpp(x, m, s, e, t, rho, cppargs, &XA);
+            XA_h = XA;
+            P2 = pcsaft_p_cpp(x, m, s, e, t, rho + h, cppargs, &XA_h);
+            step = (P1 - p)*h/(P2 - P1);
+            if (P2 <= P1 || !(fabs(step) < 0.2*rho)) {
+                break;
+            }
+            rho -= step;
+            if (fabs(step) < 1e-8*rho) { // the pressure of dense associating fluids is only as accurate as XA
+                converged = true;
+                break;
+            }
+        }
+        if (!converged) {
+            b.n = 0;
+        }
+    }
+
+    if (b.n == 0) {
+        n_cold += 1;
+        rho = pcsaft_den_cpp(x, m, s, e, t, p, b.phase, cppargs);
+        XA.clear();
+        if (isfinite(rho)) {
+            pcsaft_p_cpp(x, m, s, e, t, rho, cppargs, &XA);
+        }
+    }
+
+    if (isfinite(rho)) {
+        b.rho[1] = b.rho[0];
+        b.XA[1] = b.XA[0];
+        b.dist = dist;
+        b.rho[0] = rho;
+        b.XA[0] = XA;
+        b.n = min(b.n + 1, 2);
+    }
+    else {
+        b.n = 0;
+    }
+    return rho;
+}
+
+
+sweep_result pcsaft_sweep_cpp(const vector<double> &x, const vector<double> &m, const vector<double> &s,
+    const vector<double> &e, const vector<double> &t, const vector<double> &p, int phase, int props,
+    add_args &cppargs) {
+    /**
+    Calculate the density and other properties along a path of states.
+
+    Parameters
+    ----------
+    x : vector<double>, shape (n,)
+        Mole fractions of each component.
+    m, s, e : vector<double>, shape (n,)
+        Segment number, segment diameter (Angstrom) and dispersion energy (K).
+    t : vector<double>, shape (k,)
+        Temperature of each state (K). The states should be ordered along the
+        path, e.g. increasing temperatures for an isobar.
+    p : vector<double>, shape (k,)
+        Pressure of each state (Pa)
+    phase : int
+        0 (liquid), 1 (vapor) or 2 (the stable phase of the two).
+    props : int
+        The properties to calculate in addition to the density and the
+        compressibility factor: SWEEP_FUGCOEF for the fugacity coefficients
+        and the residual Gibbs energy, SWEEP_HSRES for the residual enthalpy
+        and entropy as well (with SWEEP_FUGCOEF).
+    cppargs : add_args
+        A struct containing additional arguments (see pcsaft_Z_cpp).
+
+    Returns
+    -------
+    result : sweep_result
+        The properties of each state, NaN where no density was found, and
+        the number of states whose density was solved from scratch.
+    */
+    int ncomp = x.size();
+    int nstates = t.size();
+    bool need_fugcoef = (props & (SWEEP_FUGCOEF | SWEEP_HSRES)) != 0 || phase == 2;
+
+    sweep_result result;
+    result.rho.assign(nstates, NaN);
+    result.Z.assign(nstates, NaN);
+    result.phase.assign(nstates, phase);
+    if (props & (SWEEP_FUGCOEF | SWEEP_HSRES)) {
+        result.fugcoef.assign(nstates*ncomp, NaN);
+        result.gres.assign(nstates, NaN);
+    }
+    if (props & SWEEP_HSRES) {
+        result.hres.assign(nstates, NaN);
+        result.sres.assign(nstates, NaN);
+    }
+    result.n_cold = 0;
+
+    sweep_branch branches[2];
+    for (int l = 0; l < 2; l++) {
+        branches[l].phase = l;
+        branches[l].n = 0;
+        branches[l].dist = 0;
+    }
+    int first = (phase == 1) ? 1 : 0;
+    int last = (phase == 0) ? 0 : 1;
+
+    vector<double> XA[2];
+    vector<double> fugcoef[2];
+    double rho[2], gres[2];
+    for (int k = 0; k < nstates; k++) {
+        double dist = (k > 0) ? path_distance(t[k-1], p[k-1], t[k], p[k]) : 0.;
+        double RT = kb*N_AV*t[k];
+        int best = -1;
+        for (int l = first; l <= last; l++) {
+            rho[l] = branch_solve(branches[l], dist, x, m, s, e, t[k], p[k], cppargs, XA[l], result.n_cold);
+            gres[l] = NaN;
+            if (isfinite(rho[l]) && need_fugcoef) {
+                fugcoef[l] = pcsaft_fugcoef_cpp(x, m, s, e, t[k], rho[l], cppargs);
+                gres[l] = 0.;
+                for (int i = 0; i < ncomp; i++) {
+                    gres[l] += x[i]*log(fugcoef[l][i])*RT;
+                }
+            }
+            if (isfinite(rho[l]) && (best < 0 || gres[l] < gres[best])) {
+                best = l;
+            }
+        }
+        if (phase == 2) {
+            // a branch that collapsed onto the other one is solved from
+            // scratch in the next state, so that it is found again if the
+            // phase appears
+            bool collapsed = isfinite(rho[0]) && isfinite(rho[1]) && fabs(rho[0] - rho[1]) < 1e-3*rho[0];
+            if (collapsed) {
+                branches[1-best].n = 0;
+            }
+        }
+        if (best < 0) {
+            continue;
+        }
+
+        result.rho[k] = rho[best];
+        result.phase[k] = best;
+        result.Z[k] = pcsaft_Z_cpp(x, m, s, e, t[k], rho[best], cppargs, &XA[best]);
+        if (props & (SWEEP_FUGCOEF | SWEEP_HSRES)) {
+            for (int i = 0; i < ncomp; i++) {
+                result.fugcoef[k*ncomp+i] = fugcoef[best][i];
+            }
+            result.gres[k] = gres[best];
+        }
+        if (props & SWEEP_HSRES) {
+            double dadt = pcsaft_dadt_cpp(x, m, s, e, t[k], rho[best], cppargs);
+            result.hres[k] = (-t[k]*dadt + (result.Z[k]-1))*RT; // Equation A.46 from Gross and Sadowski 2001
+            result.sres[k] = (result.hres[k] - result.gres[k])/t[k];
+        }
+    }
+    return result;
+}
@@ -0,0 +1,295 @@
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+
+#include "pcsaft_internal.h"
+
+using namespace std;
+
+/*
+Capture of the calls of the public functions in a binary trace file, and
+reading and re-evaluating the calls of a trace (see benchmarks/pcsaft_replay.cpp).
+
+The file starts with the 8 bytes "PCSAFTTR" and a uint32 version, followed
+by records that start with a one byte type:
+
+'M' (mixture): uint64 hash, uint32 ncomp, m, s and e (ncomp doubles each),
+    the vectors of add_args in the order k_ij, e_assoc, vol_a, dipm, dip_num,
+    z, dielc_coef, k_hb, l_ij, rxn_nu, rxn_lnk (each a uint32 length and the
+    doubles), dielc_model (a uint32 length and int32 values) and dielc.
+'C' (call): uint8 function id (TRACE_Z, ...), int8 phase, uint64 hash of
+    the mixture, uint32 ncomp, t, the density or pressure, rho_guess of
+    pcsaft_den_cpp, x (ncomp doubles), uint32 number of results and the
+    results.
+
+A mixture is written once, before its first call, so a call only costs the
+state and the result. Values are written in the byte order of the machine.
+Only the inputs listed above are recorded. The tolerances of solver_tol are
+replayed with their defaults, so the results of calls that used a tolerance
+budget are only reproduced to within that tolerance.
+*/
+
+const static char TRACE_MAGIC[8] = {'P', 'C', 'S', 'A', 'F', 'T', 'T', 'R'};
+const static uint32_t TRACE_VERSION = 1;
+
+#ifdef PCSAFT_TRACE
+atomic<bool> trace_active(false);
+thread_local int trace_depth = 0;
+
+static mutex trace_lock; // protects the file and the set of written mixtures
+static FILE *trace_file = NULL;
+static unordered_set<uint64_t> trace_mixtures;
+
+
+static void put_vector(FILE *fp, const vector<double> &v) {
+    uint32_t n = v.size();
+    fwrite(&n, sizeof(n), 1, fp);
+    if (n > 0) {
+        fwrite(&v[0], sizeof(double), n, fp);
+    }
+}
+
+
+void trace_record_cpp(int fn, int phase, const vector<double> &x, const vector<double> &m,
+    const vector<double> &s, const vector<double> &e, double t, double state, double rho_guess,
+    const add_args &cppargs, const double *result, int nresult) {
+    /**Append a call to the trace, preceded by its mixture if that is new.*/
+    uint64_t hash = mixture_hash_cpp(m, s, e, cppargs);
+    lock_guard<mutex> guard(trace_lock);
+    if (trace_file == NULL) {
+        return;
+    }
+    uint32_t ncomp = x.size();
+    if (trace_mixtures.insert(hash).second) {
+        fputc('M', trace_file);
+        fwrite(&hash, sizeof(hash), 1, trace_file);
+        fwrite(&ncomp, sizeof(ncomp), 1, trace_file);
+        fwrite(&m[0], sizeof(double), ncomp, trace_file);
+        fwrite(&s[0], sizeof(double), ncomp, trace_file);
+        fwrite(&e[0], sizeof(double), ncomp, trace_file);
+        put_vector(trace_file, cppargs.k_ij);
+        put_vector(trace_file, cppargs.e_assoc);
+        put_vector(trace_file, cppargs.vol_a);
+        put_vector(trace_file, cppargs.dipm);
+        put_vector(trace_file, cppargs.dip_num);
+        put_vector(trace_file, cppargs.z);
+        put_vector(trace_file, cppargs.dielc_coef);
+        put_vector(trace_file, cppargs.k_hb);
+        put_vector(trace_file, cppargs.l_ij);
+        put_vector(trace_file, cppargs.rxn_nu);
+        put_vector(trace_file, cppargs.rxn_lnk);
+        uint32_t n = cppargs.dielc_model.size();
+        fwrite(&n, sizeof(n), 1, trace_file);
+        for (uint32_t i = 0; i < n; i++) {
+            int32_t model = cppargs.dielc_model[i];
+            fwrite(&model, sizeof(model), 1, trace_file);
+        }
+        double dielc = cppargs.z.empty() ? 0. : cppargs.dielc; // dielc is not initialized without ions
+        fwrite(&dielc, sizeof(dielc), 1, trace_file);
+    }
+
+    fputc('C', trace_file);
+    fputc(fn, trace_file);
+    fputc((signed char)phase, trace_file);
+    fwrite(&hash, sizeof(hash), 1, trace_file);
+    fwrite(&ncomp, sizeof(ncomp), 1, trace_file);
+    fwrite(&t, sizeof(t), 1, trace_file);
+    fwrite(&state, sizeof(state), 1, trace_file);
+    fwrite(&rho_guess, sizeof(rho_guess), 1, trace_file);
+    fwrite(&x[0], sizeof(double), ncomp, trace_file);
+    uint32_t nres = nresult;
+    fwrite(&nres, sizeof(nres), 1, trace_file);
+    fwrite(result, sizeof(double), nres, trace_file);
+}
+#endif
+
+
+bool trace_start_cpp(const string &path) {
+    /**
+    Start writing the calls to a new trace file. Returns false if the file
+    cannot be created, or if the library was compiled without PCSAFT_TRACE.
+    Tracing should be started and stopped while no calculation is running.
+    */
+#ifdef PCSAFT_TRACE
+    trace_stop_cpp();
+    lock_guard<mutex> guard(trace_lock);
+    trace_file = fopen(path.c_str(), "wb");
+    if (trace_file == NULL) {
+        return false;
+    }
+    setvbuf(trace_file, NULL, _IOFBF, 1 << 20);
+    fwrite(TRACE_MAGIC, 1, sizeof(TRACE_MAGIC), trace_file);
+    fwrite(&TRACE_VERSION, sizeof(TRACE_VERSION), 1, trace_file);
+    trace_mixtures.clear();
+    trace_active.store(true);
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+
+void trace_stop_cpp() {
+    /**Stop tracing and close the trace file.*/
+#ifdef PCSAFT_TRACE
+    trace_active.store(false);
+    lock_guard<mutex> guard(trace_lock);
+    if (trace_file != NULL) {
+        fclose(trace_file);
+        trace_file = NULL;
+    }
+#endif
+}
+
+
+static bool get_vector(FILE *fp, vector<double> &v) {
+    uint32_t n;
+    if (fread(&n, sizeof(n), 1, fp) != 1) {
+        return false;
+    }
+    v.resize(n);
+    return n == 0 || fread(&v[0], sizeof(double), n, fp) == n;
+}
+
+
+bool trace_read_cpp(const string &path, vector<trace_mixture> &mixtures, vector<trace_call> &calls) {
+    /**
+    Read a trace file.
+
+    Parameters
+    ----------
+    path : string
+        Path of the trace file.
+    mixtures : vector<trace_mixture>
+        Receives the mixtures of the trace.
+    calls : vector<trace_call>
+        Receives the calls, in the order in which they were recorded. The
+        mixture of each call is an index into mixtures.
+
+    Returns
+    -------
+    ok : bool
+        False if the file cannot be read or is not a trace. A truncated last
+        record (e.g. of a process that was killed while tracing) is ignored.
+    */
+    mixtures.clear();
+    calls.clear();
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (fp == NULL) {
+        return false;
+    }
+    char magic[8];
+    uint32_t version;
+    if (fread(magic, 1, 8, fp) != 8 || memcmp(magic, TRACE_MAGIC, 8) != 0 ||
+        fread(&version, sizeof(version), 1, fp) != 1 || version != TRACE_VERSION) {
+        fclose(fp);
+        return false;
+    }
+
+    unordered_map<uint64_t, size_t> index; // mixture hash -> index in mixtures
+    int type;
+    while ((type = fgetc(fp)) != EOF) {
+        uint32_t ncomp;
+        uint64_t hash;
+        if (type == 'M') {
+            trace_mixture mix;
+            if (fread(&hash, sizeof(hash), 1, fp) != 1 || fread(&ncomp, sizeof(ncomp), 1, fp) != 1) {
+                break;
+            }
+            mix.hash = hash;
+            mix.m.resize(ncomp);
+            mix.s.resize(ncomp);
+            mix.e.resize(ncomp);
+            if (fread(&mix.m[0], sizeof(double), ncomp, fp) != ncomp ||
+                fread(&mix.s[0], sizeof(double), ncomp, fp) != ncomp ||
+                fread(&mix.e[0], sizeof(double), ncomp, fp) != ncomp) {
+                break;
+            }
+            add_args &a = mix.cppargs;
+            if (!get_vector(fp, a.k_ij) || !get_vector(fp, a.e_assoc) || !get_vector(fp, a.vol_a) ||
+                !get_vector(fp, a.dipm) || !get_vector(fp, a.dip_num) || !get_vector(fp, a.z) ||
+                !get_vector(fp, a.dielc_coef) || !get_vector(fp, a.k_hb) || !get_vector(fp, a.l_ij) ||
+                !get_vector(fp, a.rxn_nu) || !get_vector(fp, a.rxn_lnk)) {
+                break;
+            }
+            uint32_t n;
+            if (fread(&n, sizeof(n), 1, fp) != 1) {
+                break;
+            }
+            vector<int32_t> models(n);
+            if (n > 0 && fread(&models[0], sizeof(int32_t), n, fp) != n) {
+                break;
+            }
+            a.dielc_model.assign(models.begin(), models.end());
+            if (fread(&a.dielc, sizeof(a.dielc), 1, fp) != 1) {
+                break;
+            }
+            index[hash] = mixtures.size();
+            mixtures.push_back(mix);
+        }
+        else if (type == 'C') {
+            trace_call call;
+            int fn = fgetc(fp);
+            int phase = fgetc(fp);
+            if (fn == EOF || phase == EOF || fread(&hash, sizeof(hash), 1, fp) != 1 ||
+                fread(&ncomp, sizeof(ncomp), 1, fp) != 1 || fread(&call.t, sizeof(double), 1, fp) != 1 ||
+                fread(&call.state, sizeof(double), 1, fp) != 1 || fread(&call.rho_guess, sizeof(double), 1, fp) != 1) {
+                break;
+            }
+            call.fn = fn;
+            call.phase = (signed char)phase;
+            call.x.resize(ncomp);
+            if (fread(&call.x[0], sizeof(double), ncomp, fp) != ncomp || !get_vector(fp, call.result)) {
+                break;
+            }
+            unordered_map<uint64_t, size_t>::const_iterator it = index.find(hash);
+            if (it == index.end()) {
+                fclose(fp);
+                return false;
+            }
+            call.mixture = it->second;
+            calls.push_back(call);
+        }
+        else {
+            fclose(fp);
+            return false;
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+
+vector<double> trace_eval_cpp(const trace_call &call, trace_mixture &mixture) {
+    /**Evaluate a call of a trace again and return its result.*/
+    const vector<double> &x = call.x;
+    vector<double> &m = mixture.m, &s = mixture.s, &e = mixture.e;
+    add_args &cppargs = mixture.cppargs;
+    switch (call.fn) {
+        case TRACE_Z:
+            return vector<double>(1, pcsaft_Z_cpp(x, m, s, e, call.t, call.state, cppargs));
+        case TRACE_P:
+            return vector<double>(1, pcsaft_p_cpp(x, m, s, e, call.t, call.state, cppargs));
+        case TRACE_FUGCOEF:
+            return pcsaft_fugcoef_cpp(x, m, s, e, call.t, call.state, cppargs);
+        case TRACE_DEN:
+            return vector<double>(1, pcsaft_den_cpp(x, m, s, e, call.t, call.state, call.phase, cppargs,
+                call.rho_guess));
+        case TRACE_ARES:
+            return vector<double>(1, pcsaft_ares_cpp(x, m, s, e, call.t, call.state, cppargs));
+        case TRACE_DADT:
+            return vector<double>(1, pcsaft_dadt_cpp(x, m, s, e, call.t, call.state, cppargs));
+        case TRACE_HRES:
+            return vector<double>(1, pcsaft_hres_cpp(x, m, s, e, call.t, call.state, cppargs));
+        case TRACE_SRES:
+            return vector<double>(1, pcsaft_sres_cpp(x, m, s, e, call.t, call.state, cppargs));
+        case TRACE_GRES:
+            return vector<double>(1, pcsaft_gres_cpp(x, m, s, e, call.t, call.state, cppargs));
+    }
+    return vector<double>();
+}
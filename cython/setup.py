@@ -7,11 +7,50 @@ Distutils setup file for compiling to Cython module
 from distutils.core import setup, Extension
 from Cython.Build import cythonize
 import numpy as np
+import os
+import sys
+
+# OpenMP is used to evaluate the data points in parallel during parameter fitting
+if sys.platform == 'win32':
+    openmp_flags = ['/openmp']
+else:
+    openmp_flags = ['-fopenmp']
+
+# PCSAFT_INSTRUMENT=1 compiles in the solver counters (see instrument_snapshot), and
+# PCSAFT_TRACE=1 the recording of calls (see trace_start)
+define_macros = [(name, None) for name in ('PCSAFT_INSTRUMENT', 'PCSAFT_TRACE') if os.environ.get(name)]
+
+# With PCSAFT_LIB_DIR the extension links the library libpcsaft built with CMake
+# (e.g. with LTO or PGO, see README), which must have been configured with the
+# same PCSAFT_INSTRUMENT and PCSAFT_TRACE. Otherwise the C++ core is compiled
+# into the extension.
+lib_dir = os.environ.get('PCSAFT_LIB_DIR')
+if lib_dir:
+    sources = ["pcsaft_electrolyte.pyx"]
+    lib_args = dict(libraries=['pcsaft'], library_dirs=[lib_dir],
+                    runtime_library_dirs=[] if sys.platform == 'win32' else [lib_dir])
+else:
+    sources = ["pcsaft_electrolyte.pyx", "pcsaft.cpp", "pcsaft_batch.cpp", "pcsaft_fit.cpp",
+               "pcsaft_activity.cpp", "pcsaft_sweep.cpp", "pcsaft_cache.cpp", "pcsaft_instrument.cpp",
+               "pcsaft_trace.cpp", "pcsaft_db.cpp"]
+    lib_args = {}
+
+# Eigen is found with EIGEN3_INCLUDE_DIR, or in the usual install locations
+include_dirs = [np.get_include()]
+for eigen_dir in [os.environ.get('EIGEN3_INCLUDE_DIR'), '/usr/include/eigen3', '/usr/local/include/eigen3']:
+    if eigen_dir and os.path.isdir(eigen_dir):
+        include_dirs.append(eigen_dir)
+        break
 
 ext_modules = [
     Extension("pcsaft_electrolyte",
-        sources=["pcsaft_electrolyte.pyx"],
-        language="c++")]
+        sources=sources,
+        include_dirs=include_dirs,
+        define_macros=define_macros,
+        extra_compile_args=openmp_flags + (['/O2'] if sys.platform == 'win32' else ['-O3']),
+        extra_link_args=[] if sys.platform == 'win32' else openmp_flags,
+        language="c++",
+        **lib_args)]
 
 setup(name='PC-SAFT electrolyte',
       ext_modules=cythonize(ext_modules))
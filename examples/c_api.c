@@ -0,0 +1,92 @@
+/*
+Example of the C interface (pcsaft_c.h), which is also run by ctest.
+
+A methane + n-butane mixture is created, and the density, the fugacity
+coefficients and an isothermal flash are calculated, singly and as a batch,
+and with the cache of the mixture. The exit status is 1 if a result is not consistent.
+*/
+#include <stdio.h>
+#include <math.h>
+
+#include "pcsaft_c.h"
+
+#define NCOMP 2
+#define NBATCH 8
+
+static int check(int ok, const char *what) {
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+    }
+    return ok ? 0 : 1;
+}
+
+int main(void) {
+    const double m[NCOMP] = {1.0000, 2.3316};
+    const double s[NCOMP] = {3.7039, 3.7086};
+    const double e[NCOMP] = {150.03, 222.88};
+    const double k_ij[NCOMP*NCOMP] = {0., 0.022, 0.022, 0.};
+    const double k_ij_asym[NCOMP*NCOMP] = {0., 0.022, 0.03, 0.};
+    const double z[NCOMP] = {0.5, 0.5};
+    const double amounts[NCOMP] = {2., 2.};
+    double t = 300., p = 5e6;
+    pcsaft_mixture *mix;
+    double rho, rho_amounts, beta, x[NCOMP], y[NCOMP], rho_flash[2], phi_l[NCOMP], phi_v[NCOMP];
+    double t_batch[NBATCH], p_batch[NBATCH], rho_batch[NBATCH];
+    int status, status_batch[NBATCH], i, k, failed = 0;
+    long hits, misses, size;
+
+    failed += check(pcsaft_api_version() == PCSAFT_C_API_VERSION, "version");
+    status = pcsaft_mixture_create(NCOMP, m, s, e, &mix);
+    if (status != PCSAFT_OK) {
+        printf("pcsaft_mixture_create: %s\n", pcsaft_status_string(status));
+        return 1;
+    }
+    failed += check(pcsaft_mixture_set_kij(mix, k_ij_asym) == PCSAFT_ERR_ARGUMENT, "asymmetric k_ij");
+    failed += check(pcsaft_mixture_set_kij(mix, k_ij) == PCSAFT_OK, "set_kij");
+
+    status = pcsaft_density(mix, t, p, z, PCSAFT_VAPOR, &rho);
+    printf("vapor density at %g K and %g Pa: %.4f mol/m3 (%s)\n", t, p, rho, pcsaft_status_string(status));
+    failed += check(status == PCSAFT_OK && rho > 0, "density");
+    failed += check(pcsaft_density(mix, t, p, amounts, PCSAFT_VAPOR, &rho_amounts) == PCSAFT_OK &&
+        rho_amounts == rho, "density of a composition that is not normalized");
+
+    status = pcsaft_flash(mix, t, p, z, &beta, x, y, rho_flash);
+    printf("flash: beta %.6f, x %.6f %.6f, y %.6f %.6f, rho %.2f %.2f (%s)\n", beta, x[0], x[1], y[0], y[1],
+        rho_flash[0], rho_flash[1], pcsaft_status_string(status));
+    failed += check(status == PCSAFT_OK && beta > 0 && beta < 1, "two phases");
+    failed += check(pcsaft_fugacity(mix, t, p, x, PCSAFT_LIQUID, phi_l, NULL) == PCSAFT_OK &&
+        pcsaft_fugacity(mix, t, p, y, PCSAFT_VAPOR, phi_v, NULL) == PCSAFT_OK, "fugacity");
+    for (i = 0; i < NCOMP; i++) {
+        failed += check(fabs(x[i]*phi_l[i] - y[i]*phi_v[i]) < 1e-5*y[i]*phi_v[i], "equal fugacities");
+        failed += check(fabs(beta*y[i] + (1 - beta)*x[i] - z[i]) < 1e-9, "material balance");
+    }
+
+    for (k = 0; k < NBATCH; k++) {
+        t_batch[k] = 250. + 10.*k;
+        p_batch[k] = 1e5;
+    }
+    p_batch[NBATCH-1] = -1.;
+    status = pcsaft_density_batch(mix, NBATCH, t_batch, p_batch, z, 0, PCSAFT_VAPOR, rho_batch, status_batch);
+    failed += check(status == PCSAFT_ERR_ARGUMENT && status_batch[NBATCH-1] == PCSAFT_ERR_ARGUMENT,
+        "status of an invalid state");
+    for (k = 0; k < NBATCH - 1; k++) {
+        failed += check(status_batch[k] == PCSAFT_OK &&
+            pcsaft_density(mix, t_batch[k], p_batch[k], z, PCSAFT_VAPOR, &rho) == PCSAFT_OK &&
+            fabs(rho_batch[k] - rho) < 1e-6*rho, "batch density");
+    }
+
+    failed += check(pcsaft_mixture_set_cache(mix, 1000) == PCSAFT_OK, "set_cache");
+    for (k = 0; k < 2; k++) {
+        failed += check(pcsaft_density_batch(mix, NBATCH - 1, t_batch, p_batch, z, 0, PCSAFT_VAPOR, rho_batch + 1,
+            NULL) == PCSAFT_OK && fabs(rho_batch[1] - rho_batch[0]) < 1e-6*rho_batch[0], "cached density");
+    }
+    failed += check(pcsaft_mixture_cache_stats(mix, &hits, &misses, &size) == PCSAFT_OK && hits == NBATCH - 1 &&
+        misses == NBATCH - 1 && size == NBATCH - 1, "cache statistics");
+
+    failed += check(pcsaft_density(NULL, t, p, z, PCSAFT_VAPOR, &rho) == PCSAFT_ERR_NULL, "NULL handle");
+    failed += check(pcsaft_density(mix, -t, p, z, PCSAFT_VAPOR, &rho) == PCSAFT_ERR_ARGUMENT, "invalid state");
+    pcsaft_mixture_destroy(mix);
+
+    printf("%s\n", failed ? "FAILED" : "passed");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,107 @@
+#ifndef EVAL_STATES_H
+#define EVAL_STATES_H
+
+/*
+Evaluation of chunks of states with the batch functions of the C interface,
+shared by the command line tools.
+*/
+#include <cstring>
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "pcsaft_c.h"
+
+using namespace std;
+
+enum eval_mode {MODE_DENSITY, MODE_FUGACITY, MODE_RESIDUAL, MODE_FLASH};
+
+struct state_chunk {
+    vector<double> t, p, x; // x has ncomp values per state
+    int n;
+};
+
+struct result_chunk {
+    vector<int> status;
+    vector<double> values; // ncol values per state
+    int n;
+};
+
+
+inline int columns(eval_mode mode, int ncomp) {
+    switch (mode) {
+        case MODE_DENSITY: return 1;
+        case MODE_FUGACITY: return 1 + ncomp;
+        case MODE_RESIDUAL: return 4;
+        case MODE_FLASH: return 3 + 2*ncomp;
+    }
+    return 0;
+}
+
+
+inline void evaluate(const pcsaft_mixture *mix, eval_mode mode, int phase, const state_chunk &in,
+    result_chunk &out) {
+    /**Evaluate a chunk of states in parallel.*/
+    int n = in.n;
+    int ncomp = pcsaft_mixture_ncomp(mix);
+    int ncol = columns(mode, ncomp);
+    out.n = n;
+    out.status.assign(n, PCSAFT_OK);
+    out.values.assign((size_t)n*ncol, numeric_limits<double>::quiet_NaN());
+    if (n == 0) {
+        return;
+    }
+
+    // one composition for the whole chunk uses the vectorized kernels of the batch functions
+    int stride = 0;
+    for (int k = 1; k < n && stride == 0; k++) {
+        if (memcmp(&in.x[(size_t)k*ncomp], &in.x[0], ncomp*sizeof(double)) != 0) {
+            stride = ncomp;
+        }
+    }
+
+    double *v = &out.values[0];
+    int *st = &out.status[0];
+    if (mode == MODE_DENSITY) {
+        pcsaft_density_batch(mix, n, &in.t[0], &in.p[0], &in.x[0], stride, phase, v, st);
+    }
+    else if (mode == MODE_FUGACITY) {
+        vector<double> rho(n, numeric_limits<double>::quiet_NaN());
+        vector<double> phi((size_t)n*ncomp, numeric_limits<double>::quiet_NaN());
+        pcsaft_fugacity_batch(mix, n, &in.t[0], &in.p[0], &in.x[0], stride, phase, &phi[0], &rho[0], st);
+        for (int k = 0; k < n; k++) {
+            v[(size_t)k*ncol] = rho[k];
+            copy(phi.begin() + (size_t)k*ncomp, phi.begin() + (size_t)(k + 1)*ncomp, v + (size_t)k*ncol + 1);
+        }
+    }
+    else if (mode == MODE_RESIDUAL) {
+        vector<double> rho(n, numeric_limits<double>::quiet_NaN());
+        vector<double> res((size_t)n*3, numeric_limits<double>::quiet_NaN());
+        pcsaft_residual_batch(mix, n, &in.t[0], &in.p[0], &in.x[0], stride, phase, &res[0], &rho[0], st);
+        for (int k = 0; k < n; k++) {
+            v[(size_t)k*ncol] = rho[k];
+            copy(res.begin() + (size_t)k*3, res.begin() + (size_t)(k + 1)*3, v + (size_t)k*ncol + 1);
+        }
+    }
+    else {
+        vector<double> beta(n, numeric_limits<double>::quiet_NaN());
+        vector<double> rho((size_t)n*2, numeric_limits<double>::quiet_NaN());
+        vector<double> x((size_t)n*ncomp, numeric_limits<double>::quiet_NaN()), y(x);
+        pcsaft_flash_batch(mix, n, &in.t[0], &in.p[0], &in.x[0], stride, &beta[0], &x[0], &y[0], &rho[0], st);
+        for (int k = 0; k < n; k++) {
+            double *row = v + (size_t)k*ncol;
+            row[0] = beta[k];
+            row[1] = rho[2*k];
+            row[2] = rho[2*k+1];
+            copy(x.begin() + (size_t)k*ncomp, x.begin() + (size_t)(k + 1)*ncomp, row + 3);
+            copy(y.begin() + (size_t)k*ncomp, y.begin() + (size_t)(k + 1)*ncomp, row + 3 + ncomp);
+        }
+    }
+    for (int k = 0; k < n; k++) {
+        if (st[k] != PCSAFT_OK) {
+            fill(v + (size_t)k*ncol, v + (size_t)(k + 1)*ncol, numeric_limits<double>::quiet_NaN());
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,261 @@
+# -*- coding: utf-8 -*-
+"""
+Client of the local property server (tools/pcsaft_server.cpp).
+
+A mixture is registered once, with the same parameters as the functions of
+pcsaft_electrolyte, and the calculations then only send the states:
+
+    from pcsaft_client import PropertyClient
+
+    with PropertyClient('/tmp/pcsaft.sock') as client:
+        mix = client.register(m, s, e, {'k_ij': k_ij})
+        rho = client.density(mix, t, p, x, phase='vap')
+        beta, xl, yv, rho_l, rho_v = client.flash(mix, t, p, z)
+
+t and p are scalars or arrays of the same length, and x is one composition
+for all states or one row per state. The results of states that could not
+be calculated are NaN. A client must not be shared by several threads at
+the same time; each thread should open its own connection.
+
+Run as a script with the path of the server executable to test the server:
+
+    python pcsaft_client.py --self-test build/pcsaft_server
+"""
+import socket
+import struct
+import numpy as np
+
+PROTOCOL_VERSION = 1
+_HEADER = struct.Struct('=IHhI')
+_OP_PING, _OP_REGISTER, _OP_DENSITY, _OP_FUGACITY, _OP_RESIDUAL, _OP_FLASH, _OP_STATS = range(7)
+_PARAM_KEYS = {'k_ij': 1, 'l_ij': 2, 'k_hb': 3, 'e_assoc': 4, 'vol_a': 5, 'dipm': 6, 'dip_num': 7, 'z': 8,
+               'dielc': 9, 'dielc_model': 10, 'dielc_coef': 11}
+_PAIR_PARAMS = ('k_ij', 'l_ij', 'k_hb')
+_SERVER_ERRORS = {-1: 'invalid request', -2: 'unknown mixture', -3: 'unknown operation',
+                  1: 'NULL pointer', 2: 'invalid argument', 3: 'not converged', 4: 'out of memory'}
+
+
+class ServerError(Exception):
+    """A request was refused by the server."""
+    def __init__(self, status):
+        Exception.__init__(self, 'pcsaft_server: {} (status {})'.format(_SERVER_ERRORS.get(status, 'error'),
+                                                                       status))
+        self.status = status
+
+
+def _dense_pairs(params, ncomp):
+    """Convert a pair parameter given as for pcsaft_electrolyte to a dense symmetric matrix."""
+    if isinstance(params, dict):
+        dense = np.zeros((ncomp, ncomp))
+        for (i, j), value in params.items():
+            dense[i, j] = dense[j, i] = value
+        return dense
+    params = np.asarray(params, dtype=np.float64)
+    if params.size == ncomp*ncomp:
+        return params.reshape(ncomp, ncomp)
+    dense = np.zeros((ncomp, ncomp))
+    dense[np.triu_indices(ncomp)] = params.ravel()
+    return np.triu(dense) + np.triu(dense, 1).T
+
+
+class PropertyClient(object):
+    """Connection to a property server listening on the Unix domain socket path."""
+    def __init__(self, path, timeout=None):
+        self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self._sock.settimeout(timeout)
+        self._sock.connect(path)
+        self._tag = 0
+
+    def close(self):
+        self._sock.close()
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def _request(self, op, payload=b''):
+        self._tag = (self._tag + 1) & 0xffffffff
+        self._sock.sendall(_HEADER.pack(len(payload), op, 0, self._tag) + payload)
+        length, _, status, tag = _HEADER.unpack(self._recv(_HEADER.size))
+        response = self._recv(length)
+        if status != 0:
+            raise ServerError(status)
+        return response
+
+    def _recv(self, n):
+        data = bytearray()
+        while len(data) < n:
+            chunk = self._sock.recv(min(n - len(data), 1 << 20))
+            if not chunk:
+                raise ConnectionError('pcsaft_server closed the connection')
+            data += chunk
+        return bytes(data)
+
+    def ping(self):
+        """Return the protocol version of the server and its number of mixtures."""
+        return struct.unpack('=II', self._request(_OP_PING))
+
+    def register(self, m, s, e, pyargs=None):
+        """
+        Register a mixture and return its id. The optional parameters use the
+        keys of pcsaft_electrolyte (k_ij, l_ij, k_hb, e_assoc, vol_a, dipm,
+        dip_num, z, dielc, dielc_model, dielc_coef). Registering the same
+        parameters again returns the same id.
+        """
+        m = np.asarray(m, dtype=np.float64).ravel()
+        ncomp = m.size
+        parts = [struct.pack('=II', ncomp, len(pyargs or {})), m.tobytes(),
+                 np.asarray(s, dtype=np.float64).ravel().tobytes(),
+                 np.asarray(e, dtype=np.float64).ravel().tobytes()]
+        for name in sorted(pyargs or {}, key=lambda name: _PARAM_KEYS.get(name, 0)):
+            if name not in _PARAM_KEYS:
+                raise ValueError('unknown parameter {}'.format(name))
+            if name in _PAIR_PARAMS:
+                values = _dense_pairs(pyargs[name], ncomp)
+            else:
+                values = pyargs[name]
+            values = np.asarray(values, dtype=np.float64).ravel()
+            parts.append(struct.pack('=II', _PARAM_KEYS[name], values.size) + values.tobytes())
+        return struct.unpack('=I', self._request(_OP_REGISTER, b''.join(parts)))[0]
+
+    def stats(self, mixture):
+        """Return the counters of the server and of the cache of the mixture as a dict."""
+        values = struct.unpack('=6q', self._request(_OP_STATS, struct.pack('=I', mixture)))
+        return dict(zip(('requests', 'states', 'batches', 'cache_hits', 'cache_misses', 'cache_size'), values))
+
+    def evaluate(self, op, mixture, t, p, x, phase='liq'):
+        """
+        Send a calculation (density, fugacity, residual or flash) and return
+        the status of each state and the columns of its results, (n, ncol).
+        """
+        ops = {'density': _OP_DENSITY, 'fugacity': _OP_FUGACITY, 'residual': _OP_RESIDUAL, 'flash': _OP_FLASH}
+        t = np.atleast_1d(np.asarray(t, dtype=np.float64))
+        p = np.atleast_1d(np.asarray(p, dtype=np.float64))
+        x = np.asarray(x, dtype=np.float64)
+        n = max(t.size, p.size, x.shape[0] if x.ndim == 2 else 1)
+        t = np.broadcast_to(t, (n,))
+        p = np.broadcast_to(p, (n,))
+        shared = x.ndim == 1
+        payload = struct.pack('=IiII', mixture, 1 if phase == 'vap' else 0, n, int(shared)) + \
+            np.ascontiguousarray(t).tobytes() + np.ascontiguousarray(p).tobytes() + x.tobytes()
+        response = self._request(ops[op], payload)
+        status = np.frombuffer(response, dtype=np.int32, count=n)
+        values = np.frombuffer(response, dtype=np.float64, offset=4*n)
+        return status, values.reshape(n, -1)
+
+    def density(self, mixture, t, p, x, phase='liq'):
+        """Molar density (mol m^-3) of the phase."""
+        _, values = self.evaluate('density', mixture, t, p, x, phase)
+        return self._shape(values[:, 0], t, p, x)
+
+    def fugcoef(self, mixture, t, p, x, phase='liq'):
+        """Fugacity coefficients of the phase, (ncomp) or (n, ncomp)."""
+        _, values = self.evaluate('fugacity', mixture, t, p, x, phase)
+        return self._shape(values[:, 1:], t, p, x)
+
+    def residual(self, mixture, t, p, x, phase='liq'):
+        """Residual enthalpy (J mol^-1), entropy (J mol^-1 K^-1) and Gibbs energy (J mol^-1) of the phase."""
+        _, values = self.evaluate('residual', mixture, t, p, x, phase)
+        return tuple(self._shape(values[:, k], t, p, x) for k in (1, 2, 3))
+
+    def flash(self, mixture, t, p, z):
+        """Isothermal flash: vapor fraction, liquid and vapor compositions and densities."""
+        _, values = self.evaluate('flash', mixture, t, p, z)
+        ncomp = (values.shape[1] - 3)//2
+        return (self._shape(values[:, 0], t, p, z), self._shape(values[:, 3:3+ncomp], t, p, z),
+                self._shape(values[:, 3+ncomp:], t, p, z), self._shape(values[:, 1], t, p, z),
+                self._shape(values[:, 2], t, p, z))
+
+    @staticmethod
+    def _shape(values, t, p, x):
+        """Return the results of a single state without the state dimension."""
+        if np.ndim(t) == 0 and np.ndim(p) == 0 and np.ndim(x) == 1:
+            return values[0]
+        return values
+
+
+def _self_test(server_path):
+    """Start a server, check the results of concurrent clients and stop it again."""
+    import os
+    import subprocess
+    import tempfile
+    import threading
+    import time
+
+    path = os.path.join(tempfile.mkdtemp(), 'pcsaft.sock')
+    server = subprocess.Popen([server_path, '--socket', path, '--quiet'])
+    try:
+        for _ in range(500):
+            if os.path.exists(path):
+                break
+            time.sleep(0.01)
+        failed = []
+
+        def check(ok, what):
+            if not ok:
+                print('FAILED:', what)
+                failed.append(what)
+
+        m = np.asarray([1.0000, 2.3316])
+        s = np.asarray([3.7039, 3.7086])
+        e = np.asarray([150.03, 222.88])
+        pyargs = {'k_ij': np.asarray([[0, 0.022], [0.022, 0]])}
+        z = np.asarray([0.5, 0.5])
+        t = np.linspace(250., 350., 64)
+        with PropertyClient(path) as client:
+            check(client.ping()[0] == PROTOCOL_VERSION, 'protocol version')
+            mix = client.register(m, s, e, pyargs)
+            check(client.register(m, s, e, pyargs) == mix, 'same id for the same mixture')
+            rho_batch = client.density(mix, t, 1e5, z, phase='vap')
+            beta, x, y, rho_l, rho_v = client.flash(mix, 300., 5e6, z)
+            print('flash: beta {:.6f}, x {}, y {}, rho {:.2f} {:.2f}'.format(beta, x, y, rho_l, rho_v))
+            check(0 < beta < 1 and np.allclose(beta*y + (1 - beta)*x, z, atol=1e-9), 'flash')
+            phi_l = client.fugcoef(mix, 300., 5e6, x, phase='liq')
+            phi_v = client.fugcoef(mix, 300., 5e6, y, phase='vap')
+            check(np.allclose(x*phi_l, y*phi_v, rtol=1e-5), 'equal fugacities')
+            status, _ = client.evaluate('density', mix, [300., -1.], 1e5, z)
+            check(list(status) == [0, 2], 'status of an invalid state')
+            try:
+                client.density(mix + 1, 300., 1e5, z)
+                check(False, 'unknown mixture')
+            except ServerError as err:
+                check(err.status == -2, 'unknown mixture')
+            try:
+                client.register(m, s, e, {'dielc_model': np.asarray([np.nan, 1.5])})
+                check(False, 'dielectric model that is not an integer')
+            except ServerError as err:
+                check(err.status == 2, 'dielectric model that is not an integer')
+
+        # small requests of concurrent clients are evaluated in common batches
+        results = [None]*len(t)
+
+        def worker(k0):
+            with PropertyClient(path) as client:
+                for k in range(k0, len(t), 8):
+                    results[k] = client.density(mix, t[k], 1e5, z, phase='vap')
+        threads = [threading.Thread(target=worker, args=(k,)) for k in range(8)]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        check(np.allclose(results, rho_batch, rtol=1e-9), 'concurrent requests')
+        with PropertyClient(path) as client:
+            stats = client.stats(mix)
+        print('server: {}'.format(stats))
+        check(stats['cache_hits'] > 0, 'cache hits')
+    finally:
+        server.terminate()
+        server.wait()
+    check(not os.path.exists(path), 'socket removed')
+    print('FAILED' if failed else 'passed')
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    import sys
+    if len(sys.argv) != 3 or sys.argv[1] != '--self-test':
+        print('usage: python pcsaft_client.py --self-test SERVER')
+        sys.exit(2)
+    sys.exit(_self_test(sys.argv[2]))
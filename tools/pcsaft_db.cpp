@@ -0,0 +1,304 @@
+/*
+Build and inspect parameter databases (see cython/pcsaft_db.cpp).
+
+Usage:
+
+    pcsaft_db build INPUT OUTPUT
+    pcsaft_db list DATABASE
+    pcsaft_db mixture DATABASE NAME...
+
+build converts a text file of parameters to a database. list writes the
+database back in the text format, and mixture writes the mixture of the
+named components as a mixture file of pcsaft_eval.
+
+The text file has one component or pair per line, with its values given as
+key=value. Text after # is ignored.
+
+    component NAME m=.. s=.. e=.. [e_assoc=.. vol_a=..] [dipm=.. dip_num=..]
+              [z=..] [dielc_model=.. dielc_coef=a,b,c]
+    pair NAME NAME [k_ij=..] [l_ij=..] [k_hb=..]
+
+Missing values are 0. Names cannot contain spaces, and a pair may refer to
+components that are defined further down. The exit status is 0 on success,
+1 if the input or the database is invalid, and 2 for invalid arguments.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "pcsaft_internal.h"
+
+using namespace std;
+
+
+static string format_number(double v) {
+    /**Shortest of %.15g and %.17g that reads back as the same value.*/
+    char text[32];
+    snprintf(text, sizeof(text), "%.15g", v);
+    if (strtod(text, NULL) != v) {
+        snprintf(text, sizeof(text), "%.17g", v);
+    }
+    return text;
+}
+
+
+static bool parse_value(const string &text, double &value) {
+    char *end;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+
+static bool set_component_value(param_db_component &c, const string &key, const string &text) {
+    double v;
+    if (key == "dielc_coef") {
+        stringstream parts(text);
+        string part;
+        int k = 0;
+        while (getline(parts, part, ',')) {
+            if (k >= 3 || !parse_value(part, c.dielc_coef[k])) {
+                return false;
+            }
+            k++;
+        }
+        return k == 3;
+    }
+    if (!parse_value(text, v)) {
+        return false;
+    }
+    if (key == "m") c.m = v;
+    else if (key == "s") c.s = v;
+    else if (key == "e") c.e = v;
+    else if (key == "e_assoc") c.e_assoc = v;
+    else if (key == "vol_a") c.vol_a = v;
+    else if (key == "dipm") c.dipm = v;
+    else if (key == "dip_num") c.dip_num = v;
+    else if (key == "z") c.z = v;
+    else if (key == "dielc_model" && (v == 0 || v == 1 || v == 2)) c.dielc_model = (int)v;
+    else return false;
+    return true;
+}
+
+
+static bool set_pair_value(param_db_pair &pair, const string &key, const string &text) {
+    double v;
+    if (!parse_value(text, v)) {
+        return false;
+    }
+    if (key == "k_ij") pair.k_ij = v;
+    else if (key == "l_ij") pair.l_ij = v;
+    else if (key == "k_hb") pair.k_hb = v;
+    else return false;
+    return true;
+}
+
+
+static int build_database(const char *input, const char *output) {
+    FILE *fp = fopen(input, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "cannot open %s\n", input);
+        return 1;
+    }
+    vector<string> names;
+    vector<param_db_component> components;
+    vector<pair<string, string> > pair_names;
+    vector<param_db_pair> pairs;
+    map<string, uint32_t> ids;
+    vector<int> pair_lines;
+    char buf[4096];
+    int line_no = 0;
+    bool ok = true;
+    while (ok && fgets(buf, sizeof(buf), fp) != NULL) {
+        line_no++;
+        string line = buf;
+        size_t hash = line.find('#');
+        if (hash != string::npos) {
+            line.erase(hash);
+        }
+        stringstream words(line);
+        string kind, name, name2, word;
+        if (!(words >> kind)) {
+            continue;
+        }
+        if (kind == "component" && (words >> name)) {
+            param_db_component c;
+            memset(&c, 0, sizeof(c));
+            while (ok && (words >> word)) {
+                size_t eq = word.find('=');
+                ok = eq != string::npos && set_component_value(c, word.substr(0, eq), word.substr(eq + 1));
+            }
+            if (ok && ids.count(name) > 0) {
+                fprintf(stderr, "%s:%d: %s is defined twice\n", input, line_no, name.c_str());
+                fclose(fp);
+                return 1;
+            }
+            ids[name] = names.size();
+            names.push_back(name);
+            components.push_back(c);
+        }
+        else if (kind == "pair" && (words >> name >> name2)) {
+            param_db_pair p;
+            memset(&p, 0, sizeof(p));
+            while (ok && (words >> word)) {
+                size_t eq = word.find('=');
+                ok = eq != string::npos && set_pair_value(p, word.substr(0, eq), word.substr(eq + 1));
+            }
+            pairs.push_back(p);
+            pair_names.push_back(make_pair(name, name2));
+            pair_lines.push_back(line_no);
+        }
+        else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "%s:%d: invalid line: %s", input, line_no, buf);
+        }
+    }
+    fclose(fp);
+    if (!ok) {
+        return 1;
+    }
+    for (size_t k = 0; k < pairs.size(); k++) {
+        if (ids.count(pair_names[k].first) == 0 || ids.count(pair_names[k].second) == 0 ||
+            pair_names[k].first == pair_names[k].second) {
+            fprintf(stderr, "%s:%d: the pair %s %s is not a pair of two defined components\n", input,
+                pair_lines[k], pair_names[k].first.c_str(), pair_names[k].second.c_str());
+            return 1;
+        }
+        pairs[k].i = ids[pair_names[k].first];
+        pairs[k].j = ids[pair_names[k].second];
+    }
+    if (!param_db_write_cpp(output, names, components, pairs)) {
+        fprintf(stderr, "cannot write %s (is a pair given twice?)\n", output);
+        return 1;
+    }
+    fprintf(stderr, "%s: %d components, %d pairs\n", output, (int)names.size(), (int)pairs.size());
+    return 0;
+}
+
+
+static void print_component(const param_db &db, int id) {
+    const param_db_component &c = db.components[id];
+    string line = string("component ") + param_db_name_cpp(db, id) + " m=" + format_number(c.m) +
+        " s=" + format_number(c.s) + " e=" + format_number(c.e);
+    if (c.e_assoc != 0 || c.vol_a != 0) {
+        line += " e_assoc=" + format_number(c.e_assoc) + " vol_a=" + format_number(c.vol_a);
+    }
+    if (c.dipm != 0 || c.dip_num != 0) {
+        line += " dipm=" + format_number(c.dipm) + " dip_num=" + format_number(c.dip_num);
+    }
+    if (c.z != 0) {
+        line += " z=" + format_number(c.z);
+    }
+    if (c.dielc_model != 0) {
+        line += " dielc_model=" + to_string(c.dielc_model);
+    }
+    if (c.dielc_coef[0] != 0 || c.dielc_coef[1] != 0 || c.dielc_coef[2] != 0) {
+        line += " dielc_coef=" + format_number(c.dielc_coef[0]) + "," + format_number(c.dielc_coef[1]) + "," +
+            format_number(c.dielc_coef[2]);
+    }
+    printf("%s\n", line.c_str());
+}
+
+
+static int list_database(const char *path) {
+    param_db db;
+    if (!param_db_open_cpp(path, db)) {
+        fprintf(stderr, "%s is not a valid parameter database\n", path);
+        return 1;
+    }
+    for (uint32_t k = 0; k < db.ncomp; k++) {
+        print_component(db, k);
+    }
+    for (uint32_t k = 0; k < db.npairs; k++) {
+        const param_db_pair &p = db.pairs[k];
+        string line = string("pair ") + param_db_name_cpp(db, p.i) + " " + param_db_name_cpp(db, p.j);
+        if (p.k_ij != 0) line += " k_ij=" + format_number(p.k_ij);
+        if (p.l_ij != 0) line += " l_ij=" + format_number(p.l_ij);
+        if (p.k_hb != 0) line += " k_hb=" + format_number(p.k_hb);
+        printf("%s\n", line.c_str());
+    }
+    param_db_close_cpp(db);
+    return 0;
+}
+
+
+static void print_values(const char *name, const vector<double> &v, int row) {
+    /**Write a parameter of a mixture file, with row values per line (matrices).*/
+    if (v.empty()) {
+        return;
+    }
+    printf("%s", name);
+    for (size_t k = 0; k < v.size(); k++) {
+        printf("%s%s", (k > 0 && k % row == 0) ? "\n   " : " ", format_number(v[k]).c_str());
+    }
+    printf("\n");
+}
+
+
+static int print_mixture(const char *path, int ncomp, char **names) {
+    param_db db;
+    if (!param_db_open_cpp(path, db)) {
+        fprintf(stderr, "%s is not a valid parameter database\n", path);
+        return 1;
+    }
+    vector<int> ids(ncomp);
+    for (int i = 0; i < ncomp; i++) {
+        ids[i] = param_db_find_cpp(db, names[i]);
+        if (ids[i] < 0) {
+            fprintf(stderr, "%s: no component %s\n", path, names[i]);
+            param_db_close_cpp(db);
+            return 1;
+        }
+    }
+    vector<double> m, s, e;
+    add_args cppargs;
+    param_db_mixture_cpp(db, ids, m, s, e, cppargs);
+    printf("#");
+    for (int i = 0; i < ncomp; i++) {
+        printf(" %s", names[i]);
+    }
+    printf("\n");
+    print_values("m", m, ncomp);
+    print_values("s", s, ncomp);
+    print_values("e", e, ncomp);
+    print_values("k_ij", cppargs.k_ij, ncomp);
+    print_values("l_ij", cppargs.l_ij, ncomp);
+    print_values("k_hb", cppargs.k_hb, ncomp);
+    print_values("e_assoc", cppargs.e_assoc, ncomp);
+    print_values("vol_a", cppargs.vol_a, ncomp);
+    print_values("dipm", cppargs.dipm, ncomp);
+    print_values("dip_num", cppargs.dip_num, ncomp);
+    print_values("z", cppargs.z, ncomp);
+    print_values("dielc_model", vector<double>(cppargs.dielc_model.begin(), cppargs.dielc_model.end()), ncomp);
+    print_values("dielc_coef", cppargs.dielc_coef, 3);
+    param_db_close_cpp(db);
+    return 0;
+}
+
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s build INPUT OUTPUT\n"
+        "       %s list DATABASE\n"
+        "       %s mixture DATABASE NAME...\n", name, name, name);
+    return 2;
+}
+
+
+int main(int argc, char **argv) {
+    string command = (argc > 1) ? argv[1] : "";
+    if (command == "build" && argc == 4) {
+        return build_database(argv[2], argv[3]);
+    }
+    if (command == "list" && argc == 3) {
+        return list_database(argv[2]);
+    }
+    if (command == "mixture" && argc >= 4) {
+        return print_mixture(argv[2], argc - 3, argv + 3);
+    }
+    return usage(argv[0]);
+}
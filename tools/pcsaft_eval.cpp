@@ -0,0 +1,591 @@
+/*
+Streaming evaluation of PC-SAFT for large files of states, e.g. to generate
+property tables.
+
+The states are read in chunks, and each chunk is evaluated with the batch
+functions of the C interface (pcsaft_c.h) on all cores. While a chunk is
+evaluated, the results of the previous chunk are written and the next chunk
+is read on a second thread. The results are written in the order of the
+input and memory use depends on the chunk size, not on the size of the file.
+
+Usage:
+
+    pcsaft_eval MODE (--mixture FILE | --database FILE --components A,B,..)
+                [--input FILE] [--output FILE] [--output-format csv|binary]
+                [--phase liq|vap] [--chunk N] [--threads N] [--quiet]
+
+MODE is density, fugacity, residual or flash. The input and output are stdin
+and stdout by default (or "-").
+
+The mixture file has one parameter per line, the name followed by the
+values: m, s and e are required, and k_ij, l_ij and k_hb (ncomp*ncomp, row
+by row), e_assoc and vol_a, dipm and dip_num, z and dielc, and dielc_model
+and dielc_coef are optional (see pcsaft_c.h). A line that starts with a
+number continues the values of the previous line, e.g. for the rows of a
+matrix. Text after # is ignored. Instead of a mixture file, the components
+can be taken by name from a parameter database (see tools/pcsaft_db.cpp).
+
+Input: CSV lines with the temperature (K), the pressure (Pa) and the ncomp
+mole fractions. Empty lines, comments (#) and a header line are skipped. A
+line that cannot be read gives an output row with status 2. Or the binary
+format, which is detected by its first 8 bytes "PCSAFTST", followed by a
+uint32 version (1) and uint32 ncomp, and then records of ncomp + 2 doubles
+(T, P, x).
+
+Output columns of each mode:
+
+    density   rho
+    fugacity  rho, phi_1 .. phi_n
+    residual  rho, hres, sres, gres
+    flash     beta, rho_l, rho_v, x_1 .. x_n, y_1 .. y_n
+
+CSV output has a header line and the status of the state (0 = success, see
+pcsaft_c.h) as the last column. The binary output starts with the 8 bytes
+"PCSAFTRS", a uint32 version (1) and the uint32 number of columns, followed
+by one record per state: an int32 status and the columns as doubles. The
+values of states that failed are NaN. The binary formats use the byte order
+of the machine.
+
+Progress is printed to stderr every two seconds, and a summary at the end.
+The exit status is 0 if all states succeeded, 1 if some failed, and 2 for
+invalid arguments or input.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <limits>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "pcsaft_c.h"
+#include "eval_states.h"
+
+using namespace std;
+
+const static char STATES_MAGIC[8] = {'P', 'C', 'S', 'A', 'F', 'T', 'S', 'T'};
+const static char RESULTS_MAGIC[8] = {'P', 'C', 'S', 'A', 'F', 'T', 'R', 'S'};
+const static uint32_t FORMAT_VERSION = 1;
+
+struct input_stream {
+    /**Buffered reader that can look ahead and read lines or raw bytes.*/
+    FILE *fp;
+    vector<char> buf;
+    size_t pos, end;
+    long long consumed; // bytes consumed so far, for the progress
+    input_stream(FILE *f) : fp(f), buf(1 << 20), pos(0), end(0), consumed(0) {}
+
+    size_t fill(size_t need) {
+        /**Make at least need bytes available unless the input ends. Returns the available bytes.*/
+        if (end - pos >= need) {
+            return end - pos;
+        }
+        memmove(&buf[0], &buf[pos], end - pos);
+        end -= pos;
+        pos = 0;
+        if (need > buf.size()) {
+            buf.resize(need);
+        }
+        while (end < need) {
+            size_t n = fread(&buf[end], 1, buf.size() - end, fp);
+            if (n == 0) {
+                break;
+            }
+            end += n;
+        }
+        return end - pos;
+    }
+
+    bool read_line(string &line) {
+        line.clear();
+        for (;;) {
+            if (pos == end && fill(1) == 0) {
+                return !line.empty();
+            }
+            char *start = &buf[pos];
+            char *nl = (char *)memchr(start, '\n', end - pos);
+            size_t n = (nl != NULL) ? nl - start : end - pos;
+            line.append(start, n);
+            pos += n;
+            consumed += n;
+            if (nl != NULL) {
+                pos += 1;
+                consumed += 1;
+                return true;
+            }
+        }
+    }
+
+    size_t read_bytes(void *dst, size_t n) {
+        size_t avail = min(fill(n), n);
+        memcpy(dst, &buf[pos], avail);
+        pos += avail;
+        consumed += avail;
+        return avail;
+    }
+};
+
+
+static bool parse_numbers(const char *text, vector<double> &values) {
+    /**Parse a comma separated list of numbers. Returns false if a field is not a number.*/
+    values.clear();
+    const char *c = text;
+    for (;;) {
+        char *end;
+        double v = strtod(c, &end);
+        if (end == c) {
+            return false;
+        }
+        values.push_back(v);
+        c = end;
+        while (*c == ' ' || *c == '\t' || *c == '\r') {
+            c++;
+        }
+        if (*c == '\0') {
+            return true;
+        }
+        if (*c != ',') {
+            return false;
+        }
+        c++;
+    }
+}
+
+
+static bool read_mixture(const char *path, pcsaft_mixture **mix) {
+    /**Read a mixture file (see the top of this file) and create the mixture.*/
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "cannot open the mixture file %s\n", path);
+        return false;
+    }
+    input_stream in(fp);
+    string line;
+    vector<string> names;
+    vector<vector<double> > params;
+    bool ok = true;
+    while (in.read_line(line)) {
+        size_t hash = line.find('#');
+        if (hash != string::npos) {
+            line.erase(hash);
+        }
+        size_t start = line.find_first_not_of(" \t\r");
+        if (start == string::npos) {
+            continue;
+        }
+        const char *c = line.c_str() + start;
+        char *end;
+        strtod(c, &end);
+        if (end == c || names.empty()) { // a line that starts with a number continues the previous parameter
+            size_t name_end = line.find_first_of(" \t,", start);
+            names.push_back(line.substr(start, name_end - start));
+            params.push_back(vector<double>());
+            c = line.c_str() + ((name_end == string::npos) ? line.size() : name_end);
+        }
+        for (;;) {
+            while (*c == ' ' || *c == '\t' || *c == ',' || *c == '\r') {
+                c++;
+            }
+            if (*c == '\0') {
+                break;
+            }
+            params.back().push_back(strtod(c, &end));
+            if (end == c) {
+                fprintf(stderr, "%s: the values of %s are not numbers\n", path, names.back().c_str());
+                ok = false;
+                break;
+            }
+            c = end;
+        }
+    }
+    fclose(fp);
+    if (!ok) {
+        return false;
+    }
+
+    const vector<double> *m = NULL, *s = NULL, *e = NULL;
+    for (size_t k = 0; k < names.size(); k++) {
+        if (names[k] == "m") m = &params[k];
+        else if (names[k] == "s") s = &params[k];
+        else if (names[k] == "e") e = &params[k];
+    }
+    if (m == NULL || s == NULL || e == NULL || m->empty() || s->size() != m->size() || e->size() != m->size()) {
+        fprintf(stderr, "%s: m, s and e are required, with one value per component\n", path);
+        return false;
+    }
+    size_t ncomp = m->size();
+    int status = pcsaft_mixture_create(ncomp, &(*m)[0], &(*s)[0], &(*e)[0], mix);
+    const vector<double> *e_assoc = NULL, *vol_a = NULL, *dipm = NULL, *dip_num = NULL, *z = NULL;
+    const vector<double> *dielc_model = NULL, *dielc_coef = NULL;
+    double dielc = 0.;
+    for (size_t k = 0; k < names.size() && status == PCSAFT_OK; k++) {
+        const string &name = names[k];
+        const vector<double> &v = params[k];
+        size_t size = (name == "k_ij" || name == "l_ij" || name == "k_hb") ? ncomp*ncomp :
+            (name == "dielc") ? 1 : (name == "dielc_coef") ? ncomp*3 : ncomp;
+        if (v.size() != size) {
+            fprintf(stderr, "%s: %s has %d values instead of %d\n", path, name.c_str(), (int)v.size(), (int)size);
+            status = PCSAFT_ERR_ARGUMENT;
+            break;
+        }
+        if (name == "k_ij") status = pcsaft_mixture_set_kij(*mix, &v[0]);
+        else if (name == "l_ij") status = pcsaft_mixture_set_lij(*mix, &v[0]);
+        else if (name == "k_hb") status = pcsaft_mixture_set_khb(*mix, &v[0]);
+        else if (name == "e_assoc") e_assoc = &v;
+        else if (name == "vol_a") vol_a = &v;
+        else if (name == "dipm") dipm = &v;
+        else if (name == "dip_num") dip_num = &v;
+        else if (name == "z") z = &v;
+        else if (name == "dielc") dielc = v[0];
+        else if (name == "dielc_model") dielc_model = &v;
+        else if (name == "dielc_coef") dielc_coef = &v;
+        else if (name != "m" && name != "s" && name != "e") {
+            fprintf(stderr, "%s: unknown parameter %s\n", path, name.c_str());
+            status = PCSAFT_ERR_ARGUMENT;
+        }
+    }
+    if (status == PCSAFT_OK && (e_assoc != NULL || vol_a != NULL)) {
+        status = pcsaft_mixture_set_association(*mix, e_assoc ? &(*e_assoc)[0] : NULL,
+            vol_a ? &(*vol_a)[0] : NULL);
+    }
+    if (status == PCSAFT_OK && (dipm != NULL || dip_num != NULL)) {
+        status = pcsaft_mixture_set_dipole(*mix, dipm ? &(*dipm)[0] : NULL, dip_num ? &(*dip_num)[0] : NULL);
+    }
+    if (status == PCSAFT_OK && z != NULL) {
+        status = pcsaft_mixture_set_ions(*mix, &(*z)[0], dielc);
+    }
+    if (status == PCSAFT_OK && dielc_model != NULL) {
+        vector<int> models(dielc_model->begin(), dielc_model->end());
+        status = pcsaft_mixture_set_dielectric(*mix, &models[0], dielc_coef ? &(*dielc_coef)[0] : NULL);
+    }
+    if (status != PCSAFT_OK) {
+        fprintf(stderr, "%s: invalid mixture: %s\n", path, pcsaft_status_string(status));
+        pcsaft_mixture_destroy(*mix);
+        *mix = NULL;
+        return false;
+    }
+    return true;
+}
+
+
+static bool database_mixture(const char *path, const char *names, pcsaft_mixture **mix) {
+    /**Create the mixture of the comma separated components of a parameter database.*/
+    pcsaft_db *db = NULL;
+    int status = pcsaft_db_open(path, &db);
+    if (status != PCSAFT_OK) {
+        fprintf(stderr, "%s: %s\n", path, pcsaft_status_string(status));
+        return false;
+    }
+    vector<int> ids;
+    string list = names;
+    size_t start = 0;
+    for (;;) {
+        size_t comma = list.find(',', start);
+        string name = list.substr(start, (comma == string::npos) ? string::npos : comma - start);
+        ids.push_back(pcsaft_db_find(db, name.c_str()));
+        if (ids.back() < 0) {
+            fprintf(stderr, "%s: no component %s\n", path, name.c_str());
+            pcsaft_db_close(db);
+            return false;
+        }
+        if (comma == string::npos) {
+            break;
+        }
+        start = comma + 1;
+    }
+    status = pcsaft_db_mixture(db, ids.size(), &ids[0], mix);
+    pcsaft_db_close(db);
+    if (status != PCSAFT_OK) {
+        fprintf(stderr, "%s: invalid mixture: %s\n", path, pcsaft_status_string(status));
+        return false;
+    }
+    return true;
+}
+
+
+struct state_reader {
+    input_stream &in;
+    bool binary;
+    int ncomp;
+    long long line_no;
+    bool header_checked;
+    string line;
+    vector<double> fields;
+
+    state_reader(input_stream &stream, int nc) : in(stream), binary(false), ncomp(nc), line_no(0),
+        header_checked(false) {}
+
+    bool open() {
+        /**Detect the format. Returns false if a binary file does not match the mixture.*/
+        if (in.fill(sizeof(STATES_MAGIC)) >= sizeof(STATES_MAGIC) &&
+            memcmp(&in.buf[in.pos], STATES_MAGIC, sizeof(STATES_MAGIC)) == 0) {
+            binary = true;
+            char magic[8];
+            uint32_t header[2];
+            in.read_bytes(magic, sizeof(magic));
+            if (in.read_bytes(header, sizeof(header)) != sizeof(header) || header[0] != FORMAT_VERSION) {
+                fprintf(stderr, "unsupported version of the binary input\n");
+                return false;
+            }
+            if ((int)header[1] != ncomp) {
+                fprintf(stderr, "the binary input has %d components, the mixture %d\n", (int)header[1], ncomp);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void read(state_chunk &chunk, int max_states) {
+        chunk.t.resize(max_states);
+        chunk.p.resize(max_states);
+        chunk.x.resize((size_t)max_states*ncomp);
+        int n = 0;
+        if (binary) {
+            vector<double> record(ncomp + 2);
+            size_t bytes = record.size()*sizeof(double);
+            while (n < max_states && in.read_bytes(&record[0], bytes) == bytes) {
+                chunk.t[n] = record[0];
+                chunk.p[n] = record[1];
+                copy(record.begin() + 2, record.end(), chunk.x.begin() + (size_t)n*ncomp);
+                n++;
+            }
+        }
+        else {
+            while (n < max_states && in.read_line(line)) {
+                line_no++;
+                size_t start = line.find_first_not_of(" \t\r");
+                if (start == string::npos || line[start] == '#') {
+                    continue;
+                }
+                bool ok = parse_numbers(line.c_str() + start, fields) && (int)fields.size() == ncomp + 2;
+                if (!header_checked) {
+                    header_checked = true;
+                    if (!ok && !parse_numbers(line.c_str() + start, fields)) {
+                        continue; // a header line
+                    }
+                }
+                if (!ok) {
+                    // an invalid temperature gives the row the status PCSAFT_ERR_ARGUMENT
+                    fields.assign(ncomp + 2, numeric_limits<double>::quiet_NaN());
+                }
+                chunk.t[n] = fields[0];
+                chunk.p[n] = fields[1];
+                copy(fields.begin() + 2, fields.end(), chunk.x.begin() + (size_t)n*ncomp);
+                n++;
+            }
+        }
+        chunk.n = n;
+    }
+};
+
+
+static void write_header(FILE *fp, bool binary, eval_mode mode, int ncomp) {
+    int ncol = columns(mode, ncomp);
+    if (binary) {
+        uint32_t header[2] = {FORMAT_VERSION, (uint32_t)ncol};
+        fwrite(RESULTS_MAGIC, 1, sizeof(RESULTS_MAGIC), fp);
+        fwrite(header, sizeof(header), 1, fp);
+        return;
+    }
+    string names;
+    if (mode == MODE_FLASH) {
+        names = "beta,rho_l,rho_v";
+        for (int i = 1; i <= ncomp; i++) names += ",x_" + to_string(i);
+        for (int i = 1; i <= ncomp; i++) names += ",y_" + to_string(i);
+    }
+    else {
+        names = "rho";
+        if (mode == MODE_FUGACITY) {
+            for (int i = 1; i <= ncomp; i++) names += ",phi_" + to_string(i);
+        }
+        else if (mode == MODE_RESIDUAL) {
+            names += ",hres,sres,gres";
+        }
+    }
+    fprintf(fp, "%s,status\n", names.c_str());
+}
+
+
+static void write_results(FILE *fp, bool binary, const result_chunk &out) {
+    if (out.n == 0) {
+        return;
+    }
+    int ncol = out.values.size()/out.n;
+    if (binary) {
+        for (int k = 0; k < out.n; k++) {
+            int32_t status = out.status[k];
+            fwrite(&status, sizeof(status), 1, fp);
+            fwrite(&out.values[(size_t)k*ncol], sizeof(double), ncol, fp);
+        }
+        return;
+    }
+    string text;
+    char number[32];
+    for (int k = 0; k < out.n; k++) {
+        for (int j = 0; j < ncol; j++) {
+            snprintf(number, sizeof(number), "%.17g,", out.values[(size_t)k*ncol+j]);
+            text += number;
+        }
+        snprintf(number, sizeof(number), "%d\n", out.status[k]);
+        text += number;
+    }
+    fwrite(text.data(), 1, text.size(), fp);
+}
+
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s density|fugacity|residual|flash (--mixture FILE | --database FILE --components A,B,..)\n"
+        "           [--input FILE] [--output FILE] [--output-format csv|binary] [--phase liq|vap] [--chunk N]\n"
+        "           [--threads N] [--quiet]\n", name);
+    return 2;
+}
+
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        return usage(argv[0]);
+    }
+    string mode_name = argv[1];
+    eval_mode mode;
+    if (mode_name == "density") mode = MODE_DENSITY;
+    else if (mode_name == "fugacity") mode = MODE_FUGACITY;
+    else if (mode_name == "residual") mode = MODE_RESIDUAL;
+    else if (mode_name == "flash") mode = MODE_FLASH;
+    else return usage(argv[0]);
+
+    const char *mixture_path = NULL, *input_path = "-", *output_path = "-", *output_format = NULL;
+    const char *database_path = NULL, *component_names = NULL;
+    int phase = PCSAFT_LIQUID;
+    int chunk_size = 16384;
+    int nthreads = 0;
+    bool quiet = false;
+    for (int i = 2; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--quiet") {
+            quiet = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        }
+        const char *value = argv[++i];
+        if (arg == "--mixture") mixture_path = value;
+        else if (arg == "--database") database_path = value;
+        else if (arg == "--components") component_names = value;
+        else if (arg == "--input") input_path = value;
+        else if (arg == "--output") output_path = value;
+        else if (arg == "--output-format") output_format = value;
+        else if (arg == "--phase" && (strcmp(value, "liq") == 0 || strcmp(value, "vap") == 0)) {
+            phase = (strcmp(value, "liq") == 0) ? PCSAFT_LIQUID : PCSAFT_VAPOR;
+        }
+        else if (arg == "--chunk" && atoi(value) > 0) chunk_size = atoi(value);
+        else if (arg == "--threads" && atoi(value) > 0) nthreads = atoi(value);
+        else return usage(argv[0]);
+    }
+    if ((mixture_path == NULL) == (database_path == NULL) || (database_path != NULL) != (component_names != NULL) ||
+        (output_format != NULL && strcmp(output_format, "csv") != 0 &&
+        strcmp(output_format, "binary") != 0)) {
+        return usage(argv[0]);
+    }
+    if (nthreads > 0) {
+        omp_set_num_threads(nthreads);
+    }
+
+    pcsaft_mixture *mix = NULL;
+    if (mixture_path != NULL ? !read_mixture(mixture_path, &mix) : !database_mixture(database_path, component_names,
+        &mix)) {
+        return 2;
+    }
+    int ncomp = pcsaft_mixture_ncomp(mix);
+
+    bool from_stdin = strcmp(input_path, "-") == 0;
+    FILE *in_fp = from_stdin ? stdin : fopen(input_path, "rb");
+    if (in_fp == NULL) {
+        fprintf(stderr, "cannot open the input %s\n", input_path);
+        return 2;
+    }
+    long long input_size = -1; // for the progress, if the input is a file
+    if (!from_stdin && fseek(in_fp, 0, SEEK_END) == 0) {
+        input_size = ftell(in_fp);
+        fseek(in_fp, 0, SEEK_SET);
+    }
+    input_stream in(in_fp);
+    state_reader reader(in, ncomp);
+    if (!reader.open()) {
+        return 2;
+    }
+    bool binary_out = (output_format != NULL) ? strcmp(output_format, "binary") == 0 : reader.binary;
+    FILE *out_fp = (strcmp(output_path, "-") == 0) ? stdout : fopen(output_path, "wb");
+    if (out_fp == NULL) {
+        fprintf(stderr, "cannot create the output %s\n", output_path);
+        return 2;
+    }
+    setvbuf(out_fp, NULL, _IOFBF, 1 << 20);
+    write_header(out_fp, binary_out, mode, ncomp);
+
+    // Pipeline: while chunk k is evaluated, the results of chunk k-1 are
+    // written and chunk k+1 is read.
+    state_chunk states, states_next;
+    result_chunk results, results_prev;
+    results_prev.n = 0;
+    reader.read(states, chunk_size);
+    long long ndone = 0;
+    long long nstatus[PCSAFT_ERR_MEMORY + 1] = {0};
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    double last_report = 0.;
+    while (states.n > 0) {
+        future<void> io = async(launch::async, [&]() {
+            write_results(out_fp, binary_out, results_prev);
+            reader.read(states_next, chunk_size);
+        });
+        evaluate(mix, mode, phase, states, results);
+        io.get();
+
+        for (int k = 0; k < results.n; k++) {
+            nstatus[min(max(results.status[k], 0), (int)PCSAFT_ERR_MEMORY)] += 1;
+        }
+        ndone += results.n;
+        swap(states, states_next);
+        swap(results, results_prev);
+
+        double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        if (!quiet && elapsed - last_report >= 2.) {
+            last_report = elapsed;
+            fprintf(stderr, "%lld states, %.0f states/s, %lld failed", ndone, ndone/elapsed, ndone - nstatus[0]);
+            if (input_size > 0) {
+                fprintf(stderr, ", %.1f %% of the input", 100.*in.consumed/input_size);
+            }
+            fprintf(stderr, "\n");
+        }
+    }
+    write_results(out_fp, binary_out, results_prev);
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    if (out_fp != stdout) {
+        fclose(out_fp);
+    }
+    else {
+        fflush(out_fp);
+    }
+    if (!from_stdin) {
+        fclose(in_fp);
+    }
+    pcsaft_mixture_destroy(mix);
+
+    if (!quiet) {
+        fprintf(stderr, "%s: %lld states in %.3f s, %.0f states/s on %d threads\n", mode_name.c_str(), ndone,
+            elapsed, (elapsed > 0) ? ndone/elapsed : 0., omp_get_max_threads());
+        for (int status = PCSAFT_ERR_NULL; status <= PCSAFT_ERR_MEMORY; status++) {
+            if (nstatus[status] > 0) {
+                fprintf(stderr, "    %lld states with status %d (%s)\n", nstatus[status], status,
+                    pcsaft_status_string(status));
+            }
+        }
+    }
+    return (nstatus[0] == ndone) ? 0 : 1;
+}
@@ -0,0 +1,602 @@
+/*
+Local property server: keeps mixtures and their caches in memory and
+evaluates requests of other processes, received over a Unix domain socket.
+
+Programs that evaluate many small batches of states, e.g. a process
+simulator calling the property functions of each unit, otherwise pay for
+creating the mixture and start with an empty cache on every call or in
+every process. The server keeps the registered mixtures with a cache of
+their densities and fugacity coefficients (pcsaft_mixture_set_cache) for
+its whole lifetime, shared by all clients. Requests of all connections are
+collected in one queue: the requests that arrive while a batch is being
+evaluated are grouped by mixture, calculation and phase, and each group is
+evaluated as one parallel batch of the C interface (pcsaft_c.h).
+
+Usage:
+
+    pcsaft_server --socket PATH [--cache N] [--threads N] [--quiet]
+
+--cache is the number of cached results per mixture (default 100000, 0
+disables the caches) and --threads the number of threads of the batches.
+The server stops on SIGINT or SIGTERM and removes the socket.
+
+Protocol: each message (request and response) is a 12 byte header followed
+by its payload. The header has the uint32 length of the payload, the uint16
+operation, an int16 status (0 in requests) and a uint32 tag that the
+response repeats. A connection sends one request at a time and reads its
+response. All values use the byte order of the machine.
+
+    op  request payload                          response payload
+    0   ping: empty                              uint32 protocol version, uint32 number of mixtures
+    1   register: uint32 ncomp, uint32 nparam,   uint32 mixture id
+        m, s, e (ncomp doubles each), and
+        nparam optional parameters: uint32 key,
+        uint32 count, count doubles
+    2   density    uint32 mixture id,            int32 status (n), then the ncol
+    3   fugacity   int32 phase (0 = liquid),     doubles of each state (the columns
+    4   residual   uint32 n, uint32 shared,      of pcsaft_eval, e.g. rho,
+    5   flash      t (n), p (n) and x (n*ncomp,  phi_1 .. phi_n for fugacity)
+                   or ncomp if shared = 1)
+    6   stats: uint32 mixture id                 int64 requests, states, batches,
+                                                 cache hits, misses and size
+
+Keys of the optional parameters (sizes as in pcsaft_c.h): 1 k_ij, 2 l_ij,
+3 k_hb, 4 e_assoc, 5 vol_a, 6 dipm, 7 dip_num, 8 z, 9 dielc, 10 dielc_model,
+11 dielc_coef. Registering the same parameters again returns the id of the
+existing mixture.
+
+The status of a response is 0, a status code of pcsaft_c.h if the
+mixture could not be created, or one of the negative SERVER_ERR_* codes.
+Responses with a nonzero status have no payload. The status of each state
+is given in the payload of the calculations, and the values of states that
+failed are NaN.
+
+tools/pcsaft_client.py is a client for Python.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <omp.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "pcsaft_c.h"
+#include "eval_states.h"
+
+using namespace std;
+
+const static uint32_t PROTOCOL_VERSION = 1;
+const static uint32_t MAX_PAYLOAD = 1u << 28; // larger requests close the connection
+const static int MAX_COMPONENTS = 1000;
+
+enum server_op {OP_PING, OP_REGISTER, OP_DENSITY, OP_FUGACITY, OP_RESIDUAL, OP_FLASH, OP_STATS};
+
+// status of a response, besides 0 and the status codes of pcsaft_c.h
+const static int SERVER_ERR_REQUEST = -1; // the payload does not match the operation
+const static int SERVER_ERR_MIXTURE = -2; // unknown mixture id
+const static int SERVER_ERR_OP = -3; // unknown operation
+
+struct msg_header {
+    uint32_t length;
+    uint16_t op;
+    int16_t status;
+    uint32_t tag;
+};
+
+struct mixture_entry {
+    pcsaft_mixture *mix;
+    int ncomp;
+    mixture_entry() : mix(NULL), ncomp(0) {}
+    ~mixture_entry() {pcsaft_mixture_destroy(mix);}
+};
+
+struct eval_job {
+    /**A calculation request, evaluated by the dispatcher.*/
+    const mixture_entry *mixture;
+    eval_mode mode;
+    int phase;
+    state_chunk states;
+    result_chunk results;
+    bool done;
+};
+
+struct server_state {
+    long cache_capacity;
+    bool quiet;
+
+    mutex registry_lock;
+    vector<unique_ptr<mixture_entry> > mixtures; // the id is the index, mixtures are never removed
+    map<string, uint32_t> mixture_ids; // register payload -> id
+
+    mutex queue_lock;
+    condition_variable queue_ready, jobs_done;
+    vector<eval_job *> queue;
+
+    atomic<long long> nrequests, nstates, nbatches;
+
+    server_state() : cache_capacity(100000), quiet(false), nrequests(0), nstates(0), nbatches(0) {}
+};
+
+static volatile sig_atomic_t stop_requested = 0;
+
+
+static void on_signal(int) {
+    stop_requested = 1;
+}
+
+
+static bool read_all(int fd, void *dst, size_t n) {
+    char *c = (char *)dst;
+    while (n > 0) {
+        ssize_t k = read(fd, c, n);
+        if (k < 0 && errno == EINTR) {
+            continue;
+        }
+        if (k <= 0) {
+            return false;
+        }
+        c += k;
+        n -= k;
+    }
+    return true;
+}
+
+
+static bool write_all(int fd, const void *src, size_t n) {
+    const char *c = (const char *)src;
+    while (n > 0) {
+        ssize_t k = send(fd, c, n, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR) {
+            continue;
+        }
+        if (k <= 0) {
+            return false;
+        }
+        c += k;
+        n -= k;
+    }
+    return true;
+}
+
+
+struct payload_reader {
+    /**Sequential reads from a payload that fail once it is exhausted.*/
+    const char *pos, *end;
+    payload_reader(const vector<char> &payload) : pos(payload.data()), end(payload.data() + payload.size()) {}
+
+    template <typename T> bool read(T *dst, size_t n) {
+        if ((size_t)(end - pos) < n*sizeof(T)) {
+            return false;
+        }
+        memcpy(dst, pos, n*sizeof(T));
+        pos += n*sizeof(T);
+        return true;
+    }
+};
+
+
+template <typename T> static void append(vector<char> &buf, const T *src, size_t n) {
+    buf.insert(buf.end(), (const char *)src, (const char *)(src + n));
+}
+
+
+static const mixture_entry *find_mixture(server_state &srv, uint32_t id) {
+    lock_guard<mutex> guard(srv.registry_lock);
+    return (id < srv.mixtures.size()) ? srv.mixtures[id].get() : NULL;
+}
+
+
+static int set_parameter(pcsaft_mixture *mix, int ncomp, uint32_t key, const vector<double> &v,
+    map<uint32_t, vector<double> > &deferred) {
+    /**Apply a parameter of a register request, or keep it for the functions that take two parameters.*/
+    size_t pair = (size_t)ncomp*ncomp;
+    size_t size = (key <= 3) ? pair : (key == 9) ? 1 : (key == 11) ? (size_t)ncomp*3 : ncomp;
+    if (key < 1 || key > 11 || v.size() != size) {
+        return PCSAFT_ERR_ARGUMENT;
+    }
+    if (key == 1) return pcsaft_mixture_set_kij(mix, &v[0]);
+    if (key == 2) return pcsaft_mixture_set_lij(mix, &v[0]);
+    if (key == 3) return pcsaft_mixture_set_khb(mix, &v[0]);
+    if (key == 10) {
+        // the dielectric models are converted to int, which needs integral values in its range
+        for (size_t i = 0; i < v.size(); i++) {
+            if (!(v[i] >= INT_MIN && v[i] <= INT_MAX) || v[i] != floor(v[i])) {
+                return PCSAFT_ERR_ARGUMENT;
+            }
+        }
+    }
+    deferred[key] = v;
+    return PCSAFT_OK;
+}
+
+
+static int register_mixture(server_state &srv, const vector<char> &payload, uint32_t &id) {
+    string key(payload.begin(), payload.end());
+    {
+        lock_guard<mutex> guard(srv.registry_lock);
+        map<string, uint32_t>::const_iterator found = srv.mixture_ids.find(key);
+        if (found != srv.mixture_ids.end()) {
+            id = found->second;
+            return PCSAFT_OK;
+        }
+    }
+
+    payload_reader in(payload);
+    uint32_t counts[2];
+    if (!in.read(counts, 2) || counts[0] < 1 || counts[0] > (uint32_t)MAX_COMPONENTS) {
+        return SERVER_ERR_REQUEST;
+    }
+    int ncomp = counts[0];
+    vector<double> m(ncomp), s(ncomp), e(ncomp);
+    if (!in.read(&m[0], ncomp) || !in.read(&s[0], ncomp) || !in.read(&e[0], ncomp)) {
+        return SERVER_ERR_REQUEST;
+    }
+    unique_ptr<mixture_entry> entry(new mixture_entry());
+    entry->ncomp = ncomp;
+    int status = pcsaft_mixture_create(ncomp, &m[0], &s[0], &e[0], &entry->mix);
+    map<uint32_t, vector<double> > deferred;
+    for (uint32_t k = 0; k < counts[1] && status == PCSAFT_OK; k++) {
+        uint32_t param[2];
+        if (!in.read(param, 2) || param[1] > (uint32_t)(in.end - in.pos)/sizeof(double)) {
+            return SERVER_ERR_REQUEST;
+        }
+        vector<double> v(param[1]);
+        in.read(v.data(), v.size());
+        status = set_parameter(entry->mix, ncomp, param[0], v, deferred);
+    }
+    if (status != PCSAFT_OK) {
+        return status;
+    }
+    if (in.pos != in.end) {
+        return SERVER_ERR_REQUEST;
+    }
+
+    const double *e_assoc = deferred.count(4) ? &deferred[4][0] : NULL;
+    const double *vol_a = deferred.count(5) ? &deferred[5][0] : NULL;
+    const double *dipm = deferred.count(6) ? &deferred[6][0] : NULL;
+    const double *dip_num = deferred.count(7) ? &deferred[7][0] : NULL;
+    if (e_assoc != NULL || vol_a != NULL) {
+        status = pcsaft_mixture_set_association(entry->mix, e_assoc, vol_a);
+    }
+    if (status == PCSAFT_OK && (dipm != NULL || dip_num != NULL)) {
+        status = pcsaft_mixture_set_dipole(entry->mix, dipm, dip_num);
+    }
+    if (status == PCSAFT_OK && deferred.count(8)) {
+        status = pcsaft_mixture_set_ions(entry->mix, &deferred[8][0], deferred.count(9) ? deferred[9][0] : 0.);
+    }
+    if (status == PCSAFT_OK && deferred.count(10)) {
+        vector<int> models(deferred[10].begin(), deferred[10].end());
+        status = pcsaft_mixture_set_dielectric(entry->mix, &models[0],
+            deferred.count(11) ? &deferred[11][0] : NULL);
+    }
+    if (status == PCSAFT_OK) {
+        status = pcsaft_mixture_set_cache(entry->mix, srv.cache_capacity);
+    }
+    if (status != PCSAFT_OK) {
+        return status;
+    }
+
+    lock_guard<mutex> guard(srv.registry_lock);
+    map<string, uint32_t>::const_iterator found = srv.mixture_ids.find(key);
+    if (found != srv.mixture_ids.end()) { // registered by another connection in the meantime
+        id = found->second;
+        return PCSAFT_OK;
+    }
+    id = srv.mixtures.size();
+    srv.mixtures.push_back(move(entry));
+    srv.mixture_ids[key] = id;
+    return PCSAFT_OK;
+}
+
+
+static int parse_states(server_state &srv, const vector<char> &payload, eval_job &job) {
+    /**Read the mixture, the phase and the states of a calculation request.*/
+    payload_reader in(payload);
+    uint32_t id, n, shared;
+    int32_t phase;
+    if (!in.read(&id, 1) || !in.read(&phase, 1) || !in.read(&n, 1) || !in.read(&shared, 1) ||
+        (phase != PCSAFT_LIQUID && phase != PCSAFT_VAPOR) || shared > 1) {
+        return SERVER_ERR_REQUEST;
+    }
+    job.mixture = find_mixture(srv, id);
+    if (job.mixture == NULL) {
+        return SERVER_ERR_MIXTURE;
+    }
+    int ncomp = job.mixture->ncomp;
+    size_t nx = (shared ? 1 : (size_t)n)*ncomp;
+    if ((size_t)(in.end - in.pos) != (2*(size_t)n + nx)*sizeof(double)) {
+        return SERVER_ERR_REQUEST;
+    }
+    job.phase = phase;
+    state_chunk &states = job.states;
+    states.n = n;
+    states.t.resize(n);
+    states.p.resize(n);
+    states.x.resize((size_t)n*ncomp);
+    in.read(states.t.data(), n);
+    in.read(states.p.data(), n);
+    if (shared) {
+        in.read(states.x.data(), ncomp);
+        for (uint32_t k = 1; k < n; k++) {
+            copy(states.x.begin(), states.x.begin() + ncomp, states.x.begin() + (size_t)k*ncomp);
+        }
+    }
+    else {
+        in.read(states.x.data(), nx);
+    }
+    return PCSAFT_OK;
+}
+
+
+static void evaluate_group(server_state &srv, const vector<eval_job *> &group) {
+    /**Evaluate jobs of the same mixture, calculation and phase as one batch.*/
+    const eval_job &first = *group[0];
+    srv.nbatches += 1;
+    if (group.size() == 1) {
+        evaluate(first.mixture->mix, first.mode, first.phase, first.states, group[0]->results);
+        return;
+    }
+    int ncomp = first.mixture->ncomp;
+    state_chunk states;
+    states.n = 0;
+    for (size_t j = 0; j < group.size(); j++) {
+        const state_chunk &s = group[j]->states;
+        states.t.insert(states.t.end(), s.t.begin(), s.t.begin() + s.n);
+        states.p.insert(states.p.end(), s.p.begin(), s.p.begin() + s.n);
+        states.x.insert(states.x.end(), s.x.begin(), s.x.begin() + (size_t)s.n*ncomp);
+        states.n += s.n;
+    }
+    result_chunk results;
+    evaluate(first.mixture->mix, first.mode, first.phase, states, results);
+    int ncol = columns(first.mode, ncomp);
+    int offset = 0;
+    for (size_t j = 0; j < group.size(); j++) {
+        result_chunk &r = group[j]->results;
+        r.n = group[j]->states.n;
+        r.status.assign(results.status.begin() + offset, results.status.begin() + offset + r.n);
+        r.values.assign(results.values.begin() + (size_t)offset*ncol,
+            results.values.begin() + (size_t)(offset + r.n)*ncol);
+        offset += r.n;
+    }
+}
+
+
+static void dispatch(server_state &srv, int nthreads) {
+    /**Take the queued jobs, evaluate them in groups and wake the connections that wait for them.*/
+    if (nthreads > 0) {
+        omp_set_num_threads(nthreads); // the setting belongs to the thread that starts the parallel regions
+    }
+    vector<eval_job *> jobs;
+    for (;;) {
+        {
+            unique_lock<mutex> guard(srv.queue_lock);
+            srv.queue_ready.wait(guard, [&]() {return !srv.queue.empty();});
+            jobs.swap(srv.queue);
+        }
+        map<tuple<const mixture_entry *, int, int>, vector<eval_job *> > groups;
+        for (size_t j = 0; j < jobs.size(); j++) {
+            eval_job *job = jobs[j];
+            int phase = (job->mode == MODE_FLASH) ? 0 : job->phase;
+            groups[make_tuple(job->mixture, (int)job->mode, phase)].push_back(job);
+        }
+        for (map<tuple<const mixture_entry *, int, int>, vector<eval_job *> >::iterator it = groups.begin();
+            it != groups.end(); ++it) {
+            evaluate_group(srv, it->second);
+        }
+        {
+            lock_guard<mutex> guard(srv.queue_lock);
+            for (size_t j = 0; j < jobs.size(); j++) {
+                jobs[j]->done = true;
+            }
+        }
+        srv.jobs_done.notify_all();
+        jobs.clear();
+    }
+}
+
+
+static int handle_request(server_state &srv, const msg_header &request, const vector<char> &payload,
+    vector<char> &response) {
+    /**Carry out a request and write the payload of its response. Returns the status of the response.*/
+    srv.nrequests += 1;
+    if (request.op == OP_PING) {
+        uint32_t values[2] = {PROTOCOL_VERSION, 0};
+        {
+            lock_guard<mutex> guard(srv.registry_lock);
+            values[1] = srv.mixtures.size();
+        }
+        append(response, values, 2);
+        return PCSAFT_OK;
+    }
+    if (request.op == OP_REGISTER) {
+        uint32_t id;
+        int status = register_mixture(srv, payload, id);
+        if (status == PCSAFT_OK) {
+            append(response, &id, 1);
+        }
+        return status;
+    }
+    if (request.op == OP_STATS) {
+        uint32_t id;
+        payload_reader in(payload);
+        if (!in.read(&id, 1) || in.pos != in.end) {
+            return SERVER_ERR_REQUEST;
+        }
+        const mixture_entry *entry = find_mixture(srv, id);
+        if (entry == NULL) {
+            return SERVER_ERR_MIXTURE;
+        }
+        long hits, misses, size;
+        pcsaft_mixture_cache_stats(entry->mix, &hits, &misses, &size);
+        int64_t values[6] = {srv.nrequests, srv.nstates, srv.nbatches, hits, misses, size};
+        append(response, values, 6);
+        return PCSAFT_OK;
+    }
+    if (request.op < OP_DENSITY || request.op > OP_FLASH) {
+        return SERVER_ERR_OP;
+    }
+
+    eval_job job;
+    job.mode = (request.op == OP_DENSITY) ? MODE_DENSITY : (request.op == OP_FUGACITY) ? MODE_FUGACITY :
+        (request.op == OP_RESIDUAL) ? MODE_RESIDUAL : MODE_FLASH;
+    job.done = false;
+    int status = parse_states(srv, payload, job);
+    if (status != PCSAFT_OK) {
+        return status;
+    }
+    srv.nstates += job.states.n;
+    if (job.states.n > 0) {
+        unique_lock<mutex> guard(srv.queue_lock);
+        srv.queue.push_back(&job);
+        srv.queue_ready.notify_one();
+        srv.jobs_done.wait(guard, [&]() {return job.done;});
+    }
+    else {
+        evaluate(job.mixture->mix, job.mode, job.phase, job.states, job.results);
+    }
+
+    vector<int32_t> states_status(job.results.status.begin(), job.results.status.end());
+    append(response, states_status.data(), states_status.size());
+    append(response, job.results.values.data(), job.results.values.size());
+    return PCSAFT_OK;
+}
+
+
+static void serve_connection(server_state &srv, int fd) {
+    vector<char> payload, response;
+    msg_header request;
+    while (read_all(fd, &request, sizeof(request)) && request.length <= MAX_PAYLOAD) {
+        payload.resize(request.length);
+        if (!read_all(fd, payload.data(), payload.size())) {
+            break;
+        }
+        response.assign(sizeof(msg_header), 0);
+        int status = handle_request(srv, request, payload, response);
+        if (status != PCSAFT_OK) {
+            response.resize(sizeof(msg_header));
+        }
+        msg_header header = {(uint32_t)(response.size() - sizeof(msg_header)), request.op, (int16_t)status,
+            request.tag};
+        memcpy(response.data(), &header, sizeof(header));
+        if (!write_all(fd, response.data(), response.size())) {
+            break;
+        }
+    }
+    close(fd);
+}
+
+
+static int open_socket(const char *path) {
+    /**Bind and listen on a Unix domain socket. A socket file left by a server that stopped is replaced.*/
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "the socket path %s is too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+    if (access(path, F_OK) == 0) {
+        if (connect(fd, (sockaddr *)&addr, sizeof(addr)) == 0) {
+            fprintf(stderr, "a server is already listening on %s\n", path);
+            close(fd);
+            return -1;
+        }
+        unlink(path);
+        close(fd);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    }
+    if (bind(fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        fprintf(stderr, "cannot listen on %s: %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+static int usage(const char *name) {
+    fprintf(stderr, "usage: %s --socket PATH [--cache N] [--threads N] [--quiet]\n", name);
+    return 2;
+}
+
+
+int main(int argc, char **argv) {
+    const char *socket_path = NULL;
+    int nthreads = 0;
+    server_state *srv = new server_state(); // not freed: the connections may still use it at exit
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--quiet") {
+            srv->quiet = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            return usage(argv[0]);
+        }
+        const char *value = argv[++i];
+        if (arg == "--socket") socket_path = value;
+        else if (arg == "--cache" && atol(value) >= 0) srv->cache_capacity = atol(value);
+        else if (arg == "--threads" && atoi(value) > 0) nthreads = atoi(value);
+        else return usage(argv[0]);
+    }
+    if (socket_path == NULL) {
+        return usage(argv[0]);
+    }
+
+    int listen_fd = open_socket(socket_path);
+    if (listen_fd < 0) {
+        return 2;
+    }
+    // no SA_RESTART, so that accept returns when the server is stopped
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    thread(dispatch, ref(*srv), nthreads).detach();
+    if (!srv->quiet) {
+        fprintf(stderr, "listening on %s, cache of %ld results per mixture\n", socket_path, srv->cache_capacity);
+    }
+    while (!stop_requested) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            if (errno != EINTR && errno != ECONNABORTED) {
+                perror("accept");
+                break;
+            }
+            continue;
+        }
+        thread(serve_connection, ref(*srv), fd).detach();
+    }
+    close(listen_fd);
+    unlink(socket_path);
+    if (!srv->quiet) {
+        fprintf(stderr, "stopped after %lld requests with %lld states in %lld batches\n",
+            (long long)srv->nrequests, (long long)srv->nstates, (long long)srv->nbatches);
+    }
+    return stop_requested ? 0 : 1;
+}